@@ -0,0 +1,970 @@
+#include <bloom/binary-fuse-filter.hpp>
+#include <bloom/blocked-filter.hpp>
+#include <bloom/concurrent-filter.hpp>
+#include <bloom/counting-filter.hpp>
+#include <bloom/cuckoo-filter.hpp>
+#include <bloom/filter.hpp>
+#include <bloom/mapped-filter.hpp>
+#include <bloom/partitioned-filter.hpp>
+#include <bloom/scalable-filter.hpp>
+#include <bloom/reduce.hpp>
+#include <bloom/sliding-window-filter.hpp>
+#include <bloom/split-block-filter.hpp>
+#include <bloom/static-filter.hpp>
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
+namespace {
+/// The width of the keys used throughout these benchmarks.
+constexpr size_t kKeyWidth = 64;
+
+/// The number of distinct keys inserted. Enough for the probes of large
+/// filters to miss in the cache.
+constexpr size_t kKeyCount = 1 << 16;
+
+using Key = std::array<uint8_t, kKeyWidth>;
+
+/// Returns `count` distinct keys of `kKeyWidth` bytes each.
+std::vector<Key> make_keys(size_t count) {
+  std::vector<Key> keys(count);
+  for (size_t i = 0; i < count; ++i) {
+    for (size_t byte = 0; byte < kKeyWidth; ++byte) {
+      keys[i][byte] = static_cast<uint8_t>((i >> ((byte % 8) * 8)) + byte);
+    }
+  }
+  return keys;
+}
+
+/// Constructs a `Filter` using `hash_count` independently seeded
+/// `DefaultHasher`s, i.e. one full pass over the key per probe.
+Bloom::Filter make_independent_filter(size_t size, size_t hash_count) {
+  std::vector<Bloom::Filter::Hasher> hashers;
+  for (size_t seed = 0; seed < hash_count; ++seed) {
+    hashers.emplace_back(Bloom::DefaultHasher(static_cast<uint32_t>(seed)));
+  }
+  return {size, hashers.begin(), hashers.end()};
+}
+
+/// Constructs a `Filter` that derives all probes from a single digest.
+Bloom::Filter make_double_hashing_filter(size_t size, size_t hash_count) {
+  return {Bloom::Options(size, hash_count), Bloom::DoubleHasher(0)};
+}
+
+/// Constructs a `BasicFilter` like `make_independent_filter()`, but calling
+/// the `DefaultHasher`s directly instead of through a `std::function`.
+Bloom::BasicFilter<Bloom::IndependentHashing<Bloom::DefaultHasher>>
+make_inlined_independent_filter(size_t size, size_t hash_count) {
+  std::vector<Bloom::DefaultHasher> hashers;
+  for (size_t seed = 0; seed < hash_count; ++seed) {
+    hashers.emplace_back(static_cast<uint32_t>(seed));
+  }
+  return {size, hashers.begin(), hashers.end()};
+}
+
+/// Constructs a `BasicFilter` like `make_double_hashing_filter()`, but without
+/// the runtime choice between digests and user provided hash functions.
+Bloom::BasicFilter<Bloom::DigestHashing<>> make_digest_filter(
+    size_t size, size_t hash_count) {
+  return {Bloom::Options(size, hash_count), Bloom::DoubleHasher(0)};
+}
+
+template <typename Filter>
+void put(benchmark::State& state, Filter filter) {
+  const auto keys = make_keys(kKeyCount);
+  benchmark::DoNotOptimize(&filter);
+  size_t i = 0;
+  for (auto _ : state) {
+    filter.put(keys[i++ % keys.size()]);
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+template <typename Filter>
+void query(benchmark::State& state, Filter filter) {
+  const auto keys = make_keys(2 * kKeyCount);
+  for (size_t i = 0; i < keys.size(); i += 2) {
+    filter.put(keys[i]);
+  }
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(filter.query(keys[i++ % keys.size()]));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+/// Queries the keys in vectors of 1024 keys with `query_batch()`.
+template <typename Filter>
+void query_batch(benchmark::State& state, Filter filter) {
+  const auto keys = make_keys(2 * kKeyCount);
+  for (size_t i = 0; i < keys.size(); i += 2) {
+    filter.put(keys[i]);
+  }
+  const size_t vector_size = 1024;
+  bool results[vector_size];
+  size_t start = 0;
+  for (auto _ : state) {
+    filter.query_batch(keys.data() + start, vector_size, results);
+    benchmark::DoNotOptimize(results);
+    start = (start + vector_size) % keys.size();
+  }
+  state.SetItemsProcessed(state.iterations() * vector_size);
+}
+
+void BM_FilterPutIndependentHashing(benchmark::State& state) {
+  put(state, make_independent_filter(state.range(0), state.range(1)));
+}
+
+void BM_FilterPutDoubleHashing(benchmark::State& state) {
+  put(state, make_double_hashing_filter(state.range(0), state.range(1)));
+}
+
+void BM_FilterQueryIndependentHashing(benchmark::State& state) {
+  query(state, make_independent_filter(state.range(0), state.range(1)));
+}
+
+void BM_FilterQueryDoubleHashing(benchmark::State& state) {
+  query(state, make_double_hashing_filter(state.range(0), state.range(1)));
+}
+
+void BM_BasicFilterQueryIndependentHashing(benchmark::State& state) {
+  query(state, make_inlined_independent_filter(state.range(0), state.range(1)));
+}
+
+void BM_BasicFilterQueryDigestHashing(benchmark::State& state) {
+  query(state, make_digest_filter(state.range(0), state.range(1)));
+}
+
+void BM_InstrumentedFilterPut(benchmark::State& state) {
+  put(state,
+      Bloom::InstrumentedFilter(Bloom::Options(state.range(0), state.range(1)),
+                                Bloom::DoubleHasher(0)));
+}
+
+void BM_InstrumentedFilterQuery(benchmark::State& state) {
+  query(state,
+        Bloom::InstrumentedFilter(
+            Bloom::Options(state.range(0), state.range(1)),
+            Bloom::DoubleHasher(0)));
+}
+
+void BM_FilterQueryBatchDoubleHashing(benchmark::State& state) {
+  query_batch(state,
+              make_double_hashing_filter(state.range(0), state.range(1)));
+}
+
+/// Composite keys of a tenant, a user and a path of `state.range(0)` bytes.
+struct CompositeKeys {
+  explicit CompositeKeys(size_t path_size) : paths(kKeyCount) {
+    for (size_t i = 0; i < kKeyCount; ++i) {
+      paths[i] = std::string(path_size, 'a') + std::to_string(i);
+    }
+  }
+
+  std::vector<std::string> paths;
+};
+
+/// Queries composite keys, passing their parts to `query()` as they are.
+void BM_FilterQueryParts(benchmark::State& state) {
+  const CompositeKeys keys(state.range(0));
+  auto filter = make_double_hashing_filter(1 << 24, 7);
+  size_t i = 0;
+  for (auto _ : state) {
+    const auto& path = keys.paths[i++ % kKeyCount];
+    benchmark::DoNotOptimize(filter.query(uint64_t{i}, uint32_t{7}, path));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+/// Queries the same composite keys as `BM_FilterQueryParts`, but copied into
+/// one buffer first.
+void BM_FilterQueryConcatenated(benchmark::State& state) {
+  const CompositeKeys keys(state.range(0));
+  auto filter = make_double_hashing_filter(1 << 24, 7);
+  size_t i = 0;
+  for (auto _ : state) {
+    const auto& path = keys.paths[i++ % kKeyCount];
+    const uint64_t tenant = i;
+    const uint32_t user = 7;
+    std::string key(reinterpret_cast<const char*>(&tenant), sizeof tenant);
+    key.append(reinterpret_cast<const char*>(&user), sizeof user);
+    key += path;
+    benchmark::DoNotOptimize(filter.query(key));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+/// Queries a `Filter` whose bits are backed as given by `state.range(2)`.
+void BM_FilterQueryPageMode(benchmark::State& state) {
+  Bloom::Options options(state.range(0), state.range(1));
+  options.page_mode = static_cast<Bloom::PageMode>(state.range(2));
+  query(state, Bloom::Filter(options, Bloom::DoubleHasher(0)));
+}
+
+void BM_FilterClear(benchmark::State& state) {
+  Bloom::Filter filter(state.range(0), 3);
+  for (auto _ : state) {
+    filter.clear();
+    benchmark::ClobberMemory();
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0) / 8);
+}
+
+/// Builds a `Filter` of `state.range(0)` bits on `state.range(1)` threads,
+/// from enough keys for several rounds of each thread.
+void BM_FilterBuild(benchmark::State& state) {
+  const auto keys = make_keys(16 * kKeyCount);
+  const Bloom::Options options(state.range(0), 7);
+  for (auto _ : state) {
+    auto filter = Bloom::Filter::build(keys.begin(),
+                                       keys.end(),
+                                       options,
+                                       Bloom::DoubleHasher(0),
+                                       state.range(1));
+    benchmark::DoNotOptimize(filter.bits().words());
+  }
+  state.SetItemsProcessed(state.iterations() * keys.size());
+}
+
+/// Constructs small filters with 20 independent hash functions, each seeded
+/// randomly (`state.range(0) == 0`) or derived from `Options::seed`.
+void BM_FilterConstructIndependentHashing(benchmark::State& state) {
+  Bloom::Options options(1024, 20);
+  if (state.range(0) != 0) options.seed = 42;
+  for (auto _ : state) {
+    Bloom::BasicFilter<Bloom::IndependentHashing<Bloom::DefaultHasher>> filter(
+        options);
+    benchmark::DoNotOptimize(filter.bits().words());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+void BM_FilterMerge(benchmark::State& state) {
+  const Bloom::Options options(state.range(0), 3);
+  Bloom::Filter filter(options, Bloom::DoubleHasher(0));
+  const Bloom::Filter other(options, Bloom::DoubleHasher(0));
+  for (auto _ : state) {
+    filter.merge(other);
+    benchmark::ClobberMemory();
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0) / 8);
+}
+
+void BM_FilterEstimatedCardinality(benchmark::State& state) {
+  Bloom::Filter filter(state.range(0), 3);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(filter.estimated_cardinality());
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0) / 8);
+}
+
+void BM_BlockedFilterPut(benchmark::State& state) {
+  put(state,
+      Bloom::BlockedFilter(Bloom::Options(state.range(0), state.range(1)),
+                           Bloom::DoubleHasher(0)));
+}
+
+void BM_BlockedFilterQuery(benchmark::State& state) {
+  query(state,
+        Bloom::BlockedFilter(Bloom::Options(state.range(0), state.range(1)),
+                             Bloom::DoubleHasher(0)));
+}
+
+void BM_CountingFilterPut(benchmark::State& state) {
+  put(state,
+      Bloom::CountingFilter<>(Bloom::Options(state.range(0), state.range(1)),
+                              Bloom::DoubleHasher(0)));
+}
+
+void BM_CountingFilterQuery(benchmark::State& state) {
+  query(state,
+        Bloom::CountingFilter<>(Bloom::Options(state.range(0), state.range(1)),
+                                Bloom::DoubleHasher(0)));
+}
+
+/// Removes and re-inserts keys, keeping the filter at a constant load.
+void BM_CountingFilterRemove(benchmark::State& state) {
+  Bloom::CountingFilter<> filter(
+      Bloom::Options(state.range(0), state.range(1)), Bloom::DoubleHasher(0));
+  const auto keys = make_keys(kKeyCount);
+  for (const auto& key : keys) {
+    filter.put(key);
+  }
+  size_t i = 0;
+  for (auto _ : state) {
+    const auto& key = keys[i++ % keys.size()];
+    benchmark::DoNotOptimize(filter.remove(key));
+    filter.put(key);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+/// Fills a `CuckooFilter` with `state.range(0)` keys, then removes and
+/// re-inserts keys, keeping the filter at a constant load.
+template <size_t FingerprintBits>
+void BM_CuckooFilterRemove(benchmark::State& state) {
+  Bloom::CuckooFilter<FingerprintBits> filter(state.range(0),
+                                              Bloom::DoubleHasher(0));
+  const auto keys = make_keys(state.range(0));
+  for (const auto& key : keys) {
+    filter.put(key);
+  }
+  size_t i = 0;
+  for (auto _ : state) {
+    const auto& key = keys[i++ % keys.size()];
+    benchmark::DoNotOptimize(filter.remove(key));
+    filter.put(key);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+/// Queries a `CuckooFilter` holding `state.range(0)` keys with as many keys
+/// again that were not inserted.
+template <size_t FingerprintBits>
+void BM_CuckooFilterQuery(benchmark::State& state) {
+  Bloom::CuckooFilter<FingerprintBits> filter(state.range(0),
+                                              Bloom::DoubleHasher(0));
+  const auto keys = make_keys(2 * state.range(0));
+  for (int64_t i = 0; i < state.range(0); ++i) {
+    filter.put(keys[i]);
+  }
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(filter.query(keys[i++ % keys.size()]));
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.counters["bits_per_key"] =
+      static_cast<double>(filter.size()) / state.range(0);
+}
+
+/// Like `BM_CuckooFilterQuery<FingerprintBits>`, but for a `Filter` sized for
+/// the same false positive rate as a full `CuckooFilter<FingerprintBits>`.
+template <size_t FingerprintBits>
+void BM_FilterQueryAtCuckooRate(benchmark::State& state) {
+  static const double kLn2 = std::log(2.0);
+  const double rate = 8.0 * 0.95 / (size_t{1} << FingerprintBits);
+  const auto size = static_cast<size_t>(
+      std::ceil(-state.range(0) * std::log(rate) / (kLn2 * kLn2)));
+  Bloom::Filter filter(Bloom::Options::ForExpectedCount(size, state.range(0)),
+                       Bloom::DoubleHasher(0));
+  const auto keys = make_keys(2 * state.range(0));
+  for (int64_t i = 0; i < state.range(0); ++i) {
+    filter.put(keys[i]);
+  }
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(filter.query(keys[i++ % keys.size()]));
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.counters["bits_per_key"] =
+      static_cast<double>(filter.size()) / state.range(0);
+}
+
+void BM_SplitBlockFilterPut(benchmark::State& state) {
+  put(state,
+      Bloom::SplitBlockFilter(state.range(0),
+                              Bloom::DoubleHasher(0),
+                              static_cast<Bloom::Isa>(state.range(1))));
+}
+
+void BM_SplitBlockFilterQuery(benchmark::State& state) {
+  query(state,
+        Bloom::SplitBlockFilter(state.range(0),
+                                Bloom::DoubleHasher(0),
+                                static_cast<Bloom::Isa>(state.range(1))));
+}
+
+void BM_SplitBlockFilterQueryBatch(benchmark::State& state) {
+  Bloom::SplitBlockFilter filter(state.range(0),
+                                 Bloom::DoubleHasher(0),
+                                 static_cast<Bloom::Isa>(state.range(1)));
+  const auto keys = make_keys(2 * kKeyCount);
+  for (size_t i = 0; i < keys.size(); i += 2) {
+    filter.put(keys[i]);
+  }
+  const std::vector<Bloom::Slice> slices(keys.begin(), keys.end());
+  std::unique_ptr<bool[]> results(new bool[slices.size()]);
+  for (auto _ : state) {
+    filter.query_batch(slices.data(), slices.size(), results.get());
+    benchmark::DoNotOptimize(results.get());
+  }
+  state.SetItemsProcessed(state.iterations() * slices.size());
+}
+
+/// Returns the `ConcurrentFilter` of the given size shared by all threads of
+/// a multi-threaded benchmark, with every other key of `keys` inserted.
+Bloom::ConcurrentFilter& shared_filter(int64_t size,
+                                       const std::vector<Key>& keys) {
+  static std::mutex mutex;
+  static std::map<int64_t, std::unique_ptr<Bloom::ConcurrentFilter>> filters;
+  std::lock_guard<std::mutex> lock(mutex);
+  auto& filter = filters[size];
+  if (!filter) {
+    filter.reset(new Bloom::ConcurrentFilter(Bloom::Options(size, 7),
+                                             Bloom::DoubleHasher(0)));
+    for (size_t i = 0; i < keys.size(); i += 2) {
+      filter->put(keys[i]);
+    }
+  }
+  return *filter;
+}
+
+/// Each thread inserts its own slice of the keys into one shared filter.
+void BM_ConcurrentFilterPut(benchmark::State& state) {
+  static const auto keys = make_keys(2 * kKeyCount);
+  auto& filter = shared_filter(state.range(0), keys);
+  size_t i = state.thread_index();
+  for (auto _ : state) {
+    filter.put(keys[i % keys.size()]);
+    i += state.threads();
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+/// Each thread queries its own slice of the keys from one shared filter.
+void BM_ConcurrentFilterQuery(benchmark::State& state) {
+  static const auto keys = make_keys(2 * kKeyCount);
+  const auto& filter = shared_filter(state.range(0), keys);
+  size_t i = state.thread_index();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(filter.query(keys[i % keys.size()]));
+    i += state.threads();
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+/// A scalable filter starting at `state.range(0)` keys, which grows to hold
+/// the `kKeyCount` keys inserted.
+void BM_ScalableFilterPut(benchmark::State& state) {
+  put(state,
+      Bloom::ScalableFilter(state.range(0), 0.01, Bloom::DoubleHasher(0)));
+}
+
+void BM_ScalableFilterQuery(benchmark::State& state) {
+  query(state,
+        Bloom::ScalableFilter(state.range(0), 0.01, Bloom::DoubleHasher(0)));
+}
+
+void BM_SlidingWindowFilterQuery(benchmark::State& state) {
+  query(state,
+        Bloom::SlidingWindowFilter<>(
+            Bloom::Options(state.range(0), state.range(1)),
+            Bloom::DoubleHasher(0)));
+}
+
+/// Queries eight `Filter`s, one per generation, as a `SlidingWindowFilter<8>`
+/// does in a single pass. Half of the keys are inserted, one eighth into each
+/// filter.
+void BM_RotatingFiltersQuery(benchmark::State& state) {
+  std::vector<Bloom::BasicFilter<Bloom::DigestHashing<>>> filters;
+  for (size_t g = 0; g < 8; ++g) {
+    filters.push_back(make_digest_filter(state.range(0), state.range(1)));
+  }
+  const auto keys = make_keys(2 * kKeyCount);
+  for (size_t i = 0; i < keys.size(); i += 2) {
+    filters[i / 2 % filters.size()].put(keys[i]);
+  }
+  size_t i = 0;
+  for (auto _ : state) {
+    const auto& key = keys[i++ % keys.size()];
+    benchmark::DoNotOptimize(
+        std::any_of(filters.begin(), filters.end(), [&key](const auto& f) {
+          return f.query(key);
+        }));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+/// Drops the oldest generation of a `SlidingWindowFilter<8>` of
+/// `state.range(0)` slots.
+void BM_SlidingWindowFilterAdvance(benchmark::State& state) {
+  Bloom::SlidingWindowFilter<> filter(Bloom::Options(state.range(0), 7),
+                                      Bloom::DoubleHasher(0));
+  for (auto _ : state) {
+    filter.advance();
+    benchmark::ClobberMemory();
+  }
+  state.SetBytesProcessed(state.iterations() * filter.slots().word_count() *
+                          sizeof(uint64_t));
+}
+
+/// Restores the CPU affinity of the calling thread when destroyed.
+class AffinityGuard {
+ public:
+#if defined(__linux__)
+  AffinityGuard() { sched_getaffinity(0, sizeof affinity_, &affinity_); }
+  ~AffinityGuard() { sched_setaffinity(0, sizeof affinity_, &affinity_); }
+
+ private:
+  cpu_set_t affinity_;
+#endif
+};
+
+/// Queries the keys of a `PartitionedFilter` of `state.range(0)` bits with
+/// two partitions per NUMA node whose partitions are on node 0, from a thread
+/// pinned to node `state.range(1)`: local accesses for node 0, remote ones
+/// for any other node.
+void BM_PartitionedFilterQuery(benchmark::State& state) {
+  const auto node = static_cast<size_t>(state.range(1));
+  if (node >= Bloom::numa_node_count()) {
+    state.SkipWithError("no such NUMA node");
+    return;
+  }
+  Bloom::PartitionedFilter<> filter(Bloom::Options(state.range(0), 7),
+                                    2 * Bloom::numa_node_count(),
+                                    Bloom::DoubleHasher(0));
+  std::vector<Key> keys;
+  for (const auto& key : make_keys(2 * kKeyCount)) {
+    if (filter.numa_node(filter.partition_of(key)) == 0) keys.push_back(key);
+  }
+  for (size_t i = 0; i < keys.size(); i += 2) {
+    filter.put(keys[i]);
+  }
+  const AffinityGuard guard;
+  Bloom::pin_thread_to_numa_node(node);
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(filter.query(keys[i++ % keys.size()]));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+/// Builds a `BinaryFuseFilter` from `state.range(0)` keys.
+template <typename Fingerprint>
+void BM_BinaryFuseFilterBuild(benchmark::State& state) {
+  const auto keys = make_keys(state.range(0));
+  for (auto _ : state) {
+    const auto filter = Bloom::BinaryFuseFilter<Fingerprint>::build(
+        keys.begin(), keys.end(), 0);
+    benchmark::DoNotOptimize(filter.fingerprints());
+  }
+  state.SetItemsProcessed(state.iterations() * keys.size());
+}
+
+/// Queries a `BinaryFuseFilter` built from `state.range(0)` keys with as many
+/// keys again that it was not built from.
+template <typename Fingerprint>
+void BM_BinaryFuseFilterQuery(benchmark::State& state) {
+  const auto keys = make_keys(2 * state.range(0));
+  const auto filter = Bloom::BinaryFuseFilter<Fingerprint>::build(
+      keys.begin(), keys.begin() + state.range(0), 0);
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(filter.query(keys[i++ % keys.size()]));
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.counters["bits_per_key"] =
+      static_cast<double>(filter.size()) / state.range(0);
+}
+
+/// Saves a `Filter` of `size` bits to a file in the working directory and
+/// removes the file again at the end of the benchmark.
+struct SavedFilter {
+  explicit SavedFilter(int64_t size)
+  : path("bloom-bench-" + std::to_string(size) + ".bloom") {
+    make_double_hashing_filter(size, 7).save(path);
+  }
+
+  ~SavedFilter() { std::remove(path.c_str()); }
+
+  std::string path;
+};
+
+/// Reads (copies) a saved filter into memory.
+void BM_FilterLoad(benchmark::State& state) {
+  const SavedFilter file(state.range(0));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(Bloom::Filter::load(file.path));
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0) / 8);
+}
+
+/// Returns a `Filter` of 2^24 bits holding a key per `bits_per_key` bits.
+Bloom::Filter make_filled_filter(int64_t bits_per_key) {
+  const size_t size = size_t{1} << 24;
+  Bloom::Filter filter = make_double_hashing_filter(size, 7);
+  for (uint64_t key = 0; key < size / bits_per_key; ++key) {
+    filter.put(key);
+  }
+  return filter;
+}
+
+/// Saves `filter` in memory with the `Encoding` `state.range(1)`.
+std::string save_compressed(benchmark::State& state,
+                            const Bloom::Filter& filter) {
+  std::stringstream stream;
+  filter.save_compressed(stream,
+                         static_cast<Bloom::Encoding>(state.range(1)));
+  return stream.str();
+}
+
+/// Compresses a filter holding a key per `state.range(0)` bits with the
+/// `Encoding` `state.range(1)`.
+void BM_FilterSaveCompressed(benchmark::State& state) {
+  const auto filter = make_filled_filter(state.range(0));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(save_compressed(state, filter));
+  }
+  state.SetBytesProcessed(state.iterations() * filter.size() / 8);
+  state.counters["compression"] =
+      static_cast<double>(filter.size() / 8 + 64) /
+      save_compressed(state, filter).size();
+}
+
+/// Decodes a compressed filter, at `BM_FilterLoad()` speed for `kRaw`.
+void BM_FilterLoadCompressed(benchmark::State& state) {
+  const std::string bytes =
+      save_compressed(state, make_filled_filter(state.range(0)));
+  for (auto _ : state) {
+    std::stringstream stream(bytes);
+    benchmark::DoNotOptimize(Bloom::Filter::load_compressed(stream));
+  }
+  state.SetBytesProcessed(state.iterations() * (int64_t{1} << 24) / 8);
+}
+
+/// Maps a saved filter and queries a single key, which faults in one page.
+void BM_MappedFilterOpen(benchmark::State& state) {
+  const SavedFilter file(state.range(0));
+  for (auto _ : state) {
+    const auto filter = Bloom::MappedFilter::open(file.path);
+    benchmark::DoNotOptimize(filter.query(0));
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0) / 8);
+}
+
+void BM_StaticFilterPutIndependentHashing(benchmark::State& state) {
+  put(state, Bloom::StaticFilter<1 << 16, 10, Bloom::DefaultHasher>());
+}
+
+void BM_StaticFilterPutDoubleHashing(benchmark::State& state) {
+  put(state, Bloom::StaticFilter<1 << 16, 10>());
+}
+
+void BM_StaticFilterQueryIndependentHashing(benchmark::State& state) {
+  query(state, Bloom::StaticFilter<1 << 16, 10, Bloom::DefaultHasher>());
+}
+
+void BM_StaticFilterQueryDoubleHashing(benchmark::State& state) {
+  query(state, Bloom::StaticFilter<1 << 16, 10>());
+}
+
+void BM_StaticFilterQueryBatchDoubleHashing(benchmark::State& state) {
+  query_batch(state, Bloom::StaticFilter<1 << 16, 10>());
+}
+
+constexpr Bloom::StaticKey kReservedWords[] = {
+    Bloom::StaticKey("alignas"),   Bloom::StaticKey("alignof"),
+    Bloom::StaticKey("auto"),      Bloom::StaticKey("bool"),
+    Bloom::StaticKey("break"),     Bloom::StaticKey("case"),
+    Bloom::StaticKey("catch"),     Bloom::StaticKey("char"),
+    Bloom::StaticKey("class"),     Bloom::StaticKey("const"),
+    Bloom::StaticKey("constexpr"), Bloom::StaticKey("continue"),
+    Bloom::StaticKey("decltype"),  Bloom::StaticKey("default"),
+    Bloom::StaticKey("delete"),    Bloom::StaticKey("do"),
+    Bloom::StaticKey("double"),    Bloom::StaticKey("else"),
+    Bloom::StaticKey("enum"),      Bloom::StaticKey("explicit"),
+    Bloom::StaticKey("extern"),    Bloom::StaticKey("false"),
+    Bloom::StaticKey("float"),     Bloom::StaticKey("for"),
+    Bloom::StaticKey("friend"),    Bloom::StaticKey("goto"),
+    Bloom::StaticKey("if"),        Bloom::StaticKey("inline"),
+    Bloom::StaticKey("int"),       Bloom::StaticKey("long"),
+    Bloom::StaticKey("mutable"),   Bloom::StaticKey("namespace"),
+    Bloom::StaticKey("new"),       Bloom::StaticKey("noexcept"),
+    Bloom::StaticKey("nullptr"),   Bloom::StaticKey("operator"),
+    Bloom::StaticKey("private"),   Bloom::StaticKey("protected"),
+    Bloom::StaticKey("public"),    Bloom::StaticKey("return"),
+    Bloom::StaticKey("short"),     Bloom::StaticKey("signed"),
+    Bloom::StaticKey("sizeof"),    Bloom::StaticKey("static"),
+    Bloom::StaticKey("struct"),    Bloom::StaticKey("switch"),
+    Bloom::StaticKey("template"),  Bloom::StaticKey("this"),
+    Bloom::StaticKey("throw"),     Bloom::StaticKey("true"),
+    Bloom::StaticKey("try"),       Bloom::StaticKey("typedef"),
+    Bloom::StaticKey("typename"),  Bloom::StaticKey("union"),
+    Bloom::StaticKey("unsigned"),  Bloom::StaticKey("using"),
+    Bloom::StaticKey("virtual"),   Bloom::StaticKey("void"),
+    Bloom::StaticKey("volatile"),  Bloom::StaticKey("while")};
+
+using ReservedWordFilter = Bloom::StaticFilter<1024, 7, Bloom::WyHasher>;
+
+/// Builds the filter over `kReservedWords` at runtime: the work a filter built
+/// at compile time saves at startup.
+void BM_StaticFilterBuildAtRuntime(benchmark::State& state) {
+  for (auto _ : state) {
+    ReservedWordFilter filter(Bloom::WyHasher(42));
+    for (const auto& key : kReservedWords) filter.put(Bloom::Slice(key));
+    benchmark::DoNotOptimize(filter);
+  }
+  state.SetItemsProcessed(state.iterations() *
+                          (sizeof kReservedWords / sizeof kReservedWords[0]));
+}
+
+/// Queries identifiers in the filter over `kReservedWords` that was built at
+/// compile time (and lives in read-only memory).
+void BM_StaticFilterQueryBuiltAtCompileTime(benchmark::State& state) {
+  static constexpr auto filter =
+      ReservedWordFilter::build(kReservedWords, Bloom::WyHasher(42));
+  const std::vector<std::string> identifiers = {
+      "filter", "return", "size", "while", "key", "hasher", "index", "auto"};
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(filter.query(identifiers[i]));
+    i = (i + 1) % identifiers.size();
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+/// The sequence of pseudo-random hashes reduced by the `BM_Reduce` benchmarks.
+uint64_t next_hash(uint64_t hash) {
+  return hash * 6364136223846793005ULL + 1442695040888963407ULL;
+}
+
+/// Hashes `kKeyCount` keys of `state.range(0)` bytes with `Hasher` and reports
+/// the throughput in bytes per second.
+template <typename Hasher>
+void BM_Hash(benchmark::State& state) {
+  const auto width = static_cast<size_t>(state.range(0));
+  std::vector<uint8_t> bytes(kKeyCount + width);
+  for (size_t i = 0; i < bytes.size(); ++i) {
+    bytes[i] = static_cast<uint8_t>(next_hash(i) >> 56);
+  }
+  const Hasher hasher(0);
+  size_t offset = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(hasher(Bloom::Slice(&bytes[offset], width)));
+    offset = (offset + 1) % kKeyCount;
+  }
+  state.SetBytesProcessed(state.iterations() * width);
+}
+
+/// Hashes vectors of 1024 8-byte integer keys like `IntegerHasher`, with the
+/// kernel for the `Isa` `state.range(0)`.
+void BM_HashIntegers(benchmark::State& state) {
+  const auto isa = static_cast<Bloom::Isa>(state.range(0));
+  std::vector<uint64_t> keys(1024);
+  for (size_t i = 0; i < keys.size(); ++i) keys[i] = next_hash(i);
+  std::vector<Bloom::Digest> digests(keys.size());
+  for (auto _ : state) {
+    switch (isa) {
+#if defined(BLOOM_HAS_X86_KERNELS)
+      case Bloom::Isa::kAvx512:
+        Bloom::Detail::Avx512IntegerKernel::hash<uint64_t>(
+            keys.data(), keys.size(), 0, digests.data());
+        break;
+      case Bloom::Isa::kAvx2:
+        Bloom::Detail::Avx2IntegerKernel::hash<uint64_t>(
+            keys.data(), keys.size(), 0, digests.data());
+        break;
+#endif
+      default:
+        Bloom::Detail::hash_integers_scalar<uint64_t>(
+            keys.data(), keys.size(), 0, digests.data());
+    }
+    benchmark::DoNotOptimize(digests.data());
+  }
+  state.SetItemsProcessed(state.iterations() * keys.size());
+}
+
+/// Queries 8-byte integer keys of a filter of `state.range(0)` bits hashing
+/// with an `IntegerHasher`, in vectors of 1024 keys with `query_batch()` if
+/// `state.range(1)` is one, and with `query()` otherwise.
+void BM_FilterQueryIntegers(benchmark::State& state) {
+  Bloom::BasicFilter<Bloom::DigestHashing<Bloom::IntegerHasher>> filter(
+      Bloom::Options(state.range(0), 7), Bloom::IntegerHasher(0));
+  std::vector<uint64_t> keys(2 * kKeyCount);
+  for (size_t i = 0; i < keys.size(); ++i) keys[i] = next_hash(i);
+  for (size_t i = 0; i < keys.size(); i += 2) {
+    filter.put(keys[i]);
+  }
+  const size_t vector_size = 1024;
+  bool results[vector_size];
+  size_t start = 0;
+  for (auto _ : state) {
+    if (state.range(1) == 1) {
+      filter.query_batch(keys.data() + start, vector_size, results);
+    } else {
+      for (size_t i = 0; i < vector_size; ++i) {
+        results[i] = filter.query(keys[start + i]);
+      }
+    }
+    benchmark::DoNotOptimize(results);
+    start = (start + vector_size) % keys.size();
+  }
+  state.SetItemsProcessed(state.iterations() * vector_size);
+}
+
+/// Reduces hashes with `%`, as a baseline for `RangeReducer`.
+void BM_ReduceModulo(benchmark::State& state) {
+  uint64_t range = state.range(0);
+  benchmark::DoNotOptimize(range);
+  uint64_t hash = 0;
+  for (auto _ : state) {
+    hash = next_hash(hash);
+    benchmark::DoNotOptimize(hash % range);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+void BM_ReduceRangeReducer(benchmark::State& state) {
+  uint64_t range = state.range(0);
+  benchmark::DoNotOptimize(range);
+  const Bloom::RangeReducer reduce(range);
+  uint64_t hash = 0;
+  for (auto _ : state) {
+    hash = next_hash(hash);
+    benchmark::DoNotOptimize(reduce(hash));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+/// Key widths (in bytes) the hashers are benchmarked with.
+void hash_arguments(benchmark::internal::Benchmark* benchmark) {
+  for (const int64_t width : {4, 8, 16, 64, 1024}) {
+    benchmark->Arg(width);
+  }
+}
+
+/// Sizes (in bits) and hash counts the `Filter` benchmarks are run with.
+void filter_arguments(benchmark::internal::Benchmark* benchmark) {
+  for (const int64_t size : {1 << 16, 1 << 24, 1 << 30}) {
+    for (const int64_t hash_count : {3, 10}) {
+      benchmark->Args({size, hash_count});
+    }
+  }
+}
+
+/// Sizes (in bits) and the instruction sets supported by this CPU.
+void isa_arguments(benchmark::internal::Benchmark* benchmark) {
+  for (const int64_t size : {1 << 16, 1 << 24, 1 << 30}) {
+    for (const auto isa : {Bloom::Isa::kScalar,
+                           Bloom::Isa::kSse42,
+                           Bloom::Isa::kAvx2,
+                           Bloom::Isa::kAvx512}) {
+      if (Bloom::cpu_supports(isa)) {
+        benchmark->Args({size, static_cast<int64_t>(isa)});
+      }
+    }
+  }
+}
+}  // namespace
+
+BENCHMARK_TEMPLATE(BM_Hash, Bloom::DefaultHasher)->Apply(hash_arguments);
+BENCHMARK_TEMPLATE(BM_Hash, Bloom::DoubleHasher)->Apply(hash_arguments);
+BENCHMARK_TEMPLATE(BM_Hash, Bloom::WyHasher64)->Apply(hash_arguments);
+BENCHMARK_TEMPLATE(BM_Hash, Bloom::WyHasher)->Apply(hash_arguments);
+BENCHMARK_TEMPLATE(BM_Hash, Bloom::IntegerHasher)->Apply(hash_arguments);
+BENCHMARK_TEMPLATE(BM_Hash, Bloom::SipHasher)->Apply(hash_arguments);
+BENCHMARK(BM_HashIntegers)->Apply([](benchmark::internal::Benchmark* b) {
+  for (const auto isa :
+       {Bloom::Isa::kScalar, Bloom::Isa::kAvx2, Bloom::Isa::kAvx512}) {
+    if (Bloom::cpu_supports(isa)) b->Arg(static_cast<int64_t>(isa));
+  }
+});
+BENCHMARK(BM_FilterQueryIntegers)->ArgsProduct({{1 << 16, 1 << 20}, {0, 1}});
+BENCHMARK(BM_ReduceModulo)->Arg(1 << 20)->Arg(1000003);
+BENCHMARK(BM_ReduceRangeReducer)->Arg(1 << 20)->Arg(1000003);
+BENCHMARK(BM_FilterPutIndependentHashing)->Apply(filter_arguments);
+BENCHMARK(BM_FilterPutDoubleHashing)->Apply(filter_arguments);
+BENCHMARK(BM_FilterQueryIndependentHashing)->Apply(filter_arguments);
+BENCHMARK(BM_FilterQueryDoubleHashing)->Apply(filter_arguments);
+BENCHMARK(BM_BasicFilterQueryIndependentHashing)->Apply(filter_arguments);
+BENCHMARK(BM_BasicFilterQueryDigestHashing)->Apply(filter_arguments);
+BENCHMARK(BM_FilterQueryBatchDoubleHashing)->Apply(filter_arguments);
+BENCHMARK(BM_InstrumentedFilterPut)->Apply(filter_arguments);
+BENCHMARK(BM_InstrumentedFilterQuery)->Apply(filter_arguments);
+BENCHMARK(BM_FilterQueryParts)->Arg(8)->Arg(64);
+BENCHMARK(BM_FilterQueryConcatenated)->Arg(8)->Arg(64);
+BENCHMARK(BM_FilterQueryPageMode)
+    ->Args({1 << 30, 3, static_cast<int64_t>(Bloom::PageMode::kDefault)})
+    ->Args({1 << 30,
+            3,
+            static_cast<int64_t>(Bloom::PageMode::kTransparentHugePages)});
+BENCHMARK(BM_FilterClear)->Arg(1 << 24)->Arg(1 << 30);
+BENCHMARK(BM_FilterConstructIndependentHashing)->Arg(0)->Arg(1);
+BENCHMARK(BM_FilterBuild)
+    ->ArgsProduct({{1 << 24, 1 << 30}, {1, 2, 4, 8}})
+    ->UseRealTime();
+BENCHMARK(BM_FilterMerge)->Arg(1 << 24)->Arg(1 << 30);
+BENCHMARK(BM_FilterEstimatedCardinality)->Arg(1 << 24)->Arg(1 << 30);
+BENCHMARK(BM_BlockedFilterPut)->Apply(filter_arguments);
+BENCHMARK(BM_BlockedFilterQuery)->Apply(filter_arguments);
+BENCHMARK(BM_CountingFilterPut)->Apply(filter_arguments);
+BENCHMARK(BM_CountingFilterQuery)->Apply(filter_arguments);
+BENCHMARK(BM_CountingFilterRemove)->Apply(filter_arguments);
+BENCHMARK_TEMPLATE(BM_CuckooFilterRemove, 12)
+    ->Arg(kKeyCount)
+    ->Arg(16 * kKeyCount);
+BENCHMARK_TEMPLATE(BM_CuckooFilterQuery, 8)
+    ->Arg(kKeyCount)
+    ->Arg(16 * kKeyCount);
+BENCHMARK_TEMPLATE(BM_CuckooFilterQuery, 12)
+    ->Arg(kKeyCount)
+    ->Arg(16 * kKeyCount);
+BENCHMARK_TEMPLATE(BM_CuckooFilterQuery, 16)
+    ->Arg(kKeyCount)
+    ->Arg(16 * kKeyCount);
+BENCHMARK_TEMPLATE(BM_FilterQueryAtCuckooRate, 8)
+    ->Arg(kKeyCount)
+    ->Arg(16 * kKeyCount);
+BENCHMARK_TEMPLATE(BM_FilterQueryAtCuckooRate, 12)
+    ->Arg(kKeyCount)
+    ->Arg(16 * kKeyCount);
+BENCHMARK_TEMPLATE(BM_FilterQueryAtCuckooRate, 16)
+    ->Arg(kKeyCount)
+    ->Arg(16 * kKeyCount);
+BENCHMARK(BM_SplitBlockFilterPut)->Apply(isa_arguments);
+BENCHMARK(BM_SplitBlockFilterQuery)->Apply(isa_arguments);
+BENCHMARK(BM_SplitBlockFilterQueryBatch)->Apply(isa_arguments);
+BENCHMARK(BM_ConcurrentFilterPut)
+    ->Arg(1 << 20)
+    ->Arg(1 << 30)
+    ->ThreadRange(1, 64)
+    ->UseRealTime();
+BENCHMARK(BM_ConcurrentFilterQuery)
+    ->Arg(1 << 20)
+    ->Arg(1 << 30)
+    ->ThreadRange(1, 64)
+    ->UseRealTime();
+BENCHMARK(BM_ScalableFilterPut)->Arg(1 << 10)->Arg(kKeyCount);
+BENCHMARK(BM_ScalableFilterQuery)->Arg(1 << 10)->Arg(kKeyCount);
+BENCHMARK(BM_SlidingWindowFilterQuery)->Apply(filter_arguments);
+BENCHMARK(BM_RotatingFiltersQuery)->Apply(filter_arguments);
+BENCHMARK(BM_SlidingWindowFilterAdvance)->Arg(1 << 16)->Arg(1 << 24);
+BENCHMARK(BM_PartitionedFilterQuery)
+    ->ArgsProduct({{1 << 24, 1 << 30}, {0, 1}});
+BENCHMARK_TEMPLATE(BM_BinaryFuseFilterBuild, uint8_t)
+    ->Arg(kKeyCount)
+    ->Arg(16 * kKeyCount);
+BENCHMARK_TEMPLATE(BM_BinaryFuseFilterQuery, uint8_t)
+    ->Arg(kKeyCount)
+    ->Arg(16 * kKeyCount);
+BENCHMARK_TEMPLATE(BM_BinaryFuseFilterQuery, uint16_t)
+    ->Arg(kKeyCount)
+    ->Arg(16 * kKeyCount);
+BENCHMARK(BM_FilterLoad)->Arg(1 << 24)->Arg(int64_t{1} << 32);
+BENCHMARK(BM_MappedFilterOpen)->Arg(1 << 24)->Arg(int64_t{1} << 32);
+BENCHMARK(BM_FilterSaveCompressed)->ArgsProduct({{10, 1000}, {1, 2, 3}});
+BENCHMARK(BM_FilterLoadCompressed)->ArgsProduct({{10, 1000}, {1, 2, 3}});
+BENCHMARK(BM_StaticFilterPutIndependentHashing);
+BENCHMARK(BM_StaticFilterPutDoubleHashing);
+BENCHMARK(BM_StaticFilterQueryIndependentHashing);
+BENCHMARK(BM_StaticFilterQueryDoubleHashing);
+BENCHMARK(BM_StaticFilterQueryBatchDoubleHashing);
+BENCHMARK(BM_StaticFilterBuildAtRuntime);
+BENCHMARK(BM_StaticFilterQueryBuiltAtCompileTime);
@@ -0,0 +1,355 @@
+/// The `Matrix` benchmarks measure `Filter` and `StaticFilter` across filter
+/// sizes (from L1 resident to 8 GiB), hash counts (1 to 16), key widths (4, 16
+/// and 256 bytes) and thread counts. Besides the time per operation and keys
+/// per second, every benchmark reports:
+///
+/// - `fpr`: the empirical false positive rate of the filter as queried,
+/// - `expected_fpr`: the false positive rate predicted for its load,
+/// - `cache_misses`: last level cache misses per operation, if the kernel
+///   allows reading hardware performance counters (Linux only).
+///
+/// Run them with `--benchmark_filter=Matrix --benchmark_format=json` (or the
+/// `bloom-bench-report` target) for machine-readable results.
+
+#include <bloom/filter.hpp>
+#include <bloom/static-filter.hpp>
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+/// The number of keys the timed loops cycle through. Even keys are inserted,
+/// odd keys are not and measure the false positive rate.
+constexpr size_t kPoolKeys = size_t{1} << 16;
+
+/// The maximum number of keys inserted before measuring queries. Large filters
+/// stay below their optimal load, since filling them would take minutes.
+constexpr size_t kMaxFillKeys = size_t{1} << 21;
+
+/// Writes key number `number` to the `width` bytes at `key`: the number itself
+/// followed by bytes derived from it. Keys of four bytes are distinct for
+/// numbers below 2^32.
+void write_key(uint64_t number, uint8_t* key, size_t width) noexcept {
+  uint64_t state = number;
+  for (size_t byte = 0; byte < width; byte += 8) {
+    std::memcpy(key + byte, &state, std::min<size_t>(8, width - byte));
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+  }
+}
+
+/// A contiguous array of the first `count` keys of `width` bytes.
+class KeyPool {
+ public:
+  KeyPool(size_t count, size_t width) : width_(width), bytes_(count * width) {
+    for (size_t i = 0; i < count; ++i) {
+      write_key(i, &bytes_[i * width], width);
+    }
+  }
+
+  /// Returns key `i` modulo the size of the pool.
+  Bloom::Slice operator[](size_t i) const noexcept {
+    return {&bytes_[(i % size()) * width_], width_};
+  }
+
+  size_t size() const noexcept { return bytes_.size() / width_; }
+
+ private:
+  size_t width_;
+  std::vector<uint8_t> bytes_;
+};
+
+/// Counts last level cache misses of the calling thread, where the kernel
+/// allows it. `available()` is `false` otherwise.
+class CacheMissCounter {
+ public:
+  CacheMissCounter() {
+#if defined(__linux__)
+    perf_event_attr attributes;
+    std::memset(&attributes, 0, sizeof attributes);
+    attributes.type = PERF_TYPE_HARDWARE;
+    attributes.size = sizeof attributes;
+    attributes.config = PERF_COUNT_HW_CACHE_MISSES;
+    attributes.exclude_kernel = 1;
+    attributes.exclude_hv = 1;
+    descriptor_ = static_cast<int>(
+        syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0));
+#endif
+  }
+
+  ~CacheMissCounter() {
+#if defined(__linux__)
+    if (available()) close(descriptor_);
+#endif
+  }
+
+  CacheMissCounter(const CacheMissCounter&) = delete;
+  CacheMissCounter& operator=(const CacheMissCounter&) = delete;
+
+  bool available() const noexcept { return descriptor_ >= 0; }
+
+  /// Returns the number of misses counted so far.
+  uint64_t read() const noexcept {
+    uint64_t count = 0;
+#if defined(__linux__)
+    if (available() && ::read(descriptor_, &count, sizeof count) < 0) {
+      count = 0;
+    }
+#endif
+    return count;
+  }
+
+ private:
+  int descriptor_ = -1;
+};
+
+/// Returns `true` if a filter of `bits` bits fits into (half of) the physical
+/// memory of this machine.
+bool fits_in_memory(uint64_t bits) {
+#if defined(__linux__)
+  const auto pages = sysconf(_SC_PHYS_PAGES);
+  const auto page_size = sysconf(_SC_PAGE_SIZE);
+  if (pages > 0 && page_size > 0) {
+    return bits / 8 <= static_cast<uint64_t>(pages) * page_size / 2;
+  }
+#endif
+  return true;
+}
+
+/// Returns the number of keys that makes `hash_count` optimal for a filter of
+/// `size` bits, at most `kMaxFillKeys`.
+size_t fill_count(uint64_t size, uint64_t hash_count) {
+  const double optimal = size * std::log(2.0) / hash_count;
+  return std::min(kMaxFillKeys, static_cast<size_t>(optimal));
+}
+
+/// Inserts `fill_count()` keys into `filter`: even keys of the pool first,
+/// then keys of `width` bytes that are disjoint from the pool. Returns the
+/// number of keys inserted.
+template <typename Filter>
+size_t fill(Filter& filter, const KeyPool& keys, size_t width) {
+  const size_t count = fill_count(filter.size(), filter.hash_count());
+  const size_t from_pool = std::min(count, keys.size() / 2);
+  for (size_t i = 0; i < from_pool; ++i) {
+    filter.put(keys[2 * i]);
+  }
+  std::vector<uint8_t> key(width);
+  for (size_t i = from_pool; i < count; ++i) {
+    write_key(kPoolKeys + i, key.data(), width);
+    filter.put(Bloom::Slice(key.data(), width));
+  }
+  return count;
+}
+
+/// Queries the pool keys from `filter`, into which `fill()` inserted
+/// `inserted` keys, and reports the counters.
+template <typename Filter>
+void query_loop(benchmark::State& state,
+                const Filter& filter,
+                const KeyPool& keys,
+                size_t inserted) {
+  CacheMissCounter misses;
+  const uint64_t misses_before = misses.read();
+  uint64_t false_positives = 0;
+  uint64_t negatives = 0;
+  // Each thread starts at its own offset, and sees inserted (even) and
+  // missing (odd) keys alike.
+  size_t i = keys.size() / static_cast<size_t>(state.threads()) *
+             static_cast<size_t>(state.thread_index());
+  for (auto _ : state) {
+    const bool found = filter.query(keys[i]);
+    benchmark::DoNotOptimize(found);
+    if (i % 2 == 1) {
+      false_positives += found ? 1 : 0;
+      ++negatives;
+    }
+    ++i;
+  }
+  const uint64_t misses_after = misses.read();
+  state.SetItemsProcessed(state.iterations());
+  state.counters["fpr"] = benchmark::Counter(
+      negatives == 0 ? 0 : static_cast<double>(false_positives) / negatives,
+      benchmark::Counter::kAvgThreads);
+  state.counters["expected_fpr"] = benchmark::Counter(
+      Bloom::Detail::false_positive_rate(filter.size(),
+                                         filter.hash_count(),
+                                         static_cast<double>(inserted)),
+      benchmark::Counter::kAvgThreads);
+  if (misses.available()) {
+    state.counters["cache_misses"] =
+        benchmark::Counter(static_cast<double>(misses_after - misses_before),
+                           benchmark::Counter::kAvgIterations);
+  }
+}
+
+/// Inserts the pool keys into `filter` and reports the counters.
+template <typename Filter>
+void put_loop(benchmark::State& state, Filter& filter, const KeyPool& keys) {
+  CacheMissCounter misses;
+  const uint64_t misses_before = misses.read();
+  size_t i = 0;
+  for (auto _ : state) {
+    filter.put(keys[i++]);
+    benchmark::ClobberMemory();
+  }
+  const uint64_t misses_after = misses.read();
+  state.SetItemsProcessed(state.iterations());
+  if (misses.available()) {
+    state.counters["cache_misses"] =
+        benchmark::Counter(static_cast<double>(misses_after - misses_before),
+                           benchmark::Counter::kAvgIterations);
+  }
+}
+
+/// A `Filter` of `size` bits with `hash_count` hash functions, the pool of
+/// keys of `width` bytes it is queried with and the number of keys inserted.
+struct FilledFilter {
+  FilledFilter(int64_t size, int64_t hash_count, int64_t width)
+  : filter(Bloom::Options(size, hash_count), Bloom::DoubleHasher(0))
+  , keys(kPoolKeys, width)
+  , inserted(fill(filter, keys, width)) {}
+
+  Bloom::Filter filter;
+  KeyPool keys;
+  size_t inserted;
+};
+
+/// Returns the `FilledFilter` for the arguments of `state`, shared by all
+/// threads of a multi-threaded benchmark. Only the most recent one is kept.
+const FilledFilter& shared_filled_filter(const benchmark::State& state) {
+  static std::mutex mutex;
+  static std::tuple<int64_t, int64_t, int64_t> arguments;
+  static std::unique_ptr<FilledFilter> filter;
+  const auto wanted =
+      std::make_tuple(state.range(0), state.range(1), state.range(2));
+  std::lock_guard<std::mutex> lock(mutex);
+  if (!filter || arguments != wanted) {
+    filter.reset();
+    filter.reset(
+        new FilledFilter(state.range(0), state.range(1), state.range(2)));
+    arguments = wanted;
+  }
+  return *filter;
+}
+
+/// Arguments: size (bits), hash count, key width (bytes).
+void BM_MatrixFilterPut(benchmark::State& state) {
+  if (!fits_in_memory(state.range(0))) {
+    state.SkipWithError("the filter does not fit into memory");
+    return;
+  }
+  Bloom::Filter filter(Bloom::Options(state.range(0), state.range(1)),
+                       Bloom::DoubleHasher(0));
+  const KeyPool keys(kPoolKeys, state.range(2));
+  put_loop(state, filter, keys);
+}
+
+/// Arguments: size (bits), hash count, key width (bytes). Threads query one
+/// shared filter.
+void BM_MatrixFilterQuery(benchmark::State& state) {
+  if (!fits_in_memory(state.range(0))) {
+    state.SkipWithError("the filter does not fit into memory");
+    return;
+  }
+  const auto& filled = shared_filled_filter(state);
+  query_loop(state, filled.filter, filled.keys, filled.inserted);
+}
+
+/// Arguments: key width (bytes).
+template <size_t N, size_t K>
+void BM_MatrixStaticFilterPut(benchmark::State& state) {
+  std::unique_ptr<Bloom::StaticFilter<N, K>> filter(
+      new Bloom::StaticFilter<N, K>(Bloom::DoubleHasher(0)));
+  const KeyPool keys(kPoolKeys, state.range(0));
+  put_loop(state, *filter, keys);
+}
+
+/// Arguments: key width (bytes).
+template <size_t N, size_t K>
+void BM_MatrixStaticFilterQuery(benchmark::State& state) {
+  std::unique_ptr<Bloom::StaticFilter<N, K>> filter(
+      new Bloom::StaticFilter<N, K>(Bloom::DoubleHasher(0)));
+  const KeyPool keys(kPoolKeys, state.range(0));
+  const size_t inserted = fill(*filter, keys, state.range(0));
+  query_loop(state, *filter, keys, inserted);
+}
+
+/// Filter sizes in bits: L1 (4 KiB), L2 (256 KiB), L3 (8 MiB) resident, then
+/// 128 MiB and 8 GiB.
+const std::vector<int64_t> kSizes = {int64_t{1} << 15,
+                                     int64_t{1} << 21,
+                                     int64_t{1} << 26,
+                                     int64_t{1} << 30,
+                                     int64_t{1} << 36};
+const std::vector<int64_t> kHashCounts = {1, 2, 4, 8, 16};
+const std::vector<int64_t> kKeyWidths = {4, 16, 256};
+const std::vector<int> kThreadCounts = {2, 4, 8};
+
+void matrix_arguments(benchmark::internal::Benchmark* benchmark) {
+  benchmark->ArgNames({"bits", "k", "width"});
+  benchmark->ArgsProduct({kSizes, kHashCounts, kKeyWidths});
+}
+
+/// Registers the `StaticFilter` benchmarks for a size of `N` bits and each of
+/// the hash counts `Ks`.
+template <size_t N, size_t... Ks>
+void register_static_filter() {
+  const std::string suffix = "<" + std::to_string(N) + ", ";
+  const auto widths = [](benchmark::internal::Benchmark* benchmark) {
+    benchmark->ArgName("width");
+    for (const int64_t width : kKeyWidths) {
+      benchmark->Arg(width);
+    }
+  };
+  const int expand[] = {
+      (benchmark::RegisterBenchmark(
+           ("BM_MatrixStaticFilterPut" + suffix + std::to_string(Ks) + ">")
+               .c_str(),
+           BM_MatrixStaticFilterPut<N, Ks>)
+           ->Apply(widths),
+       benchmark::RegisterBenchmark(
+           ("BM_MatrixStaticFilterQuery" + suffix + std::to_string(Ks) + ">")
+               .c_str(),
+           BM_MatrixStaticFilterQuery<N, Ks>)
+           ->Apply(widths),
+       0)...};
+  (void)expand;
+}
+
+/// Registers the benchmarks whose arguments are computed at runtime.
+bool register_matrix() {
+  benchmark::RegisterBenchmark("BM_MatrixFilterPut", BM_MatrixFilterPut)
+      ->Apply(matrix_arguments);
+  benchmark::RegisterBenchmark("BM_MatrixFilterQuery", BM_MatrixFilterQuery)
+      ->Apply(matrix_arguments);
+  // Concurrent queries of one filter, for a cache resident and a large one.
+  auto* threaded =
+      benchmark::RegisterBenchmark("BM_MatrixFilterQuery", BM_MatrixFilterQuery)
+          ->ArgNames({"bits", "k", "width"})
+          ->ArgsProduct({{int64_t{1} << 21, int64_t{1} << 30}, {7}, {16}})
+          ->UseRealTime();
+  for (const int threads : kThreadCounts) {
+    threaded->Threads(threads);
+  }
+  register_static_filter<size_t{1} << 15, 1, 2, 4, 8, 16>();
+  register_static_filter<size_t{1} << 21, 1, 2, 4, 8, 16>();
+  return true;
+}
+
+const bool kMatrixRegistered = register_matrix();
+}  // namespace
@@ -0,0 +1,36 @@
+# Use an installed Google Benchmark if there is one.
+find_package(benchmark QUIET)
+if(benchmark_FOUND)
+  return()
+endif()
+
+# Otherwise download and unpack Google Benchmark at configure time
+configure_file(${CMAKE_CURRENT_LIST_DIR}/CMakeLists.txt.in benchmark-download/CMakeLists.txt)
+
+execute_process(COMMAND ${CMAKE_COMMAND} -G "${CMAKE_GENERATOR}" .
+  RESULT_VARIABLE result
+  WORKING_DIRECTORY ${CMAKE_BINARY_DIR}/benchmark-download)
+
+if(result)
+  message(FATAL_ERROR "CMake step for benchmark failed: ${result}")
+endif()
+
+execute_process(COMMAND ${CMAKE_COMMAND} --build .
+  RESULT_VARIABLE result
+  WORKING_DIRECTORY ${CMAKE_BINARY_DIR}/benchmark-download)
+
+if(result)
+  message(FATAL_ERROR "Build step for benchmark failed: ${result}")
+endif()
+
+# Google Benchmark's own tests would require a second googletest checkout.
+set(BENCHMARK_ENABLE_TESTING OFF CACHE BOOL "" FORCE)
+set(BENCHMARK_ENABLE_INSTALL OFF CACHE BOOL "" FORCE)
+
+# Add benchmark directly to our build. This defines the benchmark and
+# benchmark_main targets.
+add_subdirectory(${CMAKE_BINARY_DIR}/benchmark-src
+                 ${CMAKE_BINARY_DIR}/benchmark-build
+                 EXCLUDE_FROM_ALL)
+add_library(benchmark::benchmark ALIAS benchmark)
+add_library(benchmark::benchmark_main ALIAS benchmark_main)
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <new>
+
+namespace Bloom {
+
+/// The size of a cache line (in bytes) on all platforms we care about.
+constexpr size_t kCacheLineSize = 64;
+
+/// An allocator returning memory aligned to (at least) `Alignment` bytes.
+///
+/// Used for filter storage so that a block of `kCacheLineSize` bytes never
+/// straddles two cache lines. Memory is over-allocated by `Alignment` bytes
+/// and the pointer returned by `::operator new` is stashed right before the
+/// aligned pointer handed out.
+template <typename T, size_t Alignment = kCacheLineSize>
+struct AlignedAllocator {
+  static_assert((Alignment & (Alignment - 1)) == 0,
+                "the alignment must be a power of two");
+  static_assert(Alignment >= sizeof(void*),
+                "the alignment must be large enough to hold a pointer");
+
+  using value_type = T;
+
+  template <typename U>
+  struct rebind {
+    using other = AlignedAllocator<U, Alignment>;
+  };
+
+  AlignedAllocator() noexcept = default;
+
+  template <typename U>
+  AlignedAllocator(const AlignedAllocator<U, Alignment>&) noexcept {}  // NOLINT
+
+  /// Allocates storage for `count` objects of type `T`.
+  T* allocate(size_t count) {
+    if (count > (std::numeric_limits<size_t>::max() - Alignment) / sizeof(T)) {
+      throw std::bad_alloc();
+    }
+    void* original = ::operator new(count * sizeof(T) + Alignment);
+    const auto address = reinterpret_cast<uintptr_t>(original);
+    // Always advance by at least one pointer, so there is room to stash
+    // `original` right before the aligned address.
+    const auto aligned = (address + Alignment) & ~(Alignment - 1);
+    reinterpret_cast<void**>(aligned)[-1] = original;
+    return reinterpret_cast<T*>(aligned);
+  }
+
+  /// Deallocates storage previously returned by `allocate()`.
+  void deallocate(T* pointer, size_t /*unused*/) noexcept {
+    ::operator delete(reinterpret_cast<void**>(pointer)[-1]);
+  }
+};
+
+template <typename T, typename U, size_t Alignment>
+bool operator==(const AlignedAllocator<T, Alignment>& /*unused*/,
+                const AlignedAllocator<U, Alignment>& /*unused*/) noexcept {
+  return true;
+}
+
+template <typename T, typename U, size_t Alignment>
+bool operator!=(const AlignedAllocator<T, Alignment>& /*unused*/,
+                const AlignedAllocator<U, Alignment>& /*unused*/) noexcept {
+  return false;
+}
+}  // namespace Bloom
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <bloom/aligned-allocator.hpp>
+#include <bloom/bit-array.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Bloom {
+
+/// A fixed-size array of bits that may be set and tested by any number of
+/// threads at the same time, stored in cache line aligned atomic 64-bit words.
+///
+/// `set()` sets a bit with an atomic `fetch_or` on its word and `test()` reads
+/// the word with a relaxed atomic load, so no bit is ever lost to a concurrent
+/// `set()` of another bit of the same word. All operations are relaxed: they
+/// do not order any other memory.
+class AtomicBitArray {
+ public:
+  /// Constructs an `AtomicBitArray` of `size` bits, all zero. The `page_mode`
+  /// is ignored.
+  explicit AtomicBitArray(size_t size,
+                          PageMode /*unused*/ = PageMode::kDefault)
+  : size_(size), words_((size + 63) / 64) {}
+
+  /// Sets the bit at `index` to one. Safe to call concurrently with any other
+  /// operation but `clear()`.
+  ///
+  /// Bits that are already set are not written again, so that setting bits
+  /// that are set does not take the cache lines holding them away from other
+  /// cores.
+  void set(size_t index) noexcept {
+    const uint64_t mask = uint64_t{1} << (index % 64);
+    auto& word = words_[index / 64];
+    if ((word.load(std::memory_order_relaxed) & mask) == 0) {
+      word.fetch_or(mask, std::memory_order_relaxed);
+    }
+  }
+
+  /// Returns `true` if the bit at `index` is one. Safe to call concurrently
+  /// with any other operation.
+  bool test(size_t index) const noexcept {
+    const uint64_t word = words_[index / 64].load(std::memory_order_relaxed);
+    return ((word >> (index % 64)) & 1u) != 0;
+  }
+
+  /// Sets all bits to zero. Bits set concurrently may or may not survive.
+  void clear() noexcept {
+    for (auto& word : words_) {
+      word.store(0, std::memory_order_relaxed);
+    }
+  }
+
+  /// Returns the number of bits set to one. Bits set concurrently may or may
+  /// not be counted.
+  size_t count() const noexcept {
+    size_t total = 0;
+    for (const auto& word : words_) {
+      total += Detail::popcount(word.load(std::memory_order_relaxed));
+    }
+    return total;
+  }
+
+  /// Returns a snapshot of the bits. Bits set concurrently with the snapshot
+  /// may or may not be included.
+  BitArray snapshot() const {
+    BitArray bits(size_);
+    for (size_t i = 0; i < words_.size(); ++i) {
+      bits.words()[i] = words_[i].load(std::memory_order_relaxed);
+    }
+    return bits;
+  }
+
+  /// Returns a pointer to the first of the `word_count()` words.
+  const std::atomic<uint64_t>* words() const noexcept { return words_.data(); }
+
+  /// Returns the number of 64-bit words backing the bits.
+  size_t word_count() const noexcept { return words_.size(); }
+
+  /// Returns the number of bits.
+  size_t size() const noexcept { return size_; }
+
+ private:
+  using Word = std::atomic<uint64_t>;
+
+  size_t size_;
+  /// Value-initialization zeroes the words.
+  std::vector<Word, AlignedAllocator<Word>> words_;
+};
+}  // namespace Bloom
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+namespace Bloom {
+namespace Detail {
+
+/// The number of probes (keys times hash count) hashed and prefetched ahead
+/// in `put_batch()` and `query_batch()` before any of them is resolved. Large
+/// enough to keep many cache misses in flight, small enough that the prefetched
+/// lines are still in the cache once they are resolved.
+constexpr size_t kProbesPerBatch = 256;
+
+/// The size up to which a filter is assumed to stay in the (L2) cache, so that
+/// batch queries gain nothing from prefetching its words.
+constexpr size_t kCacheResidentBytes = size_t{1} << 20;
+
+/// The number of keys each thread hashes per round of a parallel build, before
+/// the threads set the bits of their partitions.
+constexpr size_t kBuildKeysPerRound = size_t{1} << 16;
+
+/// How many indices ahead of the one being set a parallel build prefetches.
+constexpr size_t kBuildPrefetchDistance = 16;
+
+/// Returns the number of keys per group of a batch operation.
+constexpr size_t batch_size(size_t hash_count) noexcept {
+  return hash_count == 0 || hash_count >= kProbesPerBatch
+             ? 1
+             : kProbesPerBatch / hash_count;
+}
+
+/// Prepares the `count` results of a batch query stored as `bool`s.
+inline void clear_results(bool* /*unused*/, size_t /*unused*/) noexcept {}
+
+/// Prepares the `count` results of a batch query stored as a bitmap.
+inline void clear_results(uint64_t* bitmap, size_t count) noexcept {
+  std::fill(bitmap, bitmap + (count + 63) / 64, 0);
+}
+
+/// Stores the `result` for the `index`-th key as a `bool`.
+inline void store_result(bool* results, size_t index, bool result) noexcept {
+  results[index] = result;
+}
+
+/// Stores the `result` for the `index`-th key as bit `index % 64` of word
+/// `index / 64` of the `bitmap`, which must have been cleared.
+inline void store_result(uint64_t* bitmap, size_t index, bool result) noexcept {
+  bitmap[index / 64] |= static_cast<uint64_t>(result) << (index % 64);
+}
+}  // namespace Detail
+}  // namespace Bloom
@@ -0,0 +1,362 @@
+#pragma once
+
+#include <bloom/aligned-allocator.hpp>
+#include <bloom/batch.hpp>
+#include <bloom/cpu.hpp>
+#include <bloom/format.hpp>
+#include <bloom/hash.hpp>
+#include <bloom/reduce.hpp>
+#include <bloom/slice.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace Bloom {
+namespace Detail {
+
+/// The number of seeds a `BinaryFuseFilter` tries before it gives up.
+constexpr size_t kMaxFuseAttempts = 100;
+
+/// Where the three fingerprints of each key are located in the array of a
+/// binary fuse filter. See Graf and Lemire, "Binary Fuse Filters: Fast and
+/// Smaller Than Xor Filters".
+///
+/// The array consists of `segment_count + 2` segments of `segment_length`
+/// fingerprints. A key maps to three consecutive segments, starting at one of
+/// the first `segment_count`, and to one position in each.
+struct FuseLayout {
+  /// Computes the layout for `key_count` distinct keys.
+  static FuseLayout ForKeyCount(size_t key_count) {
+    FuseLayout layout;
+    if (key_count > 1) {
+      const double count = static_cast<double>(key_count);
+      const auto exponent =
+          static_cast<int>(std::floor(std::log(count) / std::log(3.33) + 2.25));
+      layout.segment_length = std::min<uint64_t>(uint64_t{1} << exponent,
+                                                 uint64_t{1} << 18);
+      // The array must be about 12.5% larger than the number of keys, and more
+      // for fewer keys, for the construction to succeed.
+      const double size_factor =
+          std::max(1.125, 0.875 + 0.25 * std::log(1e6) / std::log(count));
+      const auto capacity =
+          static_cast<uint64_t>(std::round(count * size_factor));
+      const uint64_t segments =
+          (capacity + layout.segment_length - 1) / layout.segment_length;
+      layout.segment_count_length =
+          std::max<uint64_t>(segments, 3) * layout.segment_length -
+          2 * layout.segment_length;
+    } else {
+      layout.segment_length = 4;
+      layout.segment_count_length = 4;
+    }
+    return layout;
+  }
+
+  /// Returns the number of fingerprints of the array.
+  uint64_t fingerprint_count() const noexcept {
+    return segment_count_length + 2 * segment_length;
+  }
+
+  /// Returns the positions of the three fingerprints of the key with the given
+  /// `hash`: a random one in its first segment, and one in each of the next
+  /// two segments, offset by 18 bits of the hash each.
+  std::array<uint64_t, 3> positions(uint64_t hash) const noexcept {
+    const uint64_t first = multiply_high(hash, segment_count_length);
+    const uint64_t mask = segment_length - 1;
+    return {{first,
+             (first + segment_length) ^ ((hash >> 18) & mask),
+             (first + 2 * segment_length) ^ (hash & mask)}};
+  }
+
+  /// The number of fingerprints per segment, a power of two.
+  uint64_t segment_length = 0;
+  /// The number of segments a key may start at, times `segment_length`.
+  uint64_t segment_count_length = 0;
+};
+
+/// Returns the fingerprint of the key with the given `hash`.
+template <typename Fingerprint>
+constexpr Fingerprint fuse_fingerprint(uint64_t hash) noexcept {
+  return static_cast<Fingerprint>(hash ^ (hash >> 32));
+}
+
+/// Returns `true` if the fingerprints at the three `positions` of a key xor to
+/// its `fingerprint`.
+template <typename Fingerprint>
+bool fuse_contains(const Fingerprint* fingerprints,
+                   const std::array<uint64_t, 3>& positions,
+                   Fingerprint fingerprint) noexcept {
+  return (fingerprint ^ fingerprints[positions[0]] ^
+          fingerprints[positions[1]] ^ fingerprints[positions[2]]) == 0;
+}
+}  // namespace Detail
+
+/// An immutable filter for a set of keys known in advance, which stores an
+/// 8- or 16-bit fingerprint of every key such that the three fingerprints at
+/// the positions a key maps to xor to its own fingerprint.
+///
+/// A query reads exactly three fingerprints, from three adjacent segments of
+/// the array. The false positive rate is `2^-F` for `F`-bit fingerprints, at
+/// about `1.125 * F` bits per key: 9 bits for 0.4% with `uint8_t`, 18 bits
+/// for 0.0015% with `uint16_t`. A bloom filter needs `1.44 * log2(1 / rate)`
+/// bits per key for the same rates.
+///
+/// Keys cannot be added once the filter is built. It is saved and loaded like
+/// a `Filter`, and `MappedBinaryFuseFilter` queries a saved filter directly
+/// from the file.
+template <typename Fingerprint = uint8_t>
+class BinaryFuseFilter {
+ public:
+  static_assert(std::is_same<Fingerprint, uint8_t>::value ||
+                    std::is_same<Fingerprint, uint16_t>::value,
+                "the fingerprints of a BinaryFuseFilter must be uint8_t or "
+                "uint16_t");
+
+  /// Builds a `BinaryFuseFilter` from the keys in `[first, last)`, hashing
+  /// them with a random seed. See `build(first, last, seed)`.
+  template <typename Iterator>
+  static BinaryFuseFilter build(Iterator first, Iterator last) {
+    return build(first, last, Detail::random_seed());
+  }
+
+  /// Builds a `BinaryFuseFilter` from the keys in `[first, last)`, which may
+  /// contain duplicates.
+  ///
+  /// The keys are hashed with `seed`. If the fingerprints cannot be assigned
+  /// for the hashes, which becomes unlikely as the number of keys grows, all
+  /// keys are hashed again with a seed derived from the previous one, so the
+  /// seed the filter ends up with (`seed()`) may differ from `seed`.
+  ///
+  /// `Iterator` must be a forward iterator over `Slice`s or sliceable keys.
+  ///
+  /// \throws std::runtime_error if no seed works, which happens only if
+  /// distinct keys have the same 64-bit hash.
+  /// \complexity O(count * log(count))
+  template <typename Iterator>
+  static BinaryFuseFilter build(Iterator first, Iterator last, uint64_t seed) {
+    const auto count = static_cast<size_t>(std::distance(first, last));
+    std::vector<uint64_t> hashes(count);
+    for (size_t attempt = 0; attempt < Detail::kMaxFuseAttempts; ++attempt) {
+      std::transform(first, last, hashes.begin(), [seed](Slice key) {
+        return hash(key, seed);
+      });
+      // Sorting groups the keys by segment, which makes the construction
+      // cache friendly, and brings duplicates together.
+      std::sort(hashes.begin(), hashes.end());
+      hashes.erase(std::unique(hashes.begin(), hashes.end()), hashes.end());
+      BinaryFuseFilter filter(Detail::FuseLayout::ForKeyCount(hashes.size()),
+                              hashes.size(),
+                              seed);
+      if (filter.assign(hashes)) return filter;
+      seed = Detail::fmix64(seed + 0x9e3779b97f4a7c15ULL);
+      hashes.resize(count);
+    }
+    throw std::runtime_error("could not build the binary fuse filter");
+  }
+
+  /// Returns `true` if the given `key` was possibly among the keys the filter
+  /// was built from, and always if it was.
+  ///
+  /// \complexity O(1)
+  bool query(Slice key) const noexcept {
+    const uint64_t key_hash = hash(key, seed_);
+    return Detail::fuse_contains(
+        fingerprints_.data(),
+        layout_.positions(key_hash),
+        Detail::fuse_fingerprint<Fingerprint>(key_hash));
+  }
+
+  /// Queries the `count` keys starting at `keys`, storing the result for
+  /// `keys[i]` in `results[i]`. The three fingerprints of each key of a group
+  /// are prefetched before any of them is read.
+  ///
+  /// \complexity O(count)
+  template <typename Key>
+  void query_batch(const Key* keys, size_t count, bool* results) const {
+    constexpr size_t kGroupSize = Detail::batch_size(3);
+    std::array<uint64_t, kGroupSize> hashes;
+    for (size_t start = 0; start < count; start += kGroupSize) {
+      const size_t group = std::min(kGroupSize, count - start);
+      for (size_t key = 0; key < group; ++key) {
+        hashes[key] = hash(keys[start + key], seed_);
+        for (const uint64_t position : layout_.positions(hashes[key])) {
+          Detail::prefetch(fingerprints_.data() + position);
+        }
+      }
+      for (size_t key = 0; key < group; ++key) {
+        results[start + key] = Detail::fuse_contains(
+            fingerprints_.data(),
+            layout_.positions(hashes[key]),
+            Detail::fuse_fingerprint<Fingerprint>(hashes[key]));
+      }
+    }
+  }
+
+  /// Returns the size (number of bits) of the fingerprints.
+  size_t size() const noexcept {
+    return fingerprints_.size() * sizeof(Fingerprint) * 8;
+  }
+
+  /// Returns the number of distinct keys the filter was built from.
+  size_t key_count() const noexcept { return key_count_; }
+
+  /// Returns the seed the keys are hashed with.
+  uint64_t seed() const noexcept { return seed_; }
+
+  /// Returns the fingerprints.
+  const Fingerprint* fingerprints() const noexcept {
+    return fingerprints_.data();
+  }
+
+  /// Returns the number of fingerprints.
+  size_t fingerprint_count() const noexcept { return fingerprints_.size(); }
+
+  /// Writes the filter to `stream` in a versioned, little-endian binary format
+  /// (see `Detail::FuseHeader`) that `load()` and `MappedBinaryFuseFilter`
+  /// read on any platform.
+  ///
+  /// \throws std::runtime_error if writing fails.
+  /// \complexity O(N)
+  void save(std::ostream& stream) const {
+    Detail::FuseHeader header;
+    header.fingerprint_bits = sizeof(Fingerprint) * 8;
+    header.key_count = key_count_;
+    header.segment_length = layout_.segment_length;
+    header.segment_count_length = layout_.segment_count_length;
+    header.seed = seed_;
+    header.payload_checksum =
+        Detail::payload_checksum(fingerprints_.data(), fingerprints_.size());
+    Detail::write_fuse_filter(stream, header, fingerprints_.data());
+  }
+
+  /// Writes the filter to the file at `path`, replacing it if it exists. See
+  /// `save(std::ostream&)`.
+  void save(const std::string& path) const {
+    std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+    if (!stream) throw std::runtime_error("could not open " + path);
+    save(stream);
+  }
+
+  /// Reads a filter written by `save()` from `stream`.
+  ///
+  /// \throws std::runtime_error if reading fails, the data is not a binary
+  /// fuse filter with fingerprints of this size, or its checksums do not
+  /// match.
+  /// \complexity O(N)
+  static BinaryFuseFilter load(std::istream& stream) {
+    uint8_t bytes[Detail::kHeaderSize];
+    if (!stream.read(reinterpret_cast<char*>(bytes), Detail::kHeaderSize)) {
+      throw std::runtime_error("could not read the binary fuse filter header");
+    }
+    const auto header =
+        Detail::decode_fuse_header(bytes, sizeof(Fingerprint) * 8);
+    Detail::FuseLayout layout;
+    layout.segment_length = header.segment_length;
+    layout.segment_count_length = header.segment_count_length;
+    BinaryFuseFilter filter(layout, header.key_count, header.seed);
+    Detail::read_fingerprints(stream, header, filter.fingerprints_.data());
+    return filter;
+  }
+
+  /// Reads a filter written by `save()` from the file at `path`. See
+  /// `load(std::istream&)`.
+  static BinaryFuseFilter load(const std::string& path) {
+    std::ifstream stream(path, std::ios::binary);
+    if (!stream) throw std::runtime_error("could not open " + path);
+    return load(stream);
+  }
+
+ private:
+  BinaryFuseFilter(Detail::FuseLayout layout, size_t key_count, uint64_t seed)
+  : layout_(layout)
+  , key_count_(key_count)
+  , seed_(seed)
+  , fingerprints_(layout.fingerprint_count()) {}
+
+  static uint64_t hash(Slice key, uint64_t seed) noexcept {
+    return Detail::wyhash(key.data(), key.size(), seed);
+  }
+
+  /// Assigns the fingerprints for the given sorted, distinct `hashes`. Returns
+  /// `false` if that is not possible.
+  ///
+  /// Every position of the array first counts the keys mapping to it and xors
+  /// their hashes, so that the hash of the only key left at a position is
+  /// known. Keys that are alone at one of their positions are then peeled off
+  /// repeatedly, which succeeds if all keys can be. Finally, the peeled keys
+  /// are assigned in reverse order: each one sets its lone position such that
+  /// its three fingerprints xor to its own, which the keys assigned after it
+  /// never change.
+  bool assign(const std::vector<uint64_t>& hashes) {
+    const size_t capacity = fingerprints_.size();
+    // The number of keys at each position times four, plus the xor of the
+    // indices (0, 1 or 2) of the position among the three of each key.
+    std::vector<uint8_t> counts(capacity);
+    std::vector<uint64_t> xors(capacity);
+    for (const uint64_t hash : hashes) {
+      const auto positions = layout_.positions(hash);
+      for (uint8_t index = 0; index < 3; ++index) {
+        auto& count = counts[positions[index]];
+        // More than 63 keys at one position do not fit the count.
+        if (count >= 252) return false;
+        count = static_cast<uint8_t>((count + 4) ^ index);
+        xors[positions[index]] ^= hash;
+      }
+    }
+
+    std::vector<uint64_t> alone;
+    for (uint64_t position = 0; position < capacity; ++position) {
+      if (counts[position] >> 2 == 1) alone.push_back(position);
+    }
+    // The hash of each peeled key and the index of its lone position.
+    std::vector<uint64_t> peeled;
+    std::vector<uint8_t> peeled_index;
+    peeled.reserve(hashes.size());
+    peeled_index.reserve(hashes.size());
+    while (!alone.empty()) {
+      const uint64_t position = alone.back();
+      alone.pop_back();
+      if (counts[position] >> 2 != 1) continue;
+      const uint64_t hash = xors[position];
+      const auto index = static_cast<uint8_t>(counts[position] & 3);
+      peeled.push_back(hash);
+      peeled_index.push_back(index);
+      const auto positions = layout_.positions(hash);
+      for (uint8_t other = 0; other < 3; ++other) {
+        if (other == index) continue;
+        auto& count = counts[positions[other]];
+        count = static_cast<uint8_t>((count - 4) ^ other);
+        xors[positions[other]] ^= hash;
+        if (count >> 2 == 1) alone.push_back(positions[other]);
+      }
+      counts[position] = 0;
+    }
+    if (peeled.size() != hashes.size()) return false;
+
+    for (size_t i = peeled.size(); i-- > 0;) {
+      const uint64_t hash = peeled[i];
+      const auto positions = layout_.positions(hash);
+      const uint8_t index = peeled_index[i];
+      fingerprints_[positions[index]] = static_cast<Fingerprint>(
+          Detail::fuse_fingerprint<Fingerprint>(hash) ^
+          fingerprints_[positions[(index + 1) % 3]] ^
+          fingerprints_[positions[(index + 2) % 3]]);
+    }
+    return true;
+  }
+
+  Detail::FuseLayout layout_;
+  size_t key_count_;
+  uint64_t seed_;
+  std::vector<Fingerprint, AlignedAllocator<Fingerprint>> fingerprints_;
+};
+}  // namespace Bloom
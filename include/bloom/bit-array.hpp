@@ -0,0 +1,368 @@
+#pragma once
+
+#include <bloom/aligned-allocator.hpp>
+#include <bloom/cpu.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <stdexcept>
+#include <utility>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+namespace Bloom {
+
+/// How the memory of a `BitArray` is backed.
+enum class PageMode {
+  /// Regular (cache line aligned) heap memory.
+  kDefault,
+  /// An anonymous mapping aligned to 2 MiB and advised to be backed by
+  /// transparent huge pages (`MADV_HUGEPAGE`). Falls back to `kDefault` on
+  /// platforms other than Linux.
+  kTransparentHugePages,
+  /// An anonymous mapping backed by pages from the hugetlbfs pool
+  /// (`MAP_HUGETLB`). Falls back to `kTransparentHugePages` if the pool has
+  /// no pages to spare, as is the default on most systems.
+  kHugeTlb,
+};
+
+namespace Detail {
+
+/// The size of a huge page on x86-64 and (most) ARM64 Linux systems.
+constexpr size_t kHugePageSize = size_t{2} << 20;
+
+/// Returns the number of bits set in `word`.
+inline size_t popcount(uint64_t word) noexcept {
+#if defined(__GNUC__) || defined(__clang__)
+  return static_cast<size_t>(__builtin_popcountll(word));
+#else
+  word = word - ((word >> 1) & 0x5555555555555555ULL);
+  word = (word & 0x3333333333333333ULL) + ((word >> 2) & 0x3333333333333333ULL);
+  word = (word + (word >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+  return static_cast<size_t>((word * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+/// Returns the index of the lowest bit set in `word`, which must not be zero.
+inline size_t count_trailing_zeros(uint64_t word) noexcept {
+#if defined(__GNUC__) || defined(__clang__)
+  return static_cast<size_t>(__builtin_ctzll(word));
+#else
+  return popcount((word & (0 - word)) - 1);
+#endif
+}
+
+/// Returns the number of bits set in the `count` words at `words`.
+inline size_t popcount(const uint64_t* words, size_t count) noexcept {
+  size_t total = 0;
+  for (size_t i = 0; i < count; ++i) {
+    total += popcount(words[i]);
+  }
+  return total;
+}
+
+#if defined(BLOOM_HAS_X86_KERNELS)
+/// `popcount()` compiled to use the `popcnt` instruction, which the compiler
+/// only emits by itself if the whole program is compiled with `-mpopcnt`.
+__attribute__((target("popcnt"))) inline size_t popcount_native(
+    const uint64_t* words,
+    size_t count) noexcept {
+  size_t total = 0;
+  for (size_t i = 0; i < count; ++i) {
+    total += static_cast<size_t>(__builtin_popcountll(words[i]));
+  }
+  return total;
+}
+#endif
+
+/// Returns the number of bits set in the `count` words at `words`, using the
+/// fastest implementation the CPU supports.
+inline size_t count_bits(const uint64_t* words, size_t count) noexcept {
+#if defined(BLOOM_HAS_X86_KERNELS)
+  static const bool has_popcnt = __builtin_cpu_supports("popcnt") != 0;
+  if (has_popcnt) return popcount_native(words, count);
+#endif
+  return popcount(words, count);
+}
+
+/// Sets each of the `count` words at `words` to `words[i] | other[i]`.
+inline void or_words(uint64_t* words,
+                     const uint64_t* other,
+                     size_t count) noexcept {
+  for (size_t i = 0; i < count; ++i) {
+    words[i] |= other[i];
+  }
+}
+
+/// Sets each of the `count` words at `words` to `words[i] & other[i]`.
+inline void and_words(uint64_t* words,
+                      const uint64_t* other,
+                      size_t count) noexcept {
+  for (size_t i = 0; i < count; ++i) {
+    words[i] &= other[i];
+  }
+}
+
+#if defined(BLOOM_HAS_X86_KERNELS)
+/// `or_words()` and `and_words()` on four words per instruction.
+struct Avx2WordKernels {
+  __attribute__((target("avx2"))) static void or_words(uint64_t* words,
+                                                       const uint64_t* other,
+                                                       size_t count) noexcept {
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+      auto* target = reinterpret_cast<__m256i*>(words + i);
+      const auto* source = reinterpret_cast<const __m256i*>(other + i);
+      _mm256_storeu_si256(target,
+                          _mm256_or_si256(_mm256_loadu_si256(target),
+                                          _mm256_loadu_si256(source)));
+    }
+    Detail::or_words(words + i, other + i, count - i);
+  }
+
+  __attribute__((target("avx2"))) static void and_words(
+      uint64_t* words,
+      const uint64_t* other,
+      size_t count) noexcept {
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+      auto* target = reinterpret_cast<__m256i*>(words + i);
+      const auto* source = reinterpret_cast<const __m256i*>(other + i);
+      _mm256_storeu_si256(target,
+                          _mm256_and_si256(_mm256_loadu_si256(target),
+                                           _mm256_loadu_si256(source)));
+    }
+    Detail::and_words(words + i, other + i, count - i);
+  }
+};
+#endif
+
+/// `or_words()` using the widest instructions the CPU supports.
+inline void or_words_native(uint64_t* words,
+                            const uint64_t* other,
+                            size_t count) noexcept {
+#if defined(BLOOM_HAS_X86_KERNELS)
+  static const bool has_avx2 = cpu_supports(Isa::kAvx2);
+  if (has_avx2) return Avx2WordKernels::or_words(words, other, count);
+#endif
+  or_words(words, other, count);
+}
+
+/// `and_words()` using the widest instructions the CPU supports.
+inline void and_words_native(uint64_t* words,
+                             const uint64_t* other,
+                             size_t count) noexcept {
+#if defined(BLOOM_HAS_X86_KERNELS)
+  static const bool has_avx2 = cpu_supports(Isa::kAvx2);
+  if (has_avx2) return Avx2WordKernels::and_words(words, other, count);
+#endif
+  and_words(words, other, count);
+}
+}  // namespace Detail
+
+/// A fixed-size array of bits, stored in 64-bit words.
+///
+/// Unlike `std::vector<bool>`, the words are accessible directly, which makes
+/// word-level operations (clearing, unions, intersections, counting) as well
+/// as copying the bits elsewhere cheap. The words are aligned to (at least)
+/// a cache line, and may be backed by huge pages to reduce TLB misses on very
+/// large arrays. Bits past `size()` in the last word are always zero.
+class BitArray {
+ public:
+  /// Constructs an empty `BitArray`.
+  BitArray() noexcept = default;
+
+  /// Constructs a `BitArray` of `size` bits, all zero, backed by memory as
+  /// specified by `page_mode`.
+  explicit BitArray(size_t size, PageMode page_mode = PageMode::kDefault)
+  : size_(size), word_count_((size + 63) / 64), page_mode_(page_mode) {
+    allocate();
+  }
+
+  BitArray(const BitArray& other) : BitArray(other.size_, other.page_mode_) {
+    std::copy(other.words_, other.words_ + word_count_, words_);
+  }
+
+  BitArray(BitArray&& other) noexcept { swap(other); }
+
+  BitArray& operator=(BitArray other) noexcept {
+    swap(other);
+    return *this;
+  }
+
+  ~BitArray() { deallocate(); }
+
+  /// Sets the bit at `index` to one.
+  void set(size_t index) noexcept {
+    words_[index / 64] |= uint64_t{1} << (index % 64);
+  }
+
+  /// Sets the bit at `index` to zero.
+  void reset(size_t index) noexcept {
+    words_[index / 64] &= ~(uint64_t{1} << (index % 64));
+  }
+
+  /// Returns `true` if the bit at `index` is one.
+  bool test(size_t index) const noexcept {
+    return ((words_[index / 64] >> (index % 64)) & 1u) != 0;
+  }
+
+  /// Sets all bits to zero.
+  /// \complexity O(N / 64)
+  void clear() noexcept { std::fill(words_, words_ + word_count_, 0); }
+
+  /// Returns the number of bits set to one.
+  /// \complexity O(N / 64)
+  size_t count() const noexcept {
+    return Detail::count_bits(words_, word_count_);
+  }
+
+  /// Sets every bit that is one in `other` to one in this array.
+  ///
+  /// \throws std::invalid_argument if the sizes of the arrays differ.
+  /// \complexity O(N / 64)
+  BitArray& operator|=(const BitArray& other) {
+    check_same_size(other);
+    Detail::or_words_native(words_, other.words_, word_count_);
+    return *this;
+  }
+
+  /// Sets every bit that is zero in `other` to zero in this array.
+  ///
+  /// \throws std::invalid_argument if the sizes of the arrays differ.
+  /// \complexity O(N / 64)
+  BitArray& operator&=(const BitArray& other) {
+    check_same_size(other);
+    Detail::and_words_native(words_, other.words_, word_count_);
+    return *this;
+  }
+
+  /// Returns `true` if both arrays have the same size and bits.
+  bool operator==(const BitArray& other) const noexcept {
+    return size_ == other.size_ &&
+           std::equal(words_, words_ + word_count_, other.words_);
+  }
+
+  bool operator!=(const BitArray& other) const noexcept {
+    return !(*this == other);
+  }
+
+  /// Returns the words of the array. Bit `i` is bit `i % 64` of word `i / 64`.
+  /// Callers writing to the words must keep the bits past `size()` zero.
+  uint64_t* words() noexcept { return words_; }
+
+  /// Returns the words of the array. Bit `i` is bit `i % 64` of word `i / 64`.
+  const uint64_t* words() const noexcept { return words_; }
+
+  /// Returns the number of words, `ceil(N / 64)`.
+  size_t word_count() const noexcept { return word_count_; }
+
+  /// Returns the size (`N`; number of bits) of the array.
+  size_t size() const noexcept { return size_; }
+
+  /// Returns how the memory of the array is backed. This may differ from the
+  /// `PageMode` the array was constructed with, if that was not available.
+  PageMode page_mode() const noexcept { return page_mode_; }
+
+  void swap(BitArray& other) noexcept {
+    std::swap(words_, other.words_);
+    std::swap(size_, other.size_);
+    std::swap(word_count_, other.word_count_);
+    std::swap(mapped_bytes_, other.mapped_bytes_);
+    std::swap(page_mode_, other.page_mode_);
+  }
+
+ private:
+  void allocate() {
+    const size_t bytes = word_count_ * sizeof(uint64_t);
+    if (bytes == 0) return;
+#if defined(__linux__)
+    if (page_mode_ == PageMode::kHugeTlb && map(bytes, MAP_HUGETLB)) return;
+    if (page_mode_ != PageMode::kDefault) {
+      page_mode_ = PageMode::kTransparentHugePages;
+      if (map(bytes, 0)) return;
+      throw std::bad_alloc();
+    }
+#endif
+    page_mode_ = PageMode::kDefault;
+    words_ = AlignedAllocator<uint64_t>().allocate(word_count_);
+    std::fill(words_, words_ + word_count_, 0);
+  }
+
+#if defined(__linux__)
+  /// Maps (zeroed) memory for (at least) `bytes` bytes in multiples of
+  /// `Detail::kHugePageSize`, with the given extra `mmap` flags. Returns
+  /// `false` if the mapping failed.
+  bool map(size_t bytes, int flags) noexcept {
+    const size_t length =
+        (bytes + Detail::kHugePageSize - 1) & ~(Detail::kHugePageSize - 1);
+    if (flags != 0) {
+      void* memory = mmap(nullptr,
+                          length,
+                          PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | flags,
+                          -1,
+                          0);
+      if (memory == MAP_FAILED) return false;
+      words_ = static_cast<uint64_t*>(memory);
+      mapped_bytes_ = length;
+      return true;
+    }
+
+    // Transparent huge pages are only used for 2 MiB aligned ranges, so map
+    // an extra huge page and unmap the unaligned head and tail.
+    const size_t padded = length + Detail::kHugePageSize;
+    void* memory = mmap(nullptr,
+                        padded,
+                        PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS,
+                        -1,
+                        0);
+    if (memory == MAP_FAILED) return false;
+    const auto address = reinterpret_cast<uintptr_t>(memory);
+    const auto aligned =
+        (address + Detail::kHugePageSize - 1) & ~(Detail::kHugePageSize - 1);
+    const size_t head = aligned - address;
+    if (head > 0) munmap(memory, head);
+    if (padded - head > length) {
+      munmap(reinterpret_cast<void*>(aligned + length), padded - head - length);
+    }
+#if defined(MADV_HUGEPAGE)
+    madvise(reinterpret_cast<void*>(aligned), length, MADV_HUGEPAGE);
+#endif
+    words_ = reinterpret_cast<uint64_t*>(aligned);
+    mapped_bytes_ = length;
+    return true;
+  }
+#endif
+
+  void deallocate() noexcept {
+    if (words_ == nullptr) return;
+#if defined(__linux__)
+    if (mapped_bytes_ > 0) {
+      munmap(words_, mapped_bytes_);
+      return;
+    }
+#endif
+    AlignedAllocator<uint64_t>().deallocate(words_, word_count_);
+  }
+
+  void check_same_size(const BitArray& other) const {
+    if (size_ != other.size_) {
+      throw std::invalid_argument("the bit arrays must have the same size");
+    }
+  }
+
+  uint64_t* words_ = nullptr;
+  size_t size_ = 0;
+  size_t word_count_ = 0;
+  /// The length of the mapping backing `words_`, or zero if `words_` was
+  /// allocated with an `AlignedAllocator`.
+  size_t mapped_bytes_ = 0;
+  PageMode page_mode_ = PageMode::kDefault;
+};
+}  // namespace Bloom
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <bloom/aligned-allocator.hpp>
+#include <bloom/bit-array.hpp>
+#include <bloom/hash.hpp>
+#include <bloom/options.hpp>
+#include <bloom/reduce.hpp>
+#include <bloom/slice.hpp>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Bloom {
+
+/// A cache-line-blocked bloom filter with runtime configurable size and hash
+/// count.
+///
+/// The filter is split into blocks of `kBlockSize` bits (one cache line). A key
+/// is hashed once; the hash selects one block and all `k` bits of the key are
+/// set (or tested) inside that block. A `put()` or `query()` thus touches a
+/// single cache line regardless of `k`, at the cost of a somewhat higher false
+/// positive rate than a `Filter` of the same size. Use
+/// `Options::ForBlockedFilter()` or `Options::ForBlockedExpectedCount()` to
+/// size the filter with that penalty accounted for.
+class BlockedFilter {
+ public:
+  /// The number of bits per block.
+  static constexpr size_t kBlockSize = kCacheLineSize * 8;
+
+  /// Constructs a `BlockedFilter` from the given options, using a
+  /// `Bloom::DoubleHasher` seeded with `options.seed` (or randomly, if there
+  /// is none). The size is rounded up to a multiple of `kBlockSize`.
+  explicit BlockedFilter(Options options)
+  : BlockedFilter(options,
+                  Detail::seeded_hasher<DoubleHasher>(options.seed)) {}
+
+  /// Constructs a `BlockedFilter` from the given options, hashing keys with
+  /// `hasher`. The size is rounded up to a multiple of `kBlockSize`.
+  BlockedFilter(Options options, DoubleHasher hasher)
+  : hasher_(hasher)
+  , hash_count_(options.hash_count)
+  , block_count_((options.size + kBlockSize - 1) / kBlockSize)
+  , bits_(block_count_ * kBlockSize, options.page_mode) {}
+
+  /// Constructs a `BlockedFilter` from a size and hash count.
+  /// Equivalent to constructing an `Options` object and using the constructor
+  /// from `Options`.
+  BlockedFilter(size_t size, size_t hash_count)
+  : BlockedFilter(Options(size, hash_count)) {}
+
+  /// Inserts the given `key` into the bloom filter.
+  ///
+  /// Inserting means hashing the key `x` once, selecting a block from that
+  /// hash and setting the `k` bits at the positions derived from the hash
+  /// inside that block to one.
+  ///
+  /// \complexity O(k)
+  void put(Slice key) {
+    const Digest digest = hasher_(key);
+    uint64_t* block = block_for(digest);
+    Detail::ProbeSequence probes(digest);
+    for (size_t i = 0; i < hash_count_; ++i) {
+      const auto bit = bit_in_block(probes.next());
+      block[bit / 64] |= uint64_t{1} << (bit % 64);
+    }
+  }
+
+  /// Returns `true` if the given `key` has possibly been inserted in the
+  /// bloom filter.
+  ///
+  /// A particular key `x` is assumed to be present if *every* one of the `k`
+  /// bits derived from its hash is set in the block the hash selects.
+  ///
+  /// \complexity O(k)
+  bool query(Slice key) const {
+    const Digest digest = hasher_(key);
+    const uint64_t* block = block_for(digest);
+    Detail::ProbeSequence probes(digest);
+    for (size_t i = 0; i < hash_count_; ++i) {
+      const auto bit = bit_in_block(probes.next());
+      if ((block[bit / 64] & (uint64_t{1} << (bit % 64))) == 0) return false;
+    }
+    return true;
+  }
+
+  /// Clears all entries in the bloom filter.
+  /// \complexity O(N)
+  void clear() { bits_.clear(); }
+
+  /// Returns the size (`N`; number of bits) of the bloom filter. This is always
+  /// a multiple of `kBlockSize`.
+  size_t size() const noexcept { return block_count_ * kBlockSize; }
+
+  /// Returns the number of hash functions (`k`) used in `put()` and `query()`
+  /// operations.
+  size_t hash_count() const noexcept { return hash_count_; }
+
+  /// Returns the bits of the bloom filter. Block `b` consists of the words
+  /// `b * kBlockSize / 64` up to (excluding) `(b + 1) * kBlockSize / 64`.
+  const BitArray& bits() const noexcept { return bits_; }
+
+ private:
+  static constexpr size_t kWordsPerBlock = kBlockSize / 64;
+
+  /// Selects the block for a key from the low bits of the high half of its
+  /// `digest`. The bits inside the block are derived from the top bits of the
+  /// probe sequence, so block and bit positions are (nearly) independent.
+  uint64_t* block_for(Digest digest) noexcept {
+    return bits_.words() + block_index(digest) * kWordsPerBlock;
+  }
+
+  const uint64_t* block_for(Digest digest) const noexcept {
+    return bits_.words() + block_index(digest) * kWordsPerBlock;
+  }
+
+  /// Returns the index of the block for the `digest`. A multiplication maps
+  /// the *top* bits of its operand, which also make up the top bits of the
+  /// probe step, so the low half is rotated into place first. For a power of
+  /// two block count, the multiplication is a shift; a mask would select the
+  /// top bits again.
+  size_t block_index(Digest digest) const noexcept {
+    return static_cast<size_t>(Detail::multiply_high(
+        Detail::rotate_left<uint64_t>(digest.high, 32), block_count_));
+  }
+
+  /// Maps a probe position to a bit index inside a block.
+  static size_t bit_in_block(uint64_t probe) noexcept {
+    return static_cast<size_t>(probe >> (64 - 9));
+  }
+
+  static_assert(kBlockSize == 512, "bit_in_block() assumes 512-bit blocks");
+
+  DoubleHasher hasher_;
+  size_t hash_count_;
+  size_t block_count_;
+  BitArray bits_;
+};
+}  // namespace Bloom
@@ -0,0 +1,590 @@
+#pragma once
+
+#include <bloom/bit-array.hpp>
+#include <bloom/cpu.hpp>
+#include <bloom/format.hpp>
+#include <bloom/hash.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <vector>
+
+namespace Bloom {
+
+/// How `save_compressed()` and `save_delta()` encode the bits of a filter.
+enum class Encoding : uint8_t {
+  /// The smallest of the encodings below, estimated from the bits.
+  kAuto = 0,
+  /// The words as they are, for filters that are about half full.
+  kRaw = 1,
+  /// The gaps between set bits, Golomb-Rice coded. Best for sparse filters
+  /// and deltas between versions of a filter.
+  kGaps = 2,
+  /// Runs of zero words as their length, the other words as they are. Best
+  /// for filters whose set bits are clustered.
+  kRuns = 3,
+};
+
+namespace Detail {
+
+/// A compressed filter is a 64-byte header followed by the encoded words. All
+/// integers are little-endian:
+///
+/// | Offset | Size | Field                                           |
+/// |--------|------|-------------------------------------------------|
+/// | 0      | 8    | Magic bytes `BLOOMCMP`                          |
+/// | 8      | 4    | Format version (`kFormatVersion`)               |
+/// | 12     | 4    | `HashScheme` of the `DoubleHasher`              |
+/// | 16     | 8    | Size (`N`; number of bits)                      |
+/// | 24     | 8    | Hash count (`k`)                                |
+/// | 32     | 8    | Seed of the `DoubleHasher`                      |
+/// | 40     | 8    | Checksum of the (decoded) words                 |
+/// | 48     | 8    | Checksum of the words of the base of a delta    |
+/// | 56     | 1    | `Encoding` (not `kAuto`)                        |
+/// | 57     | 1    | Rice parameter of `Encoding::kGaps`             |
+/// | 58     | 1    | One for a delta, zero otherwise                 |
+/// | 59     | 1    | Reserved, zero                                  |
+/// | 60     | 4    | Low half of the checksum of bytes 0 to 59       |
+/// | 64     | 8    | Number of words of the payload (`L`)            |
+/// | 72     | 8 L  | The payload                                     |
+///
+/// The payload encodes `W = ceil(N / 64)` words `D`, which are the words of
+/// the filter or, for a delta, their exclusive or with those of the base. Its
+/// length is known up front, so that a reader never reads past it, e.g. into
+/// the next filter sent over the same connection. It is a sequence of 64-bit
+/// words:
+///
+/// - `kRaw`: the `W` words of `D`.
+/// - `kGaps`: the number `c` of bits set in `D`, then a bit stream (from the
+///   lowest bit of each word up) of `c` Golomb-Rice codes with parameter `r`:
+///   the gap `g` between a set bit and the previous one (the number of zero
+///   bits in between) is coded as `g >> r` zeros, a one and the low `r` bits
+///   of `g`.
+/// - `kRuns`: markers, each followed by literal words. The low half of a
+///   marker is a number of zero words of `D`, its high half the number of
+///   literal words of `D` that follow it.
+constexpr char kCompressedMagic[8] = {'B', 'L', 'O', 'O', 'M', 'C', 'M', 'P'};
+
+/// The fields of the header of a compressed filter.
+struct CompressedHeader {
+  /// The fields shared with an uncompressed filter.
+  FileHeader filter;
+  uint64_t base_checksum = 0;
+  Encoding encoding = Encoding::kRaw;
+  uint8_t rice_parameter = 0;
+  bool delta = false;
+};
+
+/// Encodes the `header` into the `kHeaderSize` bytes at `data`.
+inline void encode_header(const CompressedHeader& header,
+                          uint8_t* data) noexcept {
+  std::fill(data, data + kHeaderSize, 0);
+  std::copy(kCompressedMagic, kCompressedMagic + sizeof kCompressedMagic, data);
+  store_little_endian(data + 8, kFormatVersion);
+  store_little_endian(data + 12, static_cast<uint32_t>(header.filter.scheme));
+  store_little_endian(data + 16, header.filter.size);
+  store_little_endian(data + 24, header.filter.hash_count);
+  store_little_endian(data + 32, header.filter.seed);
+  store_little_endian(data + 40, header.filter.payload_checksum);
+  store_little_endian(data + 48, header.base_checksum);
+  data[56] = static_cast<uint8_t>(header.encoding);
+  data[57] = header.rice_parameter;
+  data[58] = header.delta ? 1 : 0;
+  store_little_endian(data + 60, static_cast<uint32_t>(checksum(data, 60)));
+}
+
+/// Reads the header of a compressed filter from `stream`.
+///
+/// \throws std::runtime_error if reading fails or the bytes are not the header
+/// of a compressed filter in a format, encoding and with a hash scheme this
+/// version of the library supports.
+inline CompressedHeader read_compressed_header(std::istream& stream) {
+  uint8_t data[kHeaderSize];
+  if (!stream.read(reinterpret_cast<char*>(data), kHeaderSize)) {
+    throw std::runtime_error("could not read the bloom filter header");
+  }
+  if (!std::equal(kCompressedMagic,
+                  kCompressedMagic + sizeof kCompressedMagic,
+                  data)) {
+    throw std::runtime_error("not a compressed bloom filter");
+  }
+  if (load<uint32_t>(data + 60) != static_cast<uint32_t>(checksum(data, 60))) {
+    throw std::runtime_error("the header of the bloom filter is corrupt");
+  }
+  // The fields shared with an uncompressed filter are validated as such.
+  uint8_t shared[kHeaderSize];
+  std::copy(data, data + 48, shared);
+  std::copy(kMagic, kMagic + sizeof kMagic, shared);
+  store_little_endian(shared + 48, checksum(shared, 48));
+  CompressedHeader header;
+  header.filter = decode_header(shared);
+  header.base_checksum = load<uint64_t>(data + 48);
+  header.encoding = static_cast<Encoding>(data[56]);
+  header.rice_parameter = data[57];
+  header.delta = data[58] != 0;
+  if (header.encoding != Encoding::kRaw &&
+      header.encoding != Encoding::kGaps &&
+      header.encoding != Encoding::kRuns) {
+    throw std::runtime_error("unsupported bloom filter encoding");
+  }
+  if (header.rice_parameter > 63 || data[58] > 1) {
+    throw std::runtime_error("the header of the bloom filter is corrupt");
+  }
+  return header;
+}
+
+/// The number of words `WordWriter` and `WordReader` buffer, so that large
+/// filters are encoded and decoded in pieces that stay in the cache.
+constexpr size_t kStreamChunkWords = 4096;
+
+/// Writes little-endian words to a stream, `kStreamChunkWords` at a time.
+class WordWriter {
+ public:
+  explicit WordWriter(std::ostream& stream)
+  : stream_(stream), chunk_(kStreamChunkWords) {}
+
+  void write(uint64_t word) {
+    chunk_[size_++] = word;
+    if (size_ == chunk_.size()) flush();
+  }
+
+  void write(const uint64_t* words, size_t count) {
+    while (count > 0) {
+      const size_t piece = std::min(count, chunk_.size() - size_);
+      std::copy(words, words + piece, chunk_.begin() + size_);
+      size_ += piece;
+      words += piece;
+      count -= piece;
+      if (size_ == chunk_.size()) flush();
+    }
+  }
+
+  /// Writes the buffered words to the stream.
+  ///
+  /// \throws std::runtime_error if writing fails.
+  void flush() {
+    if (!kLittleEndian) {
+      std::transform(chunk_.begin(),
+                     chunk_.begin() + size_,
+                     chunk_.begin(),
+                     [](uint64_t word) { return byte_swap(word); });
+    }
+    stream_.write(reinterpret_cast<const char*>(chunk_.data()), size_ * 8);
+    size_ = 0;
+    if (!stream_) throw std::runtime_error("could not write the bloom filter");
+  }
+
+ private:
+  std::ostream& stream_;
+  std::vector<uint64_t> chunk_;
+  size_t size_ = 0;
+};
+
+/// Counts the words written to it, to size a payload before writing it.
+class WordCounter {
+ public:
+  void write(uint64_t /*unused*/) noexcept { ++count_; }
+
+  void write(const uint64_t* /*unused*/, size_t count) noexcept {
+    count_ += count;
+  }
+
+  uint64_t count() const noexcept { return count_; }
+
+ private:
+  uint64_t count_ = 0;
+};
+
+/// Reads little-endian words from a stream, `kStreamChunkWords` at a time, but
+/// never more than the `limit` words that belong to the payload.
+class WordReader {
+ public:
+  WordReader(std::istream& stream, uint64_t limit)
+  : stream_(stream), chunk_(kStreamChunkWords), limit_(limit) {}
+
+  /// \throws std::runtime_error if the stream or the payload ends.
+  uint64_t read() {
+    if (position_ == size_) refill();
+    return chunk_[position_++];
+  }
+
+  /// Returns `true` if all `limit` words have been read.
+  bool done() const noexcept {
+    return position_ == size_ && consumed_ == limit_;
+  }
+
+ private:
+  void refill() {
+    size_ = static_cast<size_t>(
+        std::min<uint64_t>(chunk_.size(), limit_ - consumed_));
+    if (size_ == 0 ||
+        !stream_.read(reinterpret_cast<char*>(chunk_.data()), size_ * 8)) {
+      throw std::runtime_error("the bloom filter is truncated");
+    }
+    if (!kLittleEndian) {
+      std::transform(chunk_.begin(),
+                     chunk_.begin() + size_,
+                     chunk_.begin(),
+                     [](uint64_t word) { return byte_swap(word); });
+    }
+    consumed_ += size_;
+    position_ = 0;
+  }
+
+  std::istream& stream_;
+  std::vector<uint64_t> chunk_;
+  uint64_t limit_;
+  uint64_t consumed_ = 0;
+  size_t size_ = 0;
+  size_t position_ = 0;
+};
+
+/// Returns the `bits` lowest bits of `value`.
+inline uint64_t low_bits(uint64_t value, size_t bits) noexcept {
+  return bits == 64 ? value : value & ((uint64_t{1} << bits) - 1);
+}
+
+/// Writes a stream of bits to a `WordWriter` (or `WordCounter`), from the
+/// lowest bit of each word up.
+template <typename Words>
+class BitWriter {
+ public:
+  explicit BitWriter(Words& words) : words_(words) {}
+
+  /// Writes the `bits` (at most 64) lowest bits of `value`, which must be
+  /// zero above them.
+  void write(uint64_t value, size_t bits) {
+    if (bits == 0) return;
+    buffer_ |= value << filled_;
+    if (filled_ + bits < 64) {
+      filled_ += bits;
+      return;
+    }
+    words_.write(buffer_);
+    buffer_ = filled_ == 0 ? 0 : value >> (64 - filled_);
+    filled_ = filled_ + bits - 64;
+  }
+
+  /// Writes `count` zeros followed by a one.
+  void write_unary(uint64_t count) {
+    for (; count >= 64; count -= 64) write(0, 64);
+    write(uint64_t{1} << count, count + 1);
+  }
+
+  /// Writes the Golomb-Rice code of `value` with the given `parameter`: the
+  /// high bits in unary, then the `parameter` low bits. Codes of up to 63
+  /// bits, as nearly all are, are written at once.
+  void write_rice(uint64_t value, size_t parameter) {
+    const uint64_t high = value >> parameter;
+    if (high + parameter < 63) {
+      write(((value & ((uint64_t{1} << parameter) - 1)) << (high + 1)) |
+                (uint64_t{1} << high),
+            high + 1 + parameter);
+      return;
+    }
+    write_unary(high);
+    write(low_bits(value, parameter), parameter);
+  }
+
+  /// Writes the last, partial word.
+  void finish() {
+    if (filled_ != 0) words_.write(buffer_);
+    buffer_ = 0;
+    filled_ = 0;
+  }
+
+ private:
+  Words& words_;
+  uint64_t buffer_ = 0;
+  size_t filled_ = 0;
+};
+
+/// Reads a stream of bits written by a `BitWriter` from a `WordReader`.
+class BitReader {
+ public:
+  explicit BitReader(WordReader& words) : words_(words) {}
+
+  /// Reads `bits` (at most 64) bits.
+  uint64_t read(size_t bits) {
+    if (bits <= available_) return consume(bits);
+    const uint64_t low = buffer_;
+    const size_t have = available_;
+    buffer_ = words_.read();
+    available_ = 64;
+    return low | (consume(bits - have) << have);
+  }
+
+  /// Reads zeros up to the next one, and returns their number.
+  uint64_t read_unary() {
+    uint64_t count = 0;
+    while (buffer_ == 0) {
+      count += available_;
+      buffer_ = words_.read();
+      available_ = 64;
+    }
+    const size_t zeros = count_trailing_zeros(buffer_);
+    consume(zeros + 1);
+    return count + zeros;
+  }
+
+  /// Returns `true` if the bits left in the current word are all zero, like
+  /// the padding a `BitWriter` writes.
+  bool padded() const noexcept { return buffer_ == 0; }
+
+ private:
+  /// Consumes `bits` of the (at least as many) bits in the buffer.
+  uint64_t consume(size_t bits) noexcept {
+    const uint64_t value = low_bits(buffer_, bits);
+    buffer_ = bits == 64 ? 0 : buffer_ >> bits;
+    available_ -= bits;
+    return value;
+  }
+
+  WordReader& words_;
+  /// The unread bits, in the lowest `available_` bits; the others are zero.
+  uint64_t buffer_ = 0;
+  size_t available_ = 0;
+};
+
+/// The words `D` to encode: the words of a filter, or their exclusive or with
+/// those of the `base` of a delta.
+struct EncodedWords {
+  const uint64_t* words;
+  /// The words of the base of a delta, or null.
+  const uint64_t* base;
+  size_t count;
+
+  /// Calls `function(chunk, size)` for consecutive pieces of `D` of (at most)
+  /// `kStreamChunkWords` words, so that the exclusive or of a delta is only
+  /// ever computed for one piece.
+  template <typename Function>
+  void for_each_chunk(Function&& function) const {
+    std::vector<uint64_t> chunk(base == nullptr ? 0 : kStreamChunkWords);
+    for (size_t first = 0; first < count; first += kStreamChunkWords) {
+      const size_t size = std::min(kStreamChunkWords, count - first);
+      if (base == nullptr) {
+        function(words + first, size);
+        continue;
+      }
+      for (size_t i = 0; i < size; ++i) {
+        chunk[i] = words[first + i] ^ base[first + i];
+      }
+      function(chunk.data(), size);
+    }
+  }
+};
+
+/// The largest number of zero words of a marker of `kRuns`.
+constexpr uint64_t kMaxRunWords = 0xffffffff;
+
+/// Returns the Rice parameter for `set_bits` bits set out of `size`: the one
+/// minimizing the estimated size `set_bits * (r + 1) + (size >> r)` (in bits)
+/// of the code, which is close to the log2 of the mean gap times `ln(2)`.
+inline uint8_t rice_parameter(uint64_t size, uint64_t set_bits) noexcept {
+  if (set_bits == 0) return 0;
+  const double mean_gap = static_cast<double>(size) / set_bits;
+  const auto estimate = [&](int parameter) {
+    return set_bits * (parameter + 1) + (size >> parameter);
+  };
+  int parameter = std::max(
+      0, std::min(63, static_cast<int>(std::log2(mean_gap * std::log(2.0)))));
+  if (parameter < 63 && estimate(parameter + 1) < estimate(parameter)) {
+    ++parameter;
+  }
+  return static_cast<uint8_t>(parameter);
+}
+
+/// Fills in the encoding and Rice parameter of the `header` for `source`,
+/// choosing the smallest encoding if the `encoding` is `kAuto`, and returns
+/// the number of bits set in `source`. One pass over the words counts their
+/// set bits and the markers `kRuns` needs.
+inline uint64_t choose_encoding(const EncodedWords& source,
+                                Encoding encoding,
+                                CompressedHeader& header) {
+  uint64_t set_bits = 0;
+  uint64_t literals = 0;
+  uint64_t markers = source.count == 0 ? 0 : 1;
+  uint64_t previous = 0;
+  source.for_each_chunk([&](const uint64_t* chunk, size_t size) {
+    set_bits += count_bits(chunk, size);
+    // Without branches, which zero and other words would mispredict.
+    for (size_t i = 0; i < size; ++i) {
+      const uint64_t literal = chunk[i] != 0 ? 1 : 0;
+      literals += literal;
+      // Zero words after literals start the next marker.
+      markers += previous & (literal ^ 1);
+      previous = literal;
+    }
+  });
+  header.rice_parameter = rice_parameter(header.filter.size, set_bits);
+  if (encoding != Encoding::kAuto) {
+    header.encoding = encoding;
+    return set_bits;
+  }
+  const uint64_t raw = source.count;
+  const uint64_t runs = markers + literals;
+  const uint64_t gaps =
+      1 + (set_bits * (header.rice_parameter + 1) +
+           (header.filter.size >> header.rice_parameter) + 63) /
+              64;
+  header.encoding = Encoding::kRaw;
+  if (runs < raw) header.encoding = Encoding::kRuns;
+  if (gaps < std::min(raw, runs)) header.encoding = Encoding::kGaps;
+  return set_bits;
+}
+
+/// Writes the payload encoding `source`, in which `set_bits` bits are set, as
+/// the `header` asks to `words` (a `WordWriter` or `WordCounter`).
+template <typename Words>
+void encode_payload(const EncodedWords& source,
+                    uint64_t set_bits,
+                    const CompressedHeader& header,
+                    Words& words) {
+  switch (header.encoding) {
+    case Encoding::kAuto:
+    case Encoding::kRaw:
+      source.for_each_chunk([&words](const uint64_t* chunk, size_t size) {
+        words.write(chunk, size);
+      });
+      break;
+    case Encoding::kGaps: {
+      words.write(set_bits);
+      BitWriter<Words> bits(words);
+      const size_t parameter = header.rice_parameter;
+      uint64_t position = 0;
+      uint64_t next = 0;
+      source.for_each_chunk([&](const uint64_t* chunk, size_t size) {
+        for (size_t i = 0; i < size; ++i, position += 64) {
+          for (uint64_t word = chunk[i]; word != 0; word &= word - 1) {
+            const uint64_t bit = position + count_trailing_zeros(word);
+            bits.write_rice(bit - next, parameter);
+            next = bit + 1;
+          }
+        }
+      });
+      bits.finish();
+      break;
+    }
+    case Encoding::kRuns: {
+      // Zero runs carry over from one piece to the next, literal runs end
+      // with their piece.
+      uint64_t zeros = 0;
+      source.for_each_chunk([&](const uint64_t* chunk, size_t size) {
+        size_t i = 0;
+        while (i < size) {
+          for (; i < size && chunk[i] == 0; ++i) {
+            if (++zeros == kMaxRunWords) {
+              words.write(zeros);
+              zeros = 0;
+            }
+          }
+          const size_t first = i;
+          while (i < size && chunk[i] != 0) ++i;
+          if (i == first) break;
+          words.write(zeros | (uint64_t{i - first} << 32));
+          words.write(chunk + first, i - first);
+          zeros = 0;
+        }
+      });
+      if (zeros != 0) words.write(zeros);
+      break;
+    }
+  }
+}
+
+/// Writes `source` (with the header fields of the filter already set in
+/// `header`) to `stream`, encoded as the `encoding` asks. The payload is
+/// encoded twice: once to count its words, then to write them.
+///
+/// \throws std::runtime_error if writing fails.
+inline void write_compressed(std::ostream& stream,
+                             CompressedHeader header,
+                             const EncodedWords& source,
+                             Encoding encoding) {
+  const uint64_t set_bits = choose_encoding(source, encoding, header);
+  WordCounter counter;
+  encode_payload(source, set_bits, header, counter);
+  uint8_t bytes[kHeaderSize];
+  encode_header(header, bytes);
+  stream.write(reinterpret_cast<const char*>(bytes), kHeaderSize);
+  WordWriter writer(stream);
+  writer.write(counter.count());
+  encode_payload(source, set_bits, header, writer);
+  writer.flush();
+}
+
+/// Decodes the payload described by `header` from `stream` and applies it to
+/// the `header.filter.word_count()` words at `words`, which must hold the
+/// base for a delta and be zero otherwise, then verifies their checksum. The
+/// payload is decoded a piece at a time and each word is written once, so
+/// that decoding runs at the speed of the stream.
+///
+/// \throws std::runtime_error if reading fails, the words do not hold the
+/// base of a delta, or the payload or its checksum are corrupt. The words are
+/// then left in an unspecified state.
+inline void read_compressed_words(std::istream& stream,
+                                  const CompressedHeader& header,
+                                  uint64_t* words) {
+  const uint64_t count = header.filter.word_count();
+  if (header.delta && payload_checksum(words, count) != header.base_checksum) {
+    throw std::runtime_error("the delta was not made against this filter");
+  }
+  const auto corrupt = [] {
+    return std::runtime_error("the bits of the bloom filter are corrupt");
+  };
+  uint8_t length[8];
+  if (!stream.read(reinterpret_cast<char*>(length), sizeof length)) {
+    throw std::runtime_error("the bloom filter is truncated");
+  }
+  WordReader reader(stream, load<uint64_t>(length));
+  switch (header.encoding) {
+    case Encoding::kAuto:
+    case Encoding::kRaw:
+      for (uint64_t i = 0; i < count; ++i) words[i] ^= reader.read();
+      break;
+    case Encoding::kGaps: {
+      const uint64_t set_bits = reader.read();
+      if (set_bits > header.filter.size) throw corrupt();
+      BitReader bits(reader);
+      const size_t parameter = header.rice_parameter;
+      const uint64_t size = header.filter.size;
+      uint64_t next = 0;
+      for (uint64_t i = 0; i < set_bits; ++i) {
+        const uint64_t high = bits.read_unary();
+        if (high > (size >> parameter)) throw corrupt();
+        const uint64_t gap = (high << parameter) | bits.read(parameter);
+        if (gap >= size - next) throw corrupt();
+        const uint64_t position = next + gap;
+        words[position / 64] ^= uint64_t{1} << (position % 64);
+        next = position + 1;
+      }
+      if (!bits.padded()) throw corrupt();
+      break;
+    }
+    case Encoding::kRuns:
+      for (uint64_t i = 0; i < count;) {
+        const uint64_t marker = reader.read();
+        const uint64_t zeros = marker & kMaxRunWords;
+        const uint64_t literals = marker >> 32;
+        if (zeros + literals == 0 || zeros + literals > count - i) {
+          throw corrupt();
+        }
+        i += zeros;
+        for (const uint64_t stop = i + literals; i < stop; ++i) {
+          words[i] ^= reader.read();
+        }
+      }
+      break;
+  }
+  if (!reader.done() ||
+      payload_checksum(words, count) != header.filter.payload_checksum) {
+    throw corrupt();
+  }
+}
+}  // namespace Detail
+}  // namespace Bloom
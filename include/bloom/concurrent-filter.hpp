@@ -0,0 +1,30 @@
+#pragma once
+
+#include <bloom/atomic-bit-array.hpp>
+#include <bloom/filter.hpp>
+#include <bloom/hash-policy.hpp>
+#include <bloom/hash.hpp>
+
+namespace Bloom {
+
+/// A bloom filter that may be shared by any number of threads inserting and
+/// querying keys concurrently, without locks.
+///
+/// The bits live in an `AtomicBitArray`: `put()` sets bits with an atomic
+/// `fetch_or` on the 64-bit word containing them and `query()` reads words
+/// with relaxed atomic loads, so a single
+/// instance replaces per-thread filters that would have to be merged. A key
+/// is guaranteed to be found by a `query()` that *happens after* the `put()`
+/// of that key (e.g. because the threads synchronized in between). A `query()`
+/// racing with the `put()` of the same key may or may not find it, but neither
+/// operation ever observes a torn word. There is no ordering between the bits
+/// of a key and other memory: a positive `query()` does not synchronize with
+/// the `put()` that made it positive.
+///
+/// It is a `BasicFilter` hashing keys with a `DoubleHasher`, so it sets the
+/// same bits as a `Filter` constructed from the same `Options` and hasher.
+/// `bits()` returns the `AtomicBitArray`, whose `snapshot()` copies the bits;
+/// the `page_mode` of the `Options` is ignored.
+using ConcurrentFilter =
+    BasicFilter<DigestHashing<DoubleHasher>, AtomicBitArray>;
+}  // namespace Bloom
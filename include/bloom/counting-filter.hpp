@@ -0,0 +1,201 @@
+#pragma once
+
+#include <bloom/bit-array.hpp>
+#include <bloom/hash-policy.hpp>
+#include <bloom/hash.hpp>
+#include <bloom/options.hpp>
+#include <bloom/reduce.hpp>
+#include <bloom/slice.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <stdexcept>
+#include <utility>
+
+namespace Bloom {
+
+/// A bloom filter that supports removing keys, by keeping a small saturating
+/// counter instead of a single bit in each of its `N` positions.
+///
+/// `CounterBits` may be 4 (the default, enough for all but the most skewed
+/// workloads) or 8. Counters are packed into 64-bit words. A counter that
+/// reaches `kMaxCount` sticks there: it is no longer decremented, since the
+/// number of keys that incremented it is unknown. Removing a key that was
+/// never inserted may remove other keys (cause false negatives).
+///
+/// Probe positions are derived exactly like those of a `Filter` constructed
+/// from the same `Options` and `Hasher`s.
+template <size_t CounterBits = 4>
+class CountingFilter {
+ public:
+  static_assert(CounterBits == 4 || CounterBits == 8,
+                "counters must be 4 or 8 bits wide");
+
+  using Hasher = DynamicHashing::Hasher;
+
+  /// The largest value a counter can hold.
+  static constexpr uint64_t kMaxCount = (uint64_t{1} << CounterBits) - 1;
+
+  /// Constructs a `CountingFilter` with a size and a user provided iterator
+  /// range of hash functions, like the corresponding `Filter` constructor.
+  template <typename Iterator>
+  CountingFilter(size_t size, Iterator hashers_begin, Iterator hashers_end)
+  : CountingFilter(size,
+                   PageMode::kDefault,
+                   DynamicHashing(hashers_begin, hashers_end)) {}
+
+  /// Constructs a `CountingFilter` with a size and a user provided list of
+  /// hash functions.
+  CountingFilter(size_t size, std::initializer_list<Hasher> hashers)
+  : CountingFilter(size, hashers.begin(), hashers.end()) {}
+
+  /// Constructs a `CountingFilter` from the given options, using a
+  /// `Bloom::DoubleHasher` seeded with `options.seed` (or randomly, if there
+  /// is none).
+  explicit CountingFilter(Options options)
+  : CountingFilter(options.size,
+                   options.page_mode,
+                   DynamicHashing(options.hash_count, options.seed)) {}
+
+  /// Constructs a `CountingFilter` from the given options, deriving all `k`
+  /// probe positions of a key from a single digest computed by
+  /// `double_hasher`. The filter takes `options.size * CounterBits` bits.
+  CountingFilter(Options options, DoubleHasher double_hasher)
+  : CountingFilter(options.size,
+                   options.page_mode,
+                   DynamicHashing(options.hash_count, double_hasher)) {}
+
+  /// Constructs a `CountingFilter` from a size and hash count.
+  /// Equivalent to constructing an `Options` object and using the constructor
+  /// from `Options`.
+  CountingFilter(size_t size, size_t hash_count)
+  : CountingFilter(Options(size, hash_count)) {}
+
+  /// Inserts the given `key` into the bloom filter, incrementing each of its
+  /// `k` counters unless it is saturated.
+  ///
+  /// \complexity O(k)
+  void put(Slice key) {
+    for_each_index(key, [this](size_t index) {
+      this->increment(index);
+      return true;
+    });
+  }
+
+  /// Removes the given `key` from the bloom filter, decrementing each of its
+  /// `k` counters unless it is saturated. Returns `false` (and removes
+  /// nothing) if the key is not in the filter, i.e. `query(key)` is `false`.
+  ///
+  /// Only keys that were inserted may be removed: removing any other key that
+  /// happens to be a false positive decrements counters of other keys.
+  ///
+  /// \complexity O(k)
+  bool remove(Slice key) {
+    if (!query(key)) return false;
+    for_each_index(key, [this](size_t index) {
+      this->decrement(index);
+      return true;
+    });
+    return true;
+  }
+
+  /// Returns `true` if the given `key` has possibly been inserted in the
+  /// bloom filter (and not removed since), i.e. if all of its `k` counters
+  /// are non-zero.
+  ///
+  /// \complexity O(k)
+  bool query(Slice key) const {
+    return for_each_index(
+        key, [this](size_t index) { return this->count(index) != 0; });
+  }
+
+  /// Returns an upper bound on the number of times the `key` was inserted
+  /// (minus the number of times it was removed): the smallest of its `k`
+  /// counters. This is exact unless the counters of the key are shared with
+  /// other keys or saturated.
+  ///
+  /// \complexity O(k)
+  uint64_t estimate_count(Slice key) const {
+    uint64_t minimum = kMaxCount;
+    for_each_index(key, [this, &minimum](size_t index) {
+      minimum = std::min(minimum, this->count(index));
+      return minimum != 0;
+    });
+    return minimum;
+  }
+
+  /// Clears all entries in the bloom filter.
+  /// \complexity O(N)
+  void clear() { counters_.clear(); }
+
+  /// Returns the size (`N`; number of counters) of the bloom filter.
+  size_t size() const noexcept { return reduce_.range(); }
+
+  /// Returns the number of hash functions (`k`) used in `put()`, `remove()`
+  /// and `query()` operations.
+  size_t hash_count() const noexcept { return hashing_.hash_count(); }
+
+  /// Returns the counters of the bloom filter. Counter `i` consists of the
+  /// bits `i * CounterBits` up to (excluding) `(i + 1) * CounterBits`.
+  const BitArray& counters() const noexcept { return counters_; }
+
+ private:
+  static constexpr size_t kCountersPerWord = 64 / CounterBits;
+
+  CountingFilter(size_t size, PageMode page_mode, DynamicHashing hashing)
+  : hashing_(std::move(hashing))
+  , reduce_(size, hashing_.reduce_method())
+  , counters_(size * CounterBits, page_mode) {
+    if (hashing_.hash_count() > size) {
+      throw std::invalid_argument(
+          "the number of hash functions must not be greater than the "
+          "size of the bloom filter");
+    }
+  }
+
+  /// Returns the value of the counter at `index`.
+  uint64_t count(size_t index) const noexcept {
+    const uint64_t word = counters_.words()[index / kCountersPerWord];
+    return (word >> shift(index)) & kMaxCount;
+  }
+
+  /// Increments the counter at `index` unless it is saturated, without
+  /// branching on its value.
+  void increment(size_t index) noexcept {
+    uint64_t& word = counters_.words()[index / kCountersPerWord];
+    const size_t offset = shift(index);
+    const uint64_t saturated = ((word >> offset) & kMaxCount) == kMaxCount;
+    word += (1 - saturated) << offset;
+  }
+
+  /// Decrements the counter at `index` unless it is zero or saturated,
+  /// without branching on its value.
+  void decrement(size_t index) noexcept {
+    uint64_t& word = counters_.words()[index / kCountersPerWord];
+    const size_t offset = shift(index);
+    const uint64_t value = (word >> offset) & kMaxCount;
+    const uint64_t live = value != 0 && value != kMaxCount;
+    word -= live << offset;
+  }
+
+  static size_t shift(size_t index) noexcept {
+    return (index % kCountersPerWord) * CounterBits;
+  }
+
+  /// Invokes `function` with each of the `k` counter indices of the `key`,
+  /// stopping early as soon as `function` returns `false`.
+  template <typename Function>
+  bool for_each_index(Slice key, Function function) const {
+    return hashing_.for_each_index(key, reduce_, function);
+  }
+
+  DynamicHashing hashing_;
+  RangeReducer reduce_;
+  BitArray counters_;
+};
+
+template <size_t CounterBits>
+constexpr uint64_t CountingFilter<CounterBits>::kMaxCount;
+}  // namespace Bloom
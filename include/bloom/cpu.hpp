@@ -0,0 +1,110 @@
+#pragma once
+
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__GNUC__) || defined(__clang__))
+/// Defined if the x86 SIMD kernels of the library are compiled in. They are
+/// compiled with per-function `target` attributes, so no `-m` flags are
+/// needed, and selected at runtime based on what the CPU supports.
+#define BLOOM_HAS_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+#include <cstdint>
+#include <initializer_list>
+
+namespace Bloom {
+
+/// The instruction set extensions for which the library provides kernels, in
+/// order of preference.
+enum class Isa {
+  kScalar,
+  kSse42,
+  kAvx2,
+  kAvx512,
+};
+
+/// Returns `true` if the kernels for `isa` are compiled in and the CPU the
+/// program is running on supports `isa`.
+inline bool cpu_supports(Isa isa) noexcept {
+  switch (isa) {
+    case Isa::kScalar: return true;
+#if defined(BLOOM_HAS_X86_KERNELS)
+    case Isa::kSse42: return __builtin_cpu_supports("sse4.2") != 0;
+    case Isa::kAvx2: return __builtin_cpu_supports("avx2") != 0;
+    case Isa::kAvx512: return __builtin_cpu_supports("avx512f") != 0;
+#else
+    case Isa::kSse42:
+    case Isa::kAvx2:
+    case Isa::kAvx512: return false;
+#endif
+  }
+  return false;
+}
+
+/// Returns the most preferable `Isa` the CPU supports. Determined once.
+inline Isa best_isa() noexcept {
+  static const Isa isa = [] {
+    for (const auto candidate : {Isa::kAvx512, Isa::kAvx2, Isa::kSse42}) {
+      if (cpu_supports(candidate)) return candidate;
+    }
+    return Isa::kScalar;
+  }();
+  return isa;
+}
+
+namespace Detail {
+
+/// `true` if the CPU stores integers with their least significant byte first.
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+constexpr bool kLittleEndian = false;
+#else
+constexpr bool kLittleEndian = true;
+#endif
+
+/// Returns `value`, which has only one byte.
+inline uint8_t byte_swap(uint8_t value) noexcept { return value; }
+
+/// Reverses the order of the bytes of `value`.
+inline uint16_t byte_swap(uint16_t value) noexcept {
+  return static_cast<uint16_t>((value << 8) | (value >> 8));
+}
+
+/// Reverses the order of the bytes of `value`.
+inline uint32_t byte_swap(uint32_t value) noexcept {
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_bswap32(value);
+#else
+  value = ((value << 8) & 0xff00ff00u) | ((value >> 8) & 0x00ff00ffu);
+  return (value << 16) | (value >> 16);
+#endif
+}
+
+/// Reverses the order of the bytes of `value`.
+inline uint64_t byte_swap(uint64_t value) noexcept {
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_bswap64(value);
+#else
+  const uint64_t low = byte_swap(static_cast<uint32_t>(value));
+  return (low << 32) | byte_swap(static_cast<uint32_t>(value >> 32));
+#endif
+}
+
+/// Hints the CPU to fetch the cache line containing `address` for reading.
+inline void prefetch(const void* address) noexcept {
+#if defined(__GNUC__) || defined(__clang__)
+  __builtin_prefetch(address, 0);
+#else
+  (void)address;
+#endif
+}
+
+/// Hints the CPU to fetch the cache line containing `address` for writing.
+inline void prefetch_for_write(const void* address) noexcept {
+#if defined(__GNUC__) || defined(__clang__)
+  __builtin_prefetch(address, 1);
+#else
+  (void)address;
+#endif
+}
+}  // namespace Detail
+}  // namespace Bloom
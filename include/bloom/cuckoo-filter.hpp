@@ -0,0 +1,285 @@
+#pragma once
+
+#include <bloom/bit-array.hpp>
+#include <bloom/format.hpp>
+#include <bloom/hash.hpp>
+#include <bloom/reduce.hpp>
+#include <bloom/slice.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+namespace Bloom {
+
+/// A filter that supports removing keys, by storing a small fingerprint of
+/// every key in one of two buckets of four slots each. See Fan et al.,
+/// "Cuckoo Filter: Practically Better Than Bloom".
+///
+/// `FingerprintBits` may be 8, 12 (the default) or 16. Buckets are packed
+/// without padding, so that a bucket holds `4 * FingerprintBits` bits, and
+/// are compared against a fingerprint four slots at a time with a few integer
+/// operations. A query reads exactly two buckets. The false positive rate is
+/// about `8 / 2^FingerprintBits` when the filter is (nearly) full: 3% for 8,
+/// 0.2% for 12 and 0.01% for 16 bits, at `FingerprintBits / 0.95` bits per
+/// key.
+///
+/// A key is stored in its first bucket, or in its second bucket (derived from
+/// the first and its fingerprint), or, if both are full, makes room by moving
+/// the fingerprint of another key to that key's other bucket, and so on. If
+/// no room is found after `kMaxKicks` moves, the filter is full.
+///
+/// Inserting the same key more than once stores it more than once (in total
+/// at most eight times). Removing a key that was never inserted may remove a
+/// different key with the same fingerprint (cause a false negative).
+template <size_t FingerprintBits = 12, typename Hasher = DoubleHasher>
+class CuckooFilter {
+ public:
+  static_assert(FingerprintBits == 8 || FingerprintBits == 12 ||
+                    FingerprintBits == 16,
+                "fingerprints must be 8, 12 or 16 bits wide");
+  static_assert(Detail::IsDigestHasher<Hasher>::value,
+                "the hash function of a CuckooFilter must produce a Digest");
+
+  /// The number of fingerprints per bucket.
+  static constexpr size_t kSlotsPerBucket = 4;
+
+  /// The number of fingerprints that are moved to make room for a new one
+  /// before `put()` gives up.
+  static constexpr size_t kMaxKicks = 500;
+
+  /// The proportion of slots `put()` fills with high probability before it
+  /// first fails.
+  static constexpr double kMaxLoadFactor = 0.95;
+
+  /// Constructs a `CuckooFilter` that can hold (at least) `capacity` keys,
+  /// hashing them with a randomly seeded `Hasher`.
+  explicit CuckooFilter(size_t capacity) : CuckooFilter(capacity, Hasher()) {}
+
+  /// Constructs a `CuckooFilter` that can hold (at least) `capacity` keys,
+  /// hashing them with `hasher`.
+  CuckooFilter(size_t capacity, Hasher hasher)
+  : hasher_(std::move(hasher))
+  , bucket_count_(std::max<size_t>(
+        static_cast<size_t>(std::ceil(capacity / kMaxLoadFactor /
+                                      kSlotsPerBucket)),
+        1))
+  // One more word, so that the last bucket can be loaded as a whole word.
+  , buckets_(bucket_count_ * kBucketBits + 64) {}
+
+  /// Inserts the given `key` into the filter. Returns `false` (and changes
+  /// nothing) if the filter is full.
+  ///
+  /// \complexity O(1) on average, O(kMaxKicks) if the filter is nearly full.
+  bool put(Slice key) {
+    const Location location = locate(key);
+    if (insert(location.first, location.fingerprint)) return true;
+    if (insert(location.second, location.fingerprint)) return true;
+
+    // Move fingerprints to their other bucket until one lands in a bucket
+    // with room, and move them all back if none does.
+    std::array<std::pair<size_t, size_t>, kMaxKicks> moves;
+    uint64_t fingerprint = location.fingerprint;
+    size_t bucket = next_random() % 2 == 0 ? location.first : location.second;
+    for (size_t kick = 0; kick < kMaxKicks; ++kick) {
+      const size_t slot = next_random() % kSlotsPerBucket;
+      fingerprint = exchange(bucket, slot, fingerprint);
+      moves[kick] = {bucket, slot};
+      bucket = alternate(bucket, fingerprint);
+      if (insert(bucket, fingerprint)) return true;
+    }
+    for (size_t kick = kMaxKicks; kick-- > 0;) {
+      fingerprint =
+          exchange(moves[kick].first, moves[kick].second, fingerprint);
+    }
+    return false;
+  }
+
+  /// Returns `true` if the given `key` has possibly been inserted into the
+  /// filter (and not removed since).
+  ///
+  /// \complexity O(1)
+  bool query(Slice key) const noexcept {
+    const Location location = locate(key);
+    return find(load(location.first), location.fingerprint) != 0 ||
+           find(load(location.second), location.fingerprint) != 0;
+  }
+
+  /// Removes (one copy of) the given `key` from the filter. Returns `false`
+  /// (and removes nothing) if the key is not in the filter, i.e. `query(key)`
+  /// is `false`.
+  ///
+  /// Only keys that were inserted may be removed: removing any other key that
+  /// happens to be a false positive removes another key.
+  ///
+  /// \complexity O(1)
+  bool remove(Slice key) {
+    const Location location = locate(key);
+    return erase(location.first, location.fingerprint) ||
+           erase(location.second, location.fingerprint);
+  }
+
+  /// Removes all keys from the filter.
+  /// \complexity O(N)
+  void clear() noexcept {
+    buckets_.clear();
+    count_ = 0;
+  }
+
+  /// Returns the size (number of bits) of the buckets.
+  size_t size() const noexcept { return bucket_count_ * kBucketBits; }
+
+  /// Returns the number of buckets.
+  size_t bucket_count() const noexcept { return bucket_count_; }
+
+  /// Returns the number of fingerprints the filter holds.
+  size_t count() const noexcept { return count_; }
+
+  /// Returns the proportion of slots that hold a fingerprint.
+  double load_factor() const noexcept {
+    return static_cast<double>(count_) / (bucket_count_ * kSlotsPerBucket);
+  }
+
+  /// Returns the hasher keys are hashed with.
+  const Hasher& hasher() const noexcept { return hasher_; }
+
+ private:
+  static constexpr size_t kBucketBits = kSlotsPerBucket * FingerprintBits;
+  static constexpr size_t kBucketBytes = kBucketBits / 8;
+  static constexpr uint64_t kFingerprintMask =
+      (uint64_t{1} << FingerprintBits) - 1;
+  static constexpr uint64_t kBucketMask =
+      kBucketBits == 64 ? ~uint64_t{0} : (uint64_t{1} << kBucketBits % 64) - 1;
+  /// The lowest bit of every slot of a bucket.
+  static constexpr uint64_t kLowBits =
+      uint64_t{1} | uint64_t{1} << FingerprintBits |
+      uint64_t{1} << 2 * FingerprintBits | uint64_t{1} << 3 * FingerprintBits;
+  /// The highest bit of every slot of a bucket.
+  static constexpr uint64_t kHighBits = kLowBits << (FingerprintBits - 1);
+
+  /// The fingerprint and both buckets of a key.
+  struct Location {
+    uint64_t fingerprint;
+    size_t first;
+    size_t second;
+  };
+
+  Location locate(Slice key) const noexcept {
+    const Digest digest = hasher_(key);
+    Location location;
+    // A zero marks an empty slot.
+    location.fingerprint =
+        std::max<uint64_t>(digest.high >> (64 - FingerprintBits), 1);
+    location.first =
+        static_cast<size_t>(Detail::multiply_high(digest.low, bucket_count_));
+    location.second = alternate(location.first, location.fingerprint);
+    return location;
+  }
+
+  /// Returns the other bucket of the key with the given `fingerprint` in
+  /// `bucket`. Since `(h - (h - b)) = b` modulo the bucket count, the other
+  /// bucket of the other bucket is `bucket` again, for any bucket count.
+  size_t alternate(size_t bucket, uint64_t fingerprint) const noexcept {
+    const auto offset = static_cast<size_t>(
+        Detail::multiply_high(Detail::fmix64(fingerprint), bucket_count_));
+    return offset >= bucket ? offset - bucket
+                            : offset + bucket_count_ - bucket;
+  }
+
+  /// Returns a word with the highest bit of the first slot of `bucket` that
+  /// holds `fingerprint` set, and possibly that of later slots, or zero if no
+  /// slot holds it.
+  static uint64_t find(uint64_t bucket, uint64_t fingerprint) noexcept {
+    // A slot holds the fingerprint iff it is zero after the xor, and the
+    // subtraction borrows from (only) the highest bit of a zero slot, unless a
+    // lower slot borrowed from it.
+    const uint64_t difference = bucket ^ (fingerprint * kLowBits);
+    return (difference - kLowBits) & ~difference & kHighBits;
+  }
+
+  /// Returns the index of the first slot marked by `find()`.
+  static size_t first_slot(uint64_t found) noexcept {
+    return Detail::count_trailing_zeros(found) / FingerprintBits;
+  }
+
+  /// Stores `fingerprint` in an empty slot of `bucket`. Returns `false` if
+  /// there is none.
+  bool insert(size_t bucket, uint64_t fingerprint) noexcept {
+    const uint64_t value = load(bucket);
+    const uint64_t empty = find(value, 0);
+    if (empty == 0) return false;
+    const size_t shift = first_slot(empty) * FingerprintBits;
+    store(bucket, value | fingerprint << shift);
+    ++count_;
+    return true;
+  }
+
+  /// Clears the first slot of `bucket` holding `fingerprint`. Returns `false`
+  /// if there is none.
+  bool erase(size_t bucket, uint64_t fingerprint) noexcept {
+    const uint64_t value = load(bucket);
+    const uint64_t found = find(value, fingerprint);
+    if (found == 0) return false;
+    const size_t shift = first_slot(found) * FingerprintBits;
+    store(bucket, value & ~(kFingerprintMask << shift));
+    --count_;
+    return true;
+  }
+
+  /// Replaces the fingerprint in `slot` of `bucket` with `fingerprint` and
+  /// returns the one it held.
+  uint64_t exchange(size_t bucket, size_t slot, uint64_t fingerprint) noexcept {
+    const uint64_t value = load(bucket);
+    const size_t shift = slot * FingerprintBits;
+    store(bucket,
+          (value & ~(kFingerprintMask << shift)) | fingerprint << shift);
+    return (value >> shift) & kFingerprintMask;
+  }
+
+  /// Returns the slots of `bucket`, the first in the lowest bits.
+  uint64_t load(size_t bucket) const noexcept {
+    return Detail::load<uint64_t>(bytes() + bucket * kBucketBytes) &
+           kBucketMask;
+  }
+
+  /// Replaces the slots of `bucket` with `value`, leaving the following
+  /// bucket unchanged.
+  void store(size_t bucket, uint64_t value) noexcept {
+    uint8_t* data =
+        reinterpret_cast<uint8_t*>(buckets_.words()) + bucket * kBucketBytes;
+    const uint64_t word = Detail::load<uint64_t>(data);
+    Detail::store_little_endian(data, (word & ~kBucketMask) | value);
+  }
+
+  const uint8_t* bytes() const noexcept {
+    return reinterpret_cast<const uint8_t*>(buckets_.words());
+  }
+
+  /// Returns the next value of a xorshift generator, which picks the slots
+  /// whose fingerprints are moved.
+  uint64_t next_random() noexcept {
+    random_ ^= random_ << 13;
+    random_ ^= random_ >> 7;
+    random_ ^= random_ << 17;
+    return random_;
+  }
+
+  Hasher hasher_;
+  size_t bucket_count_;
+  BitArray buckets_;
+  size_t count_ = 0;
+  uint64_t random_ = 0x9e3779b97f4a7c15ULL;
+};
+
+template <size_t FingerprintBits, typename Hasher>
+constexpr size_t CuckooFilter<FingerprintBits, Hasher>::kSlotsPerBucket;
+
+template <size_t FingerprintBits, typename Hasher>
+constexpr size_t CuckooFilter<FingerprintBits, Hasher>::kMaxKicks;
+
+template <size_t FingerprintBits, typename Hasher>
+constexpr double CuckooFilter<FingerprintBits, Hasher>::kMaxLoadFactor;
+}  // namespace Bloom
@@ -1,67 +1,222 @@
 #pragma once
 
+#include <bloom/batch.hpp>
+#include <bloom/bit-array.hpp>
+#include <bloom/compression.hpp>
+#include <bloom/cpu.hpp>
+#include <bloom/format.hpp>
+#include <bloom/hash-policy.hpp>
 #include <bloom/hash.hpp>
+#include <bloom/instrumentation.hpp>
 #include <bloom/options.hpp>
+#include <bloom/parallel.hpp>
+#include <bloom/reduce.hpp>
 #include <bloom/slice.hpp>
 
 #include <algorithm>
+#include <array>
+#include <cmath>
 #include <cstddef>
 #include <cstdint>
-#include <functional>
+#include <exception>
+#include <fstream>
 #include <initializer_list>
+#include <iterator>
 #include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 namespace Bloom {
 
-/// A bloom filter with runtime configurable size and hash count.
-class Filter {
+/// A bloom filter with runtime configurable size and hash count, whose
+/// hashing, storage and mapping of hashes to bit indices are policies resolved
+/// at compile time, so that `put()` and `query()` compile to a single loop
+/// without indirect calls.
+///
+/// - The `HashPolicy` computes the `k` bit indices of a key: `DynamicHashing`
+///   (see `Filter`), `DigestHashing` or `IndependentHashing` (see
+///   hash-policy.hpp for what a hash policy provides).
+/// - The `StoragePolicy` holds the bits. It is constructed from a size and a
+///   `PageMode` and provides `set()`, `test()`, `clear()`, `count()`,
+///   `size()`, `words()` and `word_count()`, like `BitArray` and
+///   `AtomicBitArray`. `merge()` and `intersect()` also need `|=` and `&=`.
+/// - The `ReducePolicy` maps hashes to bit indices, like `RangeReducer`,
+///   `MaskReducer` or `MultiplyHighReducer`.
+/// - The `InstrumentationPolicy` counts operations for `statistics()`:
+///   `NoInstrumentation`, which compiles to nothing, or `Instrumentation`
+///   (see `InstrumentedFilter`).
+///
+/// For example, a filter hashing integer keys, whose size is always a power of
+/// two:
+///
+/// ```cpp
+/// BasicFilter<DigestHashing<IntegerHasher>, BitArray, MaskReducer> filter(
+///     Options(1 << 20, 7), IntegerHasher(42));
+/// ```
+template <typename HashPolicy = DynamicHashing,
+          typename StoragePolicy = BitArray,
+          typename ReducePolicy = RangeReducer,
+          typename InstrumentationPolicy = NoInstrumentation>
+class BasicFilter {
  public:
-  using Hasher = std::function<uint32_t(Slice slice)>;
+  /// The type of the hash functions the filter may be constructed with.
+  using Hasher = typename HashPolicy::Hasher;
 
-  /// Constructs a `Filter` with a size and a user provided iterator range of
-  /// hash functions. The hash functions are copied into the filter and the
+  /// Constructs a `BasicFilter` with a size and a user provided iterator range
+  /// of hash functions. The hash functions are copied into the filter and the
   /// distance between `hashers_begin` and `hashers_end` becomes the hash count.
   template <typename Iterator>
-  Filter(size_t size, Iterator hashers_begin, Iterator hashers_end)
-  : hashers_(hashers_begin, hashers_end), bits_(size) {
-    if (hashers_.size() > size) {
-      throw std::invalid_argument(
-          "the number of hash functions must not be greater than the "
-          "size of the bloom filter");
-    }
-  }
+  BasicFilter(size_t size, Iterator hashers_begin, Iterator hashers_end)
+  : BasicFilter(size,
+                PageMode::kDefault,
+                HashPolicy(hashers_begin, hashers_end)) {}
 
-  /// Constructs a `Filter` with a size and a user provided list of hash
+  /// Constructs a `BasicFilter` with a size and a user provided list of hash
   /// functions.
-  Filter(size_t size, std::initializer_list<Hasher> hashers)
-  : Filter(size, hashers.begin(), hashers.end()) {}
-
-  /// Constructs a `Filter` from the given options, using the
-  /// `Bloom::DefaultHasher` as the `Hasher` type.
-  explicit Filter(Options options) : bits_(options.size) {
-    hashers_.reserve(options.hash_count);
-    for (size_t h = 0; h < options.hash_count; ++h) {
-      hashers_.emplace_back(DefaultHasher());
-    }
+  BasicFilter(size_t size, std::initializer_list<Hasher> hashers)
+  : BasicFilter(size, hashers.begin(), hashers.end()) {}
+
+  /// Constructs a `BasicFilter` from the given options, with hash functions
+  /// seeded with (or derived from) `options.seed`, or randomly seeded if there
+  /// is none.
+  ///
+  /// For a `Filter`, each key is hashed only once, by a `Bloom::DoubleHasher`,
+  /// and all `k` probe positions are derived from the resulting digest.
+  explicit BasicFilter(Options options)
+  : BasicFilter(options.size,
+                options.page_mode,
+                HashPolicy(options.hash_count, options.seed)) {}
+
+  /// Constructs a `BasicFilter` from the given options, deriving all `k` probe
+  /// positions of a key from a single digest computed by `digest_hasher`
+  /// (e.g. a `DoubleHasher` for a `Filter`).
+  template <typename DigestHasher,
+            typename = std::enable_if_t<
+                std::is_constructible<HashPolicy, size_t, DigestHasher>::value>>
+  BasicFilter(Options options, DigestHasher digest_hasher)
+  : BasicFilter(options.size,
+                options.page_mode,
+                HashPolicy(options.hash_count, std::move(digest_hasher))) {}
+
+  /// Constructs a `BasicFilter` from the given options, with randomly seeded
+  /// hash functions, and inserts the keys in `[first, last)` using
+  /// `thread_count` threads.
+  ///
+  /// The bits are split into one contiguous partition per thread. The keys
+  /// are processed in rounds: each thread first hashes its share of the keys
+  /// of a round, sorting the bit indices by partition, then sets the indices
+  /// of its own partition found by all threads. No two threads ever write to
+  /// the same word, so no atomic operations are needed, and the filter has
+  /// the same bits as if the keys had been inserted with `put()` one by one.
+  ///
+  /// `Iterator` must be a random access iterator over `Slice`s or sliceable
+  /// keys. If hashing a key throws, all threads stop after their current
+  /// round and the exception is rethrown. If a thread cannot be started, no
+  /// key is inserted and the `std::system_error` is rethrown.
+  ///
+  /// \complexity O(count * k / thread_count)
+  template <typename Iterator>
+  static BasicFilter build(
+      Iterator first,
+      Iterator last,
+      Options options,
+      size_t thread_count = Detail::default_thread_count()) {
+    BasicFilter filter(options);
+    filter.put_parallel(first, last, thread_count);
+    return filter;
+  }
+
+  /// Constructs a `BasicFilter` from the given options, deriving all `k`
+  /// probe positions of a key from a single digest computed by
+  /// `digest_hasher`, and inserts the keys in `[first, last)` using
+  /// `thread_count` threads. See `build(first, last, options, thread_count)`.
+  template <typename Iterator,
+            typename DigestHasher,
+            typename = std::enable_if_t<
+                !std::is_integral<DigestHasher>::value &&
+                std::is_constructible<HashPolicy, size_t, DigestHasher>::value>>
+  static BasicFilter build(
+      Iterator first,
+      Iterator last,
+      Options options,
+      DigestHasher digest_hasher,
+      size_t thread_count = Detail::default_thread_count()) {
+    BasicFilter filter(options, std::move(digest_hasher));
+    filter.put_parallel(first, last, thread_count);
+    return filter;
   }
 
-  // Constructs a `Filter` from a size and hash count.
+  // Constructs a `BasicFilter` from a size and hash count.
   // Equivalent to constructing an `Options` object and using the constructor
   // from `Options`.
-  Filter(size_t size, size_t hash_count) : Filter(Options(size, hash_count)) {}
+  BasicFilter(size_t size, size_t hash_count)
+  : BasicFilter(Options(size, hash_count)) {}
 
   /// Inserts the given `key` into the bloom filter.
   ///
   /// Inserting means passing a key `x` through every hash function `h_k` with
   /// `k` in `1..K` and setting the bit in the position returned by `h_k(x)` to
-  /// one.
+  /// one. For a `Filter` constructed from `Options`, `h_k(x)` is instead the
+  /// `k`-th position derived from a single `Digest` of `x` via double hashing.
   ///
   /// \complexity O(k)
-  void put(Slice slice) {
-    for (const auto& hasher : hashers_) {
-      bits_[hasher(slice) % size()] = true;
+  void put(Slice slice) { put_key(slice); }
+
+  /// Inserts the key made of the elements of `key`, e.g.
+  /// `std::forward_as_tuple(tenant_id, user_id, path)`, where each element is
+  /// a `Slice` or sliceable.
+  ///
+  /// The key is the concatenation of the bytes of its parts, so it is the same
+  /// key as a buffer holding the parts one after another. Hash functions with
+  /// a `stream()` method (like `DoubleHasher`) hash the parts in place; for
+  /// other hash functions, they are copied into one buffer (on the stack,
+  /// unless longer than 256 bytes). Delimit parts of varying size, or prefix
+  /// them with their size, if e.g. ("ab", "c") and ("a", "bc") must be
+  /// different keys.
+  ///
+  /// \complexity O(k)
+  template <typename... Parts>
+  void put(const std::tuple<Parts...>& key) {
+    const auto parts = Detail::to_slices(key);
+    put_key(Detail::SliceList(parts));
+  }
+
+  /// Inserts the key made of the given parts, i.e. `put(a, b, c)` is
+  /// `put(std::forward_as_tuple(a, b, c))`.
+  ///
+  /// \complexity O(k)
+  template <typename... Parts>
+  void put(Slice first, Slice second, const Parts&... rest) {
+    const std::array<Slice, 2 + sizeof...(Parts)> parts = {
+        {first, second, rest...}};
+    put_key(Detail::SliceList(parts));
+  }
+
+  /// Inserts the `count` keys starting at `keys` into the bloom filter.
+  ///
+  /// `Key` may be `Slice` or any type for which `Sliceable` is specialized,
+  /// e.g. an array of fixed-width integers. The keys are processed in groups:
+  /// all keys of a group are hashed and the words they map to are prefetched
+  /// before any bit is set, so that the cache misses of a group overlap
+  /// instead of stalling on one another.
+  ///
+  /// \complexity O(count * k)
+  template <typename Key>
+  void put_batch(const Key* keys, size_t count) {
+    const size_t hash_count = hashing_.hash_count();
+    const size_t group_size = Detail::batch_size(hash_count);
+    std::vector<size_t> indices(group_size * hash_count);
+    for (size_t start = 0; start < count; start += group_size) {
+      const size_t group = std::min(group_size, count - start);
+      hash_group(keys + start, group, indices.data());
+      for (size_t i = 0, stop = group * hash_count; i < stop; ++i) {
+        set(indices[i]);
+      }
     }
+    instrumentation_.count_puts(count);
   }
 
   /// Returns `true` if the given `key` has possibly been inserted in the
@@ -72,27 +227,500 @@ class Filter {
   /// hashes the key to is *set* (one).
   ///
   /// \complexity O(k)
-  bool query(Slice key) const {
-    return std::all_of(hashers_.begin(),
-                       hashers_.end(),
-                       [this, &key](const auto& hasher) {
-                         return this->bits_[hasher(key) % this->size()];
-                       });
+  bool query(Slice key) const { return query_key(key); }
+
+  /// Returns `true` if the key made of the elements of `key` has possibly
+  /// been inserted in the bloom filter. See `put(const std::tuple&)`.
+  ///
+  /// \complexity O(k)
+  template <typename... Parts>
+  bool query(const std::tuple<Parts...>& key) const {
+    const auto parts = Detail::to_slices(key);
+    return query_key(Detail::SliceList(parts));
+  }
+
+  /// Returns `true` if the key made of the given parts has possibly been
+  /// inserted in the bloom filter, i.e. `query(a, b, c)` is
+  /// `query(std::forward_as_tuple(a, b, c))`.
+  ///
+  /// \complexity O(k)
+  template <typename... Parts>
+  bool query(Slice first, Slice second, const Parts&... rest) const {
+    const std::array<Slice, 2 + sizeof...(Parts)> parts = {
+        {first, second, rest...}};
+    return query_key(Detail::SliceList(parts));
+  }
+
+  /// Queries the `count` keys starting at `keys`, storing the result for
+  /// `keys[i]` in `results[i]`.
+  ///
+  /// See `put_batch()` for the accepted `Key` types and how the keys are
+  /// processed.
+  ///
+  /// \complexity O(count * k)
+  template <typename Key>
+  void query_batch(const Key* keys, size_t count, bool* results) const {
+    query_batch_into(keys, count, results);
+  }
+
+  /// Queries the `count` keys starting at `keys`, storing the result for
+  /// `keys[i]` in bit `i % 64` of `bitmap[i / 64]`. The `bitmap` must hold at
+  /// least `(count + 63) / 64` words.
+  ///
+  /// \complexity O(count * k)
+  template <typename Key>
+  void query_batch(const Key* keys, size_t count, uint64_t* bitmap) const {
+    query_batch_into(keys, count, bitmap);
   }
 
   /// Clears all entries in the bloom filter.
   /// \complexity O(N)
-  void clear() { std::fill(bits_.begin(), bits_.end(), 0); }
+  void clear() { bits_.clear(); }
+
+  /// Inserts all keys inserted into `other` into this bloom filter, by setting
+  /// every bit that is set in `other`. Afterwards, the filter is the same as if
+  /// the keys of both filters had been inserted into it.
+  ///
+  /// \throws std::invalid_argument if the filters differ in size, hash count
+  /// or seeds, or use user provided hash functions.
+  /// \complexity O(N)
+  BasicFilter& merge(const BasicFilter& other) {
+    check_compatible(other);
+    bits_ |= other.bits_;
+    return *this;
+  }
+
+  /// Keeps only the bits that are also set in `other`. Afterwards, the filter
+  /// finds every key inserted into both filters, and has at most the false
+  /// positive rate of either of them.
+  ///
+  /// \throws std::invalid_argument if the filters differ in size, hash count
+  /// or seeds, or use user provided hash functions.
+  /// \complexity O(N)
+  BasicFilter& intersect(const BasicFilter& other) {
+    check_compatible(other);
+    bits_ &= other.bits_;
+    return *this;
+  }
 
   /// Returns the size (`N`; number of bits) of the bloom filter.
   size_t size() const noexcept { return bits_.size(); }
 
   /// Returns the number of hash functions (`k`) used in `put()` and `query()`
   /// operations.
-  size_t hash_count() const noexcept { return hashers_.size(); }
+  size_t hash_count() const noexcept { return hashing_.hash_count(); }
+
+  /// Returns the proportion of bits that are set.
+  /// \complexity O(N)
+  double fill_ratio() const noexcept {
+    return static_cast<double>(bits_.count()) / size();
+  }
+
+  /// Returns an estimate of the number of distinct keys inserted into the
+  /// bloom filter, derived from the number of bits that are set (see
+  /// `Detail::estimated_count()`). Infinite if all bits are set.
+  /// \complexity O(N)
+  double estimated_cardinality() const noexcept {
+    return Detail::estimated_count(size(), hash_count(), bits_.count());
+  }
+
+  /// Returns the probability that `query()` returns `true` for a key that was
+  /// not inserted, given the bits that are currently set.
+  /// \complexity O(N)
+  double estimated_false_positive_rate() const noexcept {
+    return std::pow(fill_ratio(), hash_count());
+  }
+
+  /// Returns the counters of the `InstrumentationPolicy` together with the
+  /// fill ratio, estimated false positive rate and estimated cardinality,
+  /// which are derived from a single count of the bits that are set.
+  /// \complexity O(N)
+  FilterStatistics statistics() const {
+    FilterStatistics statistics;
+    statistics.counters = instrumentation_.snapshot();
+    const size_t set_bits = bits_.count();
+    statistics.fill_ratio = static_cast<double>(set_bits) / size();
+    statistics.estimated_false_positive_rate =
+        std::pow(statistics.fill_ratio, hash_count());
+    statistics.estimated_cardinality =
+        Detail::estimated_count(size(), hash_count(), set_bits);
+    return statistics;
+  }
+
+  /// Returns the bits of the bloom filter.
+  const StoragePolicy& bits() const noexcept { return bits_; }
+
+  /// Returns the hash policy of the bloom filter.
+  const HashPolicy& hashing() const noexcept { return hashing_; }
+
+  /// Writes the bloom filter to `stream` in a versioned, little-endian binary
+  /// format (see `Detail::FileHeader`) that `load()` and `MappedFilter` read
+  /// on any platform.
+  ///
+  /// Only filters whose `HashPolicy` derives indices from a digest, whose
+  /// `StoragePolicy` stores plain `uint64_t` words and whose `ReducePolicy` is
+  /// a `RangeReducer` can be saved, as the format does not record how indices
+  /// were reduced and readers reduce them like a `RangeReducer`.
+  ///
+  /// \throws std::invalid_argument if the filter uses user provided hash
+  /// functions, which cannot be serialized.
+  /// \throws std::runtime_error if writing fails.
+  /// \complexity O(N)
+  void save(std::ostream& stream) const {
+    Detail::write_filter(stream, file_header(), bits_.words());
+  }
+
+  /// Writes the bloom filter to the file at `path`, replacing it if it exists.
+  /// See `save(std::ostream&)`.
+  void save(const std::string& path) const {
+    std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+    if (!stream) throw std::runtime_error("could not open " + path);
+    save(stream);
+  }
+
+  /// Reads a bloom filter written by `save()` from `stream`.
+  ///
+  /// \throws std::runtime_error if reading fails, the data is not a bloom
+  /// filter in a supported format, its checksums do not match, or it was
+  /// saved with a hash function other than that of the `HashPolicy`.
+  /// \complexity O(N)
+  static BasicFilter load(std::istream& stream,
+                          PageMode page_mode = PageMode::kDefault) {
+    const auto header = Detail::read_header(stream);
+    BasicFilter filter = from_header(header, page_mode);
+    Detail::read_words(stream, header, filter.bits_.words());
+    return filter;
+  }
+
+  /// Reads a bloom filter written by `save()` from the file at `path`.
+  /// See `load(std::istream&)`.
+  static BasicFilter load(const std::string& path,
+                          PageMode page_mode = PageMode::kDefault) {
+    std::ifstream stream(path, std::ios::binary);
+    if (!stream) throw std::runtime_error("could not open " + path);
+    return load(stream, page_mode);
+  }
+
+  /// Writes the bloom filter to `stream` like `save()`, but with its bits
+  /// compressed with the given `encoding` (see `Encoding`), e.g. to ship it
+  /// to other machines. Sparse filters take a fraction of their size; a filter
+  /// that is about half full takes its size, as no encoding makes it smaller.
+  /// The bits are encoded a piece at a time, as they are written.
+  ///
+  /// \throws std::invalid_argument if the filter uses user provided hash
+  /// functions, which cannot be serialized.
+  /// \throws std::runtime_error if writing fails.
+  /// \complexity O(N)
+  void save_compressed(std::ostream& stream,
+                       Encoding encoding = Encoding::kAuto) const {
+    Detail::CompressedHeader header;
+    header.filter = file_header();
+    Detail::write_compressed(
+        stream,
+        header,
+        Detail::EncodedWords{bits_.words(), nullptr, bits_.word_count()},
+        encoding);
+  }
+
+  /// Writes the difference between `base`, a previous version of this bloom
+  /// filter, and this bloom filter to `stream`, compressed with the given
+  /// `encoding`. `load_delta()` turns `base` into this bloom filter. The
+  /// difference is the exclusive or of the bits, whose bits are few if few
+  /// keys were inserted since `base`, so it compresses well.
+  ///
+  /// \throws std::invalid_argument if the filters differ in size, hash count
+  /// or seeds, or use user provided hash functions.
+  /// \throws std::runtime_error if writing fails.
+  /// \complexity O(N)
+  void save_delta(std::ostream& stream,
+                  const BasicFilter& base,
+                  Encoding encoding = Encoding::kAuto) const {
+    check_compatible(base);
+    Detail::CompressedHeader header;
+    header.filter = file_header();
+    header.base_checksum =
+        Detail::payload_checksum(base.bits_.words(), base.bits_.word_count());
+    header.delta = true;
+    Detail::write_compressed(stream,
+                             header,
+                             Detail::EncodedWords{bits_.words(),
+                                                  base.bits_.words(),
+                                                  bits_.word_count()},
+                             encoding);
+  }
+
+  /// Reads a bloom filter written by `save_compressed()` from `stream`,
+  /// decoding its bits straight into the filter a piece at a time. Reads
+  /// nothing past the filter.
+  ///
+  /// \throws std::runtime_error if reading fails, the data is not a compressed
+  /// bloom filter (e.g. a delta) in a supported format, its checksums do not
+  /// match, or it was saved with a hash function other than that of the
+  /// `HashPolicy`.
+  /// \complexity O(N)
+  static BasicFilter load_compressed(std::istream& stream,
+                                     PageMode page_mode = PageMode::kDefault) {
+    const auto header = Detail::read_compressed_header(stream);
+    if (header.delta) {
+      throw std::runtime_error(
+          "the bloom filter is a delta, which load_delta() reads");
+    }
+    BasicFilter filter = from_header(header.filter, page_mode);
+    Detail::read_compressed_words(stream, header, filter.bits_.words());
+    return filter;
+  }
+
+  /// Reads a delta written by `save_delta()` from `stream` and returns the
+  /// bloom filter it was made from, i.e. `base` with the difference applied.
+  /// `base` is left as it is, so that it can keep answering queries until
+  /// the new version replaces it.
+  ///
+  /// \throws std::runtime_error if reading fails, the data is not a delta in
+  /// a supported format, `base` is not the filter the delta was made against
+  /// or its checksums do not match.
+  /// \complexity O(N)
+  static BasicFilter load_delta(std::istream& stream, const BasicFilter& base) {
+    static_assert(std::is_same<ReducePolicy, RangeReducer>::value,
+                  "only filters reducing with a RangeReducer can be loaded");
+    const auto header = Detail::read_compressed_header(stream);
+    if (!header.delta) {
+      throw std::runtime_error("the bloom filter is not a delta");
+    }
+    const DoubleHasher double_hasher = base.hashing_.double_hasher();
+    if (header.filter.size != base.size() ||
+        header.filter.hash_count != base.hash_count() ||
+        header.filter.seed != double_hasher.seed ||
+        header.filter.scheme != double_hasher.scheme) {
+      throw std::runtime_error("the delta was not made against this filter");
+    }
+    BasicFilter filter(base);
+    Detail::read_compressed_words(stream, header, filter.bits_.words());
+    return filter;
+  }
 
  private:
-  std::vector<Hasher> hashers_;
-  std::vector<bool> bits_;
+  BasicFilter(size_t size, PageMode page_mode, HashPolicy hashing)
+  : hashing_(std::move(hashing))
+  , bits_(size, page_mode)
+  , reduce_(Detail::make_reducer<ReducePolicy>(size,
+                                               hashing_.reduce_method())) {
+    if (hashing_.hash_count() > size) {
+      throw std::invalid_argument(
+          "the number of hash functions must not be greater than the "
+          "size of the bloom filter");
+    }
+  }
+
+  /// Returns the header `save()` writes for the bloom filter.
+  Detail::FileHeader file_header() const {
+    static_assert(std::is_same<ReducePolicy, RangeReducer>::value,
+                  "only filters reducing with a RangeReducer can be saved");
+    const DoubleHasher double_hasher = hashing_.double_hasher();
+    Detail::FileHeader header;
+    header.scheme = double_hasher.scheme;
+    header.size = size();
+    header.hash_count = hash_count();
+    header.seed = double_hasher.seed;
+    header.payload_checksum =
+        Detail::payload_checksum(bits_.words(), bits_.word_count());
+    return header;
+  }
+
+  /// Constructs an empty bloom filter with the parameters in `header`.
+  static BasicFilter from_header(const Detail::FileHeader& header,
+                                 PageMode page_mode) {
+    static_assert(std::is_same<ReducePolicy, RangeReducer>::value,
+                  "only filters reducing with a RangeReducer can be loaded");
+    using DigestHasher = typename HashPolicy::DigestHasher;
+    Options options(header.size, header.hash_count);
+    options.page_mode = page_mode;
+    return BasicFilter(options,
+                       Detail::from_double_hasher<DigestHasher>(
+                           DoubleHasher(header.seed, header.scheme)));
+  }
+
+  void check_compatible(const BasicFilter& other) const {
+    if (size() != other.size() || !hashing_.compatible_with(other.hashing_)) {
+      throw std::invalid_argument(
+          "the bloom filters must have the same size, hash count and seeds");
+    }
+  }
+
+  /// Inserts a `Slice` or `Detail::SliceList`.
+  template <typename Key>
+  void put_key(const Key& key) {
+    const auto sample = instrumentation_.begin_put();
+    hashing_.for_each_index(key, reduce_, [this](size_t index) {
+      this->set(index);
+      return true;
+    });
+    instrumentation_.end_put(sample);
+  }
+
+  /// Queries a `Slice` or `Detail::SliceList`.
+  template <typename Key>
+  bool query_key(const Key& key) const {
+    const auto sample = instrumentation_.begin_query();
+    const bool found = hashing_.for_each_index(
+        key, reduce_, [this](size_t index) { return this->test(index); });
+    instrumentation_.end_query(sample, found);
+    return found;
+  }
+
+  void set(size_t index) noexcept { bits_.set(index); }
+
+  bool test(size_t index) const noexcept { return bits_.test(index); }
+
+  /// Inserts the keys in `[first, last)` using `thread_count` threads. See
+  /// `build()`.
+  template <typename Iterator>
+  void put_parallel(Iterator first, Iterator last, size_t thread_count) {
+    static_assert(
+        std::is_base_of<
+            std::random_access_iterator_tag,
+            typename std::iterator_traits<Iterator>::iterator_category>::value,
+        "build() requires random access iterators");
+    const auto count = static_cast<size_t>(last - first);
+    const size_t rounds_per_thread =
+        (count + Detail::kBuildKeysPerRound - 1) / Detail::kBuildKeysPerRound;
+    thread_count = std::max<size_t>(
+        std::min({thread_count, rounds_per_thread, bits_.word_count()}), 1);
+    if (thread_count == 1) {
+      for (; first != last; ++first) {
+        put(*first);
+      }
+      return;
+    }
+
+    const size_t words_per_partition =
+        (bits_.word_count() + thread_count - 1) / thread_count;
+    const size_t bits_per_partition = words_per_partition * 64;
+    const size_t keys_per_round = thread_count * Detail::kBuildKeysPerRound;
+    // indices[t][p] holds the indices thread `t` found in partition `p`.
+    std::vector<std::vector<std::vector<size_t>>> indices(
+        thread_count, std::vector<std::vector<size_t>>(thread_count));
+    // errors[t] holds what thread `t` threw while hashing, if anything.
+    std::vector<std::exception_ptr> errors(thread_count);
+    Detail::Barrier barrier(thread_count);
+    Detail::run_in_parallel(thread_count, [&](size_t thread) {
+      auto& found = indices[thread];
+      for (size_t start = 0; start < count; start += keys_per_round) {
+        for (auto& partition : found) partition.clear();
+        const size_t begin =
+            std::min(count, start + thread * Detail::kBuildKeysPerRound);
+        const size_t end =
+            std::min(count, begin + Detail::kBuildKeysPerRound);
+        try {
+          for (size_t key = begin; key < end; ++key) {
+            hashing_.for_each_index(
+                first[key],
+                reduce_,
+                [&found, bits_per_partition](size_t index) {
+                  found[index / bits_per_partition].push_back(index);
+                  return true;
+                });
+          }
+        } catch (...) {
+          errors[thread] = std::current_exception();
+        }
+        // A thread that threw still arrives, so that the others are not left
+        // waiting for it, and then all of them stop.
+        barrier.wait();
+        if (std::any_of(errors.begin(), errors.end(), [](const auto& error) {
+              return static_cast<bool>(error);
+            })) {
+          return;
+        }
+        for (const auto& partitions : indices) {
+          const auto& own = partitions[thread];
+          for (size_t i = 0; i < own.size(); ++i) {
+            if (i + Detail::kBuildPrefetchDistance < own.size()) {
+              Detail::prefetch_for_write(
+                  bits_.words() +
+                  own[i + Detail::kBuildPrefetchDistance] / 64);
+            }
+            set(own[i]);
+          }
+        }
+        barrier.wait();
+      }
+    });
+    for (const auto& error : errors) {
+      if (error) std::rethrow_exception(error);
+    }
+    instrumentation_.count_puts(count);
+  }
+
+  /// Writes the `k` bit indices of each of the `count` `keys` to `indices`
+  /// (`k` consecutive entries per key), prefetching their words on the way.
+  template <typename Key>
+  void hash_group(const Key* keys, size_t count, size_t* indices) const {
+    hashing_.for_each_batch_index(
+        keys, count, reduce_, [this, &indices](size_t index) {
+          Detail::prefetch(bits_.words() + index / 64);
+          *indices++ = index;
+          return true;
+        });
+  }
+
+  template <typename Key, typename Result>
+  void query_batch_into(const Key* keys, size_t count, Result* results) const {
+    Detail::clear_results(results, count);
+    const size_t hash_count = hashing_.hash_count();
+    if (hash_count > 0 && bits_.word_count() * sizeof(uint64_t) <=
+                              Detail::kCacheResidentBytes) {
+      // Nothing to gain from prefetching: resolve each key as it is hashed,
+      // up to the first of its bits that is not set.
+      size_t key = 0;
+      size_t hits = 0;
+      hashing_.for_each_batch_index(
+          keys, count, reduce_, [&](size_t index) {
+            if (!this->test(index)) {
+              Detail::store_result(results, key++, false);
+              hits = 0;
+              return false;
+            }
+            if (++hits == hash_count) {
+              Detail::store_result(results, key++, true);
+              hits = 0;
+            }
+            return true;
+          });
+      instrumentation_.count_queries(results, count);
+      return;
+    }
+    const size_t group_size = Detail::batch_size(hash_count);
+    std::vector<size_t> indices(group_size * hash_count);
+    for (size_t start = 0; start < count; start += group_size) {
+      const size_t group = std::min(group_size, count - start);
+      hash_group(keys + start, group, indices.data());
+      for (size_t key = 0; key < group; ++key) {
+        const size_t* key_indices = indices.data() + key * hash_count;
+        Detail::store_result(
+            results,
+            start + key,
+            std::all_of(key_indices,
+                        key_indices + hash_count,
+                        [this](size_t index) { return this->test(index); }));
+      }
+    }
+    instrumentation_.count_queries(results, count);
+  }
+
+  HashPolicy hashing_;
+  StoragePolicy bits_;
+  /// Maps hashes to bit indices, with the method the `HashPolicy` asks for
+  /// if the `ReducePolicy` is a `RangeReducer`.
+  ReducePolicy reduce_;
+  InstrumentationPolicy instrumentation_;
 };
+
+/// A bloom filter with runtime configurable size and hash count, hashing keys
+/// either with a `DoubleHasher` or with user provided hash functions.
+using Filter = BasicFilter<DynamicHashing>;
+
+/// A `Filter` that counts its operations and samples their latencies, see
+/// `Instrumentation` and `statistics()`.
+using InstrumentedFilter =
+    BasicFilter<DynamicHashing, BitArray, RangeReducer, Instrumentation<>>;
 }  // namespace Bloom
@@ -0,0 +1,328 @@
+#pragma once
+
+#include <bloom/cpu.hpp>
+#include <bloom/hash.hpp>
+#include <bloom/reduce.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+#include <vector>
+
+namespace Bloom {
+namespace Detail {
+
+/// The on-disk format of a filter is a 64-byte header followed by the words
+/// of its bits. All integers are little-endian:
+///
+/// | Offset | Size | Field                                           |
+/// |--------|------|-------------------------------------------------|
+/// | 0      | 8    | Magic bytes `BLOOMCPP`                          |
+/// | 8      | 4    | Format version (`kFormatVersion`)               |
+/// | 12     | 4    | `HashScheme` of the `DoubleHasher`              |
+/// | 16     | 8    | Size (`N`; number of bits)                      |
+/// | 24     | 8    | Hash count (`k`)                                |
+/// | 32     | 8    | Seed of the `DoubleHasher`                      |
+/// | 40     | 8    | Checksum of the words                           |
+/// | 48     | 8    | Checksum of bytes 0 to 47                       |
+/// | 56     | 8    | Reserved, zero                                  |
+/// | 64     | 8 W  | The `W = ceil(N / 64)` words of the bits        |
+///
+/// The words start at a multiple of 64 bytes, so they are cache line aligned
+/// when the file is mapped into memory.
+constexpr char kMagic[8] = {'B', 'L', 'O', 'O', 'M', 'C', 'P', 'P'};
+constexpr uint32_t kFormatVersion = 1;
+constexpr size_t kHeaderSize = 64;
+
+/// The fields of the header of a serialized filter.
+struct FileHeader {
+  HashScheme scheme;
+  uint64_t size;
+  uint64_t hash_count;
+  uint64_t seed;
+  uint64_t payload_checksum;
+
+  /// Returns the number of words following the header.
+  uint64_t word_count() const noexcept {
+    return size / 64 + (size % 64 != 0 ? 1 : 0);
+  }
+};
+
+/// Writes `value` to `data` as a little-endian integer.
+template <typename T>
+void store_little_endian(uint8_t* data, T value) noexcept {
+  if (!kLittleEndian) value = byte_swap(value);
+  std::memcpy(data, &value, sizeof value);
+}
+
+/// Returns the 64-bit checksum of the `size` bytes at `data`.
+inline uint64_t checksum(const uint8_t* data, size_t size) noexcept {
+  return murmur3_128(data, size, 0).low;
+}
+
+/// Returns the checksum of the little-endian encoding of the `count` words
+/// (or fingerprints).
+template <typename T>
+uint64_t payload_checksum(const T* words, size_t count) {
+  if (kLittleEndian) {
+    return checksum(reinterpret_cast<const uint8_t*>(words), count * sizeof(T));
+  }
+  std::vector<uint8_t> bytes(count * sizeof(T));
+  for (size_t i = 0; i < count; ++i) {
+    store_little_endian(&bytes[i * sizeof(T)], words[i]);
+  }
+  return checksum(bytes.data(), bytes.size());
+}
+
+/// Encodes the `header` into the `kHeaderSize` bytes at `data`.
+inline void encode_header(const FileHeader& header, uint8_t* data) noexcept {
+  std::fill(data, data + kHeaderSize, 0);
+  std::copy(kMagic, kMagic + sizeof kMagic, data);
+  store_little_endian(data + 8, kFormatVersion);
+  store_little_endian(data + 12, static_cast<uint32_t>(header.scheme));
+  store_little_endian(data + 16, header.size);
+  store_little_endian(data + 24, header.hash_count);
+  store_little_endian(data + 32, header.seed);
+  store_little_endian(data + 40, header.payload_checksum);
+  store_little_endian(data + 48, checksum(data, 48));
+}
+
+/// Decodes the header from the `kHeaderSize` bytes at `data`.
+///
+/// \throws std::runtime_error if the bytes are not the header of a filter in
+/// a format and with a hash scheme this version of the library supports.
+inline FileHeader decode_header(const uint8_t* data) {
+  if (!std::equal(kMagic, kMagic + sizeof kMagic, data)) {
+    throw std::runtime_error("not a serialized bloom filter");
+  }
+  if (load<uint64_t>(data + 48) != checksum(data, 48)) {
+    throw std::runtime_error("the header of the bloom filter is corrupt");
+  }
+  if (load<uint32_t>(data + 8) != kFormatVersion) {
+    throw std::runtime_error("unsupported bloom filter format version");
+  }
+  FileHeader header;
+  header.scheme = static_cast<HashScheme>(load<uint32_t>(data + 12));
+  if (header.scheme != HashScheme::kMurmur3DoubleHashing &&
+      header.scheme != HashScheme::kWyhashDoubleHashing &&
+      header.scheme != HashScheme::kIntegerDoubleHashing &&
+      header.scheme != HashScheme::kSipHashDoubleHashing) {
+    throw std::runtime_error("unsupported bloom filter hash scheme");
+  }
+  header.size = load<uint64_t>(data + 16);
+  header.hash_count = load<uint64_t>(data + 24);
+  header.seed = load<uint64_t>(data + 32);
+  header.payload_checksum = load<uint64_t>(data + 40);
+  if (header.hash_count > header.size) {
+    throw std::runtime_error("the header of the bloom filter is corrupt");
+  }
+  // The size must fit a `size_t`, and the number of bytes of its words too.
+  if (header.size > std::numeric_limits<size_t>::max() - 63 ||
+      header.word_count() > std::numeric_limits<size_t>::max() / 8) {
+    throw std::runtime_error("the bloom filter is too large");
+  }
+  return header;
+}
+
+/// A `BinaryFuseFilter` is stored as a 64-byte header followed by its
+/// fingerprints. All integers are little-endian:
+///
+/// | Offset | Size | Field                                           |
+/// |--------|------|-------------------------------------------------|
+/// | 0      | 8    | Magic bytes `BLOOMFUS`                          |
+/// | 8      | 4    | Format version (`kFormatVersion`)               |
+/// | 12     | 4    | Bits per fingerprint (8 or 16)                  |
+/// | 16     | 8    | Number of distinct keys                         |
+/// | 24     | 8    | Segment length                                  |
+/// | 32     | 8    | Segment count times segment length              |
+/// | 40     | 8    | Seed of the key hash                            |
+/// | 48     | 8    | Checksum of the fingerprints                    |
+/// | 56     | 8    | Checksum of bytes 0 to 55                       |
+/// | 64     | F A  | The `A` fingerprints of `F` bytes each          |
+///
+/// `A` is the segment count plus two, times the segment length.
+constexpr char kFuseMagic[8] = {'B', 'L', 'O', 'O', 'M', 'F', 'U', 'S'};
+
+/// The fields of the header of a serialized `BinaryFuseFilter`.
+struct FuseHeader {
+  uint32_t fingerprint_bits;
+  uint64_t key_count;
+  uint64_t segment_length;
+  uint64_t segment_count_length;
+  uint64_t seed;
+  uint64_t payload_checksum;
+
+  /// Returns the number of fingerprints following the header.
+  uint64_t fingerprint_count() const noexcept {
+    return segment_count_length + 2 * segment_length;
+  }
+
+  /// Returns the number of bytes following the header.
+  uint64_t payload_size() const noexcept {
+    return fingerprint_count() * (fingerprint_bits / 8);
+  }
+};
+
+/// Encodes the `header` into the `kHeaderSize` bytes at `data`.
+inline void encode_header(const FuseHeader& header, uint8_t* data) noexcept {
+  std::copy(kFuseMagic, kFuseMagic + sizeof kFuseMagic, data);
+  store_little_endian(data + 8, kFormatVersion);
+  store_little_endian(data + 12, header.fingerprint_bits);
+  store_little_endian(data + 16, header.key_count);
+  store_little_endian(data + 24, header.segment_length);
+  store_little_endian(data + 32, header.segment_count_length);
+  store_little_endian(data + 40, header.seed);
+  store_little_endian(data + 48, header.payload_checksum);
+  store_little_endian(data + 56, checksum(data, 56));
+}
+
+/// Decodes the header of a `BinaryFuseFilter` from the `kHeaderSize` bytes at
+/// `data`.
+///
+/// \throws std::runtime_error if the bytes are not the header of a binary fuse
+/// filter with `fingerprint_bits` bits per fingerprint.
+inline FuseHeader decode_fuse_header(const uint8_t* data,
+                                     uint32_t fingerprint_bits) {
+  if (!std::equal(kFuseMagic, kFuseMagic + sizeof kFuseMagic, data)) {
+    throw std::runtime_error("not a serialized binary fuse filter");
+  }
+  if (load<uint64_t>(data + 56) != checksum(data, 56)) {
+    throw std::runtime_error("the header of the binary fuse filter is corrupt");
+  }
+  if (load<uint32_t>(data + 8) != kFormatVersion) {
+    throw std::runtime_error("unsupported binary fuse filter format version");
+  }
+  FuseHeader header;
+  header.fingerprint_bits = load<uint32_t>(data + 12);
+  if (header.fingerprint_bits != fingerprint_bits) {
+    throw std::runtime_error(
+        "the binary fuse filter was saved with a different fingerprint size");
+  }
+  header.key_count = load<uint64_t>(data + 16);
+  header.segment_length = load<uint64_t>(data + 24);
+  header.segment_count_length = load<uint64_t>(data + 32);
+  header.seed = load<uint64_t>(data + 40);
+  header.payload_checksum = load<uint64_t>(data + 48);
+  if (!is_power_of_two(header.segment_length) ||
+      header.segment_length > (uint64_t{1} << 18) ||
+      header.segment_count_length % header.segment_length != 0 ||
+      header.segment_count_length == 0) {
+    throw std::runtime_error("the header of the binary fuse filter is corrupt");
+  }
+  // The number of bytes of the fingerprints must fit a `size_t`.
+  if (header.segment_count_length >
+      std::numeric_limits<size_t>::max() / (fingerprint_bits / 8) -
+          2 * header.segment_length) {
+    throw std::runtime_error("the binary fuse filter is too large");
+  }
+  return header;
+}
+
+/// Writes the `header` followed by the `values` to `stream`.
+///
+/// \throws std::runtime_error if writing fails.
+template <typename T>
+void write_fuse_filter(std::ostream& stream,
+                       const FuseHeader& header,
+                       const T* values) {
+  uint8_t bytes[kHeaderSize];
+  encode_header(header, bytes);
+  stream.write(reinterpret_cast<const char*>(bytes), kHeaderSize);
+  const size_t count = header.fingerprint_count();
+  if (kLittleEndian) {
+    stream.write(reinterpret_cast<const char*>(values), count * sizeof(T));
+  } else {
+    for (size_t i = 0; i < count; ++i) {
+      uint8_t value[sizeof(T)];
+      store_little_endian(value, values[i]);
+      stream.write(reinterpret_cast<const char*>(value), sizeof value);
+    }
+  }
+  if (!stream) {
+    throw std::runtime_error("could not write the binary fuse filter");
+  }
+}
+
+/// Writes the `header` followed by the `words` to `stream`.
+///
+/// \throws std::runtime_error if writing fails.
+inline void write_filter(std::ostream& stream,
+                         const FileHeader& header,
+                         const uint64_t* words) {
+  uint8_t bytes[kHeaderSize];
+  encode_header(header, bytes);
+  stream.write(reinterpret_cast<const char*>(bytes), kHeaderSize);
+  const size_t count = header.word_count();
+  if (kLittleEndian) {
+    stream.write(reinterpret_cast<const char*>(words), count * 8);
+  } else {
+    for (size_t i = 0; i < count; ++i) {
+      uint8_t word[8];
+      store_little_endian(word, words[i]);
+      stream.write(reinterpret_cast<const char*>(word), sizeof word);
+    }
+  }
+  if (!stream) throw std::runtime_error("could not write the bloom filter");
+}
+
+/// Reads a header from `stream`.
+///
+/// \throws std::runtime_error if reading fails or the header is invalid.
+inline FileHeader read_header(std::istream& stream) {
+  uint8_t bytes[kHeaderSize];
+  if (!stream.read(reinterpret_cast<char*>(bytes), kHeaderSize)) {
+    throw std::runtime_error("could not read the bloom filter header");
+  }
+  return decode_header(bytes);
+}
+
+/// Reads the words described by `header` from `stream` into `words` and
+/// verifies their checksum.
+///
+/// \throws std::runtime_error if reading fails or the checksum mismatches.
+inline void read_words(std::istream& stream,
+                       const FileHeader& header,
+                       uint64_t* words) {
+  const size_t count = header.word_count();
+  if (!stream.read(reinterpret_cast<char*>(words), count * 8)) {
+    throw std::runtime_error("the bloom filter is truncated");
+  }
+  if (!kLittleEndian) {
+    std::transform(words, words + count, words, [](uint64_t word) {
+      return byte_swap(word);
+    });
+  }
+  if (payload_checksum(words, count) != header.payload_checksum) {
+    throw std::runtime_error("the bits of the bloom filter are corrupt");
+  }
+}
+
+/// Reads the fingerprints described by `header` from `stream` into `values`
+/// and verifies their checksum.
+///
+/// \throws std::runtime_error if reading fails or the checksum mismatches.
+template <typename T>
+void read_fingerprints(std::istream& stream,
+                       const FuseHeader& header,
+                       T* values) {
+  const size_t count = header.fingerprint_count();
+  if (!stream.read(reinterpret_cast<char*>(values), count * sizeof(T))) {
+    throw std::runtime_error("the binary fuse filter is truncated");
+  }
+  if (!kLittleEndian) {
+    std::transform(values, values + count, values, [](T value) {
+      return byte_swap(value);
+    });
+  }
+  if (payload_checksum(values, count) != header.payload_checksum) {
+    throw std::runtime_error(
+        "the fingerprints of the binary fuse filter are corrupt");
+  }
+}
+}  // namespace Detail
+}  // namespace Bloom
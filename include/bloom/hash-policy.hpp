@@ -0,0 +1,371 @@
+#pragma once
+
+#include <bloom/hash.hpp>
+#include <bloom/reduce.hpp>
+#include <bloom/slice.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace Bloom {
+namespace Detail {
+
+/// The `HashScheme` of the `DoubleHasher` equivalent to a `Hasher` whose hash
+/// function is fixed at compile time.
+template <typename Hasher>
+struct HashSchemeOf;
+
+template <>
+struct HashSchemeOf<WyHasher>
+    : std::integral_constant<HashScheme, HashScheme::kWyhashDoubleHashing> {};
+
+template <>
+struct HashSchemeOf<IntegerHasher>
+    : std::integral_constant<HashScheme, HashScheme::kIntegerDoubleHashing> {
+};
+
+template <>
+struct HashSchemeOf<SipHasher>
+    : std::integral_constant<HashScheme, HashScheme::kSipHashDoubleHashing> {
+};
+
+/// Returns the `DoubleHasher` computing the same digests as `hasher`.
+template <typename Hasher>
+DoubleHasher to_double_hasher(const Hasher& hasher) noexcept {
+  return DoubleHasher(hasher.seed, HashSchemeOf<Hasher>::value);
+}
+
+inline DoubleHasher to_double_hasher(const DoubleHasher& hasher) noexcept {
+  return hasher;
+}
+
+/// Returns the `Hasher` computing the same digests as `hasher`.
+///
+/// \throws std::runtime_error if `hasher` uses a different hash function.
+template <typename Hasher>
+Hasher from_double_hasher(const DoubleHasher& hasher) {
+  if (hasher.scheme != HashSchemeOf<Hasher>::value) {
+    throw std::runtime_error(
+        "the bloom filter was saved with a different hash scheme");
+  }
+  return Hasher(hasher.seed);
+}
+
+template <>
+inline DoubleHasher from_double_hasher<DoubleHasher>(
+    const DoubleHasher& hasher) {
+  return hasher;
+}
+}  // namespace Detail
+
+/// Derives all `k` indices of a key from a single `Digest` computed by a
+/// `Hasher` that is known at compile time, e.g. `DoubleHasher`, `WyHasher` or
+/// `IntegerHasher`. The digest is computed and the probe loop is compiled
+/// without any indirect call.
+template <typename HashFunction = DoubleHasher>
+class DigestHashing {
+ public:
+  static_assert(Detail::IsDigestHasher<HashFunction>::value,
+                "the hash function of DigestHashing must produce a Digest");
+
+  using Hasher = HashFunction;
+  using DigestHasher = HashFunction;
+
+  /// Constructs the policy for `hash_count` indices per key, hashing keys with
+  /// a randomly seeded `Hasher`.
+  explicit DigestHashing(size_t hash_count)
+  : DigestHashing(hash_count, Hasher()) {}
+
+  /// Constructs the policy for `hash_count` indices per key, hashing keys with
+  /// a `Hasher` with the given `seed`, or a randomly seeded one if there is
+  /// none.
+  DigestHashing(size_t hash_count, Seed seed)
+  : DigestHashing(hash_count, Detail::seeded_hasher<Hasher>(seed)) {}
+
+  /// Constructs the policy for `hash_count` indices per key, hashing keys with
+  /// `hasher`.
+  DigestHashing(size_t hash_count, Hasher hasher)
+  : hasher_(std::move(hasher)), hash_count_(hash_count) {}
+
+  size_t hash_count() const noexcept { return hash_count_; }
+
+  static constexpr RangeReducer::Method reduce_method() noexcept {
+    return RangeReducer::Method::kMultiplyHigh;
+  }
+
+  template <typename Key, typename Reducer, typename Function>
+  bool for_each_index(const Key& key,
+                      const Reducer& reduce,
+                      Function&& function) const {
+    Detail::ProbeSequence probes(Detail::hash_key(hasher_, key));
+    for (size_t i = 0; i < hash_count_; ++i) {
+      if (!function(static_cast<size_t>(reduce(probes.next())))) return false;
+    }
+    return true;
+  }
+
+  /// Invokes `function` with each of the `k` indices of each of the `count`
+  /// `keys`, in order, skipping the remaining indices of a key as soon as
+  /// `function` returns `false`. Fixed-width integer keys are hashed in rounds
+  /// before any index of the round is derived, so that they are hashed
+  /// several at a time where the `Hasher` supports it (see
+  /// `Detail::hash_keys()`).
+  template <typename Key, typename Reducer, typename Function>
+  void for_each_batch_index(const Key* keys,
+                            size_t count,
+                            const Reducer& reduce,
+                            Function&& function) const {
+    for_each_batch_index(
+        keys, count, reduce, function, Detail::IsFixedWidthInteger<Key>());
+  }
+
+  /// Returns the `DoubleHasher` equivalent to the `Hasher`.
+  DoubleHasher double_hasher() const noexcept {
+    return Detail::to_double_hasher(hasher_);
+  }
+
+  /// Returns `true` if `other` maps every key to the same indices.
+  bool compatible_with(const DigestHashing& other) const noexcept {
+    const DoubleHasher mine = double_hasher();
+    const DoubleHasher theirs = other.double_hasher();
+    return hash_count_ == other.hash_count_ && mine.seed == theirs.seed &&
+           mine.scheme == theirs.scheme;
+  }
+
+  /// Returns the `Hasher` keys are hashed with.
+  const Hasher& hasher() const noexcept { return hasher_; }
+
+ private:
+  template <typename Key, typename Reducer, typename Function>
+  void for_each_batch_index(const Key* keys,
+                            size_t count,
+                            const Reducer& reduce,
+                            Function& function,
+                            std::true_type /* fixed-width integers */) const {
+    constexpr size_t kKeysPerRound = 64;
+    Digest digests[kKeysPerRound];
+    for (size_t start = 0; start < count; start += kKeysPerRound) {
+      const size_t round = std::min(count - start, kKeysPerRound);
+      Detail::hash_keys(hasher_, keys + start, round, digests);
+      for (size_t key = 0; key < round; ++key) {
+        Detail::ProbeSequence probes(digests[key]);
+        for (size_t i = 0; i < hash_count_; ++i) {
+          if (!function(static_cast<size_t>(reduce(probes.next())))) break;
+        }
+      }
+    }
+  }
+
+  template <typename Key, typename Reducer, typename Function>
+  void for_each_batch_index(const Key* keys,
+                            size_t count,
+                            const Reducer& reduce,
+                            Function& function,
+                            std::false_type /* fixed-width integers */) const {
+    for (size_t key = 0; key < count; ++key) {
+      for_each_index(keys[key], reduce, function);
+    }
+  }
+
+  Hasher hasher_;
+  size_t hash_count_;
+};
+
+/// Computes each of the `k` indices of a key with one of `k` independent hash
+/// functions of type `Hasher`, e.g. `DefaultHasher` or `WyHasher64`. The hash
+/// functions are called directly rather than through a `std::function`, so
+/// they are inlined.
+///
+/// A policy constructed from a hash count only default-constructs the hash
+/// functions, which must then seed themselves randomly. A policy constructed
+/// from a hash count and a `Seed` constructs the `i`-th hash function from
+/// `Detail::derive_seed(seed, i)`, so that it is reproducible.
+template <typename HashFunction>
+class IndependentHashing {
+ public:
+  using Hasher = HashFunction;
+
+  /// Constructs the policy with `hash_count` default-constructed hash
+  /// functions.
+  explicit IndependentHashing(size_t hash_count) : hashers_(hash_count) {}
+
+  /// Constructs the policy with `hash_count` hash functions, seeded with the
+  /// seeds derived from `seed`, or from a single random seed if there is
+  /// none.
+  IndependentHashing(size_t hash_count, Seed seed) {
+    const uint64_t base = seed.value_or_random();
+    hashers_.reserve(hash_count);
+    for (size_t i = 0; i < hash_count; ++i) {
+      hashers_.emplace_back(Detail::derive_seed(base, i));
+    }
+  }
+
+  /// Constructs the policy with a copy of each hash function in the range.
+  template <typename Iterator>
+  IndependentHashing(Iterator hashers_begin, Iterator hashers_end)
+  : hashers_(hashers_begin, hashers_end) {}
+
+  size_t hash_count() const noexcept { return hashers_.size(); }
+
+  /// Hash functions need not spread their values over all 64 bits.
+  static constexpr RangeReducer::Method reduce_method() noexcept {
+    return RangeReducer::Method::kModulo;
+  }
+
+  template <typename Key, typename Reducer, typename Function>
+  bool for_each_index(const Key& key,
+                      const Reducer& reduce,
+                      Function&& function) const {
+    return Detail::with_contiguous(key, [&](Slice slice) {
+      for (const auto& hasher : hashers_) {
+        if (!function(static_cast<size_t>(reduce(hasher(slice))))) {
+          return false;
+        }
+      }
+      return true;
+    });
+  }
+
+  /// Invokes `function` with each of the `k` indices of each of the `count`
+  /// `keys`, in order, skipping the remaining indices of a key as soon as
+  /// `function` returns `false`.
+  template <typename Key, typename Reducer, typename Function>
+  void for_each_batch_index(const Key* keys,
+                            size_t count,
+                            const Reducer& reduce,
+                            Function&& function) const {
+    for (size_t key = 0; key < count; ++key) {
+      const Slice slice(keys[key]);
+      for (const auto& hasher : hashers_) {
+        if (!function(static_cast<size_t>(reduce(hasher(slice))))) break;
+      }
+    }
+  }
+
+  /// Returns `true` if `other` has hash functions with the same seeds, in the
+  /// same order.
+  bool compatible_with(const IndependentHashing& other) const noexcept {
+    return std::equal(hashers_.begin(),
+                      hashers_.end(),
+                      other.hashers_.begin(),
+                      other.hashers_.end(),
+                      [](const Hasher& mine, const Hasher& theirs) {
+                        return mine.seed == theirs.seed;
+                      });
+  }
+
+ private:
+  std::vector<Hasher> hashers_;
+};
+
+/// The hash policy of `Filter`: either user provided hash functions, called
+/// through a `std::function`, or a `DoubleHasher`, chosen at runtime by the
+/// constructor of the filter.
+class DynamicHashing {
+ public:
+  /// A user provided hash function. Functions returning 32-bit values (like
+  /// `DefaultHasher`) can only address the first 2^32 bits of a filter; use
+  /// 64-bit functions (like `WyHasher64`) for larger filters.
+  using Hasher = std::function<uint64_t(Slice slice)>;
+
+  using DigestHasher = DoubleHasher;
+
+  /// Constructs the policy for `hash_count` indices per key, derived from the
+  /// digest of a randomly seeded `DoubleHasher`.
+  explicit DynamicHashing(size_t hash_count)
+  : DynamicHashing(hash_count, DoubleHasher()) {}
+
+  /// Constructs the policy for `hash_count` indices per key, derived from the
+  /// digest computed by `double_hasher`.
+  DynamicHashing(size_t hash_count, DoubleHasher double_hasher)
+  : digest_(hash_count, double_hasher), independent_(0) {}
+
+  /// Constructs the policy for `hash_count` indices per key, derived from the
+  /// digest of a `DoubleHasher` with the given `seed`, or a randomly seeded
+  /// one if there is none.
+  DynamicHashing(size_t hash_count, Seed seed)
+  : DynamicHashing(hash_count, Detail::seeded_hasher<DoubleHasher>(seed)) {}
+
+  /// Constructs the policy with a copy of each hash function in the range.
+  template <typename Iterator>
+  DynamicHashing(Iterator hashers_begin, Iterator hashers_end)
+  : digest_(0, DoubleHasher(0)), independent_(hashers_begin, hashers_end) {}
+
+  size_t hash_count() const noexcept {
+    return uses_digest() ? digest_.hash_count() : independent_.hash_count();
+  }
+
+  /// Digests are mapped with a multiplication, while user provided hash
+  /// functions, which need not spread their values over all 64 bits, are
+  /// mapped with a modulo.
+  RangeReducer::Method reduce_method() const noexcept {
+    return uses_digest() ? digest_.reduce_method()
+                         : independent_.reduce_method();
+  }
+
+  template <typename Key, typename Reducer, typename Function>
+  bool for_each_index(const Key& key,
+                      const Reducer& reduce,
+                      Function&& function) const {
+    if (uses_digest()) {
+      return digest_.for_each_index(
+          key, reduce, std::forward<Function>(function));
+    }
+    return independent_.for_each_index(
+        key, reduce, std::forward<Function>(function));
+  }
+
+  template <typename Key, typename Reducer, typename Function>
+  void for_each_batch_index(const Key* keys,
+                            size_t count,
+                            const Reducer& reduce,
+                            Function&& function) const {
+    if (uses_digest()) {
+      digest_.for_each_batch_index(
+          keys, count, reduce, std::forward<Function>(function));
+    } else {
+      independent_.for_each_batch_index(
+          keys, count, reduce, std::forward<Function>(function));
+    }
+  }
+
+  /// Returns the `DoubleHasher` keys are hashed with.
+  ///
+  /// \throws std::invalid_argument if keys are hashed with user provided hash
+  /// functions instead.
+  DoubleHasher double_hasher() const {
+    if (!uses_digest()) {
+      throw std::invalid_argument(
+          "only filters constructed from options can be saved");
+    }
+    return digest_.double_hasher();
+  }
+
+  /// Returns `true` if `other` derives indices from a digest computed by an
+  /// equal `DoubleHasher`.
+  ///
+  /// \throws std::invalid_argument if either policy hashes keys with user
+  /// provided hash functions, which cannot be compared.
+  bool compatible_with(const DynamicHashing& other) const {
+    if (!uses_digest() || !other.uses_digest()) {
+      throw std::invalid_argument(
+          "only filters constructed from options can be combined");
+    }
+    return digest_.compatible_with(other.digest_);
+  }
+
+ private:
+  bool uses_digest() const noexcept { return independent_.hash_count() == 0; }
+
+  DigestHashing<DoubleHasher> digest_;
+  /// The user provided hash functions. Empty if indices are derived from the
+  /// digest computed by the `DoubleHasher` of `digest_`.
+  IndependentHashing<Hasher> independent_;
+};
+}  // namespace Bloom
@@ -1,11 +1,18 @@
 #pragma once
 
+#include <bloom/cpu.hpp>
+#include <bloom/reduce.hpp>
 #include <bloom/slice.hpp>
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <limits>
 #include <random>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 namespace Bloom {
 namespace Detail {
@@ -17,9 +24,34 @@ constexpr T rotate_left(T value, T amount) {
   return (value << amount) | (value >> (word_size - amount));
 }
 
+/// Reads a little-endian `T` from the (possibly unaligned) memory at `data`,
+/// so that hashes are the same on every platform.
+template <typename T>
+inline T load(const uint8_t* data) noexcept {
+  T value;
+  std::memcpy(&value, data, sizeof value);
+  return kLittleEndian ? value : byte_swap(value);
+}
+
+/// Reads a little-endian `T` from the characters at `data` one byte at a time,
+/// so that it can be evaluated at compile time, e.g. on a string literal.
+template <typename T>
+constexpr T load(const char* data) noexcept {
+  T value = 0;
+  for (size_t i = 0; i < sizeof(T); ++i) {
+    value |= static_cast<T>(static_cast<uint8_t>(data[i])) << (i * 8);
+  }
+  return value;
+}
+
 /// Implements the 32-bit murmur3 hash function.
 /// See https://en.wikipedia.org/wiki/MurmurHash#MurmurHash3.
-inline uint32_t murmur3_32(const uint8_t* data, size_t size, uint32_t seed) {
+///
+/// Like all hash functions below, it hashes either bytes (`uint8_t`) or
+/// characters (`char`), with the same result for the same bytes. Only the
+/// latter can be evaluated at compile time.
+template <typename Byte>
+constexpr uint32_t murmur3_32(const Byte* data, size_t size, uint32_t seed) {
   const uint32_t c1 = 0xcc9e2d51;
   const uint32_t c2 = 0x1b873593;
   const uint32_t r1 = 15;
@@ -28,9 +60,8 @@ inline uint32_t murmur3_32(const uint8_t* data, size_t size, uint32_t seed) {
   uint32_t hash = seed;
 
   if (size >= 4) {
-    const auto* four_byte_chunk = reinterpret_cast<const uint32_t*>(data);
     for (size_t i = 0, stop = size / 4; i < stop; ++i) {
-      uint32_t k = *four_byte_chunk++;
+      uint32_t k = load<uint32_t>(data + i * 4);
 
       k *= c1;
       k = rotate_left(k, r1);
@@ -48,7 +79,7 @@ inline uint32_t murmur3_32(const uint8_t* data, size_t size, uint32_t seed) {
     const auto* remaining_bytes = data + size - 1;
     for (size_t i = 0, stop = size & 3u; i < stop; ++i) {
       remaining_chunk <<= 8;
-      remaining_chunk |= static_cast<uint32_t>(*remaining_bytes--);
+      remaining_chunk |= static_cast<uint8_t>(*remaining_bytes--);
     }
 
     remaining_chunk *= c1;
@@ -66,29 +97,1213 @@ inline uint32_t murmur3_32(const uint8_t* data, size_t size, uint32_t seed) {
 
   return hash;
 }
+
+/// The 64-bit finalization mix of murmur3. Forces all bits of `k` to avalanche.
+constexpr uint64_t fmix64(uint64_t k) noexcept {
+  k ^= k >> 33;
+  k *= 0xff51afd7ed558ccdULL;
+  k ^= k >> 33;
+  k *= 0xc4ceb9fe1a85ec53ULL;
+  k ^= k >> 33;
+  return k;
+}
 }  // namespace Detail
 
+/// A 128-bit hash value, split into two 64-bit halves.
+struct Digest {
+  uint64_t low;
+  uint64_t high;
+};
+
+namespace Detail {
+
+/// Mixes the 16-byte block at `data` into the murmur3 x64 128 state.
+template <typename Byte>
+constexpr void murmur3_128_block(const Byte* data,
+                                 uint64_t& h1,
+                                 uint64_t& h2) noexcept {
+  const uint64_t c1 = 0x87c37b91114253d5ULL;
+  const uint64_t c2 = 0x4cf5ad432745937fULL;
+
+  uint64_t k1 = load<uint64_t>(data);
+  uint64_t k2 = load<uint64_t>(data + 8);
+
+  k1 *= c1;
+  k1 = rotate_left<uint64_t>(k1, 31);
+  k1 *= c2;
+  h1 ^= k1;
+
+  h1 = rotate_left<uint64_t>(h1, 27);
+  h1 += h2;
+  h1 = h1 * 5 + 0x52dce729;
+
+  k2 *= c2;
+  k2 = rotate_left<uint64_t>(k2, 33);
+  k2 *= c1;
+  h2 ^= k2;
+
+  h2 = rotate_left<uint64_t>(h2, 31);
+  h2 += h1;
+  h2 = h2 * 5 + 0x38495ab5;
+}
+
+/// Mixes the last (size % 16) bytes of a key of `size` bytes, at `data`, into
+/// the murmur3 x64 128 state and returns the final hash.
+template <typename Byte>
+constexpr Digest murmur3_128_finish(const Byte* data,
+                                    size_t size,
+                                    uint64_t h1,
+                                    uint64_t h2) noexcept {
+  const uint64_t c1 = 0x87c37b91114253d5ULL;
+  const uint64_t c2 = 0x4cf5ad432745937fULL;
+
+  const size_t remaining = size & 15u;
+  if (remaining > 8) {
+    uint64_t k2 = 0;
+    for (size_t i = remaining; i > 8; --i) {
+      k2 ^= uint64_t{static_cast<uint8_t>(data[i - 1])} << ((i - 9) * 8);
+    }
+    k2 *= c2;
+    k2 = rotate_left<uint64_t>(k2, 33);
+    k2 *= c1;
+    h2 ^= k2;
+  }
+  if (remaining > 0) {
+    uint64_t k1 = 0;
+    for (size_t i = (remaining > 8 ? 8 : remaining); i > 0; --i) {
+      k1 ^= uint64_t{static_cast<uint8_t>(data[i - 1])} << ((i - 1) * 8);
+    }
+    k1 *= c1;
+    k1 = rotate_left<uint64_t>(k1, 31);
+    k1 *= c2;
+    h1 ^= k1;
+  }
+
+  h1 ^= size;
+  h2 ^= size;
+
+  h1 += h2;
+  h2 += h1;
+
+  h1 = fmix64(h1);
+  h2 = fmix64(h2);
+
+  h1 += h2;
+  h2 += h1;
+
+  return {h1, h2};
+}
+
+/// Implements the 128-bit murmur3 hash function (`MurmurHash3_x64_128`).
+/// See https://github.com/aappleby/smhasher/blob/master/src/MurmurHash3.cpp.
+template <typename Byte>
+constexpr Digest murmur3_128(const Byte* data, size_t size, uint64_t seed) {
+  uint64_t h1 = seed;
+  uint64_t h2 = seed;
+  for (size_t i = 0, stop = size / 16; i < stop; ++i, data += 16) {
+    murmur3_128_block(data, h1, h2);
+  }
+  // `data` now points at the remaining (size % 16) bytes.
+  return murmur3_128_finish(data, size, h1, h2);
+}
+
+/// Hashes bytes with `murmur3_128()`. Also accepts a null `data` of size zero.
+inline Digest murmur3_128(const uint8_t* data, size_t size, uint64_t seed) {
+  return murmur3_128<uint8_t>(data, size, seed);
+}
+
+/// Computes `murmur3_128()` of the concatenation of all byte strings passed to
+/// `update()`, buffering at most one incomplete block.
+class Murmur3Stream {
+ public:
+  explicit Murmur3Stream(uint64_t seed) noexcept : h1_(seed), h2_(seed) {}
+
+  void update(const uint8_t* data, size_t size) noexcept {
+    size_ += size;
+    if (buffered_ > 0) {
+      const size_t take = std::min(size, 16 - buffered_);
+      std::memcpy(buffer_ + buffered_, data, take);
+      buffered_ += take;
+      data += take;
+      size -= take;
+      if (buffered_ < 16) return;
+      murmur3_128_block(buffer_, h1_, h2_);
+      buffered_ = 0;
+    }
+    for (; size >= 16; data += 16, size -= 16) {
+      murmur3_128_block(data, h1_, h2_);
+    }
+    if (size > 0) std::memcpy(buffer_, data, size);
+    buffered_ = size;
+  }
+
+  Digest finalize() const noexcept {
+    return murmur3_128_finish(buffer_, size_, h1_, h2_);
+  }
+
+ private:
+  uint64_t h1_;
+  uint64_t h2_;
+  uint8_t buffer_[16];
+  size_t buffered_ = 0;
+  size_t size_ = 0;
+};
+
+/// The secret constants of wyhash.
+template <typename = void>
+struct WyhashConstants {
+  static constexpr uint64_t kSecret[4] = {0x2d358dccaa6c78a5ULL,
+                                          0x8bb84b93962eacc9ULL,
+                                          0x4b33a62ed433d4a3ULL,
+                                          0x4d5a2da51de1aa47ULL};
+};
+
+template <typename T>
+constexpr uint64_t WyhashConstants<T>::kSecret[4];
+
+/// Multiplies `a` and `b` and folds the 128-bit product into 64 bits.
+constexpr uint64_t wymix(uint64_t a, uint64_t b) noexcept {
+  const Product product = multiply(a, b);
+  return product.low ^ product.high;
+}
+
+/// Reads the 1 to 3 bytes at `data` into an integer, as wyhash does.
+template <typename Byte>
+constexpr uint64_t load_small(const Byte* data, size_t size) noexcept {
+  return (uint64_t{static_cast<uint8_t>(data[0])} << 16) |
+         (uint64_t{static_cast<uint8_t>(data[size >> 1])} << 8) |
+         static_cast<uint8_t>(data[size - 1]);
+}
+
+/// Runs the wyhash compression over the `size` bytes at `data` and returns
+/// the final 128-bit state, from which `wyhash()` and `wyhash_128()` derive
+/// their results.
+///
+/// Modelled on wyhash (final version 4) by Wang Yi: 48 bytes are consumed per
+/// round by three independent multiply-mix lanes, and keys of up to 16 bytes
+/// are read with (at most) four overlapping loads and no loop at all.
+template <typename Byte>
+constexpr Product wyhash_state(const Byte* data,
+                               size_t size,
+                               uint64_t seed) noexcept {
+  const uint64_t* secret = WyhashConstants<>::kSecret;
+  seed ^= wymix(seed ^ secret[0], secret[1]);
+  uint64_t a = 0;
+  uint64_t b = 0;
+  if (size <= 16) {
+    if (size >= 4) {
+      const size_t offset = (size >> 3) << 2;
+      a = (uint64_t{load<uint32_t>(data)} << 32) |
+          load<uint32_t>(data + offset);
+      b = (uint64_t{load<uint32_t>(data + size - 4)} << 32) |
+          load<uint32_t>(data + size - 4 - offset);
+    } else if (size > 0) {
+      a = load_small(data, size);
+    }
+  } else {
+    size_t remaining = size;
+    if (remaining > 48) {
+      uint64_t seed1 = seed;
+      uint64_t seed2 = seed;
+      do {
+        seed = wymix(load<uint64_t>(data) ^ secret[1],
+                     load<uint64_t>(data + 8) ^ seed);
+        seed1 = wymix(load<uint64_t>(data + 16) ^ secret[2],
+                      load<uint64_t>(data + 24) ^ seed1);
+        seed2 = wymix(load<uint64_t>(data + 32) ^ secret[3],
+                      load<uint64_t>(data + 40) ^ seed2);
+        data += 48;
+        remaining -= 48;
+      } while (remaining > 48);
+      seed ^= seed1 ^ seed2;
+    }
+    while (remaining > 16) {
+      seed = wymix(load<uint64_t>(data) ^ secret[1],
+                   load<uint64_t>(data + 8) ^ seed);
+      data += 16;
+      remaining -= 16;
+    }
+    a = load<uint64_t>(data + remaining - 16);
+    b = load<uint64_t>(data + remaining - 8);
+  }
+  return multiply(a ^ secret[1], b ^ seed);
+}
+
+/// Folds the final state of `wyhash_state()` for a key of `size` bytes into
+/// the 64-bit hash.
+constexpr uint64_t wyhash_fold(Product state, size_t size) noexcept {
+  const uint64_t* secret = WyhashConstants<>::kSecret;
+  return wymix(state.low ^ secret[0] ^ size, state.high ^ secret[1]);
+}
+
+/// Folds the final state of `wyhash_state()` for a key of `size` bytes into
+/// the 128-bit hash: the 64-bit hash and a second, differently mixed fold.
+constexpr Digest wyhash_fold_128(Product state, size_t size) noexcept {
+  const uint64_t* secret = WyhashConstants<>::kSecret;
+  return {wyhash_fold(state, size),
+          wymix(state.low ^ secret[2], state.high ^ secret[3] ^ size)};
+}
+
+/// Returns a 64-bit wyhash of the `size` bytes at `data`.
+template <typename Byte>
+constexpr uint64_t wyhash(const Byte* data, size_t size, uint64_t seed) {
+  return wyhash_fold(wyhash_state(data, size, seed), size);
+}
+
+/// Returns a 128-bit wyhash of the `size` bytes at `data`: the 64-bit hash
+/// and a second, differently mixed fold of the same final state.
+template <typename Byte>
+constexpr Digest wyhash_128(const Byte* data, size_t size, uint64_t seed) {
+  return wyhash_fold_128(wyhash_state(data, size, seed), size);
+}
+
+/// Computes the final state of `wyhash_state()` for the concatenation of all
+/// byte strings passed to `update()`.
+///
+/// A round of 48 bytes is only run once more than 48 bytes are pending, as
+/// `wyhash_state()` leaves up to 48 bytes for its 16-byte rounds. Those end
+/// with the last 16 bytes of the key, which may overlap the last round, so
+/// the 16 bytes before the pending ones are kept too.
+class WyhashStream {
+ public:
+  explicit WyhashStream(uint64_t seed) noexcept
+  : key_seed_(seed)
+  , seed_(seed ^ wymix(seed ^ WyhashConstants<>::kSecret[0],
+                       WyhashConstants<>::kSecret[1])) {}
+
+  void update(const uint8_t* data, size_t size) noexcept {
+    size_ += size;
+    while (size > 0) {
+      const size_t take = std::min(size, kCapacity - pending_);
+      std::memcpy(buffer_ + 16 + pending_, data, take);
+      pending_ += take;
+      data += take;
+      size -= take;
+      if (pending_ > 48) {
+        round(buffer_ + 16);
+        pending_ -= 48;
+        std::memmove(buffer_, buffer_ + 48, 16 + pending_);
+      }
+    }
+  }
+
+  /// Returns the final state, as `wyhash_state()` of the whole key.
+  Product state() const noexcept {
+    if (size_ <= 16) return wyhash_state(key(), size_, key_seed_);
+    const uint64_t* secret = WyhashConstants<>::kSecret;
+    uint64_t seed = rounds_ ? seed_ ^ seed1_ ^ seed2_ : seed_;
+    const uint8_t* data = key();
+    size_t remaining = pending_;
+    while (remaining > 16) {
+      seed = wymix(load<uint64_t>(data) ^ secret[1],
+                   load<uint64_t>(data + 8) ^ seed);
+      data += 16;
+      remaining -= 16;
+    }
+    const uint64_t a = load<uint64_t>(data + remaining - 16);
+    const uint64_t b = load<uint64_t>(data + remaining - 8);
+    return multiply(a ^ secret[1], b ^ seed);
+  }
+
+  /// Returns the total size of the key.
+  size_t size() const noexcept { return size_; }
+
+  /// Returns the bytes of the key, if it is at most 16 bytes long.
+  const uint8_t* key() const noexcept { return buffer_ + 16; }
+
+ private:
+  static constexpr size_t kCapacity = 64;
+
+  void round(const uint8_t* data) noexcept {
+    const uint64_t* secret = WyhashConstants<>::kSecret;
+    if (!rounds_) {
+      seed1_ = seed2_ = seed_;
+      rounds_ = true;
+    }
+    seed_ = wymix(load<uint64_t>(data) ^ secret[1],
+                  load<uint64_t>(data + 8) ^ seed_);
+    seed1_ = wymix(load<uint64_t>(data + 16) ^ secret[2],
+                   load<uint64_t>(data + 24) ^ seed1_);
+    seed2_ = wymix(load<uint64_t>(data + 32) ^ secret[3],
+                   load<uint64_t>(data + 40) ^ seed2_);
+  }
+
+  uint64_t key_seed_;
+  uint64_t seed_;
+  uint64_t seed1_ = 0;
+  uint64_t seed2_ = 0;
+  bool rounds_ = false;
+  /// The 16 bytes before the pending ones, then the pending bytes.
+  uint8_t buffer_[16 + kCapacity];
+  size_t pending_ = 0;
+  size_t size_ = 0;
+};
+
+/// Returns a 128-bit hash of a single 64-bit `value` (e.g. a 4- or 8-byte
+/// key) in two multiplications, without any of the bookkeeping of hashing a
+/// byte string. Both halves multiply by a fixed constant, so no seed can make
+/// the hash degenerate.
+constexpr Digest hash_integer(uint64_t value, uint64_t seed) noexcept {
+  const uint64_t* secret = WyhashConstants<>::kSecret;
+  const uint64_t mixed = value ^ seed;
+  return {wymix(mixed ^ secret[0], secret[1]),
+          wymix(mixed ^ secret[2], secret[3])};
+}
+
+/// Hashes keys of 4 or 8 bytes, read as little-endian integers, with
+/// `hash_integer()` and all other keys with `wyhash_128()`.
+template <typename Byte>
+constexpr Digest hash_integer_key(const Byte* data,
+                                  size_t size,
+                                  uint64_t seed) noexcept {
+  if (size == 8) return hash_integer(load<uint64_t>(data), seed);
+  if (size == 4) return hash_integer(load<uint32_t>(data), seed);
+  return wyhash_128(data, size, seed);
+}
+
+/// Hashes the `count` integers of type `Integer` (`uint32_t` or `uint64_t`)
+/// stored at `keys` to `digests`, as `hash_integer_key()` hashes their bytes.
+/// The portable reference of the SIMD kernels below.
+template <typename Integer>
+void hash_integers_scalar(const void* keys,
+                          size_t count,
+                          uint64_t seed,
+                          Digest* digests) noexcept {
+  const auto* bytes = static_cast<const uint8_t*>(keys);
+  for (size_t i = 0; i < count; ++i, bytes += sizeof(Integer)) {
+    digests[i] = hash_integer(load<Integer>(bytes), seed);
+  }
+}
+
+#if defined(BLOOM_HAS_X86_KERNELS)
+/// Computes `hash_integer()` of four keys at once. AVX2 has no 64-bit
+/// multiplication, so each 128-bit product of `wymix()` is assembled from four
+/// 32x32-bit ones.
+struct Avx2IntegerKernel {
+  __attribute__((target("avx2"))) static __m256i load(const void* keys,
+                                                      uint64_t /*width*/) {
+    return _mm256_loadu_si256(static_cast<const __m256i*>(keys));
+  }
+
+  __attribute__((target("avx2"))) static __m256i load(const void* keys,
+                                                      uint32_t /*width*/) {
+    return _mm256_cvtepu32_epi64(
+        _mm_loadu_si128(static_cast<const __m128i*>(keys)));
+  }
+
+  /// Returns `wymix(a, b)` in each lane. `b_high` holds the high half of `b`.
+  __attribute__((target("avx2"))) static __m256i wymix(__m256i a,
+                                                       __m256i b,
+                                                       __m256i b_high) {
+    const __m256i low_half = _mm256_set1_epi64x(0xffffffff);
+    const __m256i a_high = _mm256_srli_epi64(a, 32);
+    const __m256i low_low = _mm256_mul_epu32(a, b);
+    const __m256i low_high = _mm256_mul_epu32(a, b_high);
+    const __m256i high_low = _mm256_mul_epu32(a_high, b);
+    const __m256i high_high = _mm256_mul_epu32(a_high, b_high);
+    // Bits 32 to 95 of the product, without the carries into the high half.
+    const __m256i middle =
+        _mm256_add_epi64(_mm256_add_epi64(_mm256_srli_epi64(low_low, 32),
+                                          _mm256_and_si256(low_high, low_half)),
+                         _mm256_and_si256(high_low, low_half));
+    const __m256i low = _mm256_or_si256(_mm256_slli_epi64(middle, 32),
+                                        _mm256_and_si256(low_low, low_half));
+    const __m256i high = _mm256_add_epi64(
+        _mm256_add_epi64(high_high, _mm256_srli_epi64(middle, 32)),
+        _mm256_add_epi64(_mm256_srli_epi64(low_high, 32),
+                         _mm256_srli_epi64(high_low, 32)));
+    return _mm256_xor_si256(low, high);
+  }
+
+  template <typename Integer>
+  __attribute__((target("avx2"))) static void hash(const void* keys,
+                                                   size_t count,
+                                                   uint64_t seed,
+                                                   Digest* digests) {
+    const uint64_t* secret = WyhashConstants<>::kSecret;
+    const __m256i low_seed = broadcast(seed ^ secret[0]);
+    const __m256i low_factor = broadcast(secret[1]);
+    const __m256i low_factor_high = broadcast(secret[1] >> 32);
+    const __m256i high_seed = broadcast(seed ^ secret[2]);
+    const __m256i high_factor = broadcast(secret[3]);
+    const __m256i high_factor_high = broadcast(secret[3] >> 32);
+    const auto* bytes = static_cast<const uint8_t*>(keys);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+      const __m256i value = load(bytes + i * sizeof(Integer), Integer());
+      const __m256i low = wymix(
+          _mm256_xor_si256(value, low_seed), low_factor, low_factor_high);
+      const __m256i high = wymix(
+          _mm256_xor_si256(value, high_seed), high_factor, high_factor_high);
+      // Interleaves the halves into digests 0 and 2, and 1 and 3.
+      const __m256i even = _mm256_unpacklo_epi64(low, high);
+      const __m256i odd = _mm256_unpackhi_epi64(low, high);
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(digests + i),
+                          _mm256_permute2x128_si256(even, odd, 0x20));
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(digests + i + 2),
+                          _mm256_permute2x128_si256(even, odd, 0x31));
+    }
+    hash_integers_scalar<Integer>(
+        bytes + i * sizeof(Integer), count - i, seed, digests + i);
+  }
+
+  __attribute__((target("avx2"))) static __m256i broadcast(uint64_t value) {
+    return _mm256_set1_epi64x(static_cast<long long>(value));
+  }
+};
+
+#if defined(__GNUC__) && !defined(__clang__)
+// GCC 12 takes the `_mm512_undefined_epi32()` passthrough operands of the
+// unmasked AVX-512 intrinsics for uninitialized variables.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+/// Computes `hash_integer()` of eight keys at once, as `Avx2IntegerKernel`
+/// does for four.
+struct Avx512IntegerKernel {
+  __attribute__((target("avx512f"))) static __m512i load(const void* keys,
+                                                         uint64_t /*width*/) {
+    return _mm512_loadu_si512(keys);
+  }
+
+  __attribute__((target("avx512f"))) static __m512i load(const void* keys,
+                                                         uint32_t /*width*/) {
+    return _mm512_cvtepu32_epi64(
+        _mm256_loadu_si256(static_cast<const __m256i*>(keys)));
+  }
+
+  /// Returns `wymix(a, b)` in each lane. `b_high` holds the high half of `b`.
+  __attribute__((target("avx512f"))) static __m512i wymix(__m512i a,
+                                                          __m512i b,
+                                                          __m512i b_high) {
+    const __m512i low_half = _mm512_set1_epi64(0xffffffff);
+    const __m512i a_high = _mm512_srli_epi64(a, 32);
+    const __m512i low_low = _mm512_mul_epu32(a, b);
+    const __m512i low_high = _mm512_mul_epu32(a, b_high);
+    const __m512i high_low = _mm512_mul_epu32(a_high, b);
+    const __m512i high_high = _mm512_mul_epu32(a_high, b_high);
+    // Bits 32 to 95 of the product, without the carries into the high half.
+    const __m512i middle =
+        _mm512_add_epi64(_mm512_add_epi64(_mm512_srli_epi64(low_low, 32),
+                                          _mm512_and_si512(low_high, low_half)),
+                         _mm512_and_si512(high_low, low_half));
+    const __m512i low = _mm512_or_si512(_mm512_slli_epi64(middle, 32),
+                                        _mm512_and_si512(low_low, low_half));
+    const __m512i high = _mm512_add_epi64(
+        _mm512_add_epi64(high_high, _mm512_srli_epi64(middle, 32)),
+        _mm512_add_epi64(_mm512_srli_epi64(low_high, 32),
+                         _mm512_srli_epi64(high_low, 32)));
+    return _mm512_xor_si512(low, high);
+  }
+
+  template <typename Integer>
+  __attribute__((target("avx512f"))) static void hash(const void* keys,
+                                                      size_t count,
+                                                      uint64_t seed,
+                                                      Digest* digests) {
+    const uint64_t* secret = WyhashConstants<>::kSecret;
+    const __m512i low_seed = broadcast(seed ^ secret[0]);
+    const __m512i low_factor = broadcast(secret[1]);
+    const __m512i low_factor_high = broadcast(secret[1] >> 32);
+    const __m512i high_seed = broadcast(seed ^ secret[2]);
+    const __m512i high_factor = broadcast(secret[3]);
+    const __m512i high_factor_high = broadcast(secret[3] >> 32);
+    // Interleave the halves of digests 0 to 3, and 4 to 7.
+    const __m512i first = _mm512_setr_epi64(0, 8, 1, 9, 2, 10, 3, 11);
+    const __m512i second = _mm512_setr_epi64(4, 12, 5, 13, 6, 14, 7, 15);
+    const auto* bytes = static_cast<const uint8_t*>(keys);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+      const __m512i value = load(bytes + i * sizeof(Integer), Integer());
+      const __m512i low = wymix(
+          _mm512_xor_si512(value, low_seed), low_factor, low_factor_high);
+      const __m512i high = wymix(
+          _mm512_xor_si512(value, high_seed), high_factor, high_factor_high);
+      _mm512_storeu_si512(digests + i,
+                          _mm512_permutex2var_epi64(low, first, high));
+      _mm512_storeu_si512(digests + i + 4,
+                          _mm512_permutex2var_epi64(low, second, high));
+    }
+    hash_integers_scalar<Integer>(
+        bytes + i * sizeof(Integer), count - i, seed, digests + i);
+  }
+
+  __attribute__((target("avx512f"))) static __m512i broadcast(uint64_t value) {
+    return _mm512_set1_epi64(static_cast<long long>(value));
+  }
+};
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif
+
+/// Hashes the `count` integers of type `Integer` (`uint32_t` or `uint64_t`)
+/// stored at `keys` to `digests`, as `hash_integer_key()` hashes their bytes,
+/// eight or four at a time with AVX-512 or AVX2 if the CPU supports it.
+template <typename Integer>
+void hash_integers(const void* keys,
+                   size_t count,
+                   uint64_t seed,
+                   Digest* digests) noexcept {
+#if defined(BLOOM_HAS_X86_KERNELS)
+  switch (best_isa()) {
+    case Isa::kAvx512:
+      return Avx512IntegerKernel::hash<Integer>(keys, count, seed, digests);
+    case Isa::kAvx2:
+      return Avx2IntegerKernel::hash<Integer>(keys, count, seed, digests);
+    case Isa::kSse42:
+    case Isa::kScalar: break;
+  }
+#endif
+  hash_integers_scalar<Integer>(keys, count, seed, digests);
+}
+
+/// The state of SipHash with 128-bit output, with `CompressionRounds` rounds
+/// per 8-byte block and `FinalizationRounds` rounds at the end. See Aumasson
+/// and Bernstein, "SipHash: a fast short-input PRF".
+///
+/// Unlike murmur3 and wyhash, SipHash is a keyed pseudorandom function: as
+/// long as the key is secret, hashes cannot be predicted, and no keys can be
+/// crafted that collide.
+template <size_t CompressionRounds, size_t FinalizationRounds>
+class SipHashState {
+ public:
+  constexpr SipHashState(uint64_t k0, uint64_t k1) noexcept
+  : v0_(k0 ^ 0x736f6d6570736575ULL)
+  , v1_(k1 ^ 0x646f72616e646f6dULL ^ 0xee)
+  , v2_(k0 ^ 0x6c7967656e657261ULL)
+  , v3_(k1 ^ 0x7465646279746573ULL) {}
+
+  /// Mixes the 8-byte block `block` into the state.
+  constexpr void update(uint64_t block) noexcept {
+    v3_ ^= block;
+    for (size_t i = 0; i < CompressionRounds; ++i) round();
+    v0_ ^= block;
+  }
+
+  /// Mixes the last (size % 8) bytes of a key of `size` bytes, at `data`, into
+  /// a copy of the state and returns the hash.
+  template <typename Byte>
+  constexpr Digest finish(const Byte* data, size_t size) const noexcept {
+    SipHashState state = *this;
+    uint64_t last = uint64_t{size} << 56;
+    for (size_t i = size & 7u; i > 0; --i) {
+      last |= uint64_t{static_cast<uint8_t>(data[i - 1])} << ((i - 1) * 8);
+    }
+    state.update(last);
+    state.v2_ ^= 0xee;
+    for (size_t i = 0; i < FinalizationRounds; ++i) state.round();
+    const uint64_t low = state.v0_ ^ state.v1_ ^ state.v2_ ^ state.v3_;
+    state.v1_ ^= 0xdd;
+    for (size_t i = 0; i < FinalizationRounds; ++i) state.round();
+    return {low, state.v0_ ^ state.v1_ ^ state.v2_ ^ state.v3_};
+  }
+
+ private:
+  constexpr void round() noexcept {
+    v0_ += v1_;
+    v1_ = rotate_left<uint64_t>(v1_, 13);
+    v1_ ^= v0_;
+    v0_ = rotate_left<uint64_t>(v0_, 32);
+    v2_ += v3_;
+    v3_ = rotate_left<uint64_t>(v3_, 16);
+    v3_ ^= v2_;
+    v0_ += v3_;
+    v3_ = rotate_left<uint64_t>(v3_, 21);
+    v3_ ^= v0_;
+    v2_ += v1_;
+    v1_ = rotate_left<uint64_t>(v1_, 17);
+    v1_ ^= v2_;
+    v2_ = rotate_left<uint64_t>(v2_, 32);
+  }
+
+  uint64_t v0_;
+  uint64_t v1_;
+  uint64_t v2_;
+  uint64_t v3_;
+};
+
+/// The SipHash variant of `HashScheme::kSipHashDoubleHashing`: SipHash-1-3,
+/// as used for hash tables by e.g. Python and Rust.
+using SipHash13 = SipHashState<1, 3>;
+
+/// Returns the 128-bit SipHash of the `size` bytes at `data` under the key
+/// `(k0, k1)`.
+template <typename State = SipHash13, typename Byte>
+constexpr Digest siphash_128(const Byte* data,
+                             size_t size,
+                             uint64_t k0,
+                             uint64_t k1) noexcept {
+  State state(k0, k1);
+  for (size_t i = 0, stop = size / 8; i < stop; ++i, data += 8) {
+    state.update(load<uint64_t>(data));
+  }
+  // `data` now points at the remaining (size % 8) bytes.
+  return state.finish(data, size);
+}
+
+/// Returns the second half of the SipHash key derived from a 64-bit `seed`,
+/// whose first half is the seed itself.
+constexpr uint64_t siphash_k1(uint64_t seed) noexcept { return fmix64(seed); }
+
+/// Computes `siphash_128()` of the concatenation of all byte strings passed to
+/// `update()`, buffering at most one incomplete block.
+class SipHashStream {
+ public:
+  SipHashStream(uint64_t k0, uint64_t k1) noexcept : state_(k0, k1) {}
+
+  void update(const uint8_t* data, size_t size) noexcept {
+    size_ += size;
+    if (buffered_ > 0) {
+      const size_t take = std::min(size, 8 - buffered_);
+      std::memcpy(buffer_ + buffered_, data, take);
+      buffered_ += take;
+      data += take;
+      size -= take;
+      if (buffered_ < 8) return;
+      state_.update(load<uint64_t>(buffer_));
+      buffered_ = 0;
+    }
+    for (; size >= 8; data += 8, size -= 8) {
+      state_.update(load<uint64_t>(data));
+    }
+    if (size > 0) std::memcpy(buffer_, data, size);
+    buffered_ = size;
+  }
+
+  Digest finalize() const noexcept { return state_.finish(buffer_, size_); }
+
+ private:
+  SipHash13 state_;
+  uint8_t buffer_[8];
+  size_t buffered_ = 0;
+  size_t size_ = 0;
+};
+
+/// Returns a 64-bit seed read from `std::random_device`, e.g. the secret key
+/// of a keyed hash function. Each call reads the device, which is slow.
+inline uint64_t secret_seed() {
+  std::random_device device;
+  return (uint64_t{device()} << 32) ^ device();
+}
+
+/// Returns a randomly chosen 64-bit seed.
+///
+/// Seeds are drawn from a generator per thread (a Weyl sequence mixed with
+/// `fmix64()`, like splitmix64), which is seeded with `secret_seed()` on the
+/// first call of the thread. This is far cheaper than reading
+/// `std::random_device` for every seed, but the seeds of a thread follow from
+/// one another: use `secret_seed()` for seeds that must stay secret.
+inline uint64_t random_seed() {
+  thread_local uint64_t state = secret_seed();
+  state += 0x9e3779b97f4a7c15ULL;
+  return fmix64(state);
+}
+
+/// Returns the `index`-th of a sequence of seeds derived from `seed`, e.g. for
+/// the `index`-th of `k` independent hash functions. Distinct for distinct
+/// indices, and uncorrelated with one another.
+constexpr uint64_t derive_seed(uint64_t seed, uint64_t index) noexcept {
+  return fmix64(seed + (index + 1) * 0x9e3779b97f4a7c15ULL);
+}
+
+/// Generates the probe positions `g_i(x) = h1(x) + i * h2(x)` for a key `x`
+/// from a single `Digest` of that key, as described by Kirsch and Mitzenmacher
+/// in "Less Hashing, Same Performance: Building a Better Bloom Filter".
+///
+/// The step `h2` is forced to be odd so that the sequence never degenerates to
+/// a single position and visits distinct positions modulo any power of two.
+class ProbeSequence {
+ public:
+  constexpr explicit ProbeSequence(Digest digest) noexcept
+  : hash_(digest.low), step_(digest.high | 1u) {}
+
+  /// Returns the current probe position and advances to the next one.
+  constexpr uint64_t next() noexcept {
+    const uint64_t current = hash_;
+    hash_ += step_;
+    return current;
+  }
+
+ private:
+  uint64_t hash_;
+  uint64_t step_;
+};
+}  // namespace Detail
+
+/// The seed of the hash functions of a filter, or no seed, in which case the
+/// filter chooses one at random. Converts implicitly from an integer:
+///
+/// ```cpp
+/// Bloom::Options options(1 << 20, 7);
+/// options.seed = 42;
+/// ```
+class Seed {
+ public:
+  /// Constructs no seed.
+  constexpr Seed() noexcept = default;
+
+  /// Constructs the seed `value`.
+  constexpr Seed(uint64_t value) noexcept  // NOLINT
+  : value_(value), has_value_(true) {}
+
+  /// Returns `true` if there is a seed.
+  constexpr bool has_value() const noexcept { return has_value_; }
+
+  /// Returns the seed. Zero if there is none.
+  constexpr uint64_t value() const noexcept { return value_; }
+
+  /// Returns the seed, or `Detail::random_seed()` if there is none.
+  uint64_t value_or_random() const {
+    return has_value_ ? value_ : Detail::random_seed();
+  }
+
+ private:
+  uint64_t value_ = 0;
+  bool has_value_ = false;
+};
+
 /// The default hash functor used throughout the `Bloom` library.
 /// It is parameterized by a `seed` value that seeds the underlying hash
 /// function implementation.
 struct DefaultHasher {
   /// Constructs the `DefaultHasher` with the given seed.
-  explicit DefaultHasher(uint32_t seed) : seed(seed) {}
+  constexpr explicit DefaultHasher(uint32_t seed) : seed(seed) {}
 
   /// Constructs the `DefaultHasher` with a randomly chosen seed.
-  DefaultHasher() {
-    std::random_device seed_device;
-    std::mt19937 generator(seed_device());
-    std::uniform_int_distribution<uint32_t> distribution;
-    seed = distribution(generator);
-  }
+  DefaultHasher()
+  : DefaultHasher(static_cast<uint32_t>(Detail::random_seed() >> 32)) {}
 
   /// Hashes the `slice`.
   uint32_t operator()(Slice slice) const noexcept {
     return Detail::murmur3_32(slice.data(), slice.size(), seed);
   }
 
+  /// Hashes the `key`, to the same value as the `Slice` of its characters.
+  constexpr uint32_t operator()(StaticKey key) const noexcept {
+    return Detail::murmur3_32(key.data(), key.size(), seed);
+  }
+
   /// The seed used in this `DefaultHasher`.
   uint32_t seed;
 };
+
+/// How a key is hashed into the `Digest` from which all of its probe
+/// positions are derived. Stored in serialized filters.
+enum class HashScheme : uint32_t {
+  /// murmur3 x64 128 (`Detail::murmur3_128()`) under the mixed seed.
+  kMurmur3DoubleHashing = 1,
+  /// wyhash 128 (`Detail::wyhash_128()`). Several times faster than murmur3
+  /// for long keys.
+  kWyhashDoubleHashing = 2,
+  /// `Detail::hash_integer()` for keys of 4 or 8 bytes (read as little-endian
+  /// integers), and wyhash 128 for other keys. See
+  /// `Detail::hash_integer_key()`.
+  kIntegerDoubleHashing = 3,
+  /// SipHash-1-3 128 (`Detail::siphash_128()`), keyed with the seed. For
+  /// untrusted keys: with a secret seed (see `Detail::secret_seed()`), an
+  /// adversary can neither predict the bits of a key nor craft keys that
+  /// collide, e.g. to fill a filter or to find false positives offline. About
+  /// twice as slow as murmur3.
+  kSipHashDoubleHashing = 4,
+};
+
+namespace Detail {
+
+/// Hashes the `size` bytes at `data` to the `Digest` of a `DoubleHasher` with
+/// the given `seed` and `scheme`.
+///
+/// The seed is mixed before it is passed on to murmur3: murmur3 cancels a seed
+/// equal to the length of the key, leaving the halves of the digest multiples
+/// of one another, which would make the probe positions of all keys of that
+/// length strongly correlated. Mixed, no small seed has this problem.
+template <typename Byte>
+constexpr Digest double_hash(const Byte* data,
+                             size_t size,
+                             uint64_t seed,
+                             HashScheme scheme) noexcept {
+  switch (scheme) {
+    case HashScheme::kWyhashDoubleHashing: return wyhash_128(data, size, seed);
+    case HashScheme::kIntegerDoubleHashing:
+      return hash_integer_key(data, size, seed);
+    case HashScheme::kSipHashDoubleHashing:
+      return siphash_128(data, size, seed, siphash_k1(seed));
+    case HashScheme::kMurmur3DoubleHashing: break;
+  }
+  return murmur3_128(data, size, fmix64(seed));
+}
+}  // namespace Detail
+
+/// Hashes a key given in parts, e.g. the fields of a composite key, to the
+/// `Digest` that a `DoubleHasher` computes for the concatenation of the
+/// parts, without copying them into one buffer first. Obtained from the
+/// `stream()` method of a `DoubleHasher`, `WyHasher` or `IntegerHasher`:
+///
+/// ```cpp
+/// const Digest digest =
+///     hasher.stream().update(tenant_id).update(path).finalize();
+/// ```
+class DigestStream {
+ public:
+  /// Constructs the `DigestStream` of a `DoubleHasher` with the given seed and
+  /// hash scheme.
+  DigestStream(uint64_t seed, HashScheme scheme) noexcept
+  : seed_(seed)
+  , scheme_(scheme)
+  , murmur3_(Detail::fmix64(seed))
+  , wyhash_(seed)
+  , siphash_(seed, Detail::siphash_k1(seed)) {}
+
+  /// Appends the bytes of `slice` to the key.
+  DigestStream& update(Slice slice) noexcept {
+    switch (scheme_) {
+      case HashScheme::kMurmur3DoubleHashing:
+        murmur3_.update(slice.data(), slice.size());
+        break;
+      case HashScheme::kSipHashDoubleHashing:
+        siphash_.update(slice.data(), slice.size());
+        break;
+      case HashScheme::kWyhashDoubleHashing:
+      case HashScheme::kIntegerDoubleHashing:
+        wyhash_.update(slice.data(), slice.size());
+        break;
+    }
+    return *this;
+  }
+
+  /// Returns the `Digest` of the key. The stream may be updated further.
+  Digest finalize() const noexcept {
+    switch (scheme_) {
+      case HashScheme::kWyhashDoubleHashing: break;
+      case HashScheme::kIntegerDoubleHashing:
+        if (wyhash_.size() == 8) {
+          return Detail::hash_integer(
+              Detail::load<uint64_t>(wyhash_.key()), seed_);
+        }
+        if (wyhash_.size() == 4) {
+          return Detail::hash_integer(
+              Detail::load<uint32_t>(wyhash_.key()), seed_);
+        }
+        break;
+      case HashScheme::kMurmur3DoubleHashing: return murmur3_.finalize();
+      case HashScheme::kSipHashDoubleHashing: return siphash_.finalize();
+    }
+    return Detail::wyhash_fold_128(wyhash_.state(), wyhash_.size());
+  }
+
+ private:
+  uint64_t seed_;
+  HashScheme scheme_;
+  Detail::Murmur3Stream murmur3_;
+  Detail::WyhashStream wyhash_;
+  Detail::SipHashStream siphash_;
+};
+
+/// A hash functor that hashes a key *once* into a 128-bit `Digest`.
+///
+/// Filters using a `DoubleHasher` derive all `k` probe positions from this one
+/// digest via double hashing, instead of running `k` independent hash
+/// functions over the key. For long keys this makes `put()` and `query()`
+/// roughly `k` times cheaper, while the false positive rate stays the same.
+///
+/// The hash function is selected by the `scheme`, murmur3 by default. Where
+/// the hash function is known at compile time, `WyHasher` or `IntegerHasher`
+/// avoid the (well predicted) branch on the scheme.
+struct DoubleHasher {
+  /// Constructs the `DoubleHasher` with the given seed and hash scheme.
+  constexpr explicit DoubleHasher(
+      uint64_t seed,
+      HashScheme scheme = HashScheme::kMurmur3DoubleHashing)
+  : seed(seed), scheme(scheme) {}
+
+  /// Constructs the `DoubleHasher` with a randomly chosen seed.
+  DoubleHasher() : DoubleHasher(Detail::random_seed()) {}
+
+  /// Constructs the `DoubleHasher` with the given hash scheme and a randomly
+  /// chosen seed, which is read from `std::random_device` (and thus secret)
+  /// for `HashScheme::kSipHashDoubleHashing`.
+  explicit DoubleHasher(HashScheme scheme)
+  : DoubleHasher(scheme == HashScheme::kSipHashDoubleHashing
+                     ? Detail::secret_seed()
+                     : Detail::random_seed(),
+                 scheme) {}
+
+  /// Hashes the `slice`. See `Detail::double_hash()`.
+  Digest operator()(Slice slice) const noexcept {
+    return Detail::double_hash(slice.data(), slice.size(), seed, scheme);
+  }
+
+  /// Hashes the `key`, to the same digest as the `Slice` of its characters.
+  constexpr Digest operator()(StaticKey key) const noexcept {
+    return Detail::double_hash(key.data(), key.size(), seed, scheme);
+  }
+
+  /// Returns a `DigestStream` computing the same digests as this hasher.
+  DigestStream stream() const noexcept { return {seed, scheme}; }
+
+  /// The seed used in this `DoubleHasher`.
+  uint64_t seed;
+
+  /// The hash function used in this `DoubleHasher`.
+  HashScheme scheme;
+};
+
+/// A hash functor producing a 64-bit hash of a key with wyhash, e.g. for use
+/// as one of `k` independent hash functions of a `Filter` or `StaticFilter`.
+/// Unlike the 32-bit `DefaultHasher`, its values cover filters of any size.
+struct WyHasher64 {
+  /// Constructs the `WyHasher64` with the given seed.
+  constexpr explicit WyHasher64(uint64_t seed) : seed(seed) {}
+
+  /// Constructs the `WyHasher64` with a randomly chosen seed.
+  WyHasher64() : WyHasher64(Detail::random_seed()) {}
+
+  /// Hashes the `slice`.
+  uint64_t operator()(Slice slice) const noexcept {
+    return Detail::wyhash(slice.data(), slice.size(), seed);
+  }
+
+  /// Hashes the `key`, to the same value as the `Slice` of its characters.
+  constexpr uint64_t operator()(StaticKey key) const noexcept {
+    return Detail::wyhash(key.data(), key.size(), seed);
+  }
+
+  /// The seed used in this `WyHasher64`.
+  uint64_t seed;
+};
+
+/// A `DoubleHasher` fixed to `HashScheme::kWyhashDoubleHashing` at compile
+/// time.
+struct WyHasher {
+  /// Constructs the `WyHasher` with the given seed.
+  constexpr explicit WyHasher(uint64_t seed) : seed(seed) {}
+
+  /// Constructs the `WyHasher` with a randomly chosen seed.
+  WyHasher() : WyHasher(Detail::random_seed()) {}
+
+  /// Hashes the `slice`.
+  Digest operator()(Slice slice) const noexcept {
+    return Detail::wyhash_128(slice.data(), slice.size(), seed);
+  }
+
+  /// Hashes the `key`, to the same digest as the `Slice` of its characters.
+  constexpr Digest operator()(StaticKey key) const noexcept {
+    return Detail::wyhash_128(key.data(), key.size(), seed);
+  }
+
+  /// Returns a `DigestStream` computing the same digests as this hasher.
+  DigestStream stream() const noexcept {
+    return {seed, HashScheme::kWyhashDoubleHashing};
+  }
+
+  /// The seed used in this `WyHasher`.
+  uint64_t seed;
+};
+
+/// A `DoubleHasher` fixed to `HashScheme::kIntegerDoubleHashing` at compile
+/// time, for keys that are (mostly) 4- or 8-byte integers.
+struct IntegerHasher {
+  /// Constructs the `IntegerHasher` with the given seed.
+  constexpr explicit IntegerHasher(uint64_t seed) : seed(seed) {}
+
+  /// Constructs the `IntegerHasher` with a randomly chosen seed.
+  IntegerHasher() : IntegerHasher(Detail::random_seed()) {}
+
+  /// Hashes the `slice`.
+  Digest operator()(Slice slice) const noexcept {
+    return Detail::hash_integer_key(slice.data(), slice.size(), seed);
+  }
+
+  /// Hashes the `key`, to the same digest as the `Slice` of its characters.
+  constexpr Digest operator()(StaticKey key) const noexcept {
+    return Detail::hash_integer_key(key.data(), key.size(), seed);
+  }
+
+  /// Returns a `DigestStream` computing the same digests as this hasher.
+  DigestStream stream() const noexcept {
+    return {seed, HashScheme::kIntegerDoubleHashing};
+  }
+
+  /// The seed used in this `IntegerHasher`.
+  uint64_t seed;
+};
+
+/// A `DoubleHasher` fixed to `HashScheme::kSipHashDoubleHashing` at compile
+/// time, for keys chosen by an adversary.
+struct SipHasher {
+  /// Constructs the `SipHasher` with the given seed, which must be kept
+  /// secret.
+  constexpr explicit SipHasher(uint64_t seed) : seed(seed) {}
+
+  /// Constructs the `SipHasher` with a secret seed read from
+  /// `std::random_device`.
+  SipHasher() : SipHasher(Detail::secret_seed()) {}
+
+  /// Hashes the `slice`.
+  Digest operator()(Slice slice) const noexcept {
+    return Detail::siphash_128(
+        slice.data(), slice.size(), seed, Detail::siphash_k1(seed));
+  }
+
+  /// Hashes the `key`, to the same digest as the `Slice` of its characters.
+  constexpr Digest operator()(StaticKey key) const noexcept {
+    return Detail::siphash_128(
+        key.data(), key.size(), seed, Detail::siphash_k1(seed));
+  }
+
+  /// Returns a `DigestStream` computing the same digests as this hasher.
+  DigestStream stream() const noexcept {
+    return {seed, HashScheme::kSipHashDoubleHashing};
+  }
+
+  /// The seed used in this `SipHasher`.
+  uint64_t seed;
+};
+
+namespace Detail {
+
+/// Returns a `Hasher` with the given `seed`, or a default-constructed (and
+/// thus randomly seeded) one if there is none.
+template <typename Hasher>
+Hasher seeded_hasher(Seed seed) {
+  return seed.has_value() ? Hasher(seed.value()) : Hasher();
+}
+
+/// Determines whether a `Hasher` produces a `Digest` (and is thus used to
+/// derive all probe positions of a key via double hashing), or a single hash
+/// value (and is thus one of `k` independent hash functions).
+template <typename Hasher>
+struct IsDigestHasher
+    : std::is_same<
+          typename std::decay<decltype(
+              std::declval<const Hasher&>()(std::declval<Slice>()))>::type,
+          Digest> {};
+
+/// Determines whether a `Hasher` can hash a key in parts, via `stream()`.
+template <typename Hasher, typename = void>
+struct HasStream : std::false_type {};
+
+template <typename Hasher>
+struct HasStream<Hasher,
+                 decltype(void(std::declval<const Hasher&>().stream()))>
+    : std::true_type {};
+
+/// The parts of a key copied into one buffer, for hash functions that cannot
+/// hash a key in parts. Keys of up to `kInlineSize` bytes are not allocated.
+class Concatenation {
+ public:
+  static constexpr size_t kInlineSize = 256;
+
+  explicit Concatenation(SliceList parts) : size_(parts.size()) {
+    if (size_ > kInlineSize) heap_.resize(size_);
+    uint8_t* data = heap_.empty() ? inline_ : heap_.data();
+    for (const Slice& part : parts) {
+      if (part.size() > 0) std::memcpy(data, part.data(), part.size());
+      data += part.size();
+    }
+  }
+
+  Concatenation(const Concatenation&) = delete;
+  Concatenation& operator=(const Concatenation&) = delete;
+
+  Slice slice() const noexcept {
+    return {heap_.empty() ? inline_ : heap_.data(), size_};
+  }
+
+ private:
+  uint8_t inline_[kInlineSize];
+  std::vector<uint8_t> heap_;
+  size_t size_;
+};
+
+/// Calls `function` with the `Slice` of `key`.
+template <typename Function>
+auto with_contiguous(Slice key, Function&& function)
+    -> decltype(function(key)) {
+  return function(key);
+}
+
+/// Calls `function` with the `Slice` of the concatenated parts of `key`.
+template <typename Function>
+auto with_contiguous(SliceList key, Function&& function)
+    -> decltype(function(std::declval<Slice>())) {
+  const Concatenation concatenation(key);
+  return function(concatenation.slice());
+}
+
+/// Hashes `key` with `hasher`.
+template <typename Hasher>
+auto hash_key(const Hasher& hasher, Slice key) -> decltype(hasher(key)) {
+  return hasher(key);
+}
+
+template <typename Hasher>
+auto hash_parts(const Hasher& hasher, SliceList key, std::true_type) noexcept {
+  auto stream = hasher.stream();
+  for (const Slice& part : key) stream.update(part);
+  return stream.finalize();
+}
+
+template <typename Hasher>
+auto hash_parts(const Hasher& hasher, SliceList key, std::false_type) {
+  return with_contiguous(key, hasher);
+}
+
+/// Hashes the concatenation of the parts of `key` with `hasher`, streaming the
+/// parts through `hasher.stream()` if it has one.
+template <typename Hasher>
+auto hash_key(const Hasher& hasher, SliceList key)
+    -> decltype(hasher(std::declval<Slice>())) {
+  return hash_parts(hasher, key, HasStream<Hasher>());
+}
+
+/// Hashes each of the `count` `keys` with `hasher`, storing the digest of
+/// `keys[i]` in `digests[i]`.
+template <typename Hasher, typename Key>
+void hash_keys(const Hasher& hasher,
+               const Key* keys,
+               size_t count,
+               Digest* digests) {
+  for (size_t i = 0; i < count; ++i) digests[i] = hasher(Slice(keys[i]));
+}
+
+/// `true` if `Key` is an integer of 4 or 8 bytes, which `IntegerHasher`
+/// hashes with `hash_integer()`.
+template <typename Key>
+using IsFixedWidthInteger =
+    std::integral_constant<bool,
+                           std::is_integral<Key>::value &&
+                               (sizeof(Key) == 4 || sizeof(Key) == 8)>;
+
+/// The unsigned integer of the same width as the fixed-width integer `Key`.
+template <typename Key>
+using FixedWidthInteger =
+    std::conditional_t<sizeof(Key) == 8, uint64_t, uint32_t>;
+
+/// Hashes fixed-width integer keys several at a time (see
+/// `hash_integers()`).
+template <typename Key>
+std::enable_if_t<IsFixedWidthInteger<Key>::value> hash_keys(
+    const IntegerHasher& hasher,
+    const Key* keys,
+    size_t count,
+    Digest* digests) noexcept {
+  hash_integers<FixedWidthInteger<Key>>(keys, count, hasher.seed, digests);
+}
+
+/// Hashes fixed-width integer keys several at a time if `hasher` uses
+/// `HashScheme::kIntegerDoubleHashing`, and one at a time otherwise.
+template <typename Key>
+std::enable_if_t<IsFixedWidthInteger<Key>::value> hash_keys(
+    const DoubleHasher& hasher,
+    const Key* keys,
+    size_t count,
+    Digest* digests) noexcept {
+  if (hasher.scheme == HashScheme::kIntegerDoubleHashing) {
+    hash_integers<FixedWidthInteger<Key>>(keys, count, hasher.seed, digests);
+    return;
+  }
+  for (size_t i = 0; i < count; ++i) digests[i] = hasher(Slice(keys[i]));
+}
+}  // namespace Detail
 }  // namespace Bloom
@@ -0,0 +1,277 @@
+#pragma once
+
+#include <bloom/aligned-allocator.hpp>
+#include <bloom/bit-array.hpp>
+#include <bloom/cpu.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Bloom {
+
+/// The number of buckets of a `LatencyHistogram`.
+constexpr size_t kLatencyBucketCount = 32;
+
+/// A histogram of sampled latencies in ticks: cycles of the time stamp counter
+/// on x86, nanoseconds elsewhere. Bucket `i` counts the samples that took
+/// `[2^i, 2^(i + 1))` ticks; bucket zero also counts those that took no tick
+/// and the last bucket all that took longer.
+struct LatencyHistogram {
+  std::array<uint64_t, kLatencyBucketCount> buckets{};
+
+  /// Returns the number of samples.
+  uint64_t count() const noexcept {
+    uint64_t total = 0;
+    for (const uint64_t bucket : buckets) total += bucket;
+    return total;
+  }
+
+  /// Returns an upper bound of the `quantile` (in `[0, 1]`) of the latencies,
+  /// i.e. the end of the bucket holding it, or zero if there are no samples.
+  uint64_t quantile(double quantile) const noexcept {
+    const uint64_t total = count();
+    if (total == 0) return 0;
+    const auto rank = std::max<uint64_t>(
+        static_cast<uint64_t>(std::ceil(quantile * static_cast<double>(total))),
+        1);
+    uint64_t seen = 0;
+    size_t bucket = 0;
+    while (bucket + 1 < kLatencyBucketCount &&
+           (seen += buckets[bucket]) < rank) {
+      ++bucket;
+    }
+    return uint64_t{2} << bucket;
+  }
+};
+
+/// The counters of an instrumentation policy at one point in time.
+struct InstrumentationSnapshot {
+  uint64_t puts = 0;
+  uint64_t queries = 0;
+  /// The number of queries that returned `true`.
+  uint64_t positives = 0;
+  /// The sampled latencies of `put()`.
+  LatencyHistogram put_latency;
+  /// The sampled latencies of `query()`.
+  LatencyHistogram query_latency;
+};
+
+/// The counters of a filter together with gauges derived from its bits, see
+/// `BasicFilter::statistics()`.
+struct FilterStatistics {
+  /// The counters of the instrumentation policy (all zero for
+  /// `NoInstrumentation`).
+  InstrumentationSnapshot counters;
+  /// The proportion of bits that are set.
+  double fill_ratio = 0;
+  /// The probability that a query for a key that was not inserted returns
+  /// `true`, given the bits that are set.
+  double estimated_false_positive_rate = 0;
+  /// The estimated number of distinct keys inserted.
+  double estimated_cardinality = 0;
+};
+
+/// The instrumentation policy of a `BasicFilter` that counts nothing. All of
+/// its hooks are empty, so a filter using it compiles to exactly the same code
+/// as one without hooks.
+struct NoInstrumentation {
+  /// The state of an operation between its begin and end hooks.
+  struct Sample {};
+
+  Sample begin_put() const noexcept { return {}; }
+  void end_put(Sample /*unused*/) const noexcept {}
+  Sample begin_query() const noexcept { return {}; }
+  void end_query(Sample /*unused*/, bool /*unused*/) const noexcept {}
+  void count_puts(size_t /*unused*/) const noexcept {}
+  template <typename Result>
+  void count_queries(const Result* /*unused*/,
+                     size_t /*unused*/) const noexcept {}
+  InstrumentationSnapshot snapshot() const noexcept { return {}; }
+};
+
+namespace Detail {
+
+/// Returns a small number identifying the calling thread, assigned in the
+/// order in which threads first call it.
+inline size_t thread_index() noexcept {
+  static std::atomic<size_t> next{0};
+  // Constant initialized (unlike one initialized with the next index), so
+  // reading it needs no check whether it was initialized yet.
+  thread_local size_t index = 0;
+  if (index == 0) index = next.fetch_add(1, std::memory_order_relaxed) + 1;
+  return index - 1;
+}
+
+/// Returns the current time in ticks (see `LatencyHistogram`).
+inline uint64_t ticks() noexcept {
+#if defined(BLOOM_HAS_X86_KERNELS)
+  return __rdtsc();
+#else
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+#endif
+}
+
+/// Returns the number of `true` results among `count` results stored as
+/// `bool`s.
+inline size_t count_positives(const bool* results, size_t count) noexcept {
+  return static_cast<size_t>(std::count(results, results + count, true));
+}
+
+/// Returns the number of `true` results among `count` results stored as a
+/// bitmap.
+inline size_t count_positives(const uint64_t* bitmap, size_t count) noexcept {
+  size_t total = popcount(bitmap, count / 64);
+  if (count % 64 != 0) {
+    total += popcount(bitmap[count / 64] & ((uint64_t{1} << (count % 64)) - 1));
+  }
+  return total;
+}
+}  // namespace Detail
+
+/// The instrumentation policy of a `BasicFilter` that counts puts, queries and
+/// positive queries, and samples the latency of one in `SampleInterval` puts
+/// and queries of each thread into a `LatencyHistogram`.
+///
+/// Each thread counts into one of `kShardCount` shards, picked once per thread,
+/// that starts a cache line of its own, so that threads counting at the same
+/// time rarely take cache lines away from one another. Threads are numbered
+/// in the order they start counting and never renumbered, so any two threads
+/// may share a shard; counters are therefore bumped with a relaxed atomic
+/// read-modify-write, which is exact, and cheap while its cache line stays
+/// with one thread. Batch operations count their keys, but are not sampled.
+template <uint64_t SampleInterval = 64>
+class Instrumentation {
+ public:
+  static_assert(SampleInterval > 0 &&
+                    (SampleInterval & (SampleInterval - 1)) == 0,
+                "the sample interval must be a power of two");
+
+  /// The number of shards threads count into.
+  static constexpr size_t kShardCount = 32;
+
+  /// The state of an operation between its begin and end hooks.
+  struct Sample {
+    size_t shard;
+    /// The ticks at the start of the operation, or zero if it is not sampled.
+    uint64_t start;
+  };
+
+  Instrumentation() : shards_(kShardCount) {}
+
+  Sample begin_put() const noexcept { return begin(&Shard::puts); }
+
+  void end_put(Sample sample) const noexcept {
+    if (sample.start != 0) {
+      record(shards_[sample.shard].put_latency, sample.start);
+    }
+  }
+
+  Sample begin_query() const noexcept { return begin(&Shard::queries); }
+
+  void end_query(Sample sample, bool positive) const noexcept {
+    Shard& shard = shards_[sample.shard];
+    if (positive) add(shard.positives, 1);
+    if (sample.start != 0) record(shard.query_latency, sample.start);
+  }
+
+  /// Counts `count` puts of a batch.
+  void count_puts(size_t count) const noexcept {
+    add(own_shard().puts, count);
+  }
+
+  /// Counts the `count` queries of a batch, given their results.
+  template <typename Result>
+  void count_queries(const Result* results, size_t count) const noexcept {
+    Shard& shard = own_shard();
+    add(shard.queries, count);
+    add(shard.positives, Detail::count_positives(results, count));
+  }
+
+  /// Returns the sums of the counters of all shards. Operations counted
+  /// concurrently may or may not be included.
+  InstrumentationSnapshot snapshot() const noexcept {
+    InstrumentationSnapshot snapshot;
+    for (const Shard& shard : shards_) {
+      snapshot.puts += load(shard.puts);
+      snapshot.queries += load(shard.queries);
+      snapshot.positives += load(shard.positives);
+      for (size_t i = 0; i < kLatencyBucketCount; ++i) {
+        snapshot.put_latency.buckets[i] += load(shard.put_latency[i]);
+        snapshot.query_latency.buckets[i] += load(shard.query_latency[i]);
+      }
+    }
+    return snapshot;
+  }
+
+ private:
+  using Counter = std::atomic<uint64_t>;
+
+  struct alignas(kCacheLineSize) Shard {
+    Shard() = default;
+
+    Shard(const Shard& other) noexcept { *this = other; }
+
+    Shard& operator=(const Shard& other) noexcept {
+      puts.store(load(other.puts), std::memory_order_relaxed);
+      queries.store(load(other.queries), std::memory_order_relaxed);
+      positives.store(load(other.positives), std::memory_order_relaxed);
+      for (size_t i = 0; i < kLatencyBucketCount; ++i) {
+        put_latency[i].store(load(other.put_latency[i]),
+                             std::memory_order_relaxed);
+        query_latency[i].store(load(other.query_latency[i]),
+                               std::memory_order_relaxed);
+      }
+      return *this;
+    }
+
+    Counter puts{0};
+    Counter queries{0};
+    Counter positives{0};
+    std::array<Counter, kLatencyBucketCount> put_latency{};
+    std::array<Counter, kLatencyBucketCount> query_latency{};
+  };
+
+  static uint64_t load(const Counter& counter) noexcept {
+    return counter.load(std::memory_order_relaxed);
+  }
+
+  /// Adds `amount` to `counter`, and returns its previous value.
+  static uint64_t add(Counter& counter, uint64_t amount) noexcept {
+    return counter.fetch_add(amount, std::memory_order_relaxed);
+  }
+
+  Shard& own_shard() const noexcept {
+    return shards_[Detail::thread_index() % kShardCount];
+  }
+
+  /// Counts an operation in `counter` of the calling thread's shard, and
+  /// samples every `SampleInterval`-th one.
+  Sample begin(Counter Shard::*counter) const noexcept {
+    const size_t shard = Detail::thread_index() % kShardCount;
+    const uint64_t count = add(shards_[shard].*counter, 1);
+    return {shard, count % SampleInterval == 0 ? Detail::ticks() : 0};
+  }
+
+  static void record(std::array<Counter, kLatencyBucketCount>& histogram,
+                     uint64_t start) noexcept {
+    const uint64_t elapsed = Detail::ticks() - start;
+    size_t bucket = 0;
+    while (bucket + 1 < kLatencyBucketCount && (elapsed >> (bucket + 1)) != 0) {
+      ++bucket;
+    }
+    add(histogram[bucket], 1);
+  }
+
+  /// Written through `const` hooks, as queries are counted too.
+  mutable std::vector<Shard, AlignedAllocator<Shard>> shards_;
+};
+}  // namespace Bloom
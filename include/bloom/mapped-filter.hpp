@@ -0,0 +1,359 @@
+#pragma once
+
+#include <bloom/aligned-allocator.hpp>
+#include <bloom/binary-fuse-filter.hpp>
+#include <bloom/cpu.hpp>
+#include <bloom/format.hpp>
+#include <bloom/hash.hpp>
+#include <bloom/reduce.hpp>
+#include <bloom/slice.hpp>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define BLOOM_HAS_MMAP 1
+#endif
+
+namespace Bloom {
+namespace Detail {
+
+/// The bytes of a file, mapped into memory where the library can query them
+/// in place (on little-endian POSIX platforms) and read into a cache line
+/// aligned buffer otherwise.
+class MappedFile {
+ public:
+  MappedFile() = default;
+
+  /// Maps the file at `path` if `map` is `true` and the platform supports it,
+  /// and reads it otherwise.
+  ///
+  /// \throws std::system_error if the file cannot be opened or mapped.
+  MappedFile(const std::string& path, bool map) {
+#if defined(BLOOM_HAS_MMAP)
+    if (map) {
+      this->map(path);
+      return;
+    }
+#else
+    (void)map;
+#endif
+    read(path);
+  }
+
+  MappedFile(MappedFile&& other) noexcept { swap(other); }
+
+  MappedFile& operator=(MappedFile other) noexcept {
+    swap(other);
+    return *this;
+  }
+
+  MappedFile(const MappedFile&) = delete;
+
+  ~MappedFile() { release(); }
+
+  /// Returns the bytes of the file.
+  const uint8_t* data() const noexcept { return data_; }
+
+  /// Returns the bytes of the file if they were read into a buffer, which may
+  /// then be modified, or `nullptr` if they are mapped.
+  uint8_t* buffer() noexcept { return is_mapped() ? nullptr : data_; }
+
+  /// Returns the size of the file in bytes.
+  size_t size() const noexcept { return size_; }
+
+  /// Returns `true` if the file is mapped rather than read.
+  bool is_mapped() const noexcept { return mapped_; }
+
+  void swap(MappedFile& other) noexcept {
+    std::swap(data_, other.data_);
+    std::swap(size_, other.size_);
+    std::swap(mapped_, other.mapped_);
+  }
+
+ private:
+#if defined(BLOOM_HAS_MMAP)
+  void map(const std::string& path) {
+    const int file = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (file < 0) {
+      throw std::system_error(errno, std::generic_category(), path);
+    }
+    struct stat status;
+    if (::fstat(file, &status) != 0) {
+      const int error = errno;
+      ::close(file);
+      throw std::system_error(error, std::generic_category(), path);
+    }
+    const auto file_size = static_cast<size_t>(status.st_size);
+    if (file_size == 0) {
+      ::close(file);
+      return;
+    }
+    void* memory =
+        ::mmap(nullptr, file_size, PROT_READ, MAP_SHARED, file, 0);
+    const int error = errno;
+    ::close(file);
+    if (memory == MAP_FAILED) {
+      throw std::system_error(error, std::generic_category(), path);
+    }
+#if defined(MADV_RANDOM)
+    // Queries touch pages at random; reading ahead would only evict others.
+    ::madvise(memory, file_size, MADV_RANDOM);
+#endif
+    data_ = static_cast<uint8_t*>(memory);
+    size_ = file_size;
+    mapped_ = true;
+  }
+#endif
+
+  void read(const std::string& path) {
+    std::ifstream stream(path, std::ios::binary | std::ios::ate);
+    if (!stream) throw std::runtime_error("could not open " + path);
+    const auto end = stream.tellg();
+    if (end < 0) throw std::runtime_error("could not read " + path);
+    const auto file_size = static_cast<size_t>(end);
+    stream.seekg(0);
+    data_ = Allocator().allocate(file_size);
+    size_ = file_size;
+    if (!stream.read(reinterpret_cast<char*>(data_), file_size)) {
+      // The destructor does not run when the constructor throws.
+      release();
+      throw std::runtime_error("could not read " + path);
+    }
+  }
+
+  void release() noexcept {
+    if (data_ == nullptr) return;
+#if defined(BLOOM_HAS_MMAP)
+    if (mapped_) {
+      ::munmap(data_, size_);
+      return;
+    }
+#endif
+    Allocator().deallocate(data_, size_);
+  }
+
+  using Allocator = AlignedAllocator<uint8_t>;
+
+  uint8_t* data_ = nullptr;
+  size_t size_ = 0;
+  bool mapped_ = false;
+};
+}  // namespace Detail
+
+/// A read-only bloom filter queried directly from a file written by
+/// `Filter::save()`.
+///
+/// `open()` maps the file into memory instead of reading it, so opening takes
+/// the same (short) time regardless of the size of the filter, pages are only
+/// read from disk once they are queried, and all processes that open the same
+/// file share its pages in the page cache. On big-endian or non-POSIX
+/// platforms, the file is read into memory instead.
+///
+/// Only the header is validated on `open()`; checking the bits against their
+/// checksum means reading all of them, which `verify()` does on request.
+class MappedFilter {
+ public:
+  /// Opens the filter saved in the file at `path`.
+  ///
+  /// \throws std::system_error if the file cannot be opened or mapped.
+  /// \throws std::runtime_error if the file is not a bloom filter in a
+  /// supported format or is truncated.
+  static MappedFilter open(const std::string& path) {
+    MappedFilter filter;
+    filter.file_ = Detail::MappedFile(path, Detail::kLittleEndian);
+    if (filter.file_.size() < Detail::kHeaderSize) {
+      throw std::runtime_error("not a serialized bloom filter");
+    }
+    filter.adopt(Detail::decode_header(filter.file_.data()));
+    if (!Detail::kLittleEndian) {
+      auto* words = reinterpret_cast<uint64_t*>(filter.file_.buffer() +
+                                                Detail::kHeaderSize);
+      for (size_t i = 0; i < filter.word_count(); ++i) {
+        words[i] = Detail::byte_swap(words[i]);
+      }
+    }
+    return filter;
+  }
+
+  MappedFilter(MappedFilter&& other) noexcept { swap(other); }
+
+  MappedFilter& operator=(MappedFilter other) noexcept {
+    swap(other);
+    return *this;
+  }
+
+  MappedFilter(const MappedFilter&) = delete;
+
+  /// Returns `true` if the given `key` has possibly been inserted in the
+  /// bloom filter that was saved. Equivalent to `Filter::query()`.
+  ///
+  /// \complexity O(k)
+  bool query(Slice key) const {
+    Detail::ProbeSequence probes(hasher_(key));
+    for (size_t i = 0; i < hash_count_; ++i) {
+      const size_t index = reduce_(probes.next());
+      if (((words_[index / 64] >> (index % 64)) & 1u) == 0) return false;
+    }
+    return true;
+  }
+
+  /// Returns `true` if the bits match the checksum in the header.
+  /// \complexity O(N)
+  bool verify() const noexcept {
+    return Detail::payload_checksum(words_, word_count()) == payload_checksum_;
+  }
+
+  /// Returns the size (`N`; number of bits) of the bloom filter.
+  size_t size() const noexcept { return reduce_.range(); }
+
+  /// Returns the number of hash functions (`k`) used in `query()`.
+  size_t hash_count() const noexcept { return hash_count_; }
+
+  /// Returns the hasher the bloom filter was built with.
+  const DoubleHasher& hasher() const noexcept { return hasher_; }
+
+  /// Returns the words of the bits. Bit `i` is bit `i % 64` of word `i / 64`.
+  const uint64_t* words() const noexcept { return words_; }
+
+  /// Returns the number of words, `ceil(N / 64)`.
+  size_t word_count() const noexcept { return (size() + 63) / 64; }
+
+  /// Returns `true` if the bits are mapped from the file rather than copied.
+  bool is_mapped() const noexcept { return file_.is_mapped(); }
+
+  void swap(MappedFilter& other) noexcept {
+    std::swap(hasher_, other.hasher_);
+    std::swap(hash_count_, other.hash_count_);
+    std::swap(reduce_, other.reduce_);
+    std::swap(payload_checksum_, other.payload_checksum_);
+    std::swap(words_, other.words_);
+    file_.swap(other.file_);
+  }
+
+ private:
+  MappedFilter() = default;
+
+  /// Takes the fields of the `header` and checks that the file holds all the
+  /// words it describes.
+  void adopt(const Detail::FileHeader& header) {
+    if (file_.size() - Detail::kHeaderSize < header.word_count() * 8) {
+      throw std::runtime_error("the bloom filter is truncated");
+    }
+    hasher_ = DoubleHasher(header.seed, header.scheme);
+    hash_count_ = header.hash_count;
+    reduce_ = RangeReducer(header.size);
+    payload_checksum_ = header.payload_checksum;
+    words_ =
+        reinterpret_cast<const uint64_t*>(file_.data() + Detail::kHeaderSize);
+  }
+
+  DoubleHasher hasher_{0};
+  size_t hash_count_ = 0;
+  RangeReducer reduce_{0};
+  uint64_t payload_checksum_ = 0;
+  const uint64_t* words_ = nullptr;
+  Detail::MappedFile file_;
+};
+
+/// A read-only `BinaryFuseFilter` queried directly from a file written by
+/// `BinaryFuseFilter::save()`, mapped into memory like a `MappedFilter`.
+template <typename Fingerprint = uint8_t>
+class MappedBinaryFuseFilter {
+ public:
+  /// Opens the filter saved in the file at `path`.
+  ///
+  /// \throws std::system_error if the file cannot be opened or mapped.
+  /// \throws std::runtime_error if the file is not a binary fuse filter with
+  /// fingerprints of this size, or is truncated.
+  static MappedBinaryFuseFilter open(const std::string& path) {
+    MappedBinaryFuseFilter filter;
+    filter.file_ = Detail::MappedFile(path, Detail::kLittleEndian);
+    if (filter.file_.size() < Detail::kHeaderSize) {
+      throw std::runtime_error("not a serialized binary fuse filter");
+    }
+    const auto header = Detail::decode_fuse_header(filter.file_.data(),
+                                                   sizeof(Fingerprint) * 8);
+    if (filter.file_.size() - Detail::kHeaderSize < header.payload_size()) {
+      throw std::runtime_error("the binary fuse filter is truncated");
+    }
+    filter.layout_.segment_length = header.segment_length;
+    filter.layout_.segment_count_length = header.segment_count_length;
+    filter.key_count_ = header.key_count;
+    filter.seed_ = header.seed;
+    filter.payload_checksum_ = header.payload_checksum;
+    filter.fingerprints_ = reinterpret_cast<const Fingerprint*>(
+        filter.file_.data() + Detail::kHeaderSize);
+    if (!Detail::kLittleEndian) {
+      auto* fingerprints = reinterpret_cast<Fingerprint*>(
+          filter.file_.buffer() + Detail::kHeaderSize);
+      for (size_t i = 0; i < filter.fingerprint_count(); ++i) {
+        fingerprints[i] = Detail::byte_swap(fingerprints[i]);
+      }
+    }
+    return filter;
+  }
+
+  /// Returns `true` if the given `key` was possibly among the keys the filter
+  /// that was saved was built from. Equivalent to `BinaryFuseFilter::query()`.
+  ///
+  /// \complexity O(1)
+  bool query(Slice key) const noexcept {
+    const uint64_t hash = Detail::wyhash(key.data(), key.size(), seed_);
+    return Detail::fuse_contains(
+        fingerprints_,
+        layout_.positions(hash),
+        Detail::fuse_fingerprint<Fingerprint>(hash));
+  }
+
+  /// Returns `true` if the fingerprints match the checksum in the header.
+  /// \complexity O(N)
+  bool verify() const noexcept {
+    return Detail::payload_checksum(fingerprints_, fingerprint_count()) ==
+           payload_checksum_;
+  }
+
+  /// Returns the size (number of bits) of the fingerprints.
+  size_t size() const noexcept {
+    return fingerprint_count() * sizeof(Fingerprint) * 8;
+  }
+
+  /// Returns the number of distinct keys the filter was built from.
+  size_t key_count() const noexcept { return key_count_; }
+
+  /// Returns the seed the keys are hashed with.
+  uint64_t seed() const noexcept { return seed_; }
+
+  /// Returns the fingerprints.
+  const Fingerprint* fingerprints() const noexcept { return fingerprints_; }
+
+  /// Returns the number of fingerprints.
+  size_t fingerprint_count() const noexcept {
+    return layout_.fingerprint_count();
+  }
+
+  /// Returns `true` if the fingerprints are mapped from the file rather than
+  /// copied.
+  bool is_mapped() const noexcept { return file_.is_mapped(); }
+
+ private:
+  MappedBinaryFuseFilter() = default;
+
+  Detail::FuseLayout layout_;
+  size_t key_count_ = 0;
+  uint64_t seed_ = 0;
+  uint64_t payload_checksum_ = 0;
+  const Fingerprint* fingerprints_ = nullptr;
+  Detail::MappedFile file_;
+};
+}  // namespace Bloom
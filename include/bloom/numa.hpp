@@ -0,0 +1,159 @@
+#pragma once
+
+#include <bloom/parallel.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace Bloom {
+namespace Detail {
+
+/// Parses a Linux CPU or node list, e.g. "0-3,8,10-11", into the ids it
+/// contains, in ascending order. Returns an empty list for malformed input.
+inline std::vector<size_t> parse_id_list(const std::string& list) {
+  std::vector<size_t> ids;
+  size_t position = 0;
+  while (position < list.size()) {
+    size_t end = 0;
+    size_t first = 0;
+    size_t last = 0;
+    try {
+      first = std::stoul(list.substr(position), &end);
+    } catch (const std::exception&) {
+      return {};
+    }
+    position += end;
+    last = first;
+    if (position < list.size() && list[position] == '-') {
+      try {
+        last = std::stoul(list.substr(position + 1), &end);
+      } catch (const std::exception&) {
+        return {};
+      }
+      position += end + 1;
+    }
+    for (size_t id = first; id <= last; ++id) ids.push_back(id);
+    // Skip the separating comma (or trailing newline).
+    ++position;
+  }
+  std::sort(ids.begin(), ids.end());
+  return ids;
+}
+
+/// Reads the id list in the sysfs file at `path`, or returns an empty list if
+/// there is no such file.
+inline std::vector<size_t> read_id_list(const std::string& path) {
+  std::ifstream file(path);
+  std::string list;
+  if (!std::getline(file, list)) return {};
+  return parse_id_list(list);
+}
+}  // namespace Detail
+
+/// Returns the number of NUMA nodes of the machine (one more than the highest
+/// node id), or one if that is not known. Determined once.
+inline size_t numa_node_count() {
+  static const size_t count = [] {
+    const auto nodes =
+        Detail::read_id_list("/sys/devices/system/node/online");
+    return nodes.empty() ? size_t{1} : nodes.back() + 1;
+  }();
+  return count;
+}
+
+/// Returns the NUMA node of the CPU the calling thread is running on, or zero
+/// if that is not known.
+inline size_t current_numa_node() noexcept {
+#if defined(__linux__) && defined(SYS_getcpu)
+  unsigned cpu = 0;
+  unsigned node = 0;
+  if (syscall(SYS_getcpu, &cpu, &node, nullptr) == 0) return node;
+#endif
+  return 0;
+}
+
+/// Restricts the calling thread to the CPUs of NUMA node `node`, so that the
+/// memory it touches first is allocated on that node. Returns `false` (and
+/// changes nothing) if that is not possible, e.g. on platforms other than
+/// Linux.
+inline bool pin_thread_to_numa_node(size_t node) {
+#if defined(__linux__)
+  const auto cpus = Detail::read_id_list("/sys/devices/system/node/node" +
+                                         std::to_string(node) + "/cpulist");
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  size_t usable = 0;
+  for (const size_t cpu : cpus) {
+    if (cpu >= CPU_SETSIZE) break;
+    CPU_SET(cpu, &set);
+    ++usable;
+  }
+  return usable > 0 &&
+         pthread_setaffinity_np(pthread_self(), sizeof set, &set) == 0;
+#else
+  (void)node;
+  return false;
+#endif
+}
+
+namespace Detail {
+
+/// Calls `function(node, pinned)` for each NUMA node in `0..node_count` on a
+/// new thread pinned to that node as far as possible, where `pinned` tells
+/// whether pinning succeeded, and returns once all calls have returned. With
+/// a single node, `function(0, true)` is called on the calling thread instead,
+/// whose affinity is left alone.
+///
+/// \throws the first exception thrown by any call, or by `spawn` if a thread
+/// cannot be started, once the threads already started have been joined.
+template <typename Function, typename Spawner = ThreadSpawner>
+void run_on_numa_nodes(size_t node_count,
+                       Function function,
+                       Spawner spawn = Spawner()) {
+  if (node_count == 1) {
+    function(size_t{0}, true);
+    return;
+  }
+  std::vector<std::exception_ptr> errors(node_count);
+  std::vector<std::thread> threads;
+  threads.reserve(node_count);
+  try {
+    for (size_t node = 0; node < node_count; ++node) {
+      threads.push_back(spawn(
+          [&function, &errors](size_t node) {
+            try {
+              const bool pinned = pin_thread_to_numa_node(node);
+              function(node, pinned);
+            } catch (...) {
+              errors[node] = std::current_exception();
+            }
+          },
+          node));
+    }
+  } catch (...) {
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    throw;
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  for (const auto& error : errors) {
+    if (error) std::rethrow_exception(error);
+  }
+}
+}  // namespace Detail
+}  // namespace Bloom
@@ -1,13 +1,108 @@
 #pragma once
 
+#include <bloom/bit-array.hpp>
+#include <bloom/hash.hpp>
+
+#include <algorithm>
 #include <cmath>
 #include <cstddef>
 #include <cstdint>
+#include <limits>
 #include <stdexcept>
 
 namespace Bloom {
+namespace Detail {
+
+/// Returns the expected false positive rate of a (standard) bloom filter with
+/// `size` bits and `hash_count` hash functions after `count` insertions.
+inline double false_positive_rate(double size, double hash_count, double count) {
+  return std::pow(1 - std::pow(1 - 1 / size, hash_count * count), hash_count);
+}
+
+/// Returns the number of distinct keys that were most likely inserted into a
+/// (standard) bloom filter with `size` bits and `hash_count` hash functions,
+/// given that `set_bits` of its bits are one. Infinite if all bits are set.
+///
+/// See Swamidass and Baldi, "Mathematical correction for fingerprint
+/// similarity measures to improve chemical retrieval".
+inline double estimated_count(double size, double hash_count, double set_bits) {
+  if (set_bits >= size) return std::numeric_limits<double>::infinity();
+  return -size / hash_count * std::log1p(-set_bits / size);
+}
 
-/// A configuration struct for `Filter`.
+/// Returns the average of `rate(keys)` over a Poisson distributed number of
+/// `keys` with the given `mean`.
+template <typename Function>
+double poisson_average(double mean, Function rate) {
+  const double stop = mean + 10 * std::sqrt(mean) + 10;
+  double average = 0;
+  for (double keys = 0; keys <= stop; ++keys) {
+    const double log_probability =
+        -mean + keys * std::log(mean) - std::lgamma(keys + 1);
+    average += std::exp(log_probability) * rate(keys);
+  }
+  return average;
+}
+
+/// Returns the expected false positive rate of a blocked bloom filter with
+/// `size` bits split into blocks of `block_size` bits and `hash_count` hash
+/// functions after `count` insertions.
+///
+/// The number of keys hashed to any one block is (approximately) Poisson
+/// distributed, and the overall rate is the average of the rates of standard
+/// `block_size` bloom filters weighted by that distribution. See Putze et al.,
+/// "Cache-, Hash- and Space-Efficient Bloom Filters".
+inline double blocked_false_positive_rate(double size,
+                                          double hash_count,
+                                          double count,
+                                          double block_size) {
+  if (count <= 0) return 0;
+  return poisson_average(block_size * count / size, [=](double keys) {
+    return false_positive_rate(block_size, hash_count, keys);
+  });
+}
+
+/// Returns the expected false positive rate of a split block bloom filter with
+/// `size` bits after `count` insertions. Each 256-bit block consists of eight
+/// 32-bit words, and each key sets exactly one bit in every word of its block.
+inline double split_block_false_positive_rate(double size, double count) {
+  if (count <= 0) return 0;
+  return poisson_average(256 * count / size, [](double keys) {
+    return std::pow(false_positive_rate(32, 1, keys), 8);
+  });
+}
+
+/// Throws `std::invalid_argument` unless `false_positive_rate` is in (0, 1),
+/// the rates a filter can be sized for.
+inline void check_false_positive_rate(double false_positive_rate) {
+  if (!(false_positive_rate > 0 && false_positive_rate < 1)) {
+    throw std::invalid_argument(
+        "the false positive rate must be greater than zero and less than one");
+  }
+}
+
+/// Returns the hash count minimizing `blocked_false_positive_rate()`.
+inline size_t optimal_blocked_hash_count(double size,
+                                         double count,
+                                         double block_size) {
+  // Blocking shifts the optimum below the (standard) m/n * ln(2).
+  const double standard = std::ceil(size / std::max(count, 1.0) * std::log(2));
+  const auto stop = static_cast<size_t>(std::min(standard + 1, block_size));
+  size_t best = 1;
+  double best_rate = blocked_false_positive_rate(size, 1, count, block_size);
+  for (size_t hash_count = 2; hash_count <= stop; ++hash_count) {
+    const double rate =
+        blocked_false_positive_rate(size, hash_count, count, block_size);
+    if (rate < best_rate) {
+      best = hash_count;
+      best_rate = rate;
+    }
+  }
+  return best;
+}
+}  // namespace Detail
+
+/// A configuration struct for `Filter` and the other filter types.
 ///
 /// Encompasses a size (of the filter) and a hash count (number of hash
 /// functions). An `Options` object may be constructed directly from a size and
@@ -45,10 +140,87 @@ struct Options {
     return {size, static_cast<size_t>(std::ceil(optimal_hash_count))};
   }
 
+  /// Computes the optimal `Options` for a `BlockedFilter` with the given size
+  /// and expected number of inserted entries.
+  ///
+  /// Confining the bits of each key to one block of `block_size` bits raises
+  /// the false positive rate, as some blocks receive more keys than others.
+  /// The hash count is chosen to minimize that (higher) rate, and is usually
+  /// below the one `ForExpectedCount()` would choose.
+  static Options ForBlockedExpectedCount(size_t size,
+                                         size_t expected_number_of_insertions,
+                                         size_t block_size = 512) {
+    const size_t hash_count = Detail::optimal_blocked_hash_count(
+        size, expected_number_of_insertions, block_size);
+    return {size, std::min(hash_count, size)};
+  }
+
+  /// Computes the smallest `Options` (in multiples of `block_size`) for a
+  /// `BlockedFilter` that achieves the given false positive rate after the
+  /// expected number of entries have been inserted.
+  ///
+  /// The returned size accounts for the penalty of blocking, i.e. it is larger
+  /// than what a standard bloom filter would need for the same rate.
+  ///
+  /// \throws std::invalid_argument if the `false_positive_rate` is not greater
+  /// than zero and less than one.
+  static Options ForBlockedFilter(size_t expected_number_of_insertions,
+                                  double false_positive_rate,
+                                  size_t block_size = 512) {
+    Detail::check_false_positive_rate(false_positive_rate);
+    static const double kLn2 = std::log(2.0);
+    const double count = std::max<double>(expected_number_of_insertions, 1);
+    // Start at the size a standard bloom filter would need, then grow.
+    const double standard_size =
+        -count * std::log(false_positive_rate) / (kLn2 * kLn2);
+    auto blocks = static_cast<size_t>(std::ceil(standard_size / block_size));
+    blocks = std::max<size_t>(blocks, 1);
+    while (true) {
+      const size_t size = blocks * block_size;
+      const size_t hash_count =
+          Detail::optimal_blocked_hash_count(size, count, block_size);
+      if (Detail::blocked_false_positive_rate(
+              size, hash_count, count, block_size) <= false_positive_rate) {
+        return {size, hash_count};
+      }
+      blocks += std::max<size_t>(blocks / 100, 1);
+    }
+  }
+
+  /// Computes the smallest `Options` (in multiples of 256 bits) for a
+  /// `SplitBlockFilter` that achieves the given false positive rate after the
+  /// expected number of entries have been inserted. The hash count of a
+  /// `SplitBlockFilter` is always eight.
+  ///
+  /// \throws std::invalid_argument if the `false_positive_rate` is not greater
+  /// than zero and less than one.
+  static Options ForSplitBlockFilter(size_t expected_number_of_insertions,
+                                     double false_positive_rate) {
+    Detail::check_false_positive_rate(false_positive_rate);
+    const double count = std::max<double>(expected_number_of_insertions, 1);
+    auto blocks = static_cast<size_t>(std::ceil(count / 32));
+    blocks = std::max<size_t>(blocks, 1);
+    while (Detail::split_block_false_positive_rate(blocks * 256, count) >
+           false_positive_rate) {
+      blocks += std::max<size_t>(blocks / 100, 1);
+    }
+    return {blocks * 256, 8};
+  }
+
   /// The size (number of entries) to use for the bloom filter.
   size_t size;
 
   /// The number of hash functions to use in the bloom filter.
   size_t hash_count;
+
+  /// How the memory of the bloom filter is backed. Huge pages pay off for
+  /// filters much larger than what the TLB covers with regular pages.
+  PageMode page_mode = PageMode::kDefault;
+
+  /// The seed of the hash functions. Filters of the same type constructed
+  /// from options with the same size, hash count and seed hash every key to
+  /// the same bits, also in different processes, so that they can be merged.
+  /// If there is no seed (the default), every filter chooses one at random.
+  Seed seed;
 };
 }  // namespace Bloom
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace Bloom {
+namespace Detail {
+
+/// Returns the number of threads the hardware runs concurrently, or one if
+/// that is not known.
+inline size_t default_thread_count() noexcept {
+  return std::max<size_t>(std::thread::hardware_concurrency(), 1);
+}
+
+/// Blocks each of a fixed number of threads in `wait()` until all of them have
+/// arrived, then releases them together. May be used any number of times.
+class Barrier {
+ public:
+  explicit Barrier(size_t thread_count) : thread_count_(thread_count) {}
+
+  void wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    const size_t generation = generation_;
+    if (++arrived_ == thread_count_) {
+      arrived_ = 0;
+      ++generation_;
+      condition_.notify_all();
+      return;
+    }
+    condition_.wait(lock, [this, generation] {
+      return generation_ != generation;
+    });
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  size_t thread_count_;
+  size_t arrived_ = 0;
+  /// Incremented each time all threads have arrived.
+  size_t generation_ = 0;
+};
+
+/// Holds threads back until it is opened, and then lets them either all run
+/// or, if not all of them could be started, all stop.
+class StartGate {
+ public:
+  /// Blocks until the gate is opened, and returns `true` if the threads are
+  /// to run.
+  bool wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    condition_.wait(lock, [this] { return opened_; });
+    return run_;
+  }
+
+  void open(bool run) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      opened_ = true;
+      run_ = run;
+    }
+    condition_.notify_all();
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  bool opened_ = false;
+  bool run_ = false;
+};
+
+/// Starts a `std::thread` calling `function(thread_index)`.
+struct ThreadSpawner {
+  template <typename Function>
+  std::thread operator()(Function function, size_t thread_index) const {
+    return std::thread(std::move(function), thread_index);
+  }
+};
+
+/// Calls `function(thread_index)` for each `thread_index` in
+/// `0..thread_count` on its own thread (the first on the calling thread) and
+/// returns once all calls have returned. Rethrows the first exception (by
+/// thread index) that any of the calls threw, once all have returned.
+///
+/// No call starts before all threads have been started with `spawn`, so calls
+/// may wait for one another (e.g. at a `Barrier`). If starting a thread
+/// throws, no call is made, the threads already started are joined and the
+/// exception is rethrown.
+template <typename Function, typename Spawner = ThreadSpawner>
+void run_in_parallel(size_t thread_count,
+                     Function function,
+                     Spawner spawn = Spawner()) {
+  std::vector<std::exception_ptr> errors(thread_count);
+  const auto run = [&function, &errors](size_t thread_index) {
+    try {
+      function(thread_index);
+    } catch (...) {
+      errors[thread_index] = std::current_exception();
+    }
+  };
+  StartGate gate;
+  std::vector<std::thread> threads;
+  threads.reserve(thread_count - 1);
+  try {
+    for (size_t thread_index = 1; thread_index < thread_count;
+         ++thread_index) {
+      threads.push_back(spawn(
+          [&gate, &run](size_t index) {
+            if (gate.wait()) run(index);
+          },
+          thread_index));
+    }
+  } catch (...) {
+    gate.open(false);
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    throw;
+  }
+  gate.open(true);
+  run(0);
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  for (const auto& error : errors) {
+    if (error) std::rethrow_exception(error);
+  }
+}
+}  // namespace Detail
+}  // namespace Bloom
@@ -0,0 +1,184 @@
+#pragma once
+
+#include <bloom/bit-array.hpp>
+#include <bloom/hash.hpp>
+#include <bloom/numa.hpp>
+#include <bloom/options.hpp>
+#include <bloom/reduce.hpp>
+#include <bloom/slice.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace Bloom {
+
+/// A bloom filter split into independent partitions, each of which is placed
+/// on one NUMA node of the machine.
+///
+/// A key is hashed once; the digest selects one partition and the `k` bits of
+/// the key inside that partition, just like a `Filter` derives all bits from
+/// a digest. Each partition holds `1/P` of the bits and receives `1/P` of the
+/// keys in expectation, so the false positive rate is that of a `Filter` of
+/// the same size and hash count.
+///
+/// Partition `p` is placed on node `p % numa_node_count()`: it is allocated
+/// and first written by a thread pinned to that node, so its pages are backed
+/// by memory of that node (where pinning fails, see `numa_node()`). Workers pinned to a node (see
+/// `pin_thread_to_numa_node()`) can thus be handed only the keys whose
+/// `partition_of()` is on their node (see `numa_node()`), and never read
+/// memory across the interconnect. Any thread may still put or query any key.
+template <typename Hasher = DoubleHasher>
+class PartitionedFilter {
+ public:
+  static_assert(Detail::IsDigestHasher<Hasher>::value,
+                "the hash function of a PartitionedFilter must produce a "
+                "Digest");
+
+  /// Constructs a `PartitionedFilter` from the given options, with one
+  /// partition per NUMA node and a `Hasher` seeded with `options.seed` (or
+  /// randomly, if there is none).
+  explicit PartitionedFilter(Options options)
+  : PartitionedFilter(options,
+                      numa_node_count(),
+                      Detail::seeded_hasher<Hasher>(options.seed)) {}
+
+  /// Constructs a `PartitionedFilter` from the given options with
+  /// `partition_count` partitions, hashing keys with `hasher`. The size is
+  /// rounded up to a multiple of `partition_count`.
+  ///
+  /// \throws std::invalid_argument if `partition_count` is zero or greater
+  /// than the size.
+  PartitionedFilter(Options options,
+                    size_t partition_count,
+                    Hasher hasher = Hasher())
+  : hasher_(std::move(hasher))
+  , hash_count_(options.hash_count)
+  , partition_size_(checked_partition_size(options.size, partition_count))
+  , reduce_(partition_size_, RangeReducer::Method::kMultiplyHigh)
+  , partitions_(partition_count) {
+    const size_t node_count = numa_node_count();
+    Detail::run_on_numa_nodes(node_count, [&](size_t node, bool pinned) {
+      for (size_t p = node; p < partitions_.size(); p += node_count) {
+        partitions_[p].bits = BitArray(partition_size_, options.page_mode);
+        // Mapped pages are only backed by memory once written to.
+        if (partitions_[p].bits.page_mode() != PageMode::kDefault) {
+          partitions_[p].bits.clear();
+        }
+        // An unpinned thread most likely touched the pages first on the node
+        // it runs on now, but may have moved in between.
+        partitions_[p].node = pinned ? node : current_numa_node();
+      }
+    });
+  }
+
+  /// Constructs a `PartitionedFilter` from a size and hash count.
+  /// Equivalent to constructing an `Options` object and using the constructor
+  /// from `Options`.
+  PartitionedFilter(size_t size, size_t hash_count)
+  : PartitionedFilter(Options(size, hash_count)) {}
+
+  /// Inserts the given `key` into the partition selected by its digest.
+  ///
+  /// \complexity O(k)
+  void put(Slice key) {
+    const Digest digest = hasher_(key);
+    BitArray& bits = partitions_[partition_index(digest)].bits;
+    Detail::ProbeSequence probes(digest);
+    for (size_t i = 0; i < hash_count_; ++i) {
+      bits.set(static_cast<size_t>(reduce_(probes.next())));
+    }
+  }
+
+  /// Returns `true` if the given `key` has possibly been inserted in the
+  /// bloom filter. Only reads the partition selected by the key's digest.
+  ///
+  /// \complexity O(k)
+  bool query(Slice key) const {
+    const Digest digest = hasher_(key);
+    const BitArray& bits = partitions_[partition_index(digest)].bits;
+    Detail::ProbeSequence probes(digest);
+    for (size_t i = 0; i < hash_count_; ++i) {
+      if (!bits.test(static_cast<size_t>(reduce_(probes.next())))) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /// Returns the index of the partition the given `key` is inserted into and
+  /// queried in.
+  size_t partition_of(Slice key) const {
+    return partition_index(hasher_(key));
+  }
+
+  /// Returns the NUMA node the given `partition` is placed on. If its thread
+  /// could not be pinned to the intended node (`p % numa_node_count()`), this
+  /// is the node the thread ran on after first touching the partition.
+  size_t numa_node(size_t partition) const noexcept {
+    return partitions_[partition].node;
+  }
+
+  /// Returns the bits of the given `partition`.
+  const BitArray& bits(size_t partition) const noexcept {
+    return partitions_[partition].bits;
+  }
+
+  /// Clears all entries in the bloom filter.
+  /// \complexity O(N)
+  void clear() noexcept {
+    for (auto& partition : partitions_) partition.bits.clear();
+  }
+
+  /// Returns the size (`N`; number of bits) of the bloom filter, over all
+  /// partitions.
+  size_t size() const noexcept { return partition_size_ * partitions_.size(); }
+
+  /// Returns the size (number of bits) of each partition.
+  size_t partition_size() const noexcept { return partition_size_; }
+
+  /// Returns the number of partitions (`P`).
+  size_t partition_count() const noexcept { return partitions_.size(); }
+
+  /// Returns the number of hash functions (`k`) used in `put()` and `query()`
+  /// operations.
+  size_t hash_count() const noexcept { return hash_count_; }
+
+  /// Returns the hasher keys are hashed with.
+  const Hasher& hasher() const noexcept { return hasher_; }
+
+ private:
+  struct Partition {
+    BitArray bits;
+    size_t node = 0;
+  };
+
+  static size_t checked_partition_size(size_t size, size_t partition_count) {
+    if (partition_count == 0 || partition_count > size) {
+      throw std::invalid_argument(
+          "the number of partitions must be between one and the size of the "
+          "bloom filter");
+    }
+    return (size + partition_count - 1) / partition_count;
+  }
+
+  /// Selects the partition from the low bits of the high half of the
+  /// `digest`, rotated into the top bits for the multiplication, like
+  /// `BlockedFilter` selects a block. The bit positions are derived from the
+  /// top bits of the probe sequence, so they are (nearly) independent of the
+  /// partition.
+  size_t partition_index(Digest digest) const noexcept {
+    return static_cast<size_t>(
+        Detail::multiply_high(Detail::rotate_left<uint64_t>(digest.high, 32),
+                              partitions_.size()));
+  }
+
+  Hasher hasher_;
+  size_t hash_count_;
+  size_t partition_size_;
+  RangeReducer reduce_;
+  std::vector<Partition> partitions_;
+};
+}  // namespace Bloom
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+namespace Bloom {
+namespace Detail {
+
+/// The 128-bit product of two 64-bit integers.
+struct Product {
+  uint64_t low;
+  uint64_t high;
+};
+
+/// Returns the full 128-bit product of `a` and `b`.
+constexpr Product multiply(uint64_t a, uint64_t b) noexcept {
+#if defined(__SIZEOF_INT128__)
+  __extension__ using uint128 = unsigned __int128;
+  const uint128 product = static_cast<uint128>(a) * b;
+  return {static_cast<uint64_t>(product), static_cast<uint64_t>(product >> 64)};
+#else
+  const uint64_t a_low = a & 0xffffffffu;
+  const uint64_t a_high = a >> 32;
+  const uint64_t b_low = b & 0xffffffffu;
+  const uint64_t b_high = b >> 32;
+  const uint64_t low_low = a_low * b_low;
+  const uint64_t high_low = a_high * b_low;
+  const uint64_t low_high = a_low * b_high;
+  const uint64_t middle =
+      (low_low >> 32) + (high_low & 0xffffffffu) + (low_high & 0xffffffffu);
+  return {a * b,
+          a_high * b_high + (high_low >> 32) + (low_high >> 32) +
+              (middle >> 32)};
+#endif
+}
+
+/// Returns the high 64 bits of the 128-bit product of `a` and `b`.
+constexpr uint64_t multiply_high(uint64_t a, uint64_t b) noexcept {
+  return multiply(a, b).high;
+}
+
+/// Returns `true` if `value` is a (non-zero) power of two.
+constexpr bool is_power_of_two(uint64_t value) noexcept {
+  return value != 0 && (value & (value - 1)) == 0;
+}
+
+/// Maps a uniformly distributed 64-bit `hash` to `[0, Range)` with a mask if
+/// `Range` is a power of two, else with `multiply_high()`. Both are resolved
+/// at compile time.
+template <uint64_t Range>
+constexpr uint64_t reduce(uint64_t hash) noexcept {
+  return is_power_of_two(Range) ? hash & (Range - 1)
+                                : multiply_high(hash, Range);
+}
+}  // namespace Detail
+
+/// Maps hash values to indices in `[0, range)`, with the cheapest method that
+/// suits the range, chosen once at construction.
+///
+/// A `%` by a range only known at runtime compiles to a 64-bit division,
+/// which takes tens of cycles. If the range is a power of two, a mask of the
+/// low bits suffices. Otherwise the hash is mapped with a multiplication:
+/// `(hash * range) >> 64` (Lemire, "A fast alternative to the modulo
+/// reduction"). Like modulo, this is biased by at most `range / 2^64`, i.e.
+/// not measurably, but it relies on the *high* bits of the hash being
+/// uniformly distributed. Hash functions that only produce small values must
+/// use `Method::kModulo` instead.
+class RangeReducer {
+ public:
+  /// How hash values are mapped if the range is not a power of two.
+  enum class Method {
+    kMultiplyHigh,
+    kModulo,
+  };
+
+  /// Constructs a `RangeReducer` for `[0, range)`, using a mask if `range` is
+  /// a power of two and `fallback` otherwise.
+  explicit RangeReducer(uint64_t range,
+                        Method fallback = Method::kMultiplyHigh) noexcept
+  : range_(range)
+  , mask_(range - 1)
+  , method_(Detail::is_power_of_two(range) ? Kind::kMask
+                                           : fallback == Method::kModulo
+                                                 ? Kind::kModulo
+                                                 : Kind::kMultiplyHigh) {}
+
+  /// Maps the `hash` to `[0, range)`.
+  uint64_t operator()(uint64_t hash) const noexcept {
+    switch (method_) {
+      case Kind::kMask: return hash & mask_;
+      case Kind::kMultiplyHigh: return Detail::multiply_high(hash, range_);
+      case Kind::kModulo: return hash % range_;
+    }
+    return 0;
+  }
+
+  /// Returns the range (exclusive upper bound) of the indices.
+  uint64_t range() const noexcept { return range_; }
+
+  /// Returns `true` if the range is a power of two and hashes are masked.
+  bool uses_mask() const noexcept { return method_ == Kind::kMask; }
+
+ private:
+  enum class Kind {
+    kMask,
+    kMultiplyHigh,
+    kModulo,
+  };
+
+  uint64_t range_;
+  uint64_t mask_;
+  Kind method_;
+};
+
+/// Maps hash values to indices in `[0, range)` with a mask only, for a range
+/// that is known to be a power of two. Unlike `RangeReducer`, it does not
+/// branch on the method.
+class MaskReducer {
+ public:
+  /// Constructs a `MaskReducer` for `[0, range)`.
+  ///
+  /// \throws std::invalid_argument if `range` is not a power of two.
+  explicit MaskReducer(uint64_t range) : mask_(range - 1) {
+    if (!Detail::is_power_of_two(range)) {
+      throw std::invalid_argument("the range must be a power of two");
+    }
+  }
+
+  /// Maps the `hash` to `[0, range)`.
+  uint64_t operator()(uint64_t hash) const noexcept { return hash & mask_; }
+
+  /// Returns the range (exclusive upper bound) of the indices.
+  uint64_t range() const noexcept { return mask_ + 1; }
+
+ private:
+  uint64_t mask_;
+};
+
+/// Maps hash values to indices in `[0, range)` with `(hash * range) >> 64`
+/// for any range. Unlike `RangeReducer`, it does not branch on the method.
+/// Like `RangeReducer::Method::kMultiplyHigh`, it requires hashes whose high
+/// bits are uniformly distributed.
+class MultiplyHighReducer {
+ public:
+  /// Constructs a `MultiplyHighReducer` for `[0, range)`.
+  explicit MultiplyHighReducer(uint64_t range) noexcept : range_(range) {}
+
+  /// Maps the `hash` to `[0, range)`.
+  uint64_t operator()(uint64_t hash) const noexcept {
+    return Detail::multiply_high(hash, range_);
+  }
+
+  /// Returns the range (exclusive upper bound) of the indices.
+  uint64_t range() const noexcept { return range_; }
+
+ private:
+  uint64_t range_;
+};
+
+namespace Detail {
+/// Constructs a `Reducer` for `[0, range)`. Only a `RangeReducer` takes the
+/// `fallback` into account; other reducers always use their one method.
+template <typename Reducer>
+Reducer make_reducer(uint64_t range, RangeReducer::Method /*unused*/) {
+  return Reducer(range);
+}
+
+template <>
+inline RangeReducer make_reducer<RangeReducer>(uint64_t range,
+                                               RangeReducer::Method fallback) {
+  return RangeReducer(range, fallback);
+}
+}  // namespace Detail
+}  // namespace Bloom
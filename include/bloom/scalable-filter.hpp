@@ -0,0 +1,201 @@
+#pragma once
+
+#include <bloom/bit-array.hpp>
+#include <bloom/hash.hpp>
+#include <bloom/reduce.hpp>
+#include <bloom/slice.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+namespace Bloom {
+
+/// A bloom filter that grows as keys are inserted, for when the number of keys
+/// is not known in advance (Almeida et al., "Scalable Bloom Filters").
+///
+/// The filter is a chain of stages. Keys are inserted into the newest stage
+/// only. Once half of the bits of that stage are set, a new stage is added
+/// with `growth_factor` times its capacity and `tightening_ratio` times its
+/// false positive rate. The false positive rates of the stages form a
+/// geometric series bounded by the `false_positive_rate` the filter was
+/// constructed with, no matter how many stages are added.
+///
+/// All stages derive their probes from the same `Digest`, so a key is hashed
+/// once per operation regardless of the number of stages.
+class ScalableFilter {
+ public:
+  /// Constructs a `ScalableFilter` whose first stage holds `initial_capacity`
+  /// keys and whose false positive rate never exceeds `false_positive_rate`,
+  /// using a randomly seeded `Bloom::DoubleHasher`.
+  ///
+  /// \throws std::invalid_argument if the `initial_capacity` is zero, the
+  /// `false_positive_rate` or `tightening_ratio` is not in `(0, 1)` or the
+  /// `growth_factor` is less than one.
+  ScalableFilter(size_t initial_capacity,
+                 double false_positive_rate,
+                 double growth_factor = 2,
+                 double tightening_ratio = 0.85)
+  : ScalableFilter(initial_capacity,
+                   false_positive_rate,
+                   DoubleHasher(),
+                   growth_factor,
+                   tightening_ratio) {}
+
+  /// Constructs a `ScalableFilter` as above, hashing keys with `hasher`.
+  ScalableFilter(size_t initial_capacity,
+                 double false_positive_rate,
+                 DoubleHasher hasher,
+                 double growth_factor = 2,
+                 double tightening_ratio = 0.85)
+  : hasher_(hasher)
+  , false_positive_rate_(false_positive_rate)
+  , growth_factor_(growth_factor)
+  , tightening_ratio_(tightening_ratio) {
+    if (initial_capacity == 0) {
+      throw std::invalid_argument("the initial capacity must not be zero");
+    }
+    if (!(false_positive_rate > 0 && false_positive_rate < 1)) {
+      throw std::invalid_argument(
+          "the false positive rate must be between zero and one");
+    }
+    if (!(tightening_ratio > 0 && tightening_ratio < 1)) {
+      throw std::invalid_argument(
+          "the tightening ratio must be between zero and one");
+    }
+    if (!(growth_factor >= 1)) {
+      throw std::invalid_argument("the growth factor must be at least one");
+    }
+    // The rates of the stages sum up to P0 / (1 - r) = P.
+    add_stage(initial_capacity, false_positive_rate * (1 - tightening_ratio));
+  }
+
+  /// Inserts the given `key` into the newest stage of the bloom filter,
+  /// adding a new stage first if the newest one is full.
+  ///
+  /// \complexity O(k)
+  void put(Slice key) {
+    if (stages_.back().is_full()) {
+      const Stage& last = stages_.back();
+      add_stage(static_cast<size_t>(
+                    std::ceil(last.capacity * growth_factor_)),
+                last.false_positive_rate * tightening_ratio_);
+    }
+    stages_.back().put(hasher_(key));
+  }
+
+  /// Returns `true` if the given `key` has possibly been inserted in the
+  /// bloom filter. Stages are checked newest (and largest) first.
+  ///
+  /// \complexity O(k * stages)
+  bool query(Slice key) const {
+    const Digest digest = hasher_(key);
+    for (auto stage = stages_.rbegin(); stage != stages_.rend(); ++stage) {
+      if (stage->query(digest)) return true;
+    }
+    return false;
+  }
+
+  /// Removes all stages but the first one, and clears that.
+  /// \complexity O(N)
+  void clear() {
+    stages_.erase(stages_.begin() + 1, stages_.end());
+    stages_.front().clear();
+  }
+
+  /// Returns the total size (`N`; number of bits) of all stages.
+  size_t size() const noexcept {
+    size_t total = 0;
+    for (const auto& stage : stages_) {
+      total += stage.bits.size();
+    }
+    return total;
+  }
+
+  /// Returns the number of stages.
+  size_t stage_count() const noexcept { return stages_.size(); }
+
+  /// Returns the bound on the false positive rate the filter was constructed
+  /// with.
+  double false_positive_rate() const noexcept { return false_positive_rate_; }
+
+  /// Returns the false positive rate expected for the current fill of the
+  /// stages, which is at most `false_positive_rate()`.
+  double estimated_false_positive_rate() const noexcept {
+    double true_negative_rate = 1;
+    for (const auto& stage : stages_) {
+      const double fill =
+          static_cast<double>(stage.set_bits) / stage.bits.size();
+      true_negative_rate *= 1 - std::pow(fill, stage.hash_count);
+    }
+    return 1 - true_negative_rate;
+  }
+
+ private:
+  /// One stage of the filter: a bloom filter sized such that its false
+  /// positive rate is (at most) `false_positive_rate` while at most half of
+  /// its bits are set, which is the case for about `capacity` keys.
+  struct Stage {
+    Stage(size_t capacity, double false_positive_rate)
+    : capacity(capacity)
+    , false_positive_rate(false_positive_rate)
+    , hash_count(static_cast<size_t>(
+          std::max(1.0, std::ceil(-std::log2(false_positive_rate)))))
+    , bits(static_cast<size_t>(
+          std::ceil(capacity * hash_count / std::log(2.0))))
+    , reduce(bits.size()) {}
+
+    void put(Digest digest) noexcept {
+      Detail::ProbeSequence probes(digest);
+      for (size_t i = 0; i < hash_count; ++i) {
+        const auto index = static_cast<size_t>(reduce(probes.next()));
+        if (!bits.test(index)) {
+          bits.set(index);
+          ++set_bits;
+        }
+      }
+    }
+
+    bool query(Digest digest) const noexcept {
+      Detail::ProbeSequence probes(digest);
+      for (size_t i = 0; i < hash_count; ++i) {
+        if (!bits.test(static_cast<size_t>(reduce(probes.next())))) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    /// With `k` hash functions, the false positive rate is the fill ratio to
+    /// the power of `k`, which stays below `2^-k` while less than half of the
+    /// bits are set.
+    bool is_full() const noexcept { return 2 * set_bits >= bits.size(); }
+
+    void clear() noexcept {
+      bits.clear();
+      set_bits = 0;
+    }
+
+    size_t capacity;
+    double false_positive_rate;
+    size_t hash_count;
+    BitArray bits;
+    RangeReducer reduce;
+    /// The number of bits set, tracked on insertion to avoid counting them.
+    size_t set_bits = 0;
+  };
+
+  void add_stage(size_t capacity, double false_positive_rate) {
+    stages_.emplace_back(capacity, false_positive_rate);
+  }
+
+  DoubleHasher hasher_;
+  double false_positive_rate_;
+  double growth_factor_;
+  double tightening_ratio_;
+  std::vector<Stage> stages_;
+};
+}  // namespace Bloom
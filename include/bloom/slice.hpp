@@ -3,10 +3,16 @@
 #include <array>
 #include <cstddef>
 #include <cstdint>
+#include <string>
 #include <tuple>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
+
 namespace Bloom {
 
 /// A trait that may be specialized to enable construction of a `Slice` for a
@@ -16,6 +22,9 @@ namespace Bloom {
 /// ```cpp
 /// Slice to_slice(const T&) const;
 /// ```
+///
+/// A specialization for a plain struct may derive from `BytesSliceable` to
+/// view its bytes in place (see below).
 template <typename T>
 struct Sliceable;
 
@@ -56,6 +65,36 @@ class Slice {
   size_t size_;
 };
 
+/// Views the bytes of a trivially copyable `T`, e.g. a plain struct of
+/// integers, in place. Structs are not sliceable unless their `Sliceable`
+/// specialization opts in by deriving from it:
+///
+/// ```cpp
+/// template <>
+/// struct Sliceable<Point> : BytesSliceable<Point> {};
+/// ```
+///
+/// Opting in asserts that equal values have equal bytes: the bytes of any
+/// padding between (or after) the members of a struct are unspecified, and
+/// pointer members are compared by address, not by what they point to. Only
+/// opt in for types without padding or pointers, or zero the whole object
+/// before assigning the members. Where the standard library can tell (C++17),
+/// types with padding are rejected at compile time.
+template <typename T>
+struct BytesSliceable {
+  static_assert(std::is_trivially_copyable<T>::value &&
+                    !std::is_pointer<T>::value,
+                "only trivially copyable types can be viewed as bytes");
+#if defined(__cpp_lib_has_unique_object_representations)
+  static_assert(std::has_unique_object_representations<T>::value,
+                "the bytes of T include padding; specialize Sliceable<T>");
+#endif
+
+  Slice to_slice(const T& value) const noexcept {
+    return {reinterpret_cast<const uint8_t*>(&value), sizeof value};
+  }
+};
+
 #define NUMERIC_SLICEABLE(T)                                           \
   /** Specialization of `Sliceable` for `T`.  */                       \
   template <>                                                          \
@@ -80,6 +119,43 @@ NUMERIC_SLICEABLE(double);
 
 #undef NUMERIC_SLICEABLE
 
+/// A key given as characters, e.g. a string literal.
+///
+/// Unlike a `Slice`, a `StaticKey` can be hashed at compile time, which lets
+/// a `StaticFilter` over a fixed list of keys be built by the compiler (see
+/// `StaticFilter::build()`). It hashes to the same value as the `Slice` of
+/// its characters, so that the keys may be queried either way.
+class StaticKey {
+ public:
+  /// Constructs the `StaticKey` of a string literal, without the terminating
+  /// null character.
+  template <size_t M>
+  constexpr explicit StaticKey(const char (&literal)[M]) noexcept
+  : StaticKey(literal, M - 1) {}
+
+  /// Constructs the `StaticKey` of the `size` characters at `data`.
+  constexpr StaticKey(const char* data, size_t size) noexcept
+  : data_(data), size_(size) {}
+
+  /// Returns the data pointer.
+  constexpr const char* data() const noexcept { return data_; }
+
+  /// Returns the size.
+  constexpr size_t size() const noexcept { return size_; }
+
+ private:
+  const char* data_;
+  size_t size_;
+};
+
+/// Specialization of `Sliceable` for `StaticKey`, viewing its characters.
+template <>
+struct Sliceable<StaticKey> {
+  Slice to_slice(StaticKey key) const noexcept {
+    return {reinterpret_cast<const uint8_t*>(key.data()), key.size()};
+  }
+};
+
 /// Specialization of `Sliceable` for all built-in array types.
 template <typename T, size_t N>
 struct Sliceable<T[N]> {
@@ -105,4 +181,70 @@ struct Sliceable<std::array<T, N>> {
   }
 };
 
+/// Specialization of `Sliceable` for all `std::basic_string` types, e.g.
+/// `std::string`.
+template <typename Char, typename Traits, typename Allocator>
+struct Sliceable<std::basic_string<Char, Traits, Allocator>> {
+  Slice to_slice(
+      const std::basic_string<Char, Traits, Allocator>& string) const noexcept {
+    return {reinterpret_cast<const uint8_t*>(string.data()),
+            string.size() * sizeof(Char)};
+  }
+};
+
+#if __cplusplus >= 201703L
+/// Specialization of `Sliceable` for all `std::basic_string_view` types, e.g.
+/// `std::string_view`.
+template <typename Char, typename Traits>
+struct Sliceable<std::basic_string_view<Char, Traits>> {
+  Slice to_slice(std::basic_string_view<Char, Traits> view) const noexcept {
+    return {reinterpret_cast<const uint8_t*>(view.data()),
+            view.size() * sizeof(Char)};
+  }
+};
+#endif
+
+namespace Detail {
+
+/// A key made of several parts, hashed as the concatenation of their bytes.
+/// Does not own the `Slice`s.
+class SliceList {
+ public:
+  SliceList(const Slice* slices, size_t count) noexcept
+  : slices_(slices), count_(count) {}
+
+  template <size_t N>
+  explicit SliceList(const std::array<Slice, N>& slices) noexcept
+  : SliceList(slices.data(), N) {}
+
+  const Slice* begin() const noexcept { return slices_; }
+
+  const Slice* end() const noexcept { return slices_ + count_; }
+
+  /// Returns the total size of the parts.
+  size_t size() const noexcept {
+    size_t size = 0;
+    for (const Slice& slice : *this) size += slice.size();
+    return size;
+  }
+
+ private:
+  const Slice* slices_;
+  size_t count_;
+};
+
+template <typename Tuple, size_t... Indices>
+std::array<Slice, sizeof...(Indices)> to_slices(
+    const Tuple& tuple,
+    std::index_sequence<Indices...>) noexcept {
+  return {{Slice(std::get<Indices>(tuple))...}};
+}
+
+/// Returns a `Slice` of each element of `tuple`.
+template <typename... Parts>
+std::array<Slice, sizeof...(Parts)> to_slices(
+    const std::tuple<Parts...>& tuple) noexcept {
+  return to_slices(tuple, std::index_sequence_for<Parts...>());
+}
+}  // namespace Detail
 }  // namespace Bloom
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <bloom/bit-array.hpp>
+#include <bloom/hash.hpp>
+#include <bloom/options.hpp>
+#include <bloom/reduce.hpp>
+#include <bloom/slice.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+namespace Bloom {
+
+/// A bloom filter that forgets keys after a number of time steps, e.g. to
+/// deduplicate the events of the last ten minutes with a step of one minute
+/// and ten generations.
+///
+/// Keys are inserted into the current generation. `advance()` starts a new
+/// generation and drops the oldest one, so that `query()` finds the keys
+/// inserted during the last `Generations` generations (the current one
+/// included). This is equivalent to keeping one `Filter` per generation and
+/// querying all of them, but each of the `N` positions of the filter is a
+/// slot of `Generations` bits, one per generation, in a single word. A query
+/// thus reads `k` words, however many generations there are, and finds a key
+/// if any one generation has all `k` bits of the key set.
+///
+/// `Generations` must be a power of two of at most 64. Each generation is a
+/// bloom filter of `N` bits: size it for the keys inserted per generation.
+/// Dropping a generation clears one bit of every slot, one word at a time.
+template <size_t Generations = 8, typename Hasher = DoubleHasher>
+class SlidingWindowFilter {
+ public:
+  static_assert(Generations >= 2 && Generations <= 64 &&
+                    (Generations & (Generations - 1)) == 0,
+                "the number of generations must be a power of two between 2 "
+                "and 64");
+  static_assert(Detail::IsDigestHasher<Hasher>::value,
+                "the hash function of a SlidingWindowFilter must produce a "
+                "Digest");
+
+  /// Constructs a `SlidingWindowFilter` from the given options, hashing keys
+  /// with a `Hasher` seeded with `options.seed` (or randomly, if there is
+  /// none). The filter takes `options.size * Generations` bits.
+  explicit SlidingWindowFilter(Options options)
+  : SlidingWindowFilter(options, Detail::seeded_hasher<Hasher>(options.seed)) {
+  }
+
+  /// Constructs a `SlidingWindowFilter` from the given options, hashing keys
+  /// with `hasher`.
+  SlidingWindowFilter(Options options, Hasher hasher)
+  : hasher_(std::move(hasher))
+  , hash_count_(options.hash_count)
+  , size_(options.size)
+  , reduce_(options.size)
+  , slots_(options.size * Generations, options.page_mode) {}
+
+  /// Constructs a `SlidingWindowFilter` from a size and hash count.
+  /// Equivalent to constructing an `Options` object and using the constructor
+  /// from `Options`.
+  SlidingWindowFilter(size_t size, size_t hash_count)
+  : SlidingWindowFilter(Options(size, hash_count)) {}
+
+  /// Inserts the given `key` into the current generation.
+  ///
+  /// \complexity O(k)
+  void put(Slice key) {
+    const uint64_t bit = uint64_t{1} << current_;
+    Detail::ProbeSequence probes(hasher_(key));
+    for (size_t i = 0; i < hash_count_; ++i) {
+      const size_t index = static_cast<size_t>(reduce_(probes.next()));
+      slots_.words()[index / kSlotsPerWord] |= bit << shift(index);
+    }
+  }
+
+  /// Returns `true` if the given `key` has possibly been inserted during the
+  /// last `Generations` generations, i.e. if all of its `k` bits are set in
+  /// (at least) one generation.
+  ///
+  /// \complexity O(k)
+  bool query(Slice key) const {
+    // The generations in which all bits of the key seen so far are set.
+    uint64_t generations = kSlotMask;
+    Detail::ProbeSequence probes(hasher_(key));
+    for (size_t i = 0; i < hash_count_ && generations != 0; ++i) {
+      generations &= slot(static_cast<size_t>(reduce_(probes.next())));
+    }
+    return generations != 0;
+  }
+
+  /// Starts `count` new generations, dropping the `count` oldest ones (or
+  /// all, if `count` is at least `Generations`). Keys inserted afterwards are
+  /// inserted into the newest generation.
+  ///
+  /// \complexity O(N * Generations / 64)
+  void advance(size_t count = 1) noexcept {
+    if (count >= Generations) {
+      clear();
+      return;
+    }
+    uint64_t dropped = 0;
+    for (size_t i = 0; i < count; ++i) {
+      current_ = (current_ + 1) % Generations;
+      dropped |= uint64_t{1} << current_;
+    }
+    // The bits of the dropped generations in every slot of a word.
+    const uint64_t mask = ~(dropped * kLowBits);
+    uint64_t* words = slots_.words();
+    for (size_t i = 0, stop = slots_.word_count(); i < stop; ++i) {
+      words[i] &= mask;
+    }
+  }
+
+  /// Clears all generations.
+  /// \complexity O(N * Generations / 64)
+  void clear() noexcept { slots_.clear(); }
+
+  /// Returns the size (`N`; number of slots) of the bloom filter, i.e. the
+  /// number of bits of each generation.
+  size_t size() const noexcept { return size_; }
+
+  /// Returns the number of hash functions (`k`) used in `put()` and `query()`
+  /// operations.
+  size_t hash_count() const noexcept { return hash_count_; }
+
+  /// Returns the number of generations.
+  static constexpr size_t generation_count() noexcept { return Generations; }
+
+  /// Returns the index of the current generation, in `[0, Generations)`.
+  /// Slot `i` consists of the bits `i * Generations` up to (excluding)
+  /// `(i + 1) * Generations` of `slots()`, and holds the bit of generation `g`
+  /// in its bit `g`.
+  size_t current_generation() const noexcept { return current_; }
+
+  /// Returns the slots of the bloom filter.
+  const BitArray& slots() const noexcept { return slots_; }
+
+  /// Returns the hasher keys are hashed with.
+  const Hasher& hasher() const noexcept { return hasher_; }
+
+ private:
+  static constexpr size_t kSlotsPerWord = 64 / Generations;
+  static constexpr uint64_t kSlotMask =
+      Generations == 64 ? ~uint64_t{0} : (uint64_t{1} << Generations) - 1;
+  /// The lowest bit of every slot of a word.
+  static constexpr uint64_t kLowBits = ~uint64_t{0} / kSlotMask;
+
+  /// Returns the bits of the slot at `index`.
+  uint64_t slot(size_t index) const noexcept {
+    const uint64_t word = slots_.words()[index / kSlotsPerWord];
+    return (word >> shift(index)) & kSlotMask;
+  }
+
+  static size_t shift(size_t index) noexcept {
+    return (index % kSlotsPerWord) * Generations;
+  }
+
+  Hasher hasher_;
+  size_t hash_count_;
+  size_t size_;
+  RangeReducer reduce_;
+  BitArray slots_;
+  size_t current_ = 0;
+};
+}  // namespace Bloom
@@ -0,0 +1,370 @@
+#pragma once
+
+#include <bloom/aligned-allocator.hpp>
+#include <bloom/cpu.hpp>
+#include <bloom/hash.hpp>
+#include <bloom/options.hpp>
+#include <bloom/reduce.hpp>
+#include <bloom/slice.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+namespace Bloom {
+namespace Detail {
+
+/// Constants of the split block bloom filter. A template so that the salts can
+/// be defined in this header without violating the one definition rule.
+template <typename = void>
+struct SplitBlockConstants {
+  /// Odd constants multiplied with the hash of a key to obtain one bit
+  /// position per 32-bit word of a block. Taken from the Parquet
+  /// specification of split block bloom filters.
+  alignas(32) static constexpr uint32_t kSalt[8] = {0x47b6137bU,
+                                                    0x44974d91U,
+                                                    0x8824ad5bU,
+                                                    0xa2b7289dU,
+                                                    0x705495c7U,
+                                                    0x2df1424bU,
+                                                    0x9efc4947U,
+                                                    0x5c6bfb31U};
+};
+
+template <typename T>
+alignas(32) constexpr uint32_t SplitBlockConstants<T>::kSalt[8];
+
+/// The functions implementing `put()` and `query()` of a `SplitBlockFilter`
+/// for one particular `Isa`.
+struct SplitBlockKernel {
+  /// Sets the eight bits of `hash` in the 256-bit `block`.
+  void (*insert)(uint32_t* block, uint32_t hash);
+
+  /// Returns `true` if all eight bits of `hash` are set in the `block`.
+  bool (*check)(const uint32_t* block, uint32_t hash);
+
+  /// Stores the result of `check(blocks[i], hashes[i])` in `results[i]` for
+  /// every `i` in `0..count`.
+  void (*check_batch)(const uint32_t* const* blocks,
+                      const uint32_t* hashes,
+                      size_t count,
+                      bool* results);
+};
+
+/// Implements `SplitBlockKernel::check_batch` in terms of `Kernel::check`.
+template <typename Kernel>
+void check_each(const uint32_t* const* blocks,
+                const uint32_t* hashes,
+                size_t count,
+                bool* results) {
+  for (size_t i = 0; i < count; ++i) {
+    results[i] = Kernel::check(blocks[i], hashes[i]);
+  }
+}
+
+/// The portable kernel.
+struct ScalarSplitBlockKernel {
+  static uint32_t mask(uint32_t hash, size_t word) noexcept {
+    return uint32_t{1} << ((hash * SplitBlockConstants<>::kSalt[word]) >> 27);
+  }
+
+  static void insert(uint32_t* block, uint32_t hash) {
+    for (size_t word = 0; word < 8; ++word) {
+      block[word] |= mask(hash, word);
+    }
+  }
+
+  static bool check(const uint32_t* block, uint32_t hash) {
+    uint32_t missing = 0;
+    for (size_t word = 0; word < 8; ++word) {
+      missing |= ~block[word] & mask(hash, word);
+    }
+    return missing == 0;
+  }
+};
+
+#if defined(BLOOM_HAS_X86_KERNELS)
+
+/// The SSE4.2 kernel, operating on each block as two 128-bit halves.
+struct Sse42SplitBlockKernel {
+  /// Computes the masks for the four words of the `half`-th half of a block.
+  /// SSE has no per-lane variable shift, so `1 << shift` is computed by
+  /// building the float `2^shift` from its exponent and converting it back to
+  /// an integer (2^31 converts to 0x80000000, which is exactly `1 << 31`).
+  __attribute__((target("sse4.2"))) static __m128i mask(uint32_t hash,
+                                                        size_t half) {
+    const __m128i salt = _mm_load_si128(reinterpret_cast<const __m128i*>(
+        SplitBlockConstants<>::kSalt + 4 * half));
+    const __m128i shifts = _mm_srli_epi32(
+        _mm_mullo_epi32(_mm_set1_epi32(static_cast<int>(hash)), salt), 27);
+    const __m128i exponents =
+        _mm_add_epi32(_mm_slli_epi32(shifts, 23), _mm_set1_epi32(0x3f800000));
+    return _mm_cvttps_epi32(_mm_castsi128_ps(exponents));
+  }
+
+  __attribute__((target("sse4.2"))) static void insert(uint32_t* block,
+                                                       uint32_t hash) {
+    auto* halves = reinterpret_cast<__m128i*>(block);
+    _mm_store_si128(halves,
+                    _mm_or_si128(_mm_load_si128(halves), mask(hash, 0)));
+    _mm_store_si128(halves + 1,
+                    _mm_or_si128(_mm_load_si128(halves + 1), mask(hash, 1)));
+  }
+
+  __attribute__((target("sse4.2"))) static bool check(const uint32_t* block,
+                                                      uint32_t hash) {
+    const auto* halves = reinterpret_cast<const __m128i*>(block);
+    return (_mm_testc_si128(_mm_load_si128(halves), mask(hash, 0)) &
+            _mm_testc_si128(_mm_load_si128(halves + 1), mask(hash, 1))) != 0;
+  }
+};
+
+/// The AVX2 kernel, operating on each block as one 256-bit vector.
+struct Avx2SplitBlockKernel {
+  __attribute__((target("avx2"))) static __m256i mask(uint32_t hash) {
+    const __m256i salt = _mm256_load_si256(
+        reinterpret_cast<const __m256i*>(SplitBlockConstants<>::kSalt));
+    const __m256i shifts = _mm256_srli_epi32(
+        _mm256_mullo_epi32(_mm256_set1_epi32(static_cast<int>(hash)), salt),
+        27);
+    return _mm256_sllv_epi32(_mm256_set1_epi32(1), shifts);
+  }
+
+  __attribute__((target("avx2"))) static void insert(uint32_t* block,
+                                                     uint32_t hash) {
+    auto* vector = reinterpret_cast<__m256i*>(block);
+    _mm256_store_si256(vector,
+                       _mm256_or_si256(_mm256_load_si256(vector), mask(hash)));
+  }
+
+  __attribute__((target("avx2"))) static bool check(const uint32_t* block,
+                                                    uint32_t hash) {
+    const auto* vector = reinterpret_cast<const __m256i*>(block);
+    return _mm256_testc_si256(_mm256_load_si256(vector), mask(hash)) != 0;
+  }
+};
+
+// GCC's AVX-512 intrinsics self-initialize their "undefined" operands, which
+// GCC itself then warns about.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+/// The AVX-512 kernel. A block fills only half of a 512-bit register, so
+/// single keys are handled as in the AVX2 kernel, while `check_batch()` checks
+/// two keys (against two blocks) per instruction.
+struct Avx512SplitBlockKernel {
+  __attribute__((target("avx512f"))) static void insert(uint32_t* block,
+                                                        uint32_t hash) {
+    Avx2SplitBlockKernel::insert(block, hash);
+  }
+
+  __attribute__((target("avx512f"))) static bool check(const uint32_t* block,
+                                                       uint32_t hash) {
+    return Avx2SplitBlockKernel::check(block, hash);
+  }
+
+  __attribute__((target("avx512f"))) static void check_batch(
+      const uint32_t* const* blocks,
+      const uint32_t* hashes,
+      size_t count,
+      bool* results) {
+    const __m512i salt = _mm512_broadcast_i64x4(_mm256_load_si256(
+        reinterpret_cast<const __m256i*>(SplitBlockConstants<>::kSalt)));
+    const __m512i one = _mm512_set1_epi32(1);
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+      const __m512i both = _mm512_inserti64x4(
+          _mm512_castsi256_si512(_mm256_load_si256(
+              reinterpret_cast<const __m256i*>(blocks[i]))),
+          _mm256_load_si256(reinterpret_cast<const __m256i*>(blocks[i + 1])),
+          1);
+      const __m512i hash = _mm512_inserti64x4(
+          _mm512_set1_epi32(static_cast<int>(hashes[i])),
+          _mm256_set1_epi32(static_cast<int>(hashes[i + 1])),
+          1);
+      const __m512i mask = _mm512_sllv_epi32(
+          one, _mm512_srli_epi32(_mm512_mullo_epi32(hash, salt), 27));
+      const __mmask16 missing =
+          _mm512_cmpneq_epi32_mask(_mm512_and_si512(both, mask), mask);
+      results[i] = (missing & 0x00ffu) == 0;
+      results[i + 1] = (missing & 0xff00u) == 0;
+    }
+    if (i < count) {
+      results[i] = check(blocks[i], hashes[i]);
+    }
+  }
+};
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#endif  // BLOOM_HAS_X86_KERNELS
+
+/// Returns the kernel for the given `isa`, which must be supported.
+inline const SplitBlockKernel& split_block_kernel(Isa isa) {
+  static const SplitBlockKernel scalar = {
+      ScalarSplitBlockKernel::insert,
+      ScalarSplitBlockKernel::check,
+      check_each<ScalarSplitBlockKernel>};
+#if defined(BLOOM_HAS_X86_KERNELS)
+  static const SplitBlockKernel sse42 = {Sse42SplitBlockKernel::insert,
+                                         Sse42SplitBlockKernel::check,
+                                         check_each<Sse42SplitBlockKernel>};
+  static const SplitBlockKernel avx2 = {Avx2SplitBlockKernel::insert,
+                                        Avx2SplitBlockKernel::check,
+                                        check_each<Avx2SplitBlockKernel>};
+  static const SplitBlockKernel avx512 = {Avx512SplitBlockKernel::insert,
+                                          Avx512SplitBlockKernel::check,
+                                          Avx512SplitBlockKernel::check_batch};
+  switch (isa) {
+    case Isa::kScalar: return scalar;
+    case Isa::kSse42: return sse42;
+    case Isa::kAvx2: return avx2;
+    case Isa::kAvx512: return avx512;
+  }
+#endif
+  (void)isa;
+  return scalar;
+}
+}  // namespace Detail
+
+/// A split block bloom filter, as used by Apache Parquet and Impala.
+///
+/// Like a `BlockedFilter`, all bits of a key are confined to one block, but a
+/// block is only 256 bits wide and consists of eight 32-bit words, each of
+/// which receives exactly one bit of every key (so `k` is always eight). This
+/// lets `put()` and `query()` compute all eight bit positions at once and
+/// compare them against the whole block in a handful of branch-free SIMD
+/// instructions. The kernel for the best instruction set the CPU supports is
+/// selected at runtime, with a portable fallback on all other platforms.
+class SplitBlockFilter {
+ public:
+  /// The number of bits per block.
+  static constexpr size_t kBlockSize = 256;
+
+  /// The number of bits set per key.
+  static constexpr size_t kHashCount = 8;
+
+  /// Constructs a `SplitBlockFilter` with (at least) the given size, using a
+  /// randomly seeded `Bloom::DoubleHasher`. The size is rounded up to a
+  /// multiple of `kBlockSize`.
+  explicit SplitBlockFilter(size_t size)
+  : SplitBlockFilter(size, DoubleHasher()) {}
+
+  /// Constructs a `SplitBlockFilter` with (at least) the given size, hashing
+  /// keys with `hasher` and using the kernel for the given `isa`. The size is
+  /// rounded up to a multiple of `kBlockSize`.
+  ///
+  /// \throws std::invalid_argument if the CPU does not support `isa`.
+  SplitBlockFilter(size_t size, DoubleHasher hasher, Isa isa = best_isa())
+  : hasher_(hasher)
+  , isa_(isa)
+  , kernel_(&Detail::split_block_kernel(isa))
+  , block_count_(std::max<size_t>((size + kBlockSize - 1) / kBlockSize, 1))
+  , reduce_block_(block_count_)
+  , words_(block_count_ * kWordsPerBlock) {
+    if (!cpu_supports(isa)) {
+      throw std::invalid_argument(
+          "the CPU does not support the requested instruction set");
+    }
+  }
+
+  /// Constructs a `SplitBlockFilter` from the given options, for example
+  /// those computed by `Options::ForSplitBlockFilter()`.
+  ///
+  /// \throws std::invalid_argument if the hash count is not `kHashCount`.
+  explicit SplitBlockFilter(Options options)
+  : SplitBlockFilter(options.size,
+                     Detail::seeded_hasher<DoubleHasher>(options.seed)) {
+    if (options.hash_count != kHashCount) {
+      throw std::invalid_argument(
+          "the hash count of a split block filter must be eight");
+    }
+  }
+
+  /// Inserts the given `key` into the bloom filter.
+  ///
+  /// \complexity O(1)
+  void put(Slice key) {
+    const Digest digest = hasher_(key);
+    kernel_->insert(block_for(digest), lane_hash(digest));
+  }
+
+  /// Returns `true` if the given `key` has possibly been inserted in the
+  /// bloom filter.
+  ///
+  /// \complexity O(1)
+  bool query(Slice key) const {
+    const Digest digest = hasher_(key);
+    return kernel_->check(block_for(digest), lane_hash(digest));
+  }
+
+  /// Queries `count` keys at once, storing the result for `keys[i]` in
+  /// `results[i]`.
+  ///
+  /// Keys are hashed a group at a time and the blocks of the group are
+  /// prefetched before any of them is checked, so that the cache misses of
+  /// the group overlap.
+  ///
+  /// \complexity O(count)
+  void query_batch(const Slice* keys, size_t count, bool* results) const {
+    const uint32_t* blocks[kBatchSize];
+    uint32_t hashes[kBatchSize];
+    for (size_t start = 0; start < count; start += kBatchSize) {
+      const size_t group = std::min(count - start, size_t{kBatchSize});
+      for (size_t i = 0; i < group; ++i) {
+        const Digest digest = hasher_(keys[start + i]);
+        blocks[i] = block_for(digest);
+        hashes[i] = lane_hash(digest);
+        Detail::prefetch(blocks[i]);
+      }
+      kernel_->check_batch(blocks, hashes, group, results + start);
+    }
+  }
+
+  /// Clears all entries in the bloom filter.
+  /// \complexity O(N)
+  void clear() { std::fill(words_.begin(), words_.end(), 0); }
+
+  /// Returns the size (`N`; number of bits) of the bloom filter. This is always
+  /// a multiple of `kBlockSize`.
+  size_t size() const noexcept { return block_count_ * kBlockSize; }
+
+  /// Returns the number of bits set per key, which is always `kHashCount`.
+  size_t hash_count() const noexcept { return kHashCount; }
+
+  /// Returns the instruction set whose kernel this filter uses.
+  Isa isa() const noexcept { return isa_; }
+
+ private:
+  static constexpr size_t kWordsPerBlock = kBlockSize / 32;
+  static constexpr size_t kBatchSize = 16;
+
+  /// Selects the block for a key from the high half of its `digest`.
+  uint32_t* block_for(Digest digest) noexcept {
+    return &words_[reduce_block_(digest.high) * kWordsPerBlock];
+  }
+
+  const uint32_t* block_for(Digest digest) const noexcept {
+    return &words_[reduce_block_(digest.high) * kWordsPerBlock];
+  }
+
+  /// The hash from which the bit in each of the eight words is derived.
+  static uint32_t lane_hash(Digest digest) noexcept {
+    return static_cast<uint32_t>(digest.low);
+  }
+
+  DoubleHasher hasher_;
+  Isa isa_;
+  const Detail::SplitBlockKernel* kernel_;
+  size_t block_count_;
+  RangeReducer reduce_block_;
+  std::vector<uint32_t, AlignedAllocator<uint32_t>> words_;
+};
+}  // namespace Bloom
@@ -1,34 +1,77 @@
 #pragma once
 
+#include <bloom/batch.hpp>
+#include <bloom/cpu.hpp>
 #include <bloom/hash.hpp>
+#include <bloom/reduce.hpp>
 #include <bloom/slice.hpp>
 
 #include <algorithm>
 #include <array>
-#include <bitset>
 #include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <type_traits>
+#include <utility>
 
 namespace Bloom {
 
 /// A bloom filter with compile-time configurable size and hash count.
-template <size_t N, size_t k, typename Hasher = DefaultHasher>
+///
+/// If the `Hasher` produces a `Digest` (like the default `DoubleHasher`), the
+/// filter holds a single `Hasher` and derives all `k` probe positions of a key
+/// from one digest. Otherwise it holds `k` independent `Hasher` objects.
+///
+/// With hashers of a fixed seed, a filter over a list of `StaticKey`s can be
+/// built at compile time (see `build()`), and queried at compile time too. A
+/// `constexpr` filter is placed in read-only memory: it takes no work at
+/// startup and its pages are shared by all processes running the program. The
+/// `bloom-generate` tool writes such a filter for a list of keys to a header.
+template <size_t N, size_t k, typename Hasher = DoubleHasher>
 struct StaticFilter {
  public:
+  static_assert(N > 0, "the size of the bloom filter must not be zero");
   static_assert(k <= N,
                 "the number of hash functions must not be greater than the "
                 "size of the bloom filter");
 
   using HasherType = Hasher;
 
-  /// Default-constructs the filter and each of the `K` `Hasher` objects.
+  /// Default-constructs the filter and each of its `Hasher` objects.
   StaticFilter() = default;
 
   /// Constructs the `StaticFilter` with an initializer list of `Hasher`
-  /// objects.
+  /// objects: a single one for a `Digest` producing `Hasher`, else `k`.
   template <typename... Hashers>
-  explicit StaticFilter(Hashers&&... hashers)
+  constexpr explicit StaticFilter(Hashers&&... hashers)
   : hashers_({{std::forward<Hashers>(hashers)...}}) {}
 
+  /// Returns a `StaticFilter` holding the given `hashers` (see the constructor
+  /// above) into which all `keys` have been inserted. For example:
+  ///
+  /// ```cpp
+  /// constexpr Bloom::StaticKey kKeywords[] = {Bloom::StaticKey("select"),
+  ///                                           Bloom::StaticKey("from")};
+  /// constexpr auto kFilter = Bloom::StaticFilter<256, 4, Bloom::WyHasher>::
+  ///     build(kKeywords, Bloom::WyHasher(42));
+  /// static_assert(kFilter.query(Bloom::StaticKey("from")), "");
+  /// ```
+  ///
+  /// Compilers bound the work done in a constant expression, e.g. GCC to
+  /// 2^33 operations (`-fconstexpr-ops-limit`) and 2^18 iterations of one
+  /// loop (`-fconstexpr-loop-limit`), which limits the number of keys.
+  ///
+  /// \complexity O(M * k)
+  template <size_t M, typename... Hashers>
+  static constexpr StaticFilter build(const StaticKey (&keys)[M],
+                                      Hashers&&... hashers) {
+    StaticFilter filter(std::forward<Hashers>(hashers)...);
+    for (size_t i = 0; i < M; ++i) {
+      filter.put(keys[i]);
+    }
+    return filter;
+  }
+
   /// Inserts the given `key` into the bloom filter.
   ///
   /// Inserting means passing a key `x` through every hash function `h_k` with
@@ -36,10 +79,32 @@ struct StaticFilter {
   /// one.
   ///
   /// \complexity O(k)
-  void put(Slice slice) {
-    for (const auto& hasher : hashers_) {
-      const auto index = hasher(slice) % N;
-      bits_.set(index);
+  void put(Slice slice) { put_key(slice, IsDigestHasher()); }
+
+  /// Inserts the given `key` into the bloom filter, as `put()` of the `Slice`
+  /// of its characters does, but possibly at compile time.
+  ///
+  /// \complexity O(k)
+  constexpr void put(StaticKey key) { put_key(key, IsDigestHasher()); }
+
+  /// Inserts the `count` keys starting at `keys` into the bloom filter.
+  ///
+  /// `Key` may be `Slice` or any type for which `Sliceable` is specialized,
+  /// e.g. an array of fixed-width integers. The keys are processed in groups:
+  /// all keys of a group are hashed and the words they map to are prefetched
+  /// before any bit is set, so that the cache misses of a group overlap
+  /// instead of stalling on one another.
+  ///
+  /// \complexity O(count * k)
+  template <typename Key>
+  void put_batch(const Key* keys, size_t count) {
+    std::array<size_t, kBatchSize * k> indices;
+    for (size_t start = 0; start < count; start += kBatchSize) {
+      const size_t group = std::min(count - start, size_t{kBatchSize});
+      hash_group(keys + start, group, indices.data());
+      for (size_t i = 0; i < group * k; ++i) {
+        set(indices[i]);
+      }
     }
   }
 
@@ -51,26 +116,239 @@ struct StaticFilter {
   /// hashes the key to is *set* (one).
   ///
   /// \complexity O(k)
-  bool query(Slice key) const {
-    return std::all_of(hashers_.begin(),
-                       hashers_.end(),
-                       [this, &key](const auto& hasher) {
-                         return this->bits_.test(hasher(key) % this->size());
-                       });
+  bool query(Slice key) const { return query_key(key, IsDigestHasher()); }
+
+  /// Returns `true` if the given `key` has possibly been inserted in the
+  /// bloom filter, as `query()` of the `Slice` of its characters does, but
+  /// possibly at compile time. Like all filters, `query()` of a plain string
+  /// literal hashes its `Slice`, null character included; wrap the literal in
+  /// a `StaticKey` to find a key inserted as a `StaticKey`.
+  ///
+  /// \complexity O(k)
+  constexpr bool query(StaticKey key) const {
+    return query_key(key, IsDigestHasher());
+  }
+
+  /// Queries the `count` keys starting at `keys`, storing the result for
+  /// `keys[i]` in `results[i]`.
+  ///
+  /// See `put_batch()` for the accepted `Key` types and how the keys are
+  /// processed.
+  ///
+  /// \complexity O(count * k)
+  template <typename Key>
+  void query_batch(const Key* keys, size_t count, bool* results) const {
+    query_batch_into(keys, count, results);
+  }
+
+  /// Queries the `count` keys starting at `keys`, storing the result for
+  /// `keys[i]` in bit `i % 64` of `bitmap[i / 64]`. The `bitmap` must hold at
+  /// least `(count + 63) / 64` words.
+  ///
+  /// \complexity O(count * k)
+  template <typename Key>
+  void query_batch(const Key* keys, size_t count, uint64_t* bitmap) const {
+    query_batch_into(keys, count, bitmap);
   }
 
   /// Clears all entries in the bloom filter.
-  void clear() noexcept { bits_.reset(); }
+  void clear() noexcept { std::fill(std::begin(words_), std::end(words_), 0); }
 
   /// Returns the size (`N`; number of bits) of the bloom filter.
-  size_t size() const noexcept { return N; }
+  constexpr size_t size() const noexcept { return N; }
 
   /// Returns the number of hash functions (`k`) used in `put()` and `query()`
   /// operations.
-  size_t hash_count() const noexcept { return k; }
+  constexpr size_t hash_count() const noexcept { return k; }
 
  private:
-  std::array<Hasher, k> hashers_;
-  std::bitset<N> bits_;
+  using IsDigestHasher = Detail::IsDigestHasher<Hasher>;
+
+  /// The number of keys per group of `put_batch()` and `query_batch()`.
+  static constexpr size_t kBatchSize = Detail::batch_size(k);
+
+  constexpr void set(size_t index) noexcept {
+    words_[index / 64] |= uint64_t{1} << (index % 64);
+  }
+
+  constexpr bool test(size_t index) const noexcept {
+    return ((words_[index / 64] >> (index % 64)) & 1u) != 0;
+  }
+
+  /// Writes the `k` bit indices of each of the `count` `keys` to `indices`
+  /// (`k` consecutive entries per key), prefetching their words on the way.
+  template <typename Key>
+  void hash_group(const Key* keys, size_t count, size_t* indices) const {
+    for_each_batch_index(keys, count, [this, &indices](size_t index) {
+      Detail::prefetch(&this->words_[index / 64]);
+      *indices++ = index;
+      return true;
+    });
+  }
+
+  template <typename Key, typename Result>
+  void query_batch_into(const Key* keys, size_t count, Result* results) const {
+    Detail::clear_results(results, count);
+    if (k > 0 && N / 8 <= Detail::kCacheResidentBytes) {
+      // Nothing to gain from prefetching: resolve each key as it is hashed,
+      // up to the first of its bits that is not set.
+      size_t key = 0;
+      size_t hits = 0;
+      for_each_batch_index(keys, count, [&](size_t index) {
+        if (!this->test(index)) {
+          Detail::store_result(results, key++, false);
+          hits = 0;
+          return false;
+        }
+        if (++hits == k) {
+          Detail::store_result(results, key++, true);
+          hits = 0;
+        }
+        return true;
+      });
+      return;
+    }
+    std::array<size_t, kBatchSize * k> indices;
+    for (size_t start = 0; start < count; start += kBatchSize) {
+      const size_t group = std::min(count - start, size_t{kBatchSize});
+      hash_group(keys + start, group, indices.data());
+      for (size_t key = 0; key < group; ++key) {
+        const size_t* key_indices = indices.data() + key * k;
+        Detail::store_result(
+            results,
+            start + key,
+            std::all_of(key_indices,
+                        key_indices + k,
+                        [this](size_t index) { return this->test(index); }));
+      }
+    }
+  }
+
+  /// Invokes `function` with each of the `k` indices of each of the `count`
+  /// `keys`, in order, skipping the remaining indices of a key as soon as
+  /// `function` returns `false`, like `DigestHashing::for_each_batch_index()`.
+  template <typename Key, typename Function>
+  void for_each_batch_index(const Key* keys,
+                            size_t count,
+                            Function function) const {
+    for_each_batch_index(
+        keys,
+        count,
+        function,
+        std::integral_constant<bool,
+                               IsDigestHasher::value &&
+                                   Detail::IsFixedWidthInteger<Key>::value>());
+  }
+
+  template <typename Key, typename Function>
+  void for_each_batch_index(const Key* keys,
+                            size_t count,
+                            Function& function,
+                            std::true_type /* hashed in rounds */) const {
+    Digest digests[kBatchSize];
+    for (size_t start = 0; start < count; start += kBatchSize) {
+      const size_t round = std::min(count - start, size_t{kBatchSize});
+      Detail::hash_keys(hasher(0), keys + start, round, digests);
+      for (size_t key = 0; key < round; ++key) {
+        Detail::ProbeSequence probes(digests[key]);
+        for (size_t i = 0; i < k; ++i) {
+          const auto index =
+              static_cast<size_t>(Detail::reduce<N>(probes.next()));
+          if (!function(index)) break;
+        }
+      }
+    }
+  }
+
+  template <typename Key, typename Function>
+  void for_each_batch_index(const Key* keys,
+                            size_t count,
+                            Function& function,
+                            std::false_type /* hashed in rounds */) const {
+    for (size_t key = 0; key < count; ++key) {
+      all_of_indices(Slice(keys[key]), function);
+    }
+  }
+
+  // The following are written without lambdas or standard algorithms, which
+  // cannot be used in constant expressions before C++17 and C++20.
+
+  /// Returns the `i`-th `Hasher`, also from non-const functions (where the
+  /// non-const `operator[]` of `std::array` is not `constexpr`).
+  constexpr const Hasher& hasher(size_t i) const noexcept {
+    return hashers_[i];
+  }
+
+  template <typename Key>
+  constexpr void put_key(const Key& key, std::true_type /* digest */) {
+    Detail::ProbeSequence probes(hasher(0)(key));
+    for (size_t i = 0; i < k; ++i) {
+      set(static_cast<size_t>(Detail::reduce<N>(probes.next())));
+    }
+  }
+
+  template <typename Key>
+  constexpr void put_key(const Key& key, std::false_type /* digest */) {
+    for (size_t i = 0; i < k; ++i) {
+      set(static_cast<size_t>(hasher(i)(key) % N));
+    }
+  }
+
+  template <typename Key>
+  constexpr bool query_key(const Key& key, std::true_type /* digest */) const {
+    Detail::ProbeSequence probes(hasher(0)(key));
+    for (size_t i = 0; i < k; ++i) {
+      if (!test(static_cast<size_t>(Detail::reduce<N>(probes.next())))) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  template <typename Key>
+  constexpr bool query_key(const Key& key,
+                           std::false_type /* digest */) const {
+    for (size_t i = 0; i < k; ++i) {
+      if (!test(static_cast<size_t>(hasher(i)(key) % N))) return false;
+    }
+    return true;
+  }
+
+  /// Invokes `function` with each of the `k` indices the `key` hashes to,
+  /// stopping early as soon as `function` returns `false`.
+  template <typename Function>
+  bool all_of_indices(Slice key, Function function) const {
+    return all_of_indices(key, function, IsDigestHasher());
+  }
+
+  template <typename Function>
+  bool all_of_indices(Slice key,
+                      Function function,
+                      std::true_type /* digest */) const {
+    Detail::ProbeSequence probes(hashers_.front()(key));
+    for (size_t i = 0; i < k; ++i) {
+      if (!function(Detail::reduce<N>(probes.next()))) return false;
+    }
+    return true;
+  }
+
+  template <typename Function>
+  bool all_of_indices(Slice key,
+                      Function function,
+                      std::false_type /* digest */) const {
+    // Independent hash functions need not spread their values over all bits,
+    // so they are reduced with a modulo, which for a constant `N` compiles to
+    // a mask or a multiplication anyway.
+    return std::all_of(hashers_.begin(),
+                       hashers_.end(),
+                       [&key, &function](const auto& hasher) {
+                         return function(hasher(key) % N);
+                       });
+  }
+
+  std::array<Hasher, IsDigestHasher::value ? 1 : k> hashers_;
+  // A built-in array, as the non-const `operator[]` of `std::array` cannot be
+  // used in constant expressions before C++17.
+  uint64_t words_[(N + 63) / 64] = {};
 };
 }  // namespace Bloom
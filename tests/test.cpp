@@ -1,12 +1,373 @@
+#include <bloom/atomic-bit-array.hpp>
+#include <bloom/binary-fuse-filter.hpp>
+#include <bloom/bit-array.hpp>
+#include <bloom/blocked-filter.hpp>
+#include <bloom/concurrent-filter.hpp>
+#include <bloom/counting-filter.hpp>
+#include <bloom/cuckoo-filter.hpp>
 #include <bloom/filter.hpp>
+#include <bloom/mapped-filter.hpp>
+#include <bloom/partitioned-filter.hpp>
+#include <bloom/scalable-filter.hpp>
+#include <bloom/reduce.hpp>
+#include <bloom/sliding-window-filter.hpp>
+#include <bloom/split-block-filter.hpp>
 #include <bloom/static-filter.hpp>
 
+// Generated by bloom-generate from keywords.txt.
+#include "keywords.hpp"
+
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <sstream>
 #include <stdexcept>
 #include <string>
+#include <system_error>
+#include <thread>
 #include <vector>
 
+namespace {
+/// Inserts `count` distinct keys into the `filter`, then queries `count`
+/// distinct keys that were never inserted and returns the fraction of those
+/// that were (falsely) reported as present.
+template <typename Filter>
+double empirical_false_positive_rate(Filter& filter, uint64_t count) {
+  for (uint64_t key = 0; key < count; ++key) {
+    filter.put(key);
+  }
+  uint64_t false_positives = 0;
+  for (uint64_t key = count; key < 2 * count; ++key) {
+    false_positives += filter.query(key) ? 1 : 0;
+  }
+  return static_cast<double>(false_positives) / count;
+}
+
+/// The expected false positive rate `(1 - e^(-kn/m))^k` of a bloom filter with
+/// `m` bits and `k` hash functions after `n` insertions.
+double theoretical_false_positive_rate(double m, double k, double n) {
+  return std::pow(1 - std::exp(-k * n / m), k);
+}
+}  // namespace
+
+// NOLINTNEXTLINE
+TEST(TestHash, Murmur3_128MatchesReferenceImplementation) {
+  const char* text = "The quick brown fox jumps over the lazy dog";
+  const auto digest = Bloom::Detail::murmur3_128(
+      reinterpret_cast<const uint8_t*>(text), std::strlen(text), 0);
+  ASSERT_EQ(digest.low, 0xe34bbc7bbc071b6cULL);
+  ASSERT_EQ(digest.high, 0x7a433ca9c49a9347ULL);
+
+  const auto empty = Bloom::Detail::murmur3_128(nullptr, 0, 0);
+  ASSERT_EQ(empty.low, 0u);
+  ASSERT_EQ(empty.high, 0u);
+}
+
+// NOLINTNEXTLINE
+TEST(TestHash, ProbeSequenceVisitsDistinctPositionsModuloPowersOfTwo) {
+  // Even a digest with an even (zero) step must not probe the same bit twice.
+  Bloom::Detail::ProbeSequence probes(Bloom::Digest{7, 0});
+  std::vector<bool> seen(64);
+  for (size_t i = 0; i < seen.size(); ++i) {
+    const auto position = probes.next() % seen.size();
+    ASSERT_FALSE(seen[position]);
+    seen[position] = true;
+  }
+}
+
+// NOLINTNEXTLINE
+TEST(TestHash, Murmur3_32MatchesReferenceImplementationAtAnyAlignment) {
+  const std::string text = "The quick brown fox jumps over the lazy dog";
+  std::vector<uint8_t> buffer(text.size() + 8);
+  for (size_t offset = 0; offset < 8; ++offset) {
+    std::copy(text.begin(), text.end(), buffer.begin() + offset);
+    ASSERT_EQ(
+        Bloom::Detail::murmur3_32(&buffer[offset], text.size(), 0),
+        0x2e4ff723u);
+  }
+}
+
+// NOLINTNEXTLINE
+TEST(TestHash, WyhashDependsOnEveryByteLengthAndSeed) {
+  // Covers the empty, 1-3, 4-16, 17-48 and longer branches.
+  std::vector<uint8_t> bytes(200);
+  for (size_t i = 0; i < bytes.size(); ++i) {
+    bytes[i] = static_cast<uint8_t>(i * 31 + 7);
+  }
+  std::vector<uint64_t> hashes;
+  for (size_t size = 0; size <= bytes.size(); ++size) {
+    hashes.push_back(Bloom::Detail::wyhash(bytes.data(), size, 1));
+    hashes.push_back(Bloom::Detail::wyhash(bytes.data(), size, 2));
+    for (size_t i = 0; i < size; ++i) {
+      std::vector<uint8_t> flipped(bytes.begin(), bytes.begin() + size);
+      flipped[i] ^= 1;
+      ASSERT_NE(Bloom::Detail::wyhash(flipped.data(), size, 1),
+                hashes[2 * size]);
+    }
+  }
+  std::sort(hashes.begin(), hashes.end());
+  ASSERT_EQ(std::unique(hashes.begin(), hashes.end()), hashes.end());
+}
+
+// NOLINTNEXTLINE
+TEST(TestHash, WyhashIsIndependentOfAlignment) {
+  const std::string text = "The quick brown fox jumps over the lazy dog";
+  const auto* data = reinterpret_cast<const uint8_t*>(text.data());
+  const auto expected = Bloom::Detail::wyhash_128(data, text.size(), 5);
+  std::vector<uint8_t> buffer(text.size() + 8);
+  for (size_t offset = 0; offset < 8; ++offset) {
+    std::copy(text.begin(), text.end(), buffer.begin() + offset);
+    const auto digest =
+        Bloom::Detail::wyhash_128(&buffer[offset], text.size(), 5);
+    ASSERT_EQ(digest.low, expected.low);
+    ASSERT_EQ(digest.high, expected.high);
+  }
+  ASSERT_EQ(expected.low, Bloom::Detail::wyhash(data, text.size(), 5));
+}
+
+// NOLINTNEXTLINE
+TEST(TestHash, HashSchemesMatchTheirCompileTimeHashers) {
+  const uint64_t integer = 123456789;
+  const uint32_t narrow = 1234;
+  const std::string text = "not an integer";
+  const auto* text_data = reinterpret_cast<const uint8_t*>(text.data());
+  for (const Bloom::Slice key : {Bloom::Slice(integer),
+                                 Bloom::Slice(narrow),
+                                 Bloom::Slice(text_data, text.size())}) {
+    const auto wyhash =
+        Bloom::DoubleHasher(7, Bloom::HashScheme::kWyhashDoubleHashing)(key);
+    ASSERT_EQ(wyhash.low, Bloom::WyHasher(7)(key).low);
+    ASSERT_EQ(wyhash.high, Bloom::WyHasher(7)(key).high);
+    const auto integer_digest =
+        Bloom::DoubleHasher(7, Bloom::HashScheme::kIntegerDoubleHashing)(key);
+    ASSERT_EQ(integer_digest.low, Bloom::IntegerHasher(7)(key).low);
+    ASSERT_EQ(integer_digest.high, Bloom::IntegerHasher(7)(key).high);
+  }
+  // Integer keys of the same value hash the same regardless of their width.
+  ASSERT_EQ(Bloom::IntegerHasher(7)(uint64_t{narrow}).low,
+            Bloom::IntegerHasher(7)(narrow).low);
+  // Other keys fall back to wyhash.
+  const Bloom::Slice key(text_data, text.size());
+  ASSERT_EQ(Bloom::IntegerHasher(7)(key).low, Bloom::WyHasher(7)(key).low);
+}
+
+// NOLINTNEXTLINE
+TEST(TestHash, IntegerKernelsMatchHashingOneKeyAtATime) {
+  std::vector<uint64_t> wide(37);
+  std::vector<int32_t> narrow(wide.size());
+  for (size_t i = 0; i < wide.size(); ++i) {
+    wide[i] = (i + 1) * 0x9e3779b97f4a7c15ULL;
+    narrow[i] = -static_cast<int32_t>(wide[i] >> 33);
+  }
+  const Bloom::IntegerHasher hasher(7);
+  std::vector<Bloom::Digest> digests(wide.size());
+  // Every count, so that every kernel also handles every remainder.
+  for (size_t count = 0; count <= wide.size(); ++count) {
+    Bloom::Detail::hash_keys(hasher, wide.data(), count, digests.data());
+    for (size_t i = 0; i < count; ++i) {
+      ASSERT_EQ(digests[i].low, hasher(wide[i]).low);
+      ASSERT_EQ(digests[i].high, hasher(wide[i]).high);
+    }
+    Bloom::Detail::hash_keys(hasher, narrow.data(), count, digests.data());
+    for (size_t i = 0; i < count; ++i) {
+      ASSERT_EQ(digests[i].low, hasher(narrow[i]).low);
+      ASSERT_EQ(digests[i].high, hasher(narrow[i]).high);
+    }
+  }
+
+#if defined(BLOOM_HAS_X86_KERNELS)
+  std::vector<Bloom::Digest> expected(wide.size());
+  Bloom::Detail::hash_integers_scalar<uint64_t>(
+      wide.data(), wide.size(), 7, expected.data());
+  if (Bloom::cpu_supports(Bloom::Isa::kAvx2)) {
+    Bloom::Detail::Avx2IntegerKernel::hash<uint64_t>(
+        wide.data(), wide.size(), 7, digests.data());
+    for (size_t i = 0; i < wide.size(); ++i) {
+      ASSERT_EQ(digests[i].low, expected[i].low);
+      ASSERT_EQ(digests[i].high, expected[i].high);
+    }
+  }
+  if (Bloom::cpu_supports(Bloom::Isa::kAvx512)) {
+    Bloom::Detail::Avx512IntegerKernel::hash<uint64_t>(
+        wide.data(), wide.size(), 7, digests.data());
+    for (size_t i = 0; i < wide.size(); ++i) {
+      ASSERT_EQ(digests[i].low, expected[i].low);
+      ASSERT_EQ(digests[i].high, expected[i].high);
+    }
+  }
+#endif
+}
+
+// NOLINTNEXTLINE
+TEST(TestHash, DigestStreamMatchesDigestOfConcatenation) {
+  std::vector<uint8_t> bytes(300);
+  for (size_t i = 0; i < bytes.size(); ++i) {
+    bytes[i] = static_cast<uint8_t>(i * 37 + 11);
+  }
+  for (const auto scheme : {Bloom::HashScheme::kMurmur3DoubleHashing,
+                            Bloom::HashScheme::kWyhashDoubleHashing,
+                            Bloom::HashScheme::kIntegerDoubleHashing,
+                            Bloom::HashScheme::kSipHashDoubleHashing}) {
+    const Bloom::DoubleHasher hasher(7, scheme);
+    for (size_t size = 0; size <= bytes.size(); ++size) {
+      const Bloom::Digest expected = hasher(Bloom::Slice(bytes.data(), size));
+      // Split the key into parts of every length from 1 to 64 bytes.
+      for (size_t part = 1; part <= 64; ++part) {
+        Bloom::DigestStream stream = hasher.stream();
+        for (size_t start = 0; start < size; start += part) {
+          stream.update({bytes.data() + start, std::min(part, size - start)});
+        }
+        const Bloom::Digest digest = stream.finalize();
+        ASSERT_EQ(digest.low, expected.low) << size << " " << part;
+        ASSERT_EQ(digest.high, expected.high) << size << " " << part;
+      }
+    }
+  }
+
+  const uint64_t key = 42;
+  ASSERT_EQ(Bloom::IntegerHasher(3).stream().update(key).finalize().low,
+            Bloom::IntegerHasher(3)(key).low);
+  ASSERT_EQ(Bloom::WyHasher(3).stream().update(key).finalize().high,
+            Bloom::WyHasher(3)(key).high);
+}
+
+// NOLINTNEXTLINE
+TEST(TestHash, CharactersHashLikeBytes) {
+  static_assert(Bloom::Detail::murmur3_128(
+                    "The quick brown fox jumps over the lazy dog", 43, 0)
+                        .low == 0xe34bbc7bbc071b6cULL,
+                "murmur3_128() must be usable in constant expressions");
+
+  // Includes bytes of 128 and above, which are negative as `char`s.
+  std::vector<uint8_t> bytes(100);
+  for (size_t i = 0; i < bytes.size(); ++i) {
+    bytes[i] = static_cast<uint8_t>(i * 67 + 129);
+  }
+  const std::string characters(bytes.begin(), bytes.end());
+  const Bloom::DoubleHasher schemes[] = {
+      Bloom::DoubleHasher(5, Bloom::HashScheme::kMurmur3DoubleHashing),
+      Bloom::DoubleHasher(5, Bloom::HashScheme::kWyhashDoubleHashing),
+      Bloom::DoubleHasher(5, Bloom::HashScheme::kIntegerDoubleHashing),
+      Bloom::DoubleHasher(5, Bloom::HashScheme::kSipHashDoubleHashing)};
+  for (size_t size = 0; size <= bytes.size(); ++size) {
+    const Bloom::Slice slice(bytes.data(), size);
+    const Bloom::StaticKey key(characters.data(), size);
+    for (const auto& hasher : schemes) {
+      ASSERT_EQ(hasher(key).low, hasher(slice).low) << size;
+      ASSERT_EQ(hasher(key).high, hasher(slice).high) << size;
+    }
+    ASSERT_EQ(Bloom::WyHasher(5)(key).high, Bloom::WyHasher(5)(slice).high);
+    ASSERT_EQ(Bloom::IntegerHasher(5)(key).high,
+              Bloom::IntegerHasher(5)(slice).high);
+    ASSERT_EQ(Bloom::SipHasher(5)(key).high, Bloom::SipHasher(5)(slice).high);
+    ASSERT_EQ(Bloom::WyHasher64(5)(key), Bloom::WyHasher64(5)(slice));
+    ASSERT_EQ(Bloom::DefaultHasher(5)(key), Bloom::DefaultHasher(5)(slice));
+  }
+}
+
+// NOLINTNEXTLINE
+TEST(TestHash, SipHashMatchesReferenceVectors) {
+  // The 128-bit SipHash-2-4 vectors of the reference implementation, for the
+  // key 00 01 ... 0f and the messages 00 01 ... (n - 1).
+  using SipHash24 = Bloom::Detail::SipHashState<2, 4>;
+  const uint64_t k0 = 0x0706050403020100ULL;
+  const uint64_t k1 = 0x0f0e0d0c0b0a0908ULL;
+  uint8_t message[15];
+  std::iota(message, message + 15, uint8_t{0});
+  const auto empty = Bloom::Detail::siphash_128<SipHash24>(message, 0, k0, k1);
+  ASSERT_EQ(empty.low, 0xe6a825ba047f81a3ULL);
+  ASSERT_EQ(empty.high, 0x930255c71472f66dULL);
+  const auto full = Bloom::Detail::siphash_128<SipHash24>(message, 15, k0, k1);
+  ASSERT_EQ(full.low, 0x11a8b03399e99354ULL);
+  ASSERT_EQ(full.high, 0xd9c3cf970fec087eULL);
+
+  // SipHash-1-3, as used by `HashScheme::kSipHashDoubleHashing`.
+  const auto digest = Bloom::SipHasher(5)(Bloom::Slice(message, 9));
+  ASSERT_EQ(digest.low,
+            Bloom::Detail::siphash_128(message, 9, 5, Bloom::Detail::fmix64(5))
+                .low);
+}
+
+// NOLINTNEXTLINE
+TEST(TestHash, RandomSeedsAreDistinctAndDerivedSeedsReproducible) {
+  std::vector<uint64_t> seeds;
+  for (size_t i = 0; i < 1000; ++i) {
+    seeds.push_back(Bloom::Detail::random_seed());
+    seeds.push_back(Bloom::Detail::derive_seed(42, i));
+  }
+  std::sort(seeds.begin(), seeds.end());
+  ASSERT_EQ(std::unique(seeds.begin(), seeds.end()), seeds.end());
+  ASSERT_EQ(Bloom::Detail::derive_seed(42, 3),
+            Bloom::Detail::derive_seed(42, 3));
+
+  ASSERT_FALSE(Bloom::Seed().has_value());
+  const Bloom::Seed seed = 42;
+  ASSERT_TRUE(seed.has_value());
+  ASSERT_EQ(seed.value_or_random(), 42u);
+}
+
+// NOLINTNEXTLINE
+TEST(TestReduce, MultiplyHighReturnsHighHalfOfProduct) {
+  using Bloom::Detail::multiply_high;
+  ASSERT_EQ(multiply_high(0, ~uint64_t{0}), 0u);
+  ASSERT_EQ(multiply_high(uint64_t{1} << 63, 6), 3u);
+  ASSERT_EQ(multiply_high(~uint64_t{0}, ~uint64_t{0}), ~uint64_t{0} - 1);
+  ASSERT_EQ(multiply_high(0x123456789abcdef0ULL, 0x0fedcba987654321ULL),
+            0x0121fa00ad77d742ULL);
+  static_assert(multiply_high(uint64_t{1} << 32, uint64_t{1} << 32) == 1,
+                "multiply_high() must be usable in constant expressions");
+}
+
+// NOLINTNEXTLINE
+TEST(TestReduce, RangeReducerPicksMethodForRange) {
+  const Bloom::RangeReducer power_of_two(1024);
+  ASSERT_TRUE(power_of_two.uses_mask());
+  ASSERT_EQ(power_of_two(0x12345), 0x345u);
+
+  const Bloom::RangeReducer multiply(1000);
+  ASSERT_FALSE(multiply.uses_mask());
+  ASSERT_EQ(multiply(0), 0u);
+  ASSERT_EQ(multiply(~uint64_t{0}), 999u);
+  ASSERT_EQ(multiply(uint64_t{1} << 63), 500u);
+
+  const Bloom::RangeReducer modulo(1000, Bloom::RangeReducer::Method::kModulo);
+  ASSERT_FALSE(modulo.uses_mask());
+  ASSERT_EQ(modulo(1234), 234u);
+
+  ASSERT_EQ(Bloom::Detail::reduce<1024>(0x12345), 0x345u);
+  ASSERT_EQ(Bloom::Detail::reduce<1000>(~uint64_t{0}), 999u);
+}
+
+// NOLINTNEXTLINE
+TEST(TestReduce, MultiplyHighSpreadsDigestsUniformly) {
+  const size_t range = 1000;
+  const size_t count = 100000;
+  const Bloom::RangeReducer reduce(range);
+  Bloom::DoubleHasher hasher(42);
+  std::vector<size_t> histogram(range);
+  for (uint64_t key = 0; key < count; ++key) {
+    ++histogram[reduce(hasher(key).low)];
+  }
+
+  // Pearson's chi-squared statistic has a mean of 999 and a standard
+  // deviation of ~45 for 999 degrees of freedom.
+  const double expected = static_cast<double>(count) / range;
+  double chi_squared = 0;
+  for (const size_t observed : histogram) {
+    chi_squared += std::pow(observed - expected, 2) / expected;
+  }
+  ASSERT_LT(chi_squared, 1200);
+}
+
 // NOLINTNEXTLINE
 TEST(TestStaticFilter, SizeAndHashCountAsExpected) {
   {
@@ -80,6 +441,80 @@ TEST(TestStaticFilter, TestClearUnsetsAllBits) {
   ASSERT_FALSE(filter.query(2));
 }
 
+// NOLINTNEXTLINE
+TEST(TestStaticFilter, DoubleHashingFalsePositiveRateMatchesTheory) {
+  // m/n = 10 bits per key with k = 7 gives a false positive rate of ~0.82%.
+  Bloom::StaticFilter<100000, 7> filter(Bloom::DoubleHasher(42));
+  const double expected = theoretical_false_positive_rate(100000, 7, 10000);
+  ASSERT_NEAR(empirical_false_positive_rate(filter, 10000), expected, 0.003);
+}
+
+// NOLINTNEXTLINE
+TEST(TestStaticFilter, FastHashersFalsePositiveRateMatchesTheory) {
+  const double expected = theoretical_false_positive_rate(100000, 7, 10000);
+  {
+    Bloom::StaticFilter<100000, 7, Bloom::WyHasher> filter(
+        Bloom::WyHasher(42));
+    ASSERT_NEAR(empirical_false_positive_rate(filter, 10000), expected, 0.003);
+  }
+  {
+    Bloom::StaticFilter<100000, 7, Bloom::IntegerHasher> filter(
+        Bloom::IntegerHasher(42));
+    ASSERT_NEAR(empirical_false_positive_rate(filter, 10000), expected, 0.003);
+  }
+}
+
+namespace {
+constexpr Bloom::StaticKey kReservedWords[] = {Bloom::StaticKey("if"),
+                                               Bloom::StaticKey("else"),
+                                               Bloom::StaticKey("while"),
+                                               Bloom::StaticKey("return"),
+                                               Bloom::StaticKey("constexpr")};
+}  // namespace
+
+// NOLINTNEXTLINE
+TEST(TestStaticFilter, BuildsAndQueriesAtCompileTime) {
+  constexpr auto filter = Bloom::StaticFilter<256, 4, Bloom::WyHasher>::build(
+      kReservedWords, Bloom::WyHasher(42));
+  static_assert(filter.query(Bloom::StaticKey("constexpr")),
+                "inserted keys must be found at compile time");
+  static_assert(filter.size() == 256 && filter.hash_count() == 4, "");
+
+  constexpr auto independent =
+      Bloom::StaticFilter<256, 2, Bloom::WyHasher64>::build(
+          kReservedWords, Bloom::WyHasher64(1), Bloom::WyHasher64(2));
+  static_assert(independent.query(Bloom::StaticKey("while")),
+                "inserted keys must be found at compile time");
+
+  // The filter matches one built at runtime, and can be queried with slices.
+  Bloom::StaticFilter<256, 4, Bloom::WyHasher> runtime(Bloom::WyHasher(42));
+  for (const auto& key : kReservedWords) {
+    runtime.put(std::string(key.data(), key.size()));
+    ASSERT_TRUE(filter.query(std::string(key.data(), key.size())));
+    ASSERT_TRUE(independent.query(std::string(key.data(), key.size())));
+  }
+  for (const std::string key : {"for", "do", "switch", "case", "break"}) {
+    ASSERT_EQ(filter.query(key), runtime.query(key)) << key;
+  }
+}
+
+// NOLINTNEXTLINE
+TEST(TestStaticFilter, GeneratedFilterFindsItsKeys) {
+  static_assert(kKeywordFilter.query(Bloom::StaticKey("SELECT")),
+                "the generated filter must be usable in constant expressions");
+  for (const auto& key : kKeywordFilterKeys) {
+    ASSERT_TRUE(kKeywordFilter.query(key));
+    ASSERT_TRUE(kKeywordFilter.query(std::string(key.data(), key.size())));
+  }
+
+  // Generated for a false positive rate of 0.1%.
+  size_t false_positives = 0;
+  for (uint64_t key = 0; key < 10000; ++key) {
+    false_positives += kKeywordFilter.query(key) ? 1 : 0;
+  }
+  ASSERT_LT(false_positives, 50u);
+}
+
 // NOLINTNEXTLINE
 TEST(TestFilter, SizeAndHashCountAsExpectedForExplicitOptions) {
   {
@@ -238,3 +673,1943 @@ TEST(TestFilter, TestSliceableIsSpecializedForExpectedTypes) {
   ASSERT_TRUE(filter.query(static_cast<float>(11)));
   ASSERT_TRUE(filter.query(static_cast<double>(12)));
 }
+
+namespace {
+struct Point {
+  uint32_t x;
+  uint32_t y;
+};
+}  // namespace
+
+namespace Bloom {
+template <>
+struct Sliceable<Point> : BytesSliceable<Point> {};
+}  // namespace Bloom
+
+// NOLINTNEXTLINE
+TEST(TestFilter, SliceableViewsStringsAndPlainStructsInPlace) {
+  const Point point{1, 2};
+  const Bloom::Slice point_slice(point);
+  ASSERT_EQ(point_slice.data(), reinterpret_cast<const uint8_t*>(&point));
+  ASSERT_EQ(point_slice.size(), sizeof point);
+
+  const std::string text = "a string";
+  const Bloom::Slice text_slice(text);
+  ASSERT_EQ(text_slice.data(), reinterpret_cast<const uint8_t*>(text.data()));
+  ASSERT_EQ(text_slice.size(), text.size());
+  const std::u16string wide = u"wide";
+  ASSERT_EQ(Bloom::Slice(wide).size(), 8);
+
+  Bloom::Filter filter(Bloom::Options(1000, 3));
+  filter.put(point);
+  filter.put(text);
+  ASSERT_TRUE(filter.query(Point{1, 2}));
+  ASSERT_FALSE(filter.query(Point{2, 1}));
+  ASSERT_TRUE(filter.query(std::string("a string")));
+#if __cplusplus >= 201703L
+  ASSERT_TRUE(filter.query(std::string_view(text)));
+#endif
+}
+
+// NOLINTNEXTLINE
+TEST(TestFilter, KeysInPartsMatchConcatenatedKeys) {
+  const uint64_t tenant = 17;
+  const uint32_t user = 42;
+  const std::string path(300, 'p');
+  std::string concatenated(reinterpret_cast<const char*>(&tenant),
+                           sizeof tenant);
+  concatenated.append(reinterpret_cast<const char*>(&user), sizeof user);
+  concatenated += path;
+
+  std::vector<Bloom::Filter::Hasher> hashers;
+  hashers.emplace_back(Bloom::WyHasher64(1));
+  hashers.emplace_back(Bloom::WyHasher64(2));
+  Bloom::Filter digest(Bloom::Options(1 << 16, 5), Bloom::DoubleHasher(1));
+  Bloom::Filter independent(1 << 16, hashers.begin(), hashers.end());
+  Bloom::BasicFilter<Bloom::IndependentHashing<Bloom::DefaultHasher>> inlined(
+      Bloom::Options(1 << 16, 3));
+  digest.put(std::forward_as_tuple(tenant, user, path));
+  independent.put(tenant, user, path);
+  inlined.put(tenant, user, path.substr(0, 10));
+
+  ASSERT_TRUE(digest.query(concatenated));
+  ASSERT_TRUE(digest.query(tenant, user, path));
+  ASSERT_TRUE(independent.query(concatenated));
+  ASSERT_TRUE(independent.query(std::make_tuple(tenant, user, path)));
+  ASSERT_TRUE(inlined.query(tenant, user, path.substr(0, 10)));
+  ASSERT_FALSE(digest.query(tenant, user + 1, path));
+  ASSERT_FALSE(independent.query(tenant + 1, user, path));
+  ASSERT_FALSE(inlined.query(tenant, user, path.substr(0, 9)));
+}
+
+// NOLINTNEXTLINE
+TEST(TestFilter, DoubleHashingFalsePositiveRateMatchesIndependentHashing) {
+  const size_t size = 1000000;
+  const size_t hash_count = 7;
+  const uint64_t count = 100000;
+
+  std::vector<Bloom::Filter::Hasher> hashers;
+  for (uint32_t seed = 0; seed < hash_count; ++seed) {
+    hashers.emplace_back(Bloom::DefaultHasher(seed));
+  }
+  Bloom::Filter independent(size, hashers.begin(), hashers.end());
+  Bloom::Filter double_hashing(Bloom::Options(size, hash_count),
+                               Bloom::DoubleHasher(42));
+
+  const double expected =
+      theoretical_false_positive_rate(size, hash_count, count);
+  const double independent_rate =
+      empirical_false_positive_rate(independent, count);
+  const double double_hashing_rate =
+      empirical_false_positive_rate(double_hashing, count);
+
+  ASSERT_NEAR(independent_rate, expected, 0.001);
+  ASSERT_NEAR(double_hashing_rate, expected, 0.001);
+  ASSERT_NEAR(double_hashing_rate, independent_rate, 0.001);
+}
+
+// NOLINTNEXTLINE
+TEST(TestFilter, SameDoubleHasherSeedGivesSameBits) {
+  Bloom::Filter first(Bloom::Options(1000, 5), Bloom::DoubleHasher(7));
+  Bloom::Filter second(Bloom::Options(1000, 5), Bloom::DoubleHasher(7));
+  for (int key = 0; key < 50; ++key) {
+    first.put(key);
+    second.put(key);
+  }
+  for (int key = 0; key < 1000; ++key) {
+    ASSERT_EQ(first.query(key), second.query(key));
+  }
+}
+
+// NOLINTNEXTLINE
+TEST(TestFilter, DoubleHasherSeedEqualToKeyLengthIsNotDegenerate) {
+  // Unmixed, a seed of 8 cancels out in murmur3 for the 8-byte keys.
+  Bloom::Filter filter(Bloom::Options(1000000, 7), Bloom::DoubleHasher(8));
+  const double expected = theoretical_false_positive_rate(1000000, 7, 100000);
+  ASSERT_NEAR(empirical_false_positive_rate(filter, 100000), expected, 0.001);
+}
+
+// NOLINTNEXTLINE
+TEST(TestFilter, FalsePositiveRateMatchesTheoryForAnySize) {
+  // Masked (power of two) and multiplied sizes must both be unbiased.
+  for (const size_t size : {size_t{1} << 20, size_t{1000000}}) {
+    Bloom::Filter filter(Bloom::Options(size, 7), Bloom::DoubleHasher(42));
+    const double expected = theoretical_false_positive_rate(size, 7, 100000);
+    ASSERT_NEAR(empirical_false_positive_rate(filter, 100000), expected, 0.001);
+  }
+}
+
+// NOLINTNEXTLINE
+TEST(TestFilter, FalsePositiveRateMatchesTheoryForEveryHashScheme) {
+  for (const auto scheme : {Bloom::HashScheme::kWyhashDoubleHashing,
+                            Bloom::HashScheme::kIntegerDoubleHashing}) {
+    for (const uint64_t seed : {uint64_t{0}, uint64_t{8}, uint64_t{42}}) {
+      Bloom::Filter filter(Bloom::Options(1000000, 7),
+                           Bloom::DoubleHasher(seed, scheme));
+      const double expected =
+          theoretical_false_positive_rate(1000000, 7, 100000);
+      ASSERT_NEAR(
+          empirical_false_positive_rate(filter, 100000), expected, 0.001);
+    }
+  }
+}
+
+// NOLINTNEXTLINE
+TEST(TestFilter, FalsePositiveRateMatchesTheoryForWyHasher64) {
+  Bloom::Filter filter(100000,
+                       {Bloom::WyHasher64(1),
+                        Bloom::WyHasher64(2),
+                        Bloom::WyHasher64(3),
+                        Bloom::WyHasher64(4),
+                        Bloom::WyHasher64(5),
+                        Bloom::WyHasher64(6),
+                        Bloom::WyHasher64(7)});
+  const double expected = theoretical_false_positive_rate(100000, 7, 10000);
+  ASSERT_NEAR(empirical_false_positive_rate(filter, 10000), expected, 0.003);
+}
+
+// NOLINTNEXTLINE
+TEST(TestBlockedFilter, SizeIsRoundedUpToWholeBlocks) {
+  {
+    Bloom::BlockedFilter filter(512, 3);
+    ASSERT_EQ(filter.size(), 512u);
+    ASSERT_EQ(filter.hash_count(), 3u);
+  }
+  {
+    Bloom::BlockedFilter filter(513, 3);
+    ASSERT_EQ(filter.size(), 1024u);
+  }
+  {
+    Bloom::BlockedFilter filter(10, 3);
+    ASSERT_EQ(filter.size(), 512u);
+  }
+}
+
+// NOLINTNEXTLINE
+TEST(TestBlockedFilter, TestQueryAlwaysReturnsTrueForInsertedKeys) {
+  Bloom::BlockedFilter filter(4096, 8);
+  filter.put(1);
+  filter.put("hello");
+
+  std::vector<int> v = {1, 2, 3};
+  filter.put(v);
+
+  ASSERT_TRUE(filter.query(1));
+  ASSERT_TRUE(filter.query("hello"));
+  ASSERT_TRUE(filter.query(v));
+  for (int key = 0; key < 1000; ++key) {
+    filter.put(key);
+  }
+  for (int key = 0; key < 1000; ++key) {
+    ASSERT_TRUE(filter.query(key));
+  }
+}
+
+// NOLINTNEXTLINE
+TEST(TestBlockedFilter, TestClearUnsetsAllBits) {
+  Bloom::BlockedFilter filter(1024, 4);
+  filter.put(0);
+  filter.put(1);
+  ASSERT_TRUE(filter.query(0));
+  ASSERT_TRUE(filter.query(1));
+  filter.clear();
+  ASSERT_FALSE(filter.query(0));
+  ASSERT_FALSE(filter.query(1));
+}
+
+// NOLINTNEXTLINE
+TEST(TestBlockedFilter, FalsePositiveRateMatchesBlockedModel) {
+  const size_t size = 1 << 20;
+  const uint64_t count = 100000;
+  const auto options = Bloom::Options::ForBlockedExpectedCount(size, count);
+  Bloom::BlockedFilter filter(options, Bloom::DoubleHasher(42));
+
+  const double expected = Bloom::Detail::blocked_false_positive_rate(
+      size, options.hash_count, count, 512);
+  const double standard =
+      theoretical_false_positive_rate(size, options.hash_count, count);
+  const double actual = empirical_false_positive_rate(filter, count);
+
+  // The model averages the false positive rate over the number of keys per
+  // block, but not over the variance of the bits those keys set in a block,
+  // so it underestimates the rate by ~10% for 512-bit blocks.
+  ASSERT_GT(expected, standard);
+  ASSERT_NEAR(actual, expected, expected * 0.2);
+}
+
+// NOLINTNEXTLINE
+TEST(TestOptions, BlockedFilterOptionsAccountForBlockingPenalty) {
+  {
+    // m/n = 20 gives k = 14 for a standard filter; blocking lowers that.
+    const auto options = Bloom::Options::ForBlockedExpectedCount(20000, 1000);
+    ASSERT_EQ(options.size, 20000u);
+    ASSERT_LT(options.hash_count, 14u);
+    ASSERT_GT(options.hash_count, 0u);
+  }
+  {
+    const auto options = Bloom::Options::ForBlockedFilter(100000, 0.01);
+    // A standard filter needs -n * ln(p) / ln(2)^2 bits.
+    const double standard = -100000 * std::log(0.01) / std::pow(std::log(2), 2);
+    ASSERT_EQ(options.size % 512, 0u);
+    ASSERT_GT(options.size, standard);
+    ASSERT_LE(Bloom::Detail::blocked_false_positive_rate(
+                  options.size, options.hash_count, 100000, 512),
+              0.01);
+
+    Bloom::BlockedFilter filter(options, Bloom::DoubleHasher(42));
+    ASSERT_LT(empirical_false_positive_rate(filter, 100000), 0.011);
+  }
+}
+
+// NOLINTNEXTLINE
+TEST(TestOptions, BlockedFilterOptionsThrowForInvalidFalsePositiveRates) {
+  for (const double rate : {0.0, -0.5, 1.0, 2.0, std::nan("")}) {
+    ASSERT_THROW(Bloom::Options::ForBlockedFilter(1000, rate),
+                 std::invalid_argument);
+  }
+}
+
+// NOLINTNEXTLINE
+TEST(TestSplitBlockFilter, SizeAndHashCountAsExpected) {
+  Bloom::SplitBlockFilter filter(1000);
+  ASSERT_EQ(filter.size(), 1024u);
+  ASSERT_EQ(filter.hash_count(), 8u);
+  ASSERT_TRUE(Bloom::cpu_supports(filter.isa()));
+  ASSERT_EQ(filter.isa(), Bloom::best_isa());
+}
+
+// NOLINTNEXTLINE
+TEST(TestSplitBlockFilter, ThrowsWhenHashCountIsNotEight) {
+  ASSERT_THROW(Bloom::SplitBlockFilter(Bloom::Options(1024, 7)),
+               std::invalid_argument);
+}
+
+// NOLINTNEXTLINE
+TEST(TestSplitBlockFilter, AllKernelsAgree) {
+  std::vector<Bloom::Isa> supported;
+  for (const auto isa : {Bloom::Isa::kScalar,
+                         Bloom::Isa::kSse42,
+                         Bloom::Isa::kAvx2,
+                         Bloom::Isa::kAvx512}) {
+    if (Bloom::cpu_supports(isa)) supported.push_back(isa);
+  }
+
+  std::vector<uint64_t> keys(2000);
+  for (size_t i = 0; i < keys.size(); ++i) {
+    keys[i] = i * 7919;
+  }
+  const std::vector<Bloom::Slice> slices(keys.begin(), keys.end());
+
+  std::vector<Bloom::SplitBlockFilter> filters;
+  for (const auto isa : supported) {
+    filters.emplace_back(4096, Bloom::DoubleHasher(42), isa);
+    for (size_t i = 0; i < keys.size(); i += 4) {
+      filters.back().put(keys[i]);
+    }
+  }
+
+  for (const auto& filter : filters) {
+    std::unique_ptr<bool[]> results(new bool[keys.size()]);
+    filter.query_batch(slices.data(), slices.size(), results.get());
+    for (size_t i = 0; i < keys.size(); ++i) {
+      ASSERT_EQ(filter.query(keys[i]), filters.front().query(keys[i]));
+      ASSERT_EQ(results[i], filter.query(keys[i]));
+      if (i % 4 == 0) {
+        ASSERT_TRUE(results[i]);
+      }
+    }
+  }
+}
+
+// NOLINTNEXTLINE
+TEST(TestSplitBlockFilter, TestClearUnsetsAllBits) {
+  Bloom::SplitBlockFilter filter(256);
+  filter.put(0);
+  filter.put(1);
+  ASSERT_TRUE(filter.query(0));
+  ASSERT_TRUE(filter.query(1));
+  filter.clear();
+  ASSERT_FALSE(filter.query(0));
+  ASSERT_FALSE(filter.query(1));
+}
+
+// NOLINTNEXTLINE
+TEST(TestSplitBlockFilter, FalsePositiveRateMatchesOptions) {
+  const auto options = Bloom::Options::ForSplitBlockFilter(100000, 0.01);
+  ASSERT_EQ(options.size % 256, 0u);
+  ASSERT_EQ(options.hash_count, 8u);
+  ASSERT_LE(Bloom::Detail::split_block_false_positive_rate(options.size, 100000),
+            0.01);
+
+  Bloom::SplitBlockFilter filter(
+      options.size, Bloom::DoubleHasher(42), Bloom::best_isa());
+  ASSERT_NEAR(empirical_false_positive_rate(filter, 100000), 0.01, 0.001);
+}
+
+// NOLINTNEXTLINE
+TEST(TestSplitBlockFilter, OptionsThrowForInvalidFalsePositiveRates) {
+  for (const double rate : {0.0, -0.5, 1.0, 2.0, std::nan("")}) {
+    ASSERT_THROW(Bloom::Options::ForSplitBlockFilter(1000, rate),
+                 std::invalid_argument);
+  }
+}
+
+namespace {
+/// Checks that the batch operations of `filter` agree with `put()`/`query()`
+/// on a fresh copy of the same (empty) `filter`.
+template <typename Filter>
+void expect_batch_matches_single(Filter filter) {
+  Filter reference = filter;
+
+  std::vector<uint64_t> keys(1000);
+  for (size_t i = 0; i < keys.size(); ++i) {
+    keys[i] = i * 31;
+  }
+  const std::vector<Bloom::Slice> slices(keys.begin(), keys.end());
+
+  // Insert every third key, as fixed-width keys and as slices respectively.
+  std::vector<uint64_t> inserted;
+  for (size_t i = 0; i < keys.size(); i += 3) {
+    inserted.push_back(keys[i]);
+    reference.put(keys[i]);
+  }
+  filter.put_batch(inserted.data(), inserted.size() / 2);
+  const std::vector<Bloom::Slice> rest(inserted.begin() + inserted.size() / 2,
+                                       inserted.end());
+  filter.put_batch(rest.data(), rest.size());
+
+  std::unique_ptr<bool[]> results(new bool[keys.size()]);
+  std::vector<uint64_t> bitmap((keys.size() + 63) / 64, ~uint64_t{0});
+  filter.query_batch(keys.data(), keys.size(), results.get());
+  filter.query_batch(slices.data(), slices.size(), bitmap.data());
+  for (size_t i = 0; i < keys.size(); ++i) {
+    const bool expected = reference.query(keys[i]);
+    ASSERT_EQ(filter.query(keys[i]), expected);
+    ASSERT_EQ(results[i], expected);
+    ASSERT_EQ(((bitmap[i / 64] >> (i % 64)) & 1u) != 0, expected);
+    if (i % 3 == 0) {
+      ASSERT_TRUE(expected);
+    }
+  }
+}
+}  // namespace
+
+// NOLINTNEXTLINE
+TEST(TestFilter, BatchOperationsMatchSingleOperations) {
+  expect_batch_matches_single(
+      Bloom::Filter(Bloom::Options(5000, 4), Bloom::DoubleHasher(1)));
+  expect_batch_matches_single(
+      Bloom::Filter(5000, {Bloom::DefaultHasher(1), Bloom::DefaultHasher(2)}));
+  // More probes per key than fit into one group.
+  expect_batch_matches_single(
+      Bloom::Filter(Bloom::Options(100000, 300), Bloom::DoubleHasher(1)));
+  // Integer keys hashed several at a time.
+  expect_batch_matches_single(Bloom::Filter(
+      Bloom::Options(5000, 4),
+      Bloom::DoubleHasher(1, Bloom::HashScheme::kIntegerDoubleHashing)));
+  expect_batch_matches_single(
+      Bloom::BasicFilter<Bloom::DigestHashing<Bloom::IntegerHasher>>(
+          Bloom::Options(5000, 4), Bloom::IntegerHasher(1)));
+  // Filters too large to stay in the cache, whose words are prefetched.
+  const size_t large = 8 * Bloom::Detail::kCacheResidentBytes + 64;
+  expect_batch_matches_single(
+      Bloom::Filter(Bloom::Options(large, 4), Bloom::DoubleHasher(1)));
+  expect_batch_matches_single(
+      Bloom::BasicFilter<Bloom::DigestHashing<Bloom::IntegerHasher>>(
+          Bloom::Options(large, 4), Bloom::IntegerHasher(1)));
+  // Without hash functions, every key is found.
+  expect_batch_matches_single(
+      Bloom::Filter(Bloom::Options(large, 0), Bloom::DoubleHasher(1)));
+}
+
+// NOLINTNEXTLINE
+TEST(TestStaticFilter, BatchOperationsMatchSingleOperations) {
+  expect_batch_matches_single(
+      Bloom::StaticFilter<5000, 4>(Bloom::DoubleHasher(1)));
+  expect_batch_matches_single(
+      Bloom::StaticFilter<5000, 2, Bloom::DefaultHasher>(
+          Bloom::DefaultHasher(1), Bloom::DefaultHasher(2)));
+  expect_batch_matches_single(
+      Bloom::StaticFilter<5000, 4, Bloom::IntegerHasher>(
+          Bloom::IntegerHasher(1)));
+  // Without hash functions, every key is found.
+  expect_batch_matches_single(
+      Bloom::StaticFilter<5000, 0>(Bloom::DoubleHasher(1)));
+}
+
+// NOLINTNEXTLINE
+TEST(TestBitArray, SetTestResetAndCount) {
+  Bloom::BitArray bits(130);
+  ASSERT_EQ(bits.size(), 130u);
+  ASSERT_EQ(bits.word_count(), 3u);
+  ASSERT_EQ(bits.count(), 0u);
+
+  bits.set(0);
+  bits.set(64);
+  bits.set(129);
+  ASSERT_TRUE(bits.test(0));
+  ASSERT_TRUE(bits.test(64));
+  ASSERT_TRUE(bits.test(129));
+  ASSERT_FALSE(bits.test(1));
+  ASSERT_EQ(bits.count(), 3u);
+  ASSERT_EQ(bits.words()[2], 2u);
+
+  bits.reset(64);
+  ASSERT_FALSE(bits.test(64));
+  ASSERT_EQ(bits.count(), 2u);
+
+  bits.clear();
+  ASSERT_EQ(bits.count(), 0u);
+}
+
+// NOLINTNEXTLINE
+TEST(TestBitArray, WordsAreCacheLineAligned) {
+  for (const auto mode : {Bloom::PageMode::kDefault,
+                          Bloom::PageMode::kTransparentHugePages,
+                          Bloom::PageMode::kHugeTlb}) {
+    Bloom::BitArray bits(12345, mode);
+    const auto address = reinterpret_cast<uintptr_t>(bits.words());
+    ASSERT_EQ(address % Bloom::kCacheLineSize, 0u);
+    ASSERT_EQ(bits.count(), 0u);
+    bits.set(12344);
+    ASSERT_TRUE(bits.test(12344));
+  }
+}
+
+// NOLINTNEXTLINE
+TEST(TestBitArray, UnionAndIntersection) {
+  Bloom::BitArray first(100);
+  Bloom::BitArray second(100);
+  first.set(1);
+  first.set(2);
+  second.set(2);
+  second.set(99);
+
+  Bloom::BitArray both = first;
+  both |= second;
+  ASSERT_EQ(both.count(), 3u);
+  ASSERT_TRUE(both.test(1) && both.test(2) && both.test(99));
+
+  first &= second;
+  ASSERT_EQ(first.count(), 1u);
+  ASSERT_TRUE(first.test(2));
+
+  Bloom::BitArray other(101);
+  ASSERT_THROW(first |= other, std::invalid_argument);
+  ASSERT_THROW(first &= other, std::invalid_argument);
+}
+
+// NOLINTNEXTLINE
+TEST(TestBitArray, UnionAndIntersectionOfEveryLength) {
+  // Covers lengths with and without a remainder after the vectorized words.
+  for (const size_t size : {64, 256, 1000, 4096 + 3 * 64 + 7}) {
+    Bloom::BitArray first(size);
+    Bloom::BitArray second(size);
+    for (size_t i = 0; i < size; i += 3) first.set(i);
+    for (size_t i = 0; i < size; i += 5) second.set(i);
+
+    Bloom::BitArray both = first;
+    both |= second;
+    Bloom::BitArray common = first;
+    common &= second;
+    for (size_t i = 0; i < size; ++i) {
+      ASSERT_EQ(both.test(i), i % 3 == 0 || i % 5 == 0);
+      ASSERT_EQ(common.test(i), i % 15 == 0);
+    }
+  }
+}
+
+// NOLINTNEXTLINE
+TEST(TestBitArray, CopyAndMove) {
+  Bloom::BitArray original(200, Bloom::PageMode::kTransparentHugePages);
+  original.set(7);
+
+  Bloom::BitArray copy = original;
+  ASSERT_EQ(copy, original);
+  ASSERT_NE(copy.words(), original.words());
+  copy.set(8);
+  ASSERT_NE(copy, original);
+
+  Bloom::BitArray moved = std::move(copy);
+  ASSERT_TRUE(moved.test(7));
+  ASSERT_TRUE(moved.test(8));
+  ASSERT_EQ(moved.size(), 200u);
+
+  moved = original;
+  ASSERT_EQ(moved, original);
+}
+
+// NOLINTNEXTLINE
+TEST(TestFilter, PageModeIsForwardedToBits) {
+  Bloom::Options options(1 << 20, 3);
+  options.page_mode = Bloom::PageMode::kTransparentHugePages;
+  Bloom::Filter filter(options);
+#if defined(__linux__)
+  ASSERT_EQ(filter.bits().page_mode(), Bloom::PageMode::kTransparentHugePages);
+#endif
+  filter.put(42);
+  ASSERT_TRUE(filter.query(42));
+  ASSERT_EQ(filter.bits().count(), 3u);
+}
+
+// NOLINTNEXTLINE
+TEST(TestBasicFilter, PoliciesHaveSameBitsAsFilter) {
+  for (const size_t size : {size_t{1} << 14, size_t{10000}}) {
+    Bloom::Filter filter(Bloom::Options(size, 5), Bloom::DoubleHasher(3));
+    Bloom::BasicFilter<Bloom::DigestHashing<>> digest(Bloom::Options(size, 5),
+                                                      Bloom::DoubleHasher(3));
+    Bloom::BasicFilter<Bloom::DigestHashing<>,
+                       Bloom::BitArray,
+                       Bloom::MultiplyHighReducer>
+        multiply(Bloom::Options(size, 5), Bloom::DoubleHasher(3));
+    for (int key = 0; key < 500; ++key) {
+      filter.put(key);
+      digest.put(key);
+      multiply.put(key);
+    }
+    ASSERT_EQ(digest.bits(), filter.bits());
+    if (!Bloom::Detail::is_power_of_two(size)) {
+      ASSERT_EQ(multiply.bits(), filter.bits());
+    }
+    for (int key = 0; key < 1000; ++key) {
+      ASSERT_EQ(digest.query(key), filter.query(key));
+    }
+  }
+}
+
+// NOLINTNEXTLINE
+TEST(TestBasicFilter, IndependentHashingHasSameBitsAsFilter) {
+  const std::vector<Bloom::DefaultHasher> hashers = {Bloom::DefaultHasher(1),
+                                                     Bloom::DefaultHasher(2),
+                                                     Bloom::DefaultHasher(3)};
+  Bloom::Filter filter(1000, hashers.begin(), hashers.end());
+  Bloom::BasicFilter<Bloom::IndependentHashing<Bloom::DefaultHasher>>
+      independent(1000, hashers.begin(), hashers.end());
+  ASSERT_EQ(independent.hash_count(), 3u);
+  for (int key = 0; key < 100; ++key) {
+    filter.put(key);
+    independent.put(key);
+  }
+  ASSERT_EQ(independent.bits(), filter.bits());
+
+  Bloom::BasicFilter<Bloom::IndependentHashing<Bloom::WyHasher64>> seeded(
+      Bloom::Options(100000, 7));
+  const double expected = theoretical_false_positive_rate(100000, 7, 10000);
+  ASSERT_NEAR(empirical_false_positive_rate(seeded, 10000), expected, 0.003);
+}
+
+// NOLINTNEXTLINE
+TEST(TestBasicFilter, MaskReducerRequiresPowerOfTwoSize) {
+  using MaskFilter = Bloom::BasicFilter<Bloom::DigestHashing<Bloom::WyHasher>,
+                                        Bloom::BitArray,
+                                        Bloom::MaskReducer>;
+  ASSERT_THROW(MaskFilter(Bloom::Options(1000, 3), Bloom::WyHasher(1)),
+               std::invalid_argument);
+  MaskFilter filter(Bloom::Options(1 << 10, 3), Bloom::WyHasher(1));
+  filter.put(42);
+  ASSERT_TRUE(filter.query(42));
+  ASSERT_EQ(filter.bits().count(), 3u);
+}
+
+// NOLINTNEXTLINE
+TEST(TestBasicFilter, AtomicStorageSupportsConcurrentPuts) {
+  const uint64_t keys_per_thread = 5000;
+  const unsigned thread_count = 4;
+  Bloom::BasicFilter<Bloom::DigestHashing<>, Bloom::AtomicBitArray> filter(
+      Bloom::Options(1 << 16, 4), Bloom::DoubleHasher(1));
+  std::vector<std::thread> threads;
+  for (unsigned t = 0; t < thread_count; ++t) {
+    threads.emplace_back([&filter, t] {
+      for (uint64_t key = t * keys_per_thread; key < (t + 1) * keys_per_thread;
+           ++key) {
+        filter.put(key);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  Bloom::Filter sequential(Bloom::Options(1 << 16, 4), Bloom::DoubleHasher(1));
+  for (uint64_t key = 0; key < thread_count * keys_per_thread; ++key) {
+    sequential.put(key);
+  }
+  ASSERT_EQ(filter.bits().snapshot(), sequential.bits());
+  std::vector<uint64_t> keys(thread_count * keys_per_thread);
+  std::iota(keys.begin(), keys.end(), 0);
+  std::unique_ptr<bool[]> results(new bool[keys.size()]);
+  filter.query_batch(keys.data(), keys.size(), results.get());
+  ASSERT_TRUE(std::all_of(
+      results.get(), results.get() + keys.size(), [](bool r) { return r; }));
+}
+
+// NOLINTNEXTLINE
+TEST(TestInstrumentedFilter, CountsOperationsAndSamplesLatencies) {
+  const Bloom::Options options(1 << 14, 4);
+  Bloom::InstrumentedFilter filter(options, Bloom::DoubleHasher(1));
+  Bloom::Filter plain(options, Bloom::DoubleHasher(1));
+  for (uint64_t key = 0; key < 1000; ++key) {
+    filter.put(key);
+    plain.put(key);
+  }
+  uint64_t positives = 0;
+  for (uint64_t key = 0; key < 2000; ++key) {
+    ASSERT_EQ(filter.query(key), plain.query(key));
+    positives += filter.query(key) ? 1 : 0;
+  }
+  ASSERT_EQ(filter.bits(), plain.bits());
+
+  auto statistics = filter.statistics();
+  ASSERT_EQ(statistics.counters.puts, 1000);
+  ASSERT_EQ(statistics.counters.queries, 4000);
+  ASSERT_EQ(statistics.counters.positives, 2 * positives);
+  // One in 64 operations is sampled, starting with the first.
+  ASSERT_EQ(statistics.counters.put_latency.count(), 16);
+  ASSERT_EQ(statistics.counters.query_latency.count(), 63);
+  ASSERT_GT(statistics.counters.query_latency.quantile(0.5), 0);
+  ASSERT_DOUBLE_EQ(statistics.fill_ratio, plain.fill_ratio());
+  ASSERT_DOUBLE_EQ(statistics.estimated_false_positive_rate,
+                   plain.estimated_false_positive_rate());
+  ASSERT_DOUBLE_EQ(statistics.estimated_cardinality,
+                   plain.estimated_cardinality());
+
+  std::vector<uint64_t> keys(130);
+  std::iota(keys.begin(), keys.end(), 2000);
+  filter.put_batch(keys.data(), 100);
+  std::vector<uint64_t> bitmap(3);
+  filter.query_batch(keys.data(), keys.size(), bitmap.data());
+  statistics = filter.statistics();
+  ASSERT_EQ(statistics.counters.puts, 1100);
+  ASSERT_EQ(statistics.counters.queries, 4130);
+  ASSERT_EQ(statistics.counters.positives,
+            2 * positives + Bloom::Detail::count_positives(bitmap.data(), 130));
+  ASSERT_GE(statistics.counters.positives, 2 * positives + 100);
+
+  // Copies keep the counts.
+  const Bloom::InstrumentedFilter copy(filter);
+  ASSERT_EQ(copy.statistics().counters.puts, 1100);
+
+  // Without instrumentation, there is nothing to count.
+  ASSERT_EQ(plain.statistics().counters.puts, 0);
+  ASSERT_EQ(plain.statistics().counters.queries, 0);
+  ASSERT_DOUBLE_EQ(plain.statistics().fill_ratio, plain.fill_ratio());
+}
+
+// NOLINTNEXTLINE
+TEST(TestInstrumentedFilter, CountsOperationsOfConcurrentThreads) {
+  using Instrumentation = Bloom::Instrumentation<>;
+  const uint64_t keys_per_thread = 1000;
+  // More threads than shards, so that some of them share a shard.
+  const unsigned thread_count = 2 * Instrumentation::kShardCount + 1;
+  Bloom::BasicFilter<Bloom::DigestHashing<>,
+                     Bloom::AtomicBitArray,
+                     Bloom::RangeReducer,
+                     Instrumentation>
+      filter(Bloom::Options(1 << 17, 4), Bloom::DoubleHasher(1));
+  std::vector<std::thread> threads;
+  for (unsigned t = 0; t < thread_count; ++t) {
+    threads.emplace_back([&filter, t] {
+      for (uint64_t key = t * keys_per_thread; key < (t + 1) * keys_per_thread;
+           ++key) {
+        filter.put(key);
+        filter.query(key);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  // Counts are exact, also of threads sharing a shard. Each shard samples
+  // one in 64 of its operations, starting with the first.
+  const auto counters = filter.statistics().counters;
+  const uint64_t total = thread_count * keys_per_thread;
+  ASSERT_EQ(counters.puts, total);
+  ASSERT_EQ(counters.queries, total);
+  ASSERT_EQ(counters.positives, total);
+  ASSERT_GE(counters.put_latency.count(), total / 64);
+  ASSERT_LE(counters.put_latency.count(),
+            total / 64 + Instrumentation::kShardCount);
+}
+
+// NOLINTNEXTLINE
+TEST(TestInstrumentedFilter, LatencyQuantilesAreBucketBounds) {
+  Bloom::LatencyHistogram histogram;
+  ASSERT_EQ(histogram.quantile(0.5), 0);
+  histogram.buckets[0] = 1;
+  histogram.buckets[3] = 2;
+  histogram.buckets[10] = 1;
+  ASSERT_EQ(histogram.count(), 4);
+  ASSERT_EQ(histogram.quantile(0), 2);
+  ASSERT_EQ(histogram.quantile(0.5), 16);
+  ASSERT_EQ(histogram.quantile(0.75), 16);
+  ASSERT_EQ(histogram.quantile(1), 2048);
+}
+
+// NOLINTNEXTLINE
+TEST(TestFilter, MergeAndIntersectCombineKeysOfBothFilters) {
+  const Bloom::Options options(1 << 16, 5);
+  Bloom::Filter first(options, Bloom::DoubleHasher(7));
+  Bloom::Filter second(options, Bloom::DoubleHasher(7));
+  Bloom::Filter all(options, Bloom::DoubleHasher(7));
+  Bloom::Filter common(options, Bloom::DoubleHasher(7));
+  for (int key = 0; key < 2000; ++key) {
+    first.put(key);
+    all.put(key);
+  }
+  for (int key = 1000; key < 3000; ++key) {
+    second.put(key);
+    all.put(key);
+  }
+  for (int key = 1000; key < 2000; ++key) {
+    common.put(key);
+  }
+
+  Bloom::Filter merged = first;
+  merged.merge(second);
+  ASSERT_EQ(merged.bits(), all.bits());
+
+  Bloom::Filter intersected = first;
+  intersected.intersect(second);
+  for (int key = 1000; key < 2000; ++key) {
+    ASSERT_TRUE(intersected.query(key));
+  }
+  // The intersection keeps the bits of all common keys, plus bits that the
+  // keys of either filter set by chance.
+  Bloom::BitArray extra = intersected.bits();
+  extra |= common.bits();
+  ASSERT_EQ(extra, intersected.bits());
+  ASSERT_LT(intersected.estimated_false_positive_rate(),
+            first.estimated_false_positive_rate());
+}
+
+// NOLINTNEXTLINE
+TEST(TestFilter, MergeAndIntersectThrowForIncompatibleFilters) {
+  Bloom::Filter filter(Bloom::Options(1000, 3), Bloom::DoubleHasher(1));
+  Bloom::Filter other_size(Bloom::Options(1001, 3), Bloom::DoubleHasher(1));
+  Bloom::Filter other_count(Bloom::Options(1000, 4), Bloom::DoubleHasher(1));
+  Bloom::Filter other_seed(Bloom::Options(1000, 3), Bloom::DoubleHasher(2));
+  Bloom::Filter other_scheme(
+      Bloom::Options(1000, 3),
+      Bloom::DoubleHasher(1, Bloom::HashScheme::kWyhashDoubleHashing));
+  for (const auto* other :
+       {&other_size, &other_count, &other_seed, &other_scheme}) {
+    ASSERT_THROW(filter.merge(*other), std::invalid_argument);
+    ASSERT_THROW(filter.intersect(*other), std::invalid_argument);
+  }
+
+  Bloom::Filter custom(1000, {Bloom::DefaultHasher(1)});
+  ASSERT_THROW(custom.merge(custom), std::invalid_argument);
+
+  using Independent =
+      Bloom::BasicFilter<Bloom::IndependentHashing<Bloom::WyHasher64>>;
+  const std::vector<Bloom::WyHasher64> hashers = {Bloom::WyHasher64(1),
+                                                  Bloom::WyHasher64(2)};
+  Independent independent(1000, hashers.begin(), hashers.end());
+  Independent same(1000, hashers.begin(), hashers.end());
+  Independent reversed(1000, hashers.rbegin(), hashers.rend());
+  independent.merge(same);
+  ASSERT_THROW(independent.merge(reversed), std::invalid_argument);
+}
+
+// NOLINTNEXTLINE
+TEST(TestFilter, FiltersFromSeededOptionsAreCompatible) {
+  Bloom::Options options(1 << 16, 5);
+  options.seed = 7;
+  Bloom::Filter first(options);
+  Bloom::Filter second(options);
+  Bloom::Filter explicitly_seeded(options, Bloom::DoubleHasher(7));
+  for (int key = 0; key < 1000; ++key) {
+    first.put(key);
+    explicitly_seeded.put(key);
+    second.put(key + 1000);
+  }
+  ASSERT_EQ(first.bits(), explicitly_seeded.bits());
+  first.merge(second);
+  for (int key = 0; key < 2000; ++key) {
+    ASSERT_TRUE(first.query(key));
+  }
+
+  // Filters with independent hash functions derive each from the seed.
+  using Independent =
+      Bloom::BasicFilter<Bloom::IndependentHashing<Bloom::DefaultHasher>>;
+  Independent independent(options);
+  Independent same(options);
+  same.put(1);
+  independent.put(1);
+  ASSERT_EQ(same.bits(), independent.bits());
+  ASSERT_EQ(same.bits().count(), 5u);  // No two hash functions are the same.
+
+  Bloom::BlockedFilter blocked(options);
+  Bloom::BlockedFilter blocked_same(options);
+  blocked.put(1);
+  blocked_same.put(1);
+  ASSERT_EQ(blocked.bits(), blocked_same.bits());
+
+  // Without a seed, every filter chooses its own.
+  Bloom::Filter random(Bloom::Options(1 << 16, 5));
+  Bloom::Filter other_random(Bloom::Options(1 << 16, 5));
+  ASSERT_THROW(random.merge(other_random), std::invalid_argument);
+}
+
+// NOLINTNEXTLINE
+TEST(TestFilter, SipHashedFiltersRoundTripAndStayCompatible) {
+  Bloom::Filter filter(
+      Bloom::Options(1000, 5),
+      Bloom::DoubleHasher(Bloom::HashScheme::kSipHashDoubleHashing));
+  const uint64_t seed = filter.hashing().double_hasher().seed;
+  Bloom::BasicFilter<Bloom::DigestHashing<Bloom::SipHasher>> compiled(
+      Bloom::Options(1000, 5), Bloom::SipHasher(seed));
+  for (int key = 0; key < 100; ++key) {
+    filter.put(key);
+    compiled.put(key);
+  }
+  ASSERT_EQ(filter.bits(), compiled.bits());
+
+  std::stringstream stream;
+  filter.save(stream);
+  const auto loaded = Bloom::Filter::load(stream);
+  ASSERT_EQ(loaded.hashing().double_hasher().scheme,
+            Bloom::HashScheme::kSipHashDoubleHashing);
+  ASSERT_EQ(loaded.bits(), filter.bits());
+}
+
+// NOLINTNEXTLINE
+TEST(TestFilter, EstimatesMatchInsertedKeys) {
+  Bloom::Filter filter(Bloom::Options(1 << 20, 7), Bloom::DoubleHasher(5));
+  ASSERT_EQ(filter.fill_ratio(), 0);
+  ASSERT_EQ(filter.estimated_cardinality(), 0);
+  ASSERT_EQ(filter.estimated_false_positive_rate(), 0);
+
+  for (const uint64_t count : {1000u, 50000u, 100000u}) {
+    filter.clear();
+    for (uint64_t key = 0; key < count; ++key) {
+      filter.put(key);
+    }
+    // Inserting each key once more must not change the estimates.
+    for (uint64_t key = 0; key < count; ++key) {
+      filter.put(key);
+    }
+    ASSERT_NEAR(filter.estimated_cardinality(), count, 0.02 * count);
+    ASSERT_NEAR(filter.fill_ratio(),
+                1 - std::exp(-7.0 * count / (1 << 20)),
+                0.005);
+    const double expected = theoretical_false_positive_rate(1 << 20, 7, count);
+    ASSERT_NEAR(filter.estimated_false_positive_rate(), expected, expected / 5);
+  }
+
+  Bloom::Filter full(64, 1);
+  for (int key = 0; key < 10000; ++key) {
+    full.put(key);
+  }
+  ASSERT_EQ(full.fill_ratio(), 1);
+  ASSERT_TRUE(std::isinf(full.estimated_cardinality()));
+}
+
+// NOLINTNEXTLINE
+TEST(TestFilter, ParallelBuildHasSameBitsAsSequentialPuts) {
+  // More keys than one round of all threads, and a size that is not a
+  // multiple of the partitions.
+  std::vector<uint64_t> keys(5 * Bloom::Detail::kBuildKeysPerRound + 123);
+  std::iota(keys.begin(), keys.end(), 1000);
+  const Bloom::Options options(3000017, 5);
+  Bloom::Filter sequential(options, Bloom::DoubleHasher(9));
+  for (const auto key : keys) {
+    sequential.put(key);
+  }
+  for (const size_t thread_count : {1, 2, 3, 8}) {
+    const auto built = Bloom::Filter::build(keys.begin(),
+                                            keys.end(),
+                                            options,
+                                            Bloom::DoubleHasher(9),
+                                            thread_count);
+    ASSERT_EQ(built.bits(), sequential.bits()) << thread_count;
+  }
+
+  using Independent =
+      Bloom::BasicFilter<Bloom::IndependentHashing<Bloom::WyHasher64>>;
+  const auto independent = Independent::build(
+      keys.begin(), keys.end(), Bloom::Options(1 << 20, 3), 4);
+  ASSERT_EQ(independent.hash_count(), 3u);
+  for (const auto key : keys) {
+    ASSERT_TRUE(independent.query(key));
+  }
+}
+
+// NOLINTNEXTLINE
+TEST(TestFilter, ParallelBuildRethrowsExceptionsOfWorkers) {
+  struct Hasher {
+    uint64_t unhashable;
+    Bloom::Digest operator()(Bloom::Slice slice) const {
+      uint64_t key;
+      std::memcpy(&key, slice.data(), sizeof key);
+      if (key == unhashable) throw std::runtime_error("unhashable key");
+      return Bloom::DoubleHasher(1)(slice);
+    }
+  };
+  using ThrowingFilter = Bloom::BasicFilter<Bloom::DigestHashing<Hasher>>;
+  const size_t round = Bloom::Detail::kBuildKeysPerRound;
+  std::vector<uint64_t> keys(5 * round);
+  std::iota(keys.begin(), keys.end(), 0);
+  // Keys hashed by the first, second and last thread of a round.
+  for (const uint64_t unhashable : {size_t{7}, round + 7, keys.size() - 1}) {
+    for (const size_t thread_count : {1, 2, 3, 8}) {
+      ASSERT_THROW(ThrowingFilter::build(keys.begin(),
+                                         keys.end(),
+                                         Bloom::Options(1 << 16, 3),
+                                         Hasher{unhashable},
+                                         thread_count),
+                   std::runtime_error)
+          << unhashable << " " << thread_count;
+    }
+  }
+}
+
+// NOLINTNEXTLINE
+TEST(TestFilter, ParallelRunJoinsStartedThreadsIfOneCannotBeStarted) {
+  const size_t thread_count = 4;
+  // Fails to start the third thread, like std::thread when the system is out
+  // of threads.
+  const auto spawn = [](auto function, size_t thread_index) {
+    if (thread_index == 3) {
+      throw std::system_error(
+          std::make_error_code(std::errc::resource_unavailable_try_again));
+    }
+    return std::thread(std::move(function), thread_index);
+  };
+  std::atomic<size_t> calls{0};
+  Bloom::Detail::Barrier barrier(thread_count);
+  ASSERT_THROW(Bloom::Detail::run_in_parallel(
+                   thread_count,
+                   [&](size_t /*unused*/) {
+                     ++calls;
+                     barrier.wait();
+                   },
+                   spawn),
+               std::system_error);
+  ASSERT_EQ(calls.load(), 0u);
+
+  std::vector<int> ran(thread_count);
+  Bloom::Detail::run_in_parallel(
+      thread_count,
+      [&ran, &barrier](size_t thread) {
+        barrier.wait();
+        ran[thread] = 1;
+      },
+      Bloom::Detail::ThreadSpawner());
+  ASSERT_EQ(ran, std::vector<int>(thread_count, 1));
+}
+
+// NOLINTNEXTLINE
+TEST(TestFilter, ParallelBuildAcceptsSlicesAndFewKeys) {
+  const std::vector<std::string> strings = {"a", "bb", "ccc"};
+  std::vector<Bloom::Slice> slices;
+  for (const auto& string : strings) {
+    slices.emplace_back(reinterpret_cast<const uint8_t*>(string.data()),
+                        string.size());
+  }
+  const auto filter =
+      Bloom::Filter::build(slices.begin(), slices.end(), Bloom::Options(64, 2));
+  for (const auto& slice : slices) {
+    ASSERT_TRUE(filter.query(slice));
+  }
+
+  const auto empty = Bloom::Filter::build(
+      slices.end(), slices.end(), Bloom::Options(64, 2), 8);
+  ASSERT_EQ(empty.bits().count(), 0u);
+}
+
+// NOLINTNEXTLINE
+TEST(TestConcurrentFilter, HasSameBitsAsFilterWithSameSeed) {
+  Bloom::ConcurrentFilter concurrent(Bloom::Options(10000, 5),
+                                     Bloom::DoubleHasher(3));
+  Bloom::Filter filter(Bloom::Options(10000, 5), Bloom::DoubleHasher(3));
+  ASSERT_EQ(concurrent.size(), 10000u);
+  ASSERT_EQ(concurrent.hash_count(), 5u);
+  for (int key = 0; key < 500; ++key) {
+    concurrent.put(key);
+    filter.put(key);
+  }
+  ASSERT_EQ(concurrent.bits().snapshot(), filter.bits());
+  concurrent.clear();
+  ASSERT_EQ(concurrent.bits().count(), 0u);
+}
+
+// NOLINTNEXTLINE
+TEST(TestConcurrentFilter, ConcurrentPutsAreAllVisible) {
+  const uint64_t keys_per_thread = 5000;
+  const unsigned thread_count = 8;
+  Bloom::ConcurrentFilter filter(Bloom::Options(1 << 16, 4),
+                                 Bloom::DoubleHasher(1));
+
+  std::vector<std::thread> threads;
+  for (unsigned t = 0; t < thread_count; ++t) {
+    threads.emplace_back([&filter, t] {
+      for (uint64_t key = t * keys_per_thread; key < (t + 1) * keys_per_thread;
+           ++key) {
+        filter.put(key);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  Bloom::Filter sequential(Bloom::Options(1 << 16, 4), Bloom::DoubleHasher(1));
+  for (uint64_t key = 0; key < thread_count * keys_per_thread; ++key) {
+    ASSERT_TRUE(filter.query(key));
+    sequential.put(key);
+  }
+  ASSERT_EQ(filter.bits().snapshot(), sequential.bits());
+}
+
+// NOLINTNEXTLINE
+TEST(TestConcurrentFilter, ConcurrentQueriesFindKeysInsertedBefore) {
+  Bloom::ConcurrentFilter filter(Bloom::Options(1 << 16, 4),
+                                 Bloom::DoubleHasher(1));
+  for (uint64_t key = 0; key < 1000; ++key) {
+    filter.put(key);
+  }
+
+  std::atomic<bool> all_found(true);
+  std::vector<std::thread> threads;
+  // Writers insert new keys while readers query the keys inserted before.
+  for (uint64_t t = 0; t < 4; ++t) {
+    threads.emplace_back([&filter, t] {
+      for (uint64_t key = 1000 + t * 1000; key < 2000 + t * 1000; ++key) {
+        filter.put(key);
+      }
+    });
+    threads.emplace_back([&filter, &all_found] {
+      for (uint64_t key = 0; key < 1000; ++key) {
+        if (!filter.query(key)) all_found = false;
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  ASSERT_TRUE(all_found);
+}
+
+namespace {
+/// Returns a `Filter` of `size` bits with the keys `0..count` inserted.
+Bloom::Filter make_saved_filter(size_t size, uint64_t count) {
+  Bloom::Filter filter(Bloom::Options(size, 5), Bloom::DoubleHasher(3));
+  for (uint64_t key = 0; key < count; ++key) {
+    filter.put(key);
+  }
+  return filter;
+}
+
+/// A file in the working directory that is removed again on destruction.
+struct TemporaryFile {
+  explicit TemporaryFile(std::string path) : path(std::move(path)) {}
+  ~TemporaryFile() { std::remove(path.c_str()); }
+
+  /// Overwrites the file with the given `bytes`.
+  void write(const std::string& bytes) const {
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << bytes;
+  }
+
+  std::string path;
+};
+}  // namespace
+
+// NOLINTNEXTLINE
+TEST(TestSerialization, SaveAndLoadRoundTrips) {
+  for (const size_t size : {size_t{1000}, size_t{1} << 16}) {
+    const auto filter = make_saved_filter(size, 100);
+    std::stringstream stream;
+    filter.save(stream);
+    ASSERT_EQ(stream.str().size(), 64 + (size + 63) / 64 * 8);
+
+    const auto loaded = Bloom::Filter::load(stream);
+    ASSERT_EQ(loaded.size(), filter.size());
+    ASSERT_EQ(loaded.hash_count(), filter.hash_count());
+    ASSERT_EQ(loaded.bits(), filter.bits());
+    for (uint64_t key = 0; key < 1000; ++key) {
+      ASSERT_EQ(loaded.query(key), filter.query(key));
+    }
+  }
+}
+
+// NOLINTNEXTLINE
+TEST(TestSerialization, SaveAndLoadPreserveHashScheme) {
+  Bloom::Filter filter(
+      Bloom::Options(1000, 5),
+      Bloom::DoubleHasher(3, Bloom::HashScheme::kIntegerDoubleHashing));
+  for (uint64_t key = 0; key < 100; ++key) {
+    filter.put(key);
+  }
+  TemporaryFile file("serialization-scheme.bloom");
+  filter.save(file.path);
+
+  const auto loaded = Bloom::Filter::load(file.path);
+  const auto mapped = Bloom::MappedFilter::open(file.path);
+  ASSERT_EQ(mapped.hasher().scheme, Bloom::HashScheme::kIntegerDoubleHashing);
+  for (uint64_t key = 0; key < 1000; ++key) {
+    ASSERT_EQ(loaded.query(key), filter.query(key));
+    ASSERT_EQ(mapped.query(key), filter.query(key));
+  }
+}
+
+// NOLINTNEXTLINE
+TEST(TestSerialization, BasicFilterLoadChecksHashScheme) {
+  using WyFilter = Bloom::BasicFilter<Bloom::DigestHashing<Bloom::WyHasher>>;
+  WyFilter filter(Bloom::Options(1000, 5), Bloom::WyHasher(3));
+  for (uint64_t key = 0; key < 100; ++key) {
+    filter.put(key);
+  }
+  std::stringstream stream;
+  filter.save(stream);
+  const std::string bytes = stream.str();
+
+  std::stringstream input(bytes);
+  const auto loaded = WyFilter::load(input);
+  ASSERT_EQ(loaded.bits(), filter.bits());
+  ASSERT_EQ(loaded.hashing().hasher().seed, 3u);
+
+  // A `Filter` reads any scheme, a `WyHasher` filter only its own.
+  std::stringstream dynamic_input(bytes);
+  const auto dynamic = Bloom::Filter::load(dynamic_input);
+  for (uint64_t key = 0; key < 1000; ++key) {
+    ASSERT_EQ(dynamic.query(key), filter.query(key));
+  }
+  std::stringstream murmur;
+  make_saved_filter(1000, 100).save(murmur);
+  ASSERT_THROW(WyFilter::load(murmur), std::runtime_error);
+}
+
+// NOLINTNEXTLINE
+TEST(TestSerialization, HeaderIsLittleEndian) {
+  std::stringstream stream;
+  make_saved_filter(1000, 10).save(stream);
+  const std::string bytes = stream.str();
+  ASSERT_EQ(bytes.substr(0, 8), "BLOOMCPP");
+  ASSERT_EQ(bytes[8], 1);  // Version.
+  ASSERT_EQ(bytes[12], 1);  // Hash scheme.
+  ASSERT_EQ(static_cast<uint8_t>(bytes[16]), 1000 % 256);
+  ASSERT_EQ(static_cast<uint8_t>(bytes[17]), 1000 / 256);
+  ASSERT_EQ(bytes[24], 5);  // Hash count.
+  ASSERT_EQ(bytes[32], 3);  // Seed.
+}
+
+// NOLINTNEXTLINE
+TEST(TestSerialization, LoadThrowsForInvalidData) {
+  std::stringstream stream;
+  make_saved_filter(1000, 100).save(stream);
+  const std::string bytes = stream.str();
+
+  const auto load = [](const std::string& data) {
+    std::stringstream input(data);
+    return Bloom::Filter::load(input);
+  };
+  ASSERT_THROW(load(""), std::runtime_error);
+  ASSERT_THROW(load(bytes.substr(0, bytes.size() - 1)), std::runtime_error);
+  for (const size_t offset : {size_t{0}, size_t{8}, size_t{20}, size_t{70}}) {
+    std::string corrupt = bytes;
+    corrupt[offset] ^= 1;
+    ASSERT_THROW(load(corrupt), std::runtime_error);
+  }
+}
+
+// NOLINTNEXTLINE
+TEST(TestSerialization, LoadThrowsForSizesWhoseWordsOverflow) {
+  Bloom::Detail::FileHeader header;
+  header.scheme = Bloom::HashScheme::kMurmur3DoubleHashing;
+  header.size = std::numeric_limits<uint64_t>::max() - 10;
+  header.hash_count = 3;
+  header.seed = 0;
+  header.payload_checksum = 0;
+  uint8_t bytes[Bloom::Detail::kHeaderSize];
+  Bloom::Detail::encode_header(header, bytes);
+  const std::string data(reinterpret_cast<const char*>(bytes), sizeof bytes);
+
+  std::stringstream stream(data + std::string(64, '\0'));
+  ASSERT_THROW(Bloom::Filter::load(stream), std::runtime_error);
+
+  const TemporaryFile file("TestSerialization.LoadThrowsForSizes.bloom");
+  file.write(data + std::string(64, '\0'));
+  ASSERT_THROW(Bloom::MappedFilter::open(file.path), std::runtime_error);
+}
+
+// NOLINTNEXTLINE
+TEST(TestSerialization, SaveThrowsForUserProvidedHashFunctions) {
+  Bloom::Filter filter(10, {[](Bloom::Slice) { return 1u; }});
+  std::stringstream stream;
+  ASSERT_THROW(filter.save(stream), std::invalid_argument);
+}
+
+// NOLINTNEXTLINE
+TEST(TestCompression, EveryEncodingRoundTrips) {
+  // Empty, sparse and about half full, with sizes that are and are not a
+  // multiple of 64.
+  std::vector<Bloom::Filter> filters = {make_saved_filter(1000, 0),
+                                        make_saved_filter(1000, 10),
+                                        make_saved_filter(1 << 16, 100),
+                                        make_saved_filter(1 << 16, 10000)};
+  for (const auto& filter : filters) {
+    for (const auto encoding : {Bloom::Encoding::kAuto,
+                                Bloom::Encoding::kRaw,
+                                Bloom::Encoding::kGaps,
+                                Bloom::Encoding::kRuns}) {
+      std::stringstream stream;
+      filter.save_compressed(stream, encoding);
+      const auto loaded = Bloom::Filter::load_compressed(stream);
+      ASSERT_EQ(loaded.size(), filter.size());
+      ASSERT_EQ(loaded.hash_count(), filter.hash_count());
+      ASSERT_EQ(loaded.bits(), filter.bits());
+      for (uint64_t key = 0; key < 1000; ++key) {
+        ASSERT_EQ(loaded.query(key), filter.query(key));
+      }
+    }
+  }
+
+  std::stringstream sparse;
+  make_saved_filter(1 << 16, 100).save_compressed(sparse);
+  ASSERT_LT(sparse.str().size(), (1 << 16) / 8 / 10);
+  // Nothing compresses a filter that is about half full.
+  std::stringstream full;
+  make_saved_filter(1 << 16, 10000).save_compressed(full);
+  ASSERT_EQ(full.str().size(), 64 + 8 + (1 << 16) / 8);
+}
+
+// NOLINTNEXTLINE
+TEST(TestCompression, DeltasTurnTheBaseIntoTheNewVersion) {
+  const auto base = make_saved_filter(1 << 16, 5000);
+  auto next = base;
+  for (uint64_t key = 100000; key < 100050; ++key) {
+    next.put(key);
+  }
+  std::stringstream delta;
+  next.save_delta(delta, base);
+  // About 10 bits per key.
+  ASSERT_LT(delta.str().size(), 64 + 8 + 50 * 5 * 2);
+  const std::string bytes = delta.str();
+
+  const auto loaded = Bloom::Filter::load_delta(delta, base);
+  ASSERT_EQ(loaded.bits(), next.bits());
+  for (uint64_t key = 100000; key < 100050; ++key) {
+    ASSERT_TRUE(loaded.query(key));
+  }
+
+  std::stringstream wrong_base(bytes);
+  ASSERT_THROW(Bloom::Filter::load_delta(wrong_base, next), std::runtime_error);
+  std::stringstream not_a_filter(bytes);
+  ASSERT_THROW(Bloom::Filter::load_compressed(not_a_filter),
+               std::runtime_error);
+  std::stringstream not_a_delta;
+  next.save_compressed(not_a_delta);
+  ASSERT_THROW(Bloom::Filter::load_delta(not_a_delta, base),
+               std::runtime_error);
+  std::stringstream other;
+  ASSERT_THROW(next.save_delta(other, make_saved_filter(1000, 10)),
+               std::invalid_argument);
+}
+
+// NOLINTNEXTLINE
+TEST(TestCompression, ReadsNothingPastTheFilter) {
+  const auto first = make_saved_filter(1000, 10);
+  const auto second = make_saved_filter(1 << 16, 100);
+  std::stringstream stream;
+  first.save_compressed(stream, Bloom::Encoding::kGaps);
+  second.save_compressed(stream, Bloom::Encoding::kRuns);
+  second.save_delta(stream, second);
+  stream << "end";
+  ASSERT_EQ(Bloom::Filter::load_compressed(stream).bits(), first.bits());
+  ASSERT_EQ(Bloom::Filter::load_compressed(stream).bits(), second.bits());
+  ASSERT_EQ(Bloom::Filter::load_delta(stream, second).bits(), second.bits());
+  std::string rest;
+  stream >> rest;
+  ASSERT_EQ(rest, "end");
+}
+
+// NOLINTNEXTLINE
+TEST(TestCompression, LoadThrowsForInvalidData) {
+  const auto load = [](const std::string& data) {
+    std::stringstream input(data);
+    return Bloom::Filter::load_compressed(input);
+  };
+  for (const auto encoding : {Bloom::Encoding::kRaw,
+                              Bloom::Encoding::kGaps,
+                              Bloom::Encoding::kRuns}) {
+    std::stringstream stream;
+    make_saved_filter(1 << 12, 100).save_compressed(stream, encoding);
+    const std::string bytes = stream.str();
+    ASSERT_EQ(bytes.substr(0, 8), "BLOOMCMP");
+    ASSERT_THROW(load(bytes.substr(0, bytes.size() - 1)), std::runtime_error);
+    for (size_t offset = 0; offset < bytes.size(); offset += 7) {
+      std::string corrupt = bytes;
+      corrupt[offset] ^= 4;
+      ASSERT_THROW(load(corrupt), std::runtime_error);
+    }
+  }
+  ASSERT_THROW(load(""), std::runtime_error);
+  std::stringstream uncompressed;
+  make_saved_filter(1000, 10).save(uncompressed);
+  ASSERT_THROW(load(uncompressed.str()), std::runtime_error);
+}
+
+// NOLINTNEXTLINE
+TEST(TestMappedFilter, QueriesMatchSavedFilter) {
+  const TemporaryFile file("TestMappedFilter.QueriesMatchSavedFilter.bloom");
+  const auto filter = make_saved_filter(100000, 10000);
+  filter.save(file.path);
+
+  const auto mapped = Bloom::MappedFilter::open(file.path);
+  ASSERT_EQ(mapped.size(), filter.size());
+  ASSERT_EQ(mapped.hash_count(), filter.hash_count());
+  ASSERT_EQ(mapped.hasher().seed, 3u);
+  ASSERT_TRUE(mapped.verify());
+#if defined(BLOOM_HAS_MMAP)
+  ASSERT_TRUE(mapped.is_mapped());
+#endif
+  ASSERT_EQ(reinterpret_cast<uintptr_t>(mapped.words()) % 64, 0u);
+  for (uint64_t key = 0; key < 20000; ++key) {
+    ASSERT_EQ(mapped.query(key), filter.query(key));
+  }
+}
+
+// NOLINTNEXTLINE
+TEST(TestMappedFilter, OpenValidatesHeaderAndVerifyChecksBits) {
+  const TemporaryFile file("TestMappedFilter.OpenValidatesHeader.bloom");
+  ASSERT_THROW(Bloom::MappedFilter::open(file.path), std::runtime_error);
+
+  std::stringstream stream;
+  make_saved_filter(1000, 100).save(stream);
+  const std::string bytes = stream.str();
+
+  file.write(bytes.substr(0, 32));
+  ASSERT_THROW(Bloom::MappedFilter::open(file.path), std::runtime_error);
+  file.write(bytes.substr(0, bytes.size() - 8));
+  ASSERT_THROW(Bloom::MappedFilter::open(file.path), std::runtime_error);
+
+  std::string corrupt = bytes;
+  corrupt[20] ^= 1;
+  file.write(corrupt);
+  ASSERT_THROW(Bloom::MappedFilter::open(file.path), std::runtime_error);
+
+  corrupt = bytes;
+  corrupt[100] ^= 1;
+  file.write(corrupt);
+  ASSERT_FALSE(Bloom::MappedFilter::open(file.path).verify());
+}
+
+// NOLINTNEXTLINE
+TEST(TestCountingFilter, SizeAndHashCountAsExpected) {
+  Bloom::CountingFilter<> four(Bloom::Options(1000, 5));
+  ASSERT_EQ(four.size(), 1000u);
+  ASSERT_EQ(four.hash_count(), 5u);
+  ASSERT_EQ(four.counters().size(), 4000u);
+
+  Bloom::CountingFilter<8> eight(1000, 5);
+  ASSERT_EQ(eight.counters().size(), 8000u);
+}
+
+// NOLINTNEXTLINE
+TEST(TestCountingFilter, RemovedKeysAreNoLongerFound) {
+  Bloom::CountingFilter<> filter(Bloom::Options(100000, 7),
+                                 Bloom::DoubleHasher(1));
+  for (uint64_t key = 0; key < 2000; ++key) {
+    filter.put(key);
+  }
+  for (uint64_t key = 0; key < 2000; key += 2) {
+    ASSERT_TRUE(filter.remove(key));
+  }
+
+  size_t false_positives = 0;
+  for (uint64_t key = 0; key < 2000; key += 2) {
+    ASSERT_TRUE(filter.query(key + 1));
+    false_positives += filter.query(key) ? 1 : 0;
+  }
+  ASSERT_LT(false_positives, 5u);
+
+  for (uint64_t key = 1; key < 2000; key += 2) {
+    ASSERT_TRUE(filter.remove(key));
+  }
+  ASSERT_EQ(filter.counters().count(), 0u);
+}
+
+// NOLINTNEXTLINE
+TEST(TestCountingFilter, RemoveReturnsFalseForMissingKeys) {
+  Bloom::CountingFilter<> filter(Bloom::Options(1000, 3));
+  filter.put(1);
+  ASSERT_FALSE(filter.remove(2));
+  ASSERT_TRUE(filter.query(1));
+  ASSERT_TRUE(filter.remove(1));
+  ASSERT_FALSE(filter.remove(1));
+}
+
+// NOLINTNEXTLINE
+TEST(TestCountingFilter, EstimateCountCountsRepeatedPuts) {
+  Bloom::CountingFilter<> filter(Bloom::Options(1000, 3));
+  ASSERT_EQ(filter.estimate_count(1), 0u);
+  for (int i = 0; i < 3; ++i) {
+    filter.put(1);
+  }
+  ASSERT_GE(filter.estimate_count(1), 3u);
+  filter.remove(1);
+  ASSERT_GE(filter.estimate_count(1), 2u);
+}
+
+// NOLINTNEXTLINE
+TEST(TestCountingFilter, CountersSaturateAndStick) {
+  Bloom::CountingFilter<> four(Bloom::Options(64, 1));
+  Bloom::CountingFilter<8> eight(Bloom::Options(64, 1));
+  for (int i = 0; i < 300; ++i) {
+    four.put(1);
+    eight.put(1);
+  }
+  ASSERT_EQ(four.estimate_count(1), 15u);
+  ASSERT_EQ(eight.estimate_count(1), 255u);
+  ASSERT_EQ(four.counters().count(), 4u);
+
+  // A saturated counter may have been incremented by other keys too.
+  for (int i = 0; i < 300; ++i) {
+    four.remove(1);
+    eight.remove(1);
+  }
+  ASSERT_TRUE(four.query(1));
+  ASSERT_TRUE(eight.query(1));
+}
+
+// NOLINTNEXTLINE
+TEST(TestCountingFilter, FindsSameKeysAsFilterWithSameHashing) {
+  Bloom::Filter filter(Bloom::Options(1000, 4), Bloom::DoubleHasher(5));
+  Bloom::CountingFilter<> counting(Bloom::Options(1000, 4),
+                                   Bloom::DoubleHasher(5));
+  for (uint64_t key = 0; key < 100; ++key) {
+    filter.put(key);
+    counting.put(key);
+  }
+  for (uint64_t key = 0; key < 2000; ++key) {
+    ASSERT_EQ(counting.query(key), filter.query(key));
+  }
+
+  Bloom::CountingFilter<> custom(10, {[](Bloom::Slice) { return 3u; }});
+  custom.put(1);
+  ASSERT_TRUE(custom.query(2));
+  ASSERT_EQ(custom.estimate_count(2), 1u);
+}
+
+// NOLINTNEXTLINE
+TEST(TestScalableFilter, AddsStagesAsKeysAreInserted) {
+  Bloom::ScalableFilter filter(1000, 0.01, Bloom::DoubleHasher(1));
+  ASSERT_EQ(filter.stage_count(), 1);
+  const size_t initial_size = filter.size();
+  for (uint64_t key = 0; key < 100000; ++key) {
+    filter.put(key);
+  }
+  // Capacities 1000, 2000, ..., 64000 add up to more than 100000 keys.
+  ASSERT_GE(filter.stage_count(), 6);
+  ASSERT_LE(filter.stage_count(), 8);
+  ASSERT_GT(filter.size(), 100 * initial_size);
+  for (uint64_t key = 0; key < 100000; ++key) {
+    ASSERT_TRUE(filter.query(key));
+  }
+
+  filter.clear();
+  ASSERT_EQ(filter.stage_count(), 1);
+  ASSERT_EQ(filter.size(), initial_size);
+  ASSERT_FALSE(filter.query(1));
+}
+
+// NOLINTNEXTLINE
+TEST(TestScalableFilter, FalsePositiveRateStaysBelowBound) {
+  for (const double growth_factor : {2.0, 4.0}) {
+    Bloom::ScalableFilter filter(
+        100, 0.01, Bloom::DoubleHasher(2), growth_factor, 0.8);
+    const double rate = empirical_false_positive_rate(filter, 100000);
+    ASSERT_LT(rate, filter.false_positive_rate());
+    ASSERT_LT(filter.estimated_false_positive_rate(),
+              filter.false_positive_rate());
+    ASSERT_NEAR(rate, filter.estimated_false_positive_rate(), 0.002);
+  }
+}
+
+// NOLINTNEXTLINE
+TEST(TestScalableFilter, ThrowsForInvalidParameters) {
+  ASSERT_THROW(Bloom::ScalableFilter(0, 0.01), std::invalid_argument);
+  ASSERT_THROW(Bloom::ScalableFilter(10, 0), std::invalid_argument);
+  ASSERT_THROW(Bloom::ScalableFilter(10, 1), std::invalid_argument);
+  ASSERT_THROW(Bloom::ScalableFilter(10, 0.01, 0.5), std::invalid_argument);
+  ASSERT_THROW(Bloom::ScalableFilter(10, 0.01, 2, 1), std::invalid_argument);
+}
+
+namespace {
+/// Returns the fraction of the `count` keys starting at `first` that the
+/// `filter` (falsely) reports as present.
+template <typename Filter>
+double false_positive_rate_from(const Filter& filter,
+                                uint64_t first,
+                                uint64_t count) {
+  uint64_t false_positives = 0;
+  for (uint64_t key = first; key < first + count; ++key) {
+    false_positives += filter.query(key) ? 1 : 0;
+  }
+  return static_cast<double>(false_positives) / count;
+}
+}  // namespace
+
+// NOLINTNEXTLINE
+TEST(TestBinaryFuseFilter, FindsAllKeysAndFalsePositiveRateMatchesBits) {
+  std::vector<uint64_t> keys(1 << 18);
+  std::iota(keys.begin(), keys.end(), 0);
+  const auto eight =
+      Bloom::BinaryFuseFilter<uint8_t>::build(keys.begin(), keys.end(), 1);
+  const auto sixteen =
+      Bloom::BinaryFuseFilter<uint16_t>::build(keys.begin(), keys.end(), 1);
+  ASSERT_EQ(eight.key_count(), keys.size());
+  for (const auto key : keys) {
+    ASSERT_TRUE(eight.query(key));
+    ASSERT_TRUE(sixteen.query(key));
+  }
+
+  // About 1.16 fingerprints per key for this many keys, and 1.125 for more.
+  ASSERT_LT(static_cast<double>(eight.size()) / keys.size(), 8 * 1.17);
+  ASSERT_LT(static_cast<double>(sixteen.size()) / keys.size(), 16 * 1.17);
+  ASSERT_NEAR(false_positive_rate_from(eight, keys.size(), 1 << 18),
+              1.0 / 256,
+              0.0005);
+  ASSERT_LT(false_positive_rate_from(sixteen, keys.size(), 1 << 18),
+            3.0 / 65536);
+}
+
+// NOLINTNEXTLINE
+TEST(TestBinaryFuseFilter, HandlesDuplicatesAndSmallKeySets) {
+  for (size_t count = 0; count < 100; ++count) {
+    std::vector<uint64_t> keys;
+    for (uint64_t key = 0; key < count; ++key) {
+      keys.push_back(key);
+      keys.push_back(key);
+    }
+    const auto filter =
+        Bloom::BinaryFuseFilter<>::build(keys.begin(), keys.end(), count);
+    ASSERT_EQ(filter.key_count(), count);
+    for (const auto key : keys) {
+      ASSERT_TRUE(filter.query(key));
+    }
+  }
+
+  const std::vector<std::string> strings = {"alpha", "beta", "gamma"};
+  std::vector<Bloom::Slice> slices;
+  for (const auto& string : strings) {
+    slices.emplace_back(reinterpret_cast<const uint8_t*>(string.data()),
+                        string.size());
+  }
+  const auto filter =
+      Bloom::BinaryFuseFilter<uint16_t>::build(slices.begin(), slices.end());
+  std::unique_ptr<bool[]> batch(new bool[slices.size()]);
+  filter.query_batch(slices.data(), slices.size(), batch.get());
+  for (size_t i = 0; i < slices.size(); ++i) {
+    ASSERT_TRUE(filter.query(slices[i]));
+    ASSERT_TRUE(batch[i]);
+  }
+}
+
+// NOLINTNEXTLINE
+TEST(TestBinaryFuseFilter, SaveLoadAndMapRoundTrip) {
+  const TemporaryFile file("TestBinaryFuseFilter.SaveLoadAndMap.bloom");
+  std::vector<uint64_t> keys(10000);
+  std::iota(keys.begin(), keys.end(), 0);
+  const auto filter =
+      Bloom::BinaryFuseFilter<uint16_t>::build(keys.begin(), keys.end(), 7);
+  filter.save(file.path);
+
+  const auto loaded = Bloom::BinaryFuseFilter<uint16_t>::load(file.path);
+  const auto mapped = Bloom::MappedBinaryFuseFilter<uint16_t>::open(file.path);
+  ASSERT_EQ(loaded.seed(), filter.seed());
+  ASSERT_EQ(mapped.key_count(), keys.size());
+  ASSERT_EQ(mapped.size(), filter.size());
+  ASSERT_TRUE(mapped.verify());
+#if defined(BLOOM_HAS_MMAP)
+  ASSERT_TRUE(mapped.is_mapped());
+#endif
+  ASSERT_TRUE(std::equal(filter.fingerprints(),
+                         filter.fingerprints() + filter.fingerprint_count(),
+                         loaded.fingerprints()));
+  for (uint64_t key = 0; key < 2 * keys.size(); ++key) {
+    ASSERT_EQ(loaded.query(key), filter.query(key));
+    ASSERT_EQ(mapped.query(key), filter.query(key));
+  }
+
+  ASSERT_THROW(Bloom::BinaryFuseFilter<uint8_t>::load(file.path),
+               std::runtime_error);
+  ASSERT_THROW(Bloom::MappedBinaryFuseFilter<uint8_t>::open(file.path),
+               std::runtime_error);
+  ASSERT_THROW(Bloom::MappedFilter::open(file.path), std::runtime_error);
+
+  std::stringstream stream;
+  filter.save(stream);
+  const std::string bytes = stream.str();
+  file.write(bytes.substr(0, bytes.size() - 2));
+  ASSERT_THROW(Bloom::BinaryFuseFilter<uint16_t>::load(file.path),
+               std::runtime_error);
+  ASSERT_THROW(Bloom::MappedBinaryFuseFilter<uint16_t>::open(file.path),
+               std::runtime_error);
+  std::string corrupt = bytes;
+  corrupt[100] ^= 1;
+  file.write(corrupt);
+  ASSERT_THROW(Bloom::BinaryFuseFilter<uint16_t>::load(file.path),
+               std::runtime_error);
+  ASSERT_FALSE(
+      Bloom::MappedBinaryFuseFilter<uint16_t>::open(file.path).verify());
+}
+
+// NOLINTNEXTLINE
+TEST(TestBinaryFuseFilter, LoadThrowsForSegmentsWhoseSizeOverflows) {
+  Bloom::Detail::FuseHeader header;
+  header.fingerprint_bits = 16;
+  header.key_count = 10;
+  header.segment_length = 4;
+  header.segment_count_length = std::numeric_limits<uint64_t>::max() - 7;
+  header.seed = 0;
+  header.payload_checksum = 0;
+  uint8_t bytes[Bloom::Detail::kHeaderSize];
+  Bloom::Detail::encode_header(header, bytes);
+  const std::string data(reinterpret_cast<const char*>(bytes), sizeof bytes);
+
+  const TemporaryFile file("TestBinaryFuseFilter.LoadThrowsForSegments.bloom");
+  file.write(data + std::string(64, '\0'));
+  ASSERT_THROW(Bloom::BinaryFuseFilter<uint16_t>::load(file.path),
+               std::runtime_error);
+  ASSERT_THROW(Bloom::MappedBinaryFuseFilter<uint16_t>::open(file.path),
+               std::runtime_error);
+}
+
+// NOLINTNEXTLINE
+TEST(TestCuckooFilter, RemovedKeysAreNoLongerFound) {
+  Bloom::CuckooFilter<> filter(10000, Bloom::DoubleHasher(1));
+  ASSERT_EQ(filter.bucket_count(), 2632u);
+  ASSERT_EQ(filter.size(), 2632u * 48);
+  for (uint64_t key = 0; key < 10000; ++key) {
+    ASSERT_TRUE(filter.put(key));
+  }
+  ASSERT_EQ(filter.count(), 10000u);
+  ASSERT_NEAR(filter.load_factor(), 0.95, 0.001);
+  for (uint64_t key = 0; key < 10000; key += 2) {
+    ASSERT_TRUE(filter.remove(key));
+  }
+  for (uint64_t key = 1; key < 10000; key += 2) {
+    ASSERT_TRUE(filter.query(key));
+  }
+  ASSERT_EQ(filter.count(), 5000u);
+
+  // Neighbouring 12-bit slots share bytes, so an empty filter finds nothing
+  // only if every removal cleared exactly its own slot.
+  for (uint64_t key = 1; key < 10000; key += 2) {
+    ASSERT_TRUE(filter.remove(key));
+  }
+  ASSERT_EQ(filter.count(), 0u);
+  for (uint64_t key = 0; key < 10000; ++key) {
+    ASSERT_FALSE(filter.query(key));
+    ASSERT_FALSE(filter.remove(key));
+  }
+}
+
+// NOLINTNEXTLINE
+TEST(TestCuckooFilter, FailedPutLeavesFilterUnchanged) {
+  Bloom::CuckooFilter<8> filter(1000, Bloom::DoubleHasher(2));
+  uint64_t key = 0;
+  while (filter.put(key)) {
+    ++key;
+  }
+  ASSERT_EQ(filter.count(), key);
+  ASSERT_GT(filter.load_factor(), 0.9);
+  for (uint64_t inserted = 0; inserted < key; ++inserted) {
+    ASSERT_TRUE(filter.query(inserted));
+  }
+
+  filter.clear();
+  ASSERT_EQ(filter.count(), 0u);
+  // Both buckets of a key hold four copies at most.
+  for (int i = 0; i < 8; ++i) {
+    ASSERT_TRUE(filter.put(7));
+  }
+  ASSERT_FALSE(filter.put(7));
+  ASSERT_EQ(filter.count(), 8u);
+  for (int i = 0; i < 8; ++i) {
+    ASSERT_TRUE(filter.remove(7));
+  }
+  ASSERT_FALSE(filter.query(7));
+}
+
+namespace {
+/// Fills a `CuckooFilter` with `FingerprintBits`-bit fingerprints to capacity
+/// and returns its false positive rate.
+template <size_t FingerprintBits>
+double cuckoo_false_positive_rate() {
+  Bloom::CuckooFilter<FingerprintBits> filter(1 << 16, Bloom::DoubleHasher(3));
+  for (uint64_t key = 0; key < (1 << 16); ++key) {
+    EXPECT_TRUE(filter.put(key));
+  }
+  return false_positive_rate_from(filter, 1 << 16, 1 << 18);
+}
+}  // namespace
+
+// NOLINTNEXTLINE
+TEST(TestCuckooFilter, FalsePositiveRateMatchesFingerprintBits) {
+  // About 8 * load_factor / 2^FingerprintBits.
+  ASSERT_NEAR(cuckoo_false_positive_rate<8>(), 0.95 * 8 / 256, 0.005);
+  ASSERT_NEAR(cuckoo_false_positive_rate<12>(), 0.95 * 8 / 4096, 0.0005);
+  ASSERT_LT(cuckoo_false_positive_rate<16>(), 0.0003);
+}
+
+// NOLINTNEXTLINE
+TEST(TestNuma, ParsesIdListsAndReportsNodes) {
+  ASSERT_EQ(Bloom::Detail::parse_id_list("0-3,8,10-11\n"),
+            (std::vector<size_t>{0, 1, 2, 3, 8, 10, 11}));
+  ASSERT_EQ(Bloom::Detail::parse_id_list("1"), std::vector<size_t>{1});
+  ASSERT_TRUE(Bloom::Detail::parse_id_list("").empty());
+  ASSERT_TRUE(Bloom::Detail::parse_id_list("x-1").empty());
+
+  ASSERT_GE(Bloom::numa_node_count(), 1);
+  ASSERT_LT(Bloom::current_numa_node(), Bloom::numa_node_count());
+
+  // Nodes that do not exist are run on unpinned threads.
+  std::vector<int> ran(3);
+  std::vector<int> pinned(3);
+  Bloom::Detail::run_on_numa_nodes(3, [&](size_t node, bool is_pinned) {
+    ran[node] = 1;
+    pinned[node] = is_pinned;
+  });
+  ASSERT_EQ(ran, (std::vector<int>{1, 1, 1}));
+  ASSERT_EQ(pinned[2], Bloom::numa_node_count() > 2);
+  ASSERT_THROW(
+      Bloom::Detail::run_on_numa_nodes(2,
+                                       [](size_t node, bool /*unused*/) {
+                                         if (node == 1) {
+                                           throw std::bad_alloc();
+                                         }
+                                       }),
+      std::bad_alloc);
+
+  // If a thread cannot be started, those already started are joined.
+  std::atomic<size_t> calls{0};
+  const auto spawn = [](auto function, size_t node) {
+    if (node == 2) {
+      throw std::system_error(
+          std::make_error_code(std::errc::resource_unavailable_try_again));
+    }
+    return std::thread(std::move(function), node);
+  };
+  const auto count = [&calls](size_t /*unused*/, bool /*unused*/) {
+    ++calls;
+  };
+  ASSERT_THROW(Bloom::Detail::run_on_numa_nodes(3, count, spawn),
+               std::system_error);
+  ASSERT_EQ(calls.load(), 2u);
+}
+
+// NOLINTNEXTLINE
+TEST(TestPartitionedFilter, SizeAndPartitionsAsExpected) {
+  Bloom::PartitionedFilter<> filter(Bloom::Options(1001, 3), 4);
+  ASSERT_EQ(filter.partition_count(), 4);
+  ASSERT_EQ(filter.partition_size(), 251);
+  ASSERT_EQ(filter.size(), 1004);
+  ASSERT_EQ(filter.hash_count(), 3);
+  for (size_t partition = 0; partition < 4; ++partition) {
+    ASSERT_EQ(filter.bits(partition).size(), 251);
+    ASSERT_EQ(filter.numa_node(partition),
+              partition % Bloom::numa_node_count());
+  }
+
+  ASSERT_THROW(Bloom::PartitionedFilter<>(Bloom::Options(10, 3), 0),
+               std::invalid_argument);
+  ASSERT_THROW(Bloom::PartitionedFilter<>(Bloom::Options(10, 3), 11),
+               std::invalid_argument);
+  const Bloom::PartitionedFilter<> per_node(Bloom::Options(10, 3));
+  ASSERT_EQ(per_node.partition_count(), Bloom::numa_node_count());
+}
+
+// NOLINTNEXTLINE
+TEST(TestPartitionedFilter, KeysGoToTheirPartitionOnly) {
+  Bloom::PartitionedFilter<> filter(
+      Bloom::Options(1 << 16, 4), 8, Bloom::DoubleHasher(1));
+  std::vector<size_t> keys_per_partition(8);
+  std::vector<size_t> bits_per_partition(8);
+  for (uint64_t key = 0; key < 8000; ++key) {
+    const size_t partition = filter.partition_of(key);
+    filter.put(key);
+    ASSERT_TRUE(filter.query(key));
+    ++keys_per_partition[partition];
+    // Only the bits of the key's partition have changed.
+    for (size_t other = 0; other < 8; ++other) {
+      if (other != partition) {
+        ASSERT_EQ(filter.bits(other).count(), bits_per_partition[other]);
+      }
+    }
+    bits_per_partition[partition] = filter.bits(partition).count();
+  }
+  for (const size_t count : keys_per_partition) {
+    ASSERT_NEAR(count, 1000, 150);
+  }
+
+  filter.clear();
+  for (size_t partition = 0; partition < 8; ++partition) {
+    ASSERT_EQ(filter.bits(partition).count(), 0);
+  }
+}
+
+// NOLINTNEXTLINE
+TEST(TestPartitionedFilter, FalsePositiveRateMatchesFilter) {
+  const size_t count = 20000;
+  const Bloom::Options options = Bloom::Options::ForExpectedCount(
+      static_cast<size_t>(count * 10), count);
+  for (const size_t partition_count : {1, 3, 16}) {
+    Bloom::PartitionedFilter<> filter(
+        options, partition_count, Bloom::DoubleHasher(2));
+    ASSERT_NEAR(
+        empirical_false_positive_rate(filter, count),
+        theoretical_false_positive_rate(
+            filter.size(), options.hash_count, count),
+        0.003);
+  }
+}
+
+// NOLINTNEXTLINE
+TEST(TestSlidingWindowFilter, KeysExpireAfterAllGenerations) {
+  Bloom::SlidingWindowFilter<4> filter(Bloom::Options(1000, 3),
+                                       Bloom::DoubleHasher(1));
+  ASSERT_EQ(filter.size(), 1000);
+  ASSERT_EQ(filter.hash_count(), 3);
+  ASSERT_EQ(filter.generation_count(), 4);
+  ASSERT_EQ(filter.slots().size(), 4000);
+
+  filter.put("old");
+  for (size_t step = 1; step < 4; ++step) {
+    filter.advance();
+    ASSERT_EQ(filter.current_generation(), step);
+    ASSERT_TRUE(filter.query("old"));
+  }
+  filter.put("new");
+  filter.advance();
+  ASSERT_EQ(filter.current_generation(), 0);
+  ASSERT_FALSE(filter.query("old"));
+  ASSERT_TRUE(filter.query("new"));
+  ASSERT_EQ(filter.slots().count(), 3);
+
+  // "new" is in the oldest generation but one.
+  filter.advance(2);
+  ASSERT_EQ(filter.current_generation(), 2);
+  ASSERT_TRUE(filter.query("new"));
+  filter.advance(1);
+  ASSERT_EQ(filter.slots().count(), 0);
+
+  filter.put("new");
+  filter.advance(4);
+  ASSERT_EQ(filter.slots().count(), 0);
+  ASSERT_FALSE(filter.query("new"));
+}
+
+// NOLINTNEXTLINE
+TEST(TestSlidingWindowFilter, SixtyFourGenerationsFillWholeWords) {
+  Bloom::SlidingWindowFilter<64> filter(Bloom::Options(100, 4),
+                                        Bloom::DoubleHasher(1));
+  ASSERT_EQ(filter.slots().word_count(), 100);
+  for (size_t step = 0; step < 64; ++step) {
+    filter.put(step);
+    filter.advance();
+  }
+  // Key 0 was dropped by the last step, the others are still in the window.
+  ASSERT_FALSE(filter.query(0));
+  for (size_t step = 1; step < 64; ++step) {
+    ASSERT_TRUE(filter.query(step));
+  }
+}
+
+// NOLINTNEXTLINE
+TEST(TestSlidingWindowFilter, AnswersLikeOneFilterPerGeneration) {
+  const Bloom::Options options(1 << 12, 4);
+  Bloom::SlidingWindowFilter<8> window(options, Bloom::DoubleHasher(5));
+  std::vector<Bloom::Filter> filters(
+      8, Bloom::Filter(options, Bloom::DoubleHasher(5)));
+  uint64_t key = 0;
+  for (size_t step = 0; step < 20; ++step) {
+    for (size_t i = 0; i < 300; ++i, ++key) {
+      window.put(key);
+      filters[step % 8].put(key);
+    }
+    for (uint64_t probe = 0; probe < key + 1000; ++probe) {
+      const bool expected =
+          std::any_of(filters.begin(), filters.end(), [probe](auto& filter) {
+            return filter.query(probe);
+          });
+      ASSERT_EQ(window.query(probe), expected) << probe;
+    }
+    window.advance();
+    filters[(step + 1) % 8].clear();
+  }
+}
+
+// NOLINTNEXTLINE
+TEST(TestSlidingWindowFilter, FiltersFromSeededOptionsAreCompatible) {
+  Bloom::Options options(1000, 3);
+  options.seed = 42;
+  Bloom::SlidingWindowFilter<> first(options);
+  Bloom::SlidingWindowFilter<> second(options);
+  first.put("key");
+  second.put("key");
+  ASSERT_EQ(first.slots(), second.slots());
+}
@@ -0,0 +1,181 @@
+/// Writes a header defining a `Bloom::StaticFilter` over a list of keys that is
+/// built at compile time, so that it is placed in read-only memory and takes
+/// no work at startup.
+///
+/// Usage:
+///
+///   bloom-generate <name> [--fpr <rate>] [--seed <seed>]
+///                         [--input <file>] [--output <file>]
+///
+/// The keys are read one per line from the input (standard input by default).
+/// The header, written to the output (standard output by default), defines the
+/// keys as `<name>Keys` and the filter as `<name>`:
+///
+///   constexpr Bloom::StaticKey <name>Keys[] = {...};
+///   constexpr auto <name> =
+///       Bloom::StaticFilter<N, k, Bloom::WyHasher>::build(<name>Keys, ...);
+///
+/// The filter is sized for the false positive rate (1% by default). Unless
+/// given, the seed is chosen at random and recorded in the header; pass it
+/// again to reproduce the same header.
+
+#include <bloom/hash.hpp>
+#include <bloom/options.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Arguments {
+  std::string name;
+  double false_positive_rate = 0.01;
+  uint64_t seed = Bloom::Detail::random_seed();
+  std::string input;
+  std::string output;
+};
+
+Arguments parse_arguments(int argc, char** argv) {
+  Arguments arguments;
+  for (int i = 1; i < argc; ++i) {
+    const std::string argument = argv[i];
+    if (argument.compare(0, 2, "--") != 0) {
+      if (!arguments.name.empty()) {
+        throw std::invalid_argument("more than one name given");
+      }
+      arguments.name = argument;
+      continue;
+    }
+    if (i + 1 == argc) {
+      throw std::invalid_argument("missing value for " + argument);
+    }
+    const std::string value = argv[++i];
+    if (argument == "--fpr") {
+      arguments.false_positive_rate = std::stod(value);
+    } else if (argument == "--seed") {
+      arguments.seed = std::stoull(value, nullptr, 0);
+    } else if (argument == "--input") {
+      arguments.input = value;
+    } else if (argument == "--output") {
+      arguments.output = value;
+    } else {
+      throw std::invalid_argument("unknown option " + argument);
+    }
+  }
+  if (arguments.name.empty()) {
+    throw std::invalid_argument("no name given");
+  }
+  if (!(arguments.false_positive_rate > 0 &&
+        arguments.false_positive_rate < 1)) {
+    throw std::invalid_argument("the false positive rate must be in (0, 1)");
+  }
+  return arguments;
+}
+
+std::vector<std::string> read_keys(std::istream& input) {
+  std::vector<std::string> keys;
+  std::string line;
+  while (std::getline(input, line)) {
+    if (!line.empty() && line.back() == '\r') line.pop_back();
+    keys.push_back(line);
+  }
+  std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+  return keys;
+}
+
+/// Returns `key` as the body of a C++ string literal. All bytes but printable
+/// ASCII are escaped in octal, with three digits so that no digit following
+/// an escape is taken to be part of it.
+std::string escape(const std::string& key) {
+  std::string escaped;
+  for (const char character : key) {
+    const auto byte = static_cast<unsigned char>(character);
+    if (byte >= 0x20 && byte < 0x7f && byte != '"' && byte != '\\' &&
+        byte != '?') {
+      escaped += character;
+    } else {
+      char octal[5];
+      std::snprintf(octal, sizeof octal, "\\%03o", byte);
+      escaped += octal;
+    }
+  }
+  return escaped;
+}
+
+void write_header(std::ostream& output,
+                  const Arguments& arguments,
+                  const std::vector<std::string>& keys) {
+  // The size of a standard bloom filter with the optimal hash count for the
+  // false positive rate, rounded up to whole words.
+  const double ln2 = std::log(2.0);
+  const double bits = -static_cast<double>(keys.size()) *
+                      std::log(arguments.false_positive_rate) / (ln2 * ln2);
+  const size_t size = std::max<size_t>(
+      (static_cast<size_t>(std::ceil(bits)) + 63) / 64 * 64, 64);
+  const Bloom::Options options = Bloom::Options::ForFalsePositiveRate(
+      size, arguments.false_positive_rate);
+
+  output << "// Generated by bloom-generate for " << keys.size()
+         << " keys at a false positive rate of "
+         << arguments.false_positive_rate << ".\n"
+         << "// Do not edit.\n\n"
+         << "#pragma once\n\n"
+         << "#include <bloom/static-filter.hpp>\n\n"
+         << "constexpr Bloom::StaticKey " << arguments.name << "Keys[] = {\n";
+  for (const std::string& key : keys) {
+    output << "    Bloom::StaticKey(\"" << escape(key) << "\"),\n";
+  }
+  output << "};\n\n"
+         << "constexpr auto " << arguments.name << " =\n"
+         << "    Bloom::StaticFilter<" << options.size << ", "
+         << options.hash_count << ", Bloom::WyHasher>::build(\n"
+         << "        " << arguments.name << "Keys, Bloom::WyHasher(0x"
+         << std::hex << arguments.seed << std::dec << "ULL));\n";
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  try {
+    const Arguments arguments = parse_arguments(argc, argv);
+
+    std::vector<std::string> keys;
+    if (arguments.input.empty()) {
+      keys = read_keys(std::cin);
+    } else {
+      std::ifstream input(arguments.input);
+      if (!input) {
+        throw std::runtime_error("could not open " + arguments.input);
+      }
+      keys = read_keys(input);
+    }
+    if (keys.empty()) {
+      throw std::invalid_argument("no keys given");
+    }
+
+    // Generate the whole header first, so that nothing is written on failure.
+    std::ostringstream header;
+    write_header(header, arguments, keys);
+    if (arguments.output.empty()) {
+      std::cout << header.str();
+    } else {
+      std::ofstream output(arguments.output);
+      if (!(output << header.str())) {
+        throw std::runtime_error("could not write " + arguments.output);
+      }
+    }
+  } catch (const std::exception& error) {
+    std::cerr << "bloom-generate: " << error.what() << "\n";
+    return 1;
+  }
+  return 0;
+}